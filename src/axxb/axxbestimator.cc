@@ -0,0 +1,33 @@
+#include "axxbestimator.h"
+
+bool EstimateHandEyeWithRansac(const std::vector<MotionPair>& motionpairs,
+                               Pose* x, RansacSummary* ransacsummary)
+{
+    AXXBEstimator axxb_estimator;
+    RansacParameters params;
+    params.error_thresh = 0.01;
+    params.failure_probability = 0.001;
+    params.max_iterations = 500;
+    //  params.min_inlier_ratio = 0.6;
+    params.min_iterations = 50;
+    params.use_mle = true;
+    Ransac<AXXBEstimator> ransac_estimator(params,axxb_estimator);
+    // Initialize must always be called!
+    ransac_estimator.Initialize();
+    return ransac_estimator.Estimate(motionpairs, x, ransacsummary);
+}
+
+int CountHandEyeInliers(const std::vector<MotionPair>& motionpairs,
+                        const Pose& x, const double max_error)
+{
+    AXXBEstimator axxb_estimator;
+    int num_inliers = 0;
+    for (const MotionPair& motionpair : motionpairs)
+    {
+        if (axxb_estimator.Error(motionpair, x) < max_error)
+        {
+            num_inliers++;
+        }
+    }
+    return num_inliers;
+}
@@ -1,5 +1,6 @@
 #ifndef AXXBESTIMATOR_H
 #define AXXBESTIMATOR_H
+#include <algorithm>
 #include "../type.h"
 #include <theia/theia.h>
 #include"axxbsvdsolver.h"
@@ -10,11 +11,14 @@ using namespace theia;
 // Our "data".
 struct MotionPair
 {
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
     Pose A;
     Pose B;
     MotionPair() {}
-    MotionPair(Pose a,Pose b):A(a),B(b) {}
+    MotionPair(const Pose& a,const Pose& b):A(a),B(b) {}
 };
+// theia's Ransac takes the data as a plain std::vector.
+EIGEN_DEFINE_STL_VECTOR_SPECIALIZATION(MotionPair)
 
 // Our "model".
 //struct Transformation {
@@ -55,26 +59,38 @@ public:
     double Error(const MotionPair& motionpair, const Pose& trans) const
     {
         // AX=XB, so A=XBX-1
-        Pose A_predict = trans*motionpair.B*trans.inverse();
+        Pose A_predict = trans*motionpair.B*trans.Inverse();
         double error;
         // rotation error, using the rotation matrix difference
         //    Eigen::Matrix3d tmp = A_predict.topLeftCorner(3,3)-motionpair.A.topLeftCorner(3,3);
         //    Eigen::JacobiSVD<Eigen::MatrixXd> svd( tmp);
         //    error = (svd.singularValues())(0);
-        error = L2Norm(A_predict.topLeftCorner(3,3)-motionpair.A.topLeftCorner(3,3));
+        error = L2Norm(A_predict.Rotation()-motionpair.A.Rotation());
         // as there is an unknown scale factor, so the error is
         // min(||lambda*A_translation-A_translation_predict||^2)
         // = ||A_translation||^2*lambda^2-2*dot(A_translation,A_translation_predict)*lambda+||A_translation_predict||^2
         // this is a quadratic function to lambda, its minimal is
         // ||A_translation_predict||^2 -  dot(A_translation,A_translation_predict)^2/||A_translation||^2
-        Eigen::Vector3d A_translation_predict = A_predict.topRightCorner(3,1);
-        Eigen::Vector3d A_translation = motionpair.A.topRightCorner(3,1);
+        Eigen::Vector3d A_translation_predict = A_predict.Translation();
+        Eigen::Vector3d A_translation = motionpair.A.Translation();
         double a = A_translation.squaredNorm();
         double b = A_translation_predict.dot(A_translation);
         double c = A_translation_predict.squaredNorm();
-        error += 0.1*std::sqrt(c - b*b/a);
+        // rounding can make it slightly negative for an exact motion pair
+        error += 0.1*std::sqrt(std::max(0.0, c - b*b/a));
         return error;
     }
 };
 
+// Robustly estimates the hand-eye transformation X from motion pairs with
+// AX=XB, A the camera motion and B the hand motion, using AXXBEstimator in
+// RANSAC. Returns false if RANSAC fails.
+bool EstimateHandEyeWithRansac(const std::vector<MotionPair>& motionpairs,
+                               Pose* x, RansacSummary* ransacsummary);
+
+// Number of motion pairs whose AXXBEstimator error for x is below max_error,
+// e.g. to check a prior X without RANSAC.
+int CountHandEyeInliers(const std::vector<MotionPair>& motionpairs,
+                        const Pose& x, const double max_error);
+
 #endif // AXXBESTIMATOR_H
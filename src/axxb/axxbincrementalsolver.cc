@@ -0,0 +1,38 @@
+#include "axxbincrementalsolver.h"
+#include<Eigen/Eigenvalues>
+#include<glog/logging.h>
+#include "axxbsvdsolver.h"
+
+AXXBIncrementalSolver::AXXBIncrementalSolver(double forgetting_factor)
+    : forgetting_factor_(forgetting_factor)
+{
+    CHECK(forgetting_factor_>0.0 && forgetting_factor_<=1.0)
+            <<"the forgetting factor must be in (0,1]";
+    Reset();
+}
+
+void AXXBIncrementalSolver::AddMotionPair(const Pose& A, const Pose& B)
+{
+    const Eigen::Matrix<double,12,12> m = AXXBMotionPairRows(A,B);
+    normal_matrix_ *= forgetting_factor_;
+    normal_matrix_.noalias() += m.transpose()*m;
+    num_motion_pairs_++;
+}
+
+bool AXXBIncrementalSolver::SolveX(Pose* x) const
+{
+    if(num_motion_pairs_<2)
+        return false;
+    // eigenvalues are sorted in increasing order
+    Eigen::SelfAdjointEigenSolver<Eigen::Matrix<double,12,12> > eigen_solver(normal_matrix_);
+    if(eigen_solver.info()!=Eigen::Success)
+        return false;
+    *x = AXXBSolutionFromNullVector(eigen_solver.eigenvectors().col(0));
+    return true;
+}
+
+void AXXBIncrementalSolver::Reset()
+{
+    normal_matrix_.setZero();
+    num_motion_pairs_ = 0;
+}
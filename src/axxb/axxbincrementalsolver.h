@@ -0,0 +1,36 @@
+#ifndef AXXBINCREMENTALSOLVER_H
+#define AXXBINCREMENTALSOLVER_H
+
+#include<Eigen/Core>
+#include"../type.h"
+
+// Solves AX=XB from a stream of motion pairs. Instead of stacking all pairs
+// like AXXBSVDSolver it accumulates the 12x12 normal matrix M'M, so adding a
+// pair and solving cost O(1) in the number of pairs. Its smallest
+// eigenvector is the smallest right singular vector of the stacked system.
+class AXXBIncrementalSolver
+{
+public:
+    // The accumulated normal matrix is scaled by forgetting_factor in (0,1]
+    // before each new pair, so old motions fade out and a drifting X can be
+    // tracked. 1 weights all pairs equally.
+    explicit AXXBIncrementalSolver(double forgetting_factor = 1.0);
+
+    void AddMotionPair(const Pose& A, const Pose& B);
+    int NumMotionPairs() const
+    {
+        return num_motion_pairs_;
+    }
+
+    // Needs at least two motion pairs.
+    bool SolveX(Pose* x) const;
+
+    void Reset();
+
+private:
+    double forgetting_factor_;
+    Eigen::Matrix<double,12,12> normal_matrix_;
+    int num_motion_pairs_;
+};
+
+#endif // AXXBINCREMENTALSOLVER_H
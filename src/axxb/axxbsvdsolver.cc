@@ -7,33 +7,28 @@
 #include "../handeyecalibration_utils.h"
 #include<fstream>
 
-Pose AXXBSVDSolver::SolveX()
+Eigen::Matrix<double,12,12> AXXBMotionPairRows(const Pose& A, const Pose& B)
 {
-    CHECK(A_.size()==B_.size())<<"two sizes should be equal";
-    CHECK(A_.size()>=2)<<"at least two motions are needed";
-
-    Eigen::MatrixXd m = Eigen::MatrixXd::Zero(12*A_.size(),12);
-    for(int i=0; i<A_.size(); i++)
-    {
-        //extract R,t from homogophy matrix
-        Eigen::Matrix3d Ra = A_[i].topLeftCorner(3,3);
-        Eigen::Vector3d Ta = A_[i].topRightCorner(3,1);
-        Eigen::Matrix3d Rb = B_[i].topLeftCorner(3,3);
-        Eigen::Vector3d Tb = B_[i].topRightCorner(3,1);
-
-        m.block<9,9>(12*i,0) = Eigen::MatrixXd::Identity(9,9) - Eigen::kroneckerProduct(Ra,Rb);
-        Eigen::Matrix3d Ta_skew = skew(Ta);
-        m.block<3,9>(12*i+9,0) = Eigen::kroneckerProduct(Ta_skew,Tb.transpose());
-        m.block<3,3>(12*i+9,9) = Ta_skew - Ta_skew*Ra;
-    }
+    //extract R,t from rigid transformation
+    Eigen::Matrix3d Ra = A.Rotation();
+    Eigen::Vector3d Ta = A.Translation();
+    Eigen::Matrix3d Rb = B.Rotation();
+    Eigen::Vector3d Tb = B.Translation();
 
-    Eigen::JacobiSVD<Eigen::MatrixXd> svd( m, Eigen::ComputeFullV | Eigen::ComputeFullU );
-    CHECK(svd.computeV())<<"fail to compute V";
+    Eigen::Matrix<double,12,12> m = Eigen::Matrix<double,12,12>::Zero();
+    m.block<9,9>(0,0) = Eigen::MatrixXd::Identity(9,9) - Eigen::kroneckerProduct(Ra,Rb);
+    Eigen::Matrix3d Ta_skew = skew(Ta);
+    m.block<3,9>(9,0) = Eigen::kroneckerProduct(Ta_skew,Tb.transpose());
+    m.block<3,3>(9,9) = Ta_skew - Ta_skew*Ra;
+    return m;
+}
 
+Pose AXXBSolutionFromNullVector(const Eigen::Matrix<double,12,1>& v)
+{
     Eigen::Matrix3d R_alpha;
-    R_alpha.row(0) = svd.matrixV().block<3,1>(0,11).transpose();
-    R_alpha.row(1) = svd.matrixV().block<3,1>(3,11).transpose();
-    R_alpha.row(2) = svd.matrixV().block<3,1>(6,11).transpose();
+    R_alpha.row(0) = v.segment<3>(0).transpose();
+    R_alpha.row(1) = v.segment<3>(3).transpose();
+    R_alpha.row(2) = v.segment<3>(6).transpose();
 
     //  double alpha = R_alpha.determinant()/(pow(std::fabs(R_alpha.determinant()),4./3.));
     double det = R_alpha.determinant();
@@ -41,15 +36,43 @@ Pose AXXBSVDSolver::SolveX()
 
     Eigen::HouseholderQR<Eigen::Matrix3d> qr(R_alpha/alpha);
 
-    Pose handeyetransformation = Pose::Identity(4,4);
+    Eigen::Matrix3d handeyerotation;
     Eigen::Matrix3d Q = qr.householderQ();
     Eigen::Matrix3d Rwithscale = alpha*Q.transpose()*R_alpha;
     Eigen::Vector3d R_diagonal = Rwithscale.diagonal();
     for(int i=0; i<3; i++)
     {
-        handeyetransformation.block<3,1>(0,i) = int(R_diagonal(i)>=0?1:-1)*Q.col(i);
+        handeyerotation.col(i) = int(R_diagonal(i)>=0?1:-1)*Q.col(i);
     }
+    // A zero or noisy diagonal can flip one sign too many and leave a
+    // reflection, which Pose would turn into an unrelated rotation. Take the
+    // nearest rotation to R_alpha/alpha instead.
+    if (handeyerotation.determinant() < 0.0)
+    {
+        Eigen::JacobiSVD<Eigen::Matrix3d> svd(R_alpha/alpha,
+                                              Eigen::ComputeFullU | Eigen::ComputeFullV);
+        Eigen::Matrix3d sign = Eigen::Matrix3d::Identity();
+        sign(2,2) = (svd.matrixU()*svd.matrixV().transpose()).determinant();
+        handeyerotation = svd.matrixU()*sign*svd.matrixV().transpose();
+    }
+
+    Eigen::Vector3d handeyetranslation = v.segment<3>(9)/alpha;
+    return Pose(handeyerotation, handeyetranslation);
+}
+
+Pose AXXBSVDSolver::SolveX()
+{
+    CHECK(A_.size()==B_.size())<<"two sizes should be equal";
+    CHECK(A_.size()>=2)<<"at least two motions are needed";
+
+    Eigen::MatrixXd m = Eigen::MatrixXd::Zero(12*A_.size(),12);
+    for(int i=0; i<A_.size(); i++)
+    {
+        m.block<12,12>(12*i,0) = AXXBMotionPairRows(A_[i],B_[i]);
+    }
+
+    Eigen::JacobiSVD<Eigen::MatrixXd> svd( m, Eigen::ComputeFullV | Eigen::ComputeFullU );
+    CHECK(svd.computeV())<<"fail to compute V";
 
-    handeyetransformation.topRightCorner(3,1) = svd.matrixV().block<3,1>(9,11)/alpha;
-    return handeyetransformation;
+    return AXXBSolutionFromNullVector(svd.matrixV().col(11));
 }
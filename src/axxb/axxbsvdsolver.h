@@ -9,4 +9,13 @@ public:
     Pose SolveX();
 };
 
+// The 12 rows of the linear AX=XB system contributed by one motion pair, in
+// the unknowns [vec(R_x); t_x]. The camera translation only enters by its
+// direction.
+Eigen::Matrix<double,12,12> AXXBMotionPairRows(const Pose& A, const Pose& B);
+
+// X from the (right) null vector of the stacked system, which is only
+// determined up to scale and sign.
+Pose AXXBSolutionFromNullVector(const Eigen::Matrix<double,12,1>& v);
+
 #endif // AXXBSVDSOLVER_H
@@ -0,0 +1,252 @@
+// Micro-benchmarks of the calibration hot paths on synthetic scenes, so no
+// images are needed. Build with -DSHECAR_BUILD_BENCHMARKS=ON and run
+// bin/shecar_benchmark, e.g. with --benchmark_filter=AXXB.
+
+#include <benchmark/benchmark.h>
+#include <theia/theia.h>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "../axxb/axxbestimator.h"
+#include "../axxb/axxbsvdsolver.h"
+#include "../hand_eye_bundle_adjustment.h"
+#include "../handeyereprojectionerror.h"
+#include "../handeyetrackestimator.h"
+#include "../handeyetransformation.h"
+#include "../synthetic_scene.h"
+#include "../type.h"
+
+namespace
+{
+
+// Motion pairs A = X*B*X^-1 of random hand motions B, with the camera
+// translation scaled to unit length as it comes out of SfM.
+std::vector<MotionPair> RandomMotionPairs(const int num_pairs)
+{
+    std::mt19937 random(0);
+    std::normal_distribution<double> normal(0.0, 1.0);
+    const Pose x(Eigen::Matrix3d(Eigen::AngleAxisd(0.3, Eigen::Vector3d::UnitY())),
+                 Eigen::Vector3d(0.05, -0.03, 0.12));
+    std::vector<MotionPair> motionpairs;
+    for (int i = 0; i < num_pairs; i++)
+    {
+        const Eigen::Vector3d axis(normal(random), normal(random), normal(random));
+        const Pose b(Eigen::Matrix3d(Eigen::AngleAxisd(0.5, axis.normalized())),
+                     Eigen::Vector3d(normal(random), normal(random), normal(random)));
+        const Pose a = x*b*x.Inverse();
+        motionpairs.emplace_back(Pose(a.Quaternion(), a.Translation().normalized()), b);
+    }
+    return motionpairs;
+}
+
+// A synthetic scene with its reconstruction, where the views are posed from
+// the true hand-eye transformation.
+struct BenchmarkScene
+{
+    SyntheticScene scene;
+    Reconstruction reconstruction;
+    HandEyeTransformation handeyetrans;
+
+    BenchmarkScene(const int num_views, const int num_points)
+    {
+        SyntheticSceneOptions options;
+        options.num_views = num_views;
+        options.num_points = num_points;
+        GenerateSyntheticScene(options, &scene, &reconstruction);
+        handeyetrans.SetHandEyePose(scene.handeye);
+    }
+
+    // Moves X and all points away from the truth, for the bundle adjustment
+    // to have something to do.
+    void Perturb()
+    {
+        const Pose perturbation(
+            Eigen::Matrix3d(Eigen::AngleAxisd(0.01, Eigen::Vector3d::UnitX())),
+            Eigen::Vector3d(0.005, 0.0, -0.005));
+        handeyetrans.SetHandEyePose(perturbation*scene.handeye);
+        for (int i = 0; i < scene.points.size(); i++)
+        {
+            *reconstruction.MutableTrack(i)->MutablePoint() =
+                (scene.points[i] + Eigen::Vector3d::Constant(0.002)).homogeneous();
+        }
+    }
+};
+
+BundleAdjustmentOptions BenchmarkBundleAdjustmentOptions()
+{
+    BundleAdjustmentOptions options;
+    options.num_threads = 1;
+    options.verbose = false;
+    return options;
+}
+
+}  // namespace
+
+static void BM_AXXBSVDSolverSolveX(benchmark::State& state)
+{
+    const std::vector<MotionPair> motionpairs = RandomMotionPairs(state.range(0));
+    Poses a, b;
+    for (const MotionPair& motionpair : motionpairs)
+    {
+        a.emplace_back(motionpair.A);
+        b.emplace_back(motionpair.B);
+    }
+    for (auto _ : state)
+    {
+        AXXBSVDSolver solver(a, b);
+        benchmark::DoNotOptimize(solver.SolveX());
+    }
+    state.SetComplexityN(state.range(0));
+}
+BENCHMARK(BM_AXXBSVDSolverSolveX)->RangeMultiplier(4)->Range(2, 512)->Complexity();
+
+static void BM_AXXBEstimatorError(benchmark::State& state)
+{
+    const std::vector<MotionPair> motionpairs = RandomMotionPairs(1024);
+    const AXXBEstimator estimator;
+    const Pose x = Pose(Eigen::Matrix3d(Eigen::AngleAxisd(0.3, Eigen::Vector3d::UnitY())),
+                        Eigen::Vector3d(0.05, -0.03, 0.12));
+    for (auto _ : state)
+    {
+        for (const MotionPair& motionpair : motionpairs)
+        {
+            benchmark::DoNotOptimize(estimator.Error(motionpair, x));
+        }
+    }
+    state.SetItemsProcessed(state.iterations()*motionpairs.size());
+}
+BENCHMARK(BM_AXXBEstimatorError);
+
+// Evaluates the reprojection error of every observation of the scene through
+// the ceres cost function, as the bundle adjustment does.
+static void ReprojectionErrorBenchmark(benchmark::State& state,
+                                       const bool with_jacobians)
+{
+    BenchmarkScene scene(20, 500);
+    Reconstruction& reconstruction = scene.reconstruction;
+    std::vector<std::unique_ptr<ceres::CostFunction> > cost_functions;
+    std::vector<std::vector<const double*> > parameters;
+    for (const ViewId view_id : reconstruction.ViewIds())
+    {
+        const View* view = reconstruction.View(view_id);
+        for (const TrackId track_id : view->TrackIds())
+        {
+            cost_functions.emplace_back(HandEyeReprojectionError::Create(
+                                            *view->GetFeature(track_id),
+                                            scene.scene.handposes[view_id]));
+            parameters.push_back({scene.handeyetrans.HandEyeParameter(),
+                                  view->Camera().intrinsics(),
+                                  reconstruction.Track(track_id)->Point().data()
+                                 });
+        }
+    }
+
+    double residuals[2];
+    double jacobian_handeye[2*6];
+    double jacobian_intrinsics[2*Camera::kIntrinsicsSize];
+    double jacobian_point[2*4];
+    double* jacobians[3] = {jacobian_handeye, jacobian_intrinsics, jacobian_point};
+    for (auto _ : state)
+    {
+        for (int i = 0; i < cost_functions.size(); i++)
+        {
+            benchmark::DoNotOptimize(cost_functions[i]->Evaluate(
+                                         parameters[i].data(), residuals,
+                                         with_jacobians ? jacobians : nullptr));
+        }
+    }
+    state.SetItemsProcessed(state.iterations()*cost_functions.size());
+}
+
+static void BM_ReprojectionError(benchmark::State& state)
+{
+    ReprojectionErrorBenchmark(state, false);
+}
+BENCHMARK(BM_ReprojectionError);
+
+static void BM_ReprojectionErrorWithJacobians(benchmark::State& state)
+{
+    ReprojectionErrorBenchmark(state, true);
+}
+BENCHMARK(BM_ReprojectionErrorWithJacobians);
+
+// Triangulates the tracks one by one, with or without the per-track bundle
+// adjustment, from the number of views given by the argument.
+static void HandEyeEstimateTrackBenchmark(benchmark::State& state,
+        const bool bundle_adjust)
+{
+    BenchmarkScene scene(state.range(0), 200);
+    TrackEstimator::Options options;
+    options.bundle_adjustment = bundle_adjust;
+    options.ba_options = BenchmarkBundleAdjustmentOptions();
+    options.num_threads = 1;
+    HandEyeTrackEstimator track_estimator(options, &scene.reconstruction,
+                                          &scene.scene.handposes,
+                                          &scene.handeyetrans);
+    const int num_tracks = scene.scene.points.size();
+    int track_id = 0;
+    for (auto _ : state)
+    {
+        scene.reconstruction.MutableTrack(track_id)->SetEstimated(false);
+        benchmark::DoNotOptimize(track_estimator.HandEyeEstimateTrack(track_id));
+        track_id = (track_id + 1) % num_tracks;
+    }
+}
+
+static void BM_HandEyeEstimateTrack(benchmark::State& state)
+{
+    HandEyeEstimateTrackBenchmark(state, false);
+}
+BENCHMARK(BM_HandEyeEstimateTrack)->Arg(5)->Arg(20);
+
+static void BM_HandEyeEstimateTrackWithBundleAdjustment(benchmark::State& state)
+{
+    HandEyeEstimateTrackBenchmark(state, true);
+}
+BENCHMARK(BM_HandEyeEstimateTrackWithBundleAdjustment)->Arg(5)->Arg(20);
+
+static void BM_BundleAdjustTrack(benchmark::State& state)
+{
+    BenchmarkScene scene(state.range(0), 200);
+    scene.Perturb();
+    const BundleAdjustmentOptions options = BenchmarkBundleAdjustmentOptions();
+    const int num_tracks = scene.scene.points.size();
+    int track_id = 0;
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(BundleAdjustTrack(options, track_id,
+                                 &scene.reconstruction,
+                                 &scene.scene.handposes,
+                                 &scene.handeyetrans));
+        track_id = (track_id + 1) % num_tracks;
+    }
+}
+BENCHMARK(BM_BundleAdjustTrack)->Arg(5)->Arg(20);
+
+// Full hand-eye bundle adjustment from a perturbed start, for views x points.
+static void BM_BundleAdjustHandEye(benchmark::State& state)
+{
+    BenchmarkScene scene(state.range(0), state.range(1));
+    BundleAdjustmentOptions options = BenchmarkBundleAdjustmentOptions();
+    options.num_threads = state.range(2);
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        scene.Perturb();
+        state.ResumeTiming();
+        benchmark::DoNotOptimize(BundleAdjusthandEye(options,
+                                 &scene.reconstruction,
+                                 &scene.scene.handposes,
+                                 &scene.handeyetrans));
+    }
+    state.counters["tracks"] = scene.scene.points.size();
+}
+BENCHMARK(BM_BundleAdjustHandEye)
+->Args({10, 500, 1})
+->Args({20, 2000, 1})
+->Args({40, 5000, 1})
+->Args({40, 5000, 4})
+->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,499 @@
+// End-to-end regression benchmark: runs BuildHandEyeCalibration on
+// data/monocular and on synthetic scenes of increasing size, and records for
+// each case the wall time, the peak memory and the error of X against the
+// ground truth, or against a reference result for the real data.
+//
+// Every case runs in a child process of its own, so that its peak resident
+// set size is its own and a crash fails only that case. The results are
+// written as one CSV line per case, the per-stage breakdown of every case to
+// <results_file>.<case>.profile.json. Given the results of an earlier run
+// with --baseline, the run fails when a case got slower, bigger or less
+// accurate than the thresholds allow:
+//
+//   ./bin/shecar_regression --results_file=before.csv
+//   (apply the change)
+//   ./bin/shecar_regression --results_file=after.csv --baseline=before.csv
+
+#include <glog/logging.h>
+#include <gflags/gflags.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <theia/theia.h>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "../handeye_calibration.h"
+#include "../handeye_profiler.h"
+#include "../handeyecalibration_utils.h"
+#include "../handeyecalibrationbuilder.h"
+#include "../handeyetransformation.h"
+#include "../synthetic_scene.h"
+#include "../type.h"
+
+DEFINE_string(monocular_directory, "data/monocular",
+              "Directory with the *.jpg images, handposes.txt and "
+              "intrinsic.txt of the real data case. Empty to skip it.");
+DEFINE_string(monocular_reference_hand_eye, "",
+              "Reference X of the real data, in the --hand_poses_file format. "
+              "If empty, the X of the baseline is the reference.");
+DEFINE_string(synthetic_scenes, "20x2000,80x10000,320x40000x16",
+              "Comma separated synthetic cases, each VIEWSxPOINTS or "
+              "VIEWSxPOINTSxPATH_LENGTH, see generate_synthetic_scene.");
+DEFINE_double(synthetic_pixel_noise, 0.5,
+              "Standard deviation in pixels of the noise of the features.");
+DEFINE_double(synthetic_outlier_ratio, 0.1,
+              "Fraction of the synthetic matches that are outliers.");
+DEFINE_int32(synthetic_max_view_distance, 10,
+             "Only synthetic views i and j with |i - j| <= this are matched.");
+DEFINE_int32(num_threads, 1,
+             "Number of threads of every case. Keep it fixed between the "
+             "baseline and the run for comparable times.");
+DEFINE_string(results_file, "regression_results.csv",
+              "File to write the results to.");
+DEFINE_string(baseline, "", "Results file of an earlier run to compare to.");
+DEFINE_double(max_rotation_error_degrees, 0.5,
+              "Maximal rotation error of X of any case.");
+DEFINE_double(max_translation_error, 0.01,
+              "Maximal translation error of X of any case, in the unit of the "
+              "hand poses.");
+DEFINE_double(max_time_increase, 0.25,
+              "Maximal relative increase of the wall time of a case over the "
+              "baseline.");
+DEFINE_double(min_time_seconds_to_compare, 1.0,
+              "Cases faster than this in the baseline are too noisy for the "
+              "time gate.");
+DEFINE_double(max_memory_increase, 0.25,
+              "Maximal relative increase of the peak memory of a case over "
+              "the baseline.");
+
+namespace
+{
+
+const double kRadToDeg = 180.0/M_PI;
+
+struct RegressionCase
+{
+    std::string name;
+    // Synthetic scenes only.
+    int num_views = 0;
+    int num_points = 0;
+    double path_length = 0.0;
+};
+
+struct RegressionResult
+{
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+    std::string name;
+    bool success = false;
+    int num_views = 0;
+    int num_tracks = 0;
+    double wall_time_seconds = 0.0;
+    long peak_rss_kb = 0;
+    // NaN when there is nothing to compare to.
+    double rotation_error_degrees = std::numeric_limits<double>::quiet_NaN();
+    double translation_error = std::numeric_limits<double>::quiet_NaN();
+    Pose handeye;
+};
+
+// By case name.
+typedef std::map<std::string, RegressionResult, std::less<std::string>,
+        Eigen::aligned_allocator<std::pair<const std::string, RegressionResult> > >
+        RegressionResults;
+
+const char kResultsHeader[] =
+    "case,success,num_views,num_tracks,wall_time_seconds,peak_rss_kb,"
+    "rotation_error_degrees,translation_error,"
+    "r11,r21,r31,r12,r22,r32,r13,r23,r33,tx,ty,tz";
+
+std::string FormatResult(const RegressionResult& result)
+{
+    std::ostringstream line;
+    line.precision(17);
+    line << result.name << "," << result.success << "," << result.num_views
+         << "," << result.num_tracks << "," << result.wall_time_seconds << ","
+         << result.peak_rss_kb << "," << result.rotation_error_degrees << ","
+         << result.translation_error;
+    const Eigen::Matrix3d rotation = result.handeye.Rotation();
+    for (int count = 0; count < 9; count++)
+    {
+        line << "," << rotation(count%3,count/3);
+    }
+    for (int i = 0; i < 3; i++)
+    {
+        line << "," << result.handeye.Translation()(i);
+    }
+    return line.str();
+}
+
+bool ParseResult(const std::string& line, RegressionResult* result)
+{
+    std::stringstream lineStream(line);
+    std::vector<std::string> cells;
+    std::string cell;
+    while (std::getline(lineStream, cell, ','))
+    {
+        cells.emplace_back(cell);
+    }
+    if (cells.size() != 20)
+    {
+        return false;
+    }
+    result->name = cells[0];
+    result->success = cells[1] == "1";
+    result->num_views = std::stoi(cells[2]);
+    result->num_tracks = std::stoi(cells[3]);
+    result->wall_time_seconds = std::stod(cells[4]);
+    result->peak_rss_kb = std::stol(cells[5]);
+    result->rotation_error_degrees = std::stod(cells[6]);
+    result->translation_error = std::stod(cells[7]);
+    Eigen::Matrix3d rotation;
+    for (int count = 0; count < 9; count++)
+    {
+        rotation(count%3,count/3) = std::stod(cells[8 + count]);
+    }
+    result->handeye = Pose(rotation, Eigen::Vector3d(std::stod(cells[17]),
+                           std::stod(cells[18]),
+                           std::stod(cells[19])));
+    return true;
+}
+
+bool ReadResults(const std::string& filename, RegressionResults* results)
+{
+    std::ifstream indata(filename);
+    if (!indata.is_open())
+    {
+        LOG(ERROR) << "Could not open results file " << filename;
+        return false;
+    }
+    std::string line;
+    while (std::getline(indata, line))
+    {
+        if (line.empty() || line == kResultsHeader)
+        {
+            continue;
+        }
+        RegressionResult result;
+        if (!ParseResult(line, &result))
+        {
+            LOG(ERROR) << "Invalid result in " << filename << ": " << line;
+            return false;
+        }
+        (*results)[result.name] = result;
+    }
+    return true;
+}
+
+void SetHandEyeError(const Pose& reference, RegressionResult* result)
+{
+    result->rotation_error_degrees = kRadToDeg*result->handeye.Quaternion()
+                                     .angularDistance(reference.Quaternion());
+    result->translation_error =
+        (result->handeye.Translation() - reference.Translation()).norm();
+}
+
+// The options of SHECAR with its default flags.
+ReconstructionBuilderOptions RegressionBuilderOptions()
+{
+    ReconstructionBuilderOptions options = DefaultHandEyeBuilderOptions();
+    options.num_threads = FLAGS_num_threads;
+    options.reconstruction_estimator_options.num_threads = FLAGS_num_threads;
+    return options;
+}
+
+// Calibrates the images of --monocular_directory as SHECAR does, with the
+// hand poses paired to the images by the index in their filenames. The error
+// is set later, from the reference.
+RegressionResult RunMonocularCase(HandEyeProfiler* profiler)
+{
+    RegressionResult result;
+    const std::string directory = FLAGS_monocular_directory + "/";
+    HandEyeCalibrationFrames frames;
+    CHECK(ReadHandEyeCalibrationFrames(directory + "handposes.txt",
+                                       directory + "*.jpg",
+                                       directory + "intrinsic.txt", &frames));
+
+    HandEyeCalibrationOptions options;
+    options.builder_options = RegressionBuilderOptions();
+    options.profiler = profiler;
+    HandEyeCalibrationResult calibration;
+    result.success = CalibrateHandEye(options, frames, &calibration);
+    LOG_IF(ERROR, !result.success) << calibration.message;
+    result.handeye = calibration.handeye.GetHandEyePose();
+    if (calibration.reconstruction != nullptr)
+    {
+        result.num_views = calibration.reconstruction->NumViews();
+        result.num_tracks = calibration.reconstruction->NumTracks();
+    }
+    return result;
+}
+
+// Calibrates a synthetic scene from its matches, and measures the error
+// against its ground truth X.
+RegressionResult RunSyntheticCase(const RegressionCase& regression_case,
+                                  HandEyeProfiler* profiler)
+{
+    RegressionResult result;
+    SyntheticSceneOptions scene_options;
+    scene_options.num_views = regression_case.num_views;
+    scene_options.num_points = regression_case.num_points;
+    scene_options.path_length = regression_case.path_length;
+    scene_options.pixel_noise = FLAGS_synthetic_pixel_noise;
+    SyntheticScene scene;
+    Reconstruction ground_truth;
+    GenerateSyntheticScene(scene_options, &scene, &ground_truth);
+
+    SyntheticMatchesOptions matches_options;
+    matches_options.outlier_ratio = FLAGS_synthetic_outlier_ratio;
+    matches_options.max_view_distance = FLAGS_synthetic_max_view_distance;
+    const std::vector<ImagePairMatch> matches =
+        GenerateSyntheticMatches(matches_options, ground_truth);
+
+    HandEyeCalibrationBuilder builder(RegressionBuilderOptions());
+    builder.SetProfiler(profiler);
+    {
+        ScopedStageTimer stage_timer(profiler, "read_matches");
+        for (ViewId view_id = 0; view_id < ground_truth.NumViews(); view_id++)
+        {
+            const View* view = ground_truth.View(view_id);
+            CHECK(builder.AddImageWithCameraIntrinsicsPrior(
+                      view->Name(), view->CameraIntrinsicsPrior(),
+                      kInvalidCameraIntrinsicsGroupId));
+        }
+        for (const ImagePairMatch& match : matches)
+        {
+            CHECK(builder.AddTwoViewMatch(match.image1, match.image2, match));
+        }
+    }
+    builder.SetHandPoses(&scene.handposes);
+
+    HandEyeTransformation handeyetrans;
+    result.success = builder.BuildHandEyeCalibration(&handeyetrans);
+    result.handeye = handeyetrans.GetHandEyePose();
+    SetHandEyeError(scene.handeye, &result);
+    const std::unique_ptr<Reconstruction> reconstruction =
+        builder.GetReconstruction();
+    if (reconstruction != nullptr)
+    {
+        result.num_views = reconstruction->NumViews();
+        result.num_tracks = reconstruction->NumTracks();
+    }
+    return result;
+}
+
+// Runs the case in a child process, which sends its result line back through
+// a pipe. The peak memory is the one of the child alone.
+RegressionResult RunCase(const RegressionCase& regression_case)
+{
+    // Whatever is buffered would otherwise be written by both processes.
+    std::cout.flush();
+    std::fflush(nullptr);
+    int result_pipe[2];
+    CHECK_EQ(pipe(result_pipe), 0);
+    const pid_t pid = fork();
+    CHECK_GE(pid, 0) << "Could not fork.";
+    if (pid == 0)
+    {
+        close(result_pipe[0]);
+        HandEyeProfiler profiler;
+        RegressionResult result = regression_case.name == "monocular" ?
+                                  RunMonocularCase(&profiler) :
+                                  RunSyntheticCase(regression_case, &profiler);
+        result.name = regression_case.name;
+        result.wall_time_seconds = profiler.TotalWallTimeInSeconds();
+        std::cout << regression_case.name << ":\n" << profiler.Report();
+        const std::string profile_file =
+            FLAGS_results_file + "." + regression_case.name + ".profile.json";
+        LOG_IF(WARNING, !profiler.WriteJson(profile_file))
+                << "Could not write the profile report to " << profile_file;
+
+        const std::string line = FormatResult(result) + "\n";
+        CHECK_EQ(write(result_pipe[1], line.data(), line.size()),
+                 static_cast<ssize_t>(line.size()));
+        close(result_pipe[1]);
+        std::fflush(nullptr);
+        _exit(0);
+    }
+
+    close(result_pipe[1]);
+    std::string line;
+    char buffer[256];
+    ssize_t n;
+    while ((n = read(result_pipe[0], buffer, sizeof(buffer))) > 0)
+    {
+        line.append(buffer, n);
+    }
+    close(result_pipe[0]);
+    int status;
+    rusage usage;
+    CHECK_EQ(wait4(pid, &status, 0, &usage), pid);
+
+    RegressionResult result;
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0 ||
+            !ParseResult(line.substr(0, line.find('\n')), &result))
+    {
+        LOG(ERROR) << "Case " << regression_case.name << " crashed.";
+        result = RegressionResult();
+        result.name = regression_case.name;
+        result.success = false;
+    }
+    // ru_maxrss is in kilobytes on Linux.
+    result.peak_rss_kb = usage.ru_maxrss;
+    return result;
+}
+
+std::vector<RegressionCase> RegressionCases()
+{
+    std::vector<RegressionCase> cases;
+    if (FLAGS_monocular_directory.size() != 0)
+    {
+        RegressionCase monocular;
+        monocular.name = "monocular";
+        cases.emplace_back(monocular);
+    }
+    std::stringstream scenes(FLAGS_synthetic_scenes);
+    std::string scene;
+    while (std::getline(scenes, scene, ','))
+    {
+        RegressionCase synthetic;
+        synthetic.name = "synthetic_" + scene;
+        std::vector<std::string> sizes;
+        std::stringstream sceneStream(scene);
+        std::string size;
+        while (std::getline(sceneStream, size, 'x'))
+        {
+            sizes.emplace_back(size);
+        }
+        CHECK(sizes.size() == 2 || sizes.size() == 3)
+                << "Invalid synthetic scene " << scene;
+        synthetic.num_views = std::stoi(sizes[0]);
+        synthetic.num_points = std::stoi(sizes[1]);
+        if (sizes.size() == 3)
+        {
+            synthetic.path_length = std::stod(sizes[2]);
+        }
+        cases.emplace_back(synthetic);
+    }
+    return cases;
+}
+
+// Appends a message for every threshold the result exceeds.
+void CheckResult(const RegressionResult& result,
+                 const RegressionResult* baseline,
+                 std::vector<std::string>* regressions)
+{
+    std::ostringstream message;
+    if (!result.success)
+    {
+        message << result.name << ": calibration failed";
+        regressions->emplace_back(message.str());
+        return;
+    }
+    // Comparisons with NaN are false, so a case without reference passes.
+    if (result.rotation_error_degrees > FLAGS_max_rotation_error_degrees)
+    {
+        message << result.name << ": rotation error "
+                << result.rotation_error_degrees << " deg > "
+                << FLAGS_max_rotation_error_degrees;
+        regressions->emplace_back(message.str());
+        message.str("");
+    }
+    if (result.translation_error > FLAGS_max_translation_error)
+    {
+        message << result.name << ": translation error "
+                << result.translation_error << " > " << FLAGS_max_translation_error;
+        regressions->emplace_back(message.str());
+        message.str("");
+    }
+    if (baseline == nullptr || !baseline->success)
+    {
+        return;
+    }
+    if (baseline->wall_time_seconds >= FLAGS_min_time_seconds_to_compare &&
+            result.wall_time_seconds >
+            (1.0 + FLAGS_max_time_increase)*baseline->wall_time_seconds)
+    {
+        message << result.name << ": wall time " << result.wall_time_seconds
+                << "s, baseline " << baseline->wall_time_seconds << "s";
+        regressions->emplace_back(message.str());
+        message.str("");
+    }
+    if (result.peak_rss_kb >
+            (1.0 + FLAGS_max_memory_increase)*baseline->peak_rss_kb)
+    {
+        message << result.name << ": peak memory " << result.peak_rss_kb
+                << " kB, baseline " << baseline->peak_rss_kb << " kB";
+        regressions->emplace_back(message.str());
+    }
+}
+
+}  // namespace
+
+int main(int argc, char *argv[])
+{
+    google::ParseCommandLineFlags(&argc, &argv, true);
+    google::InitGoogleLogging(argv[0]);
+
+    RegressionResults baseline;
+    if (FLAGS_baseline.size() != 0)
+    {
+        CHECK(ReadResults(FLAGS_baseline, &baseline))
+                << "Could not read the baseline " << FLAGS_baseline;
+    }
+    Pose monocular_reference;
+    bool has_monocular_reference = false;
+    if (FLAGS_monocular_reference_hand_eye.size() != 0)
+    {
+        Poses reference;
+        CHECK(ReadHandPoses(FLAGS_monocular_reference_hand_eye, &reference) &&
+              reference.size() == 1)
+                << "Could not read the reference hand-eye transformation in "
+                << FLAGS_monocular_reference_hand_eye;
+        monocular_reference = reference[0];
+        has_monocular_reference = true;
+    }
+    else if (baseline.count("monocular") != 0 && baseline["monocular"].success)
+    {
+        monocular_reference = baseline["monocular"].handeye;
+        has_monocular_reference = true;
+    }
+
+    std::ofstream results_file(FLAGS_results_file);
+    CHECK(results_file.is_open()) << "Could not open " << FLAGS_results_file;
+    results_file << kResultsHeader << "\n";
+    std::vector<std::string> regressions;
+    for (const RegressionCase& regression_case : RegressionCases())
+    {
+        LOG(INFO) << "Running " << regression_case.name;
+        RegressionResult result = RunCase(regression_case);
+        if (regression_case.name == "monocular" && result.success &&
+                has_monocular_reference)
+        {
+            SetHandEyeError(monocular_reference, &result);
+        }
+        results_file << FormatResult(result) << std::endl;
+        LOG(INFO) << regression_case.name << ": " << result.wall_time_seconds
+                  << "s, " << result.peak_rss_kb << " kB, X error "
+                  << result.rotation_error_degrees << " deg "
+                  << result.translation_error;
+
+        const auto baseline_result = baseline.find(regression_case.name);
+        CheckResult(result, baseline_result != baseline.end() ?
+                    &baseline_result->second : nullptr, &regressions);
+    }
+
+    for (const std::string& regression : regressions)
+    {
+        LOG(ERROR) << "Regression: " << regression;
+    }
+    return regressions.empty() ? 0 : 1;
+}
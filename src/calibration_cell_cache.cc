@@ -0,0 +1,84 @@
+#include "calibration_cell_cache.h"
+
+#include <glog/logging.h>
+
+size_t CalibrationCellNumBytes(const CalibrationCell& cell)
+{
+    return sizeof(cell) + cell.name.capacity() + cell.feature_cache.NumBytes();
+}
+
+CalibrationCellCache::CalibrationCellCache(const size_t max_num_bytes)
+    : max_num_bytes_(max_num_bytes) {}
+
+std::shared_ptr<CalibrationCell> CalibrationCellCache::Cell(
+    const std::string& name)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = cell_of_name_.find(name);
+    if (it != cell_of_name_.end())
+    {
+        cells_.splice(cells_.begin(), cells_, it->second);
+        return cells_.front();
+    }
+    std::shared_ptr<CalibrationCell> cell(new CalibrationCell);
+    cell->name = name;
+    cells_.push_front(cell);
+    cell_of_name_[name] = cells_.begin();
+    return cell;
+}
+
+void CalibrationCellCache::Shrink()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<size_t> num_bytes;
+    size_t total_num_bytes = 0;
+    for (const std::shared_ptr<CalibrationCell>& cell : cells_)
+    {
+        num_bytes.emplace_back(CalibrationCellNumBytes(*cell));
+        total_num_bytes += num_bytes.back();
+    }
+    while (total_num_bytes > max_num_bytes_ && cells_.size() > 1)
+    {
+        VLOG(1) << "Evicting the cell " << cells_.back()->name << " of "
+                << num_bytes.back() << " bytes.";
+        total_num_bytes -= num_bytes.back();
+        num_bytes.pop_back();
+        cell_of_name_.erase(cells_.back()->name);
+        cells_.pop_back();
+    }
+}
+
+bool CalibrationCellCache::Evict(const std::string& name)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = cell_of_name_.find(name);
+    if (it == cell_of_name_.end())
+    {
+        return false;
+    }
+    cells_.erase(it->second);
+    cell_of_name_.erase(it);
+    return true;
+}
+
+size_t CalibrationCellCache::NumBytes() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_t num_bytes = 0;
+    for (const std::shared_ptr<CalibrationCell>& cell : cells_)
+    {
+        num_bytes += CalibrationCellNumBytes(*cell);
+    }
+    return num_bytes;
+}
+
+std::vector<std::string> CalibrationCellCache::CellNames() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<std::string> names;
+    for (const std::shared_ptr<CalibrationCell>& cell : cells_)
+    {
+        names.emplace_back(cell->name);
+    }
+    return names;
+}
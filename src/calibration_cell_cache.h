@@ -0,0 +1,65 @@
+#ifndef CALIBRATION_CELL_CACHE_H
+#define CALIBRATION_CELL_CACHE_H
+
+#include <Eigen/Core>
+#include <theia/theia.h>
+#include <list>
+#include <memory>
+#include <mutex>  // NOLINT
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "feature_cache.h"
+#include "type.h"
+
+using namespace theia;
+
+// What is kept of a robot cell between its calibrations.
+struct CalibrationCell
+{
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+    std::string name;
+    // Features and matches of the images of the last calibration.
+    FeatureMemoryCache feature_cache;
+    // X of the last successful calibration, the prior of the next ones.
+    bool has_handeye = false;
+    Pose handeye;
+    int num_calibrations = 0;
+};
+
+// Estimated memory of a cell.
+size_t CalibrationCellNumBytes(const CalibrationCell& cell);
+
+// The cells of the recent calibrations, bounded by their estimated memory.
+// Least recently used cells are evicted first. The cache is thread safe, the
+// cells are not: calibrate a cell from one thread at a time.
+class CalibrationCellCache
+{
+public:
+    explicit CalibrationCellCache(const size_t max_num_bytes);
+
+    // Returns the cell, empty if it is not cached, as the most recently used.
+    // An evicted cell lives on while it is used.
+    std::shared_ptr<CalibrationCell> Cell(const std::string& name);
+    // Evicts the least recently used cells until the cache is within its
+    // bound, but always keeps the most recently used cell.
+    void Shrink();
+    bool Evict(const std::string& name);
+
+    size_t NumBytes() const;
+    // Most recently used first.
+    std::vector<std::string> CellNames() const;
+
+private:
+    typedef std::list<std::shared_ptr<CalibrationCell> > CellList;
+
+    const size_t max_num_bytes_;
+    mutable std::mutex mutex_;
+    // Most recently used first.
+    CellList cells_;
+    std::unordered_map<std::string, CellList::iterator> cell_of_name_;
+};
+
+#endif // CALIBRATION_CELL_CACHE_H
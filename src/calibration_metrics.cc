@@ -0,0 +1,303 @@
+#include "calibration_metrics.h"
+
+#include <glog/logging.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <chrono>  // NOLINT
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <mutex>  // NOLINT
+#include <sstream>
+#include <thread>  // NOLINT
+
+namespace internal
+{
+std::atomic<bool> metrics_enabled(false);
+}
+
+namespace
+{
+
+// How often the socket server checks whether it should stop.
+const int kPollTimeoutMilliseconds = 200;
+
+struct MetricsExport
+{
+    std::mutex mutex;
+    std::map<std::string, double> metrics;
+    std::string textfile_path;
+    std::string socket_path;
+    double min_interval_seconds = 1.0;
+    std::chrono::steady_clock::time_point last_publish;
+    // Numbers the snapshots taken for the text file, under mutex.
+    uint64_t num_snapshots = 0;
+    // Serializes the writers of the temporary file.
+    std::mutex write_mutex;
+    // The newest snapshot written, under write_mutex. An older snapshot that
+    // gets the write_mutex later is dropped instead of replacing it.
+    uint64_t last_written_snapshot = 0;
+
+    int server_fd = -1;
+    std::atomic<bool> stop_server;
+    std::thread server_thread;
+};
+
+MetricsExport& Export()
+{
+    static MetricsExport metrics_export;
+    return metrics_export;
+}
+
+double UnixTimeInSeconds()
+{
+    return std::chrono::duration<double>(
+               std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+// The metrics in the Prometheus text format, with one TYPE line per metric
+// family. The mutex must be held.
+std::string FormatMetrics(const std::map<std::string, double>& metrics)
+{
+    std::ostringstream text;
+    text << std::setprecision(15);
+    std::string family;
+    for (const auto& metric : metrics)
+    {
+        const std::string name = metric.first.substr(0, metric.first.find('{'));
+        if (name != family)
+        {
+            family = name;
+            const bool is_counter = name.size() > 6 &&
+                                    name.compare(name.size() - 6, 6, "_total") == 0;
+            text << "# TYPE " << name << (is_counter ? " counter" : " gauge")
+                 << "\n";
+        }
+        text << metric.first << " " << metric.second << "\n";
+    }
+    return text.str();
+}
+
+// key="value" with the value escaped as the text format requires.
+std::string LabelPair(const std::string& key, const std::string& value)
+{
+    std::string pair = key + "=\"";
+    for (const char c : value)
+    {
+        if (c == '\n')
+        {
+            pair += "\\n";
+            continue;
+        }
+        if (c == '"' || c == '\\')
+        {
+            pair += '\\';
+        }
+        pair += c;
+    }
+    return pair + "\"";
+}
+
+bool WriteFileAtomically(const std::string& filepath, const std::string& text)
+{
+    const std::string temporary_filepath = filepath + ".tmp";
+    {
+        std::ofstream file(temporary_filepath);
+        file << text;
+        if (!file.good())
+        {
+            return false;
+        }
+    }
+    return std::rename(temporary_filepath.c_str(), filepath.c_str()) == 0;
+}
+
+// Sends the current metrics to every client and closes the connection, like
+// an HTTP scrape without the HTTP.
+void ServeMetrics(MetricsExport* metrics_export)
+{
+    pollfd server_poll;
+    server_poll.fd = metrics_export->server_fd;
+    server_poll.events = POLLIN;
+    while (!metrics_export->stop_server.load())
+    {
+        if (poll(&server_poll, 1, kPollTimeoutMilliseconds) <= 0)
+        {
+            continue;
+        }
+        const int client_fd = accept(metrics_export->server_fd, nullptr, nullptr);
+        if (client_fd < 0)
+        {
+            continue;
+        }
+        std::string text;
+        {
+            std::lock_guard<std::mutex> lock(metrics_export->mutex);
+            text = FormatMetrics(metrics_export->metrics);
+        }
+        size_t num_sent = 0;
+        while (num_sent < text.size())
+        {
+            const ssize_t n = send(client_fd, text.data() + num_sent,
+                                   text.size() - num_sent, MSG_NOSIGNAL);
+            if (n <= 0)
+            {
+                break;
+            }
+            num_sent += n;
+        }
+        close(client_fd);
+    }
+}
+
+bool StartSocketServer(MetricsExport* metrics_export)
+{
+    sockaddr_un address;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (metrics_export->socket_path.size() >= sizeof(address.sun_path))
+    {
+        LOG(ERROR) << "Socket path too long: " << metrics_export->socket_path;
+        return false;
+    }
+    std::strcpy(address.sun_path, metrics_export->socket_path.c_str());
+
+    metrics_export->server_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (metrics_export->server_fd < 0)
+    {
+        LOG(ERROR) << "Could not create the metrics socket.";
+        return false;
+    }
+    // A socket left behind by an earlier run would make bind fail.
+    unlink(metrics_export->socket_path.c_str());
+    if (bind(metrics_export->server_fd,
+             reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 ||
+            listen(metrics_export->server_fd, 8) != 0)
+    {
+        LOG(ERROR) << "Could not listen on " << metrics_export->socket_path;
+        close(metrics_export->server_fd);
+        metrics_export->server_fd = -1;
+        return false;
+    }
+    metrics_export->stop_server.store(false);
+    metrics_export->server_thread = std::thread(ServeMetrics, metrics_export);
+    return true;
+}
+
+}  // namespace
+
+bool StartMetricsExport(const std::string& textfile_path,
+                        const std::string& socket_path,
+                        const double min_interval_seconds)
+{
+    MetricsExport& metrics_export = Export();
+    {
+        std::lock_guard<std::mutex> lock(metrics_export.mutex);
+        metrics_export.metrics.clear();
+        metrics_export.textfile_path = textfile_path;
+        metrics_export.socket_path = socket_path;
+        metrics_export.min_interval_seconds = min_interval_seconds;
+        metrics_export.metrics["shecar_start_timestamp_seconds"] =
+            UnixTimeInSeconds();
+    }
+    if (socket_path.size() != 0 && !StartSocketServer(&metrics_export))
+    {
+        return false;
+    }
+    internal::metrics_enabled.store(true);
+    PublishMetrics(true);
+    return true;
+}
+
+void StopMetricsExport()
+{
+    if (!IsMetricsExportEnabled())
+    {
+        return;
+    }
+    PublishMetrics(true);
+    internal::metrics_enabled.store(false);
+    MetricsExport& metrics_export = Export();
+    if (metrics_export.server_thread.joinable())
+    {
+        metrics_export.stop_server.store(true);
+        metrics_export.server_thread.join();
+        close(metrics_export.server_fd);
+        metrics_export.server_fd = -1;
+        unlink(metrics_export.socket_path.c_str());
+    }
+}
+
+void SetMetric(const std::string& name, const double value)
+{
+    if (!IsMetricsExportEnabled())
+    {
+        return;
+    }
+    MetricsExport& metrics_export = Export();
+    std::lock_guard<std::mutex> lock(metrics_export.mutex);
+    metrics_export.metrics[name] = value;
+}
+
+void IncrementMetric(const std::string& name, const double increment)
+{
+    if (!IsMetricsExportEnabled())
+    {
+        return;
+    }
+    MetricsExport& metrics_export = Export();
+    std::lock_guard<std::mutex> lock(metrics_export.mutex);
+    metrics_export.metrics[name] += increment;
+}
+
+void PublishMetrics(const bool force)
+{
+    if (!IsMetricsExportEnabled())
+    {
+        return;
+    }
+    MetricsExport& metrics_export = Export();
+    std::string text;
+    uint64_t snapshot;
+    {
+        std::lock_guard<std::mutex> lock(metrics_export.mutex);
+        const std::chrono::steady_clock::time_point now =
+            std::chrono::steady_clock::now();
+        metrics_export.metrics["shecar_last_update_timestamp_seconds"] =
+            UnixTimeInSeconds();
+        if (metrics_export.textfile_path.empty() ||
+                (!force && std::chrono::duration<double>(
+                     now - metrics_export.last_publish).count() <
+                 metrics_export.min_interval_seconds))
+        {
+            return;
+        }
+        metrics_export.last_publish = now;
+        text = FormatMetrics(metrics_export.metrics);
+        snapshot = ++metrics_export.num_snapshots;
+    }
+    std::lock_guard<std::mutex> lock(metrics_export.write_mutex);
+    if (snapshot < metrics_export.last_written_snapshot)
+    {
+        return;
+    }
+    metrics_export.last_written_snapshot = snapshot;
+    LOG_IF(WARNING, !WriteFileAtomically(metrics_export.textfile_path, text))
+            << "Could not write the metrics to " << metrics_export.textfile_path;
+}
+
+std::string MetricLabel(const std::string& key, const std::string& value)
+{
+    return "{" + LabelPair(key, value) + "}";
+}
+
+std::string MetricLabel(const std::string& key1, const std::string& value1,
+                        const std::string& key2, const std::string& value2)
+{
+    return "{" + LabelPair(key1, value1) + "," + LabelPair(key2, value2) + "}";
+}
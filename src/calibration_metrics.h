@@ -0,0 +1,50 @@
+#ifndef CALIBRATION_METRICS_H
+#define CALIBRATION_METRICS_H
+
+#include <atomic>
+#include <string>
+
+// Process wide progress metrics in the Prometheus text format, so that an
+// orchestrator can follow a long calibration, estimate its remaining time and
+// time out stuck jobs without parsing the logs.
+//
+// Metrics are gauges unless their name ends in _total, and may carry labels,
+// e.g. shecar_stage_calls_total{stage="triangulation"}. They are published to
+// a text file, replaced atomically by a rename so readers never see a partial
+// file, and/or served to every client that connects to a Unix socket. Like
+// tracing, everything is off by default and then costs one atomic load.
+
+namespace internal
+{
+extern std::atomic<bool> metrics_enabled;
+}
+
+inline bool IsMetricsExportEnabled()
+{
+    return internal::metrics_enabled.load(std::memory_order_relaxed);
+}
+
+// Starts exporting to textfile_path and/or socket_path, either may be empty.
+// Publish writes the file at most every min_interval_seconds.
+bool StartMetricsExport(const std::string& textfile_path,
+                        const std::string& socket_path,
+                        const double min_interval_seconds);
+
+// Publishes a last time and stops the socket server.
+void StopMetricsExport();
+
+void SetMetric(const std::string& name, const double value);
+void IncrementMetric(const std::string& name, const double increment = 1.0);
+
+// Writes the text file if min_interval_seconds have passed since the last
+// write, or always if force. Every publish also updates
+// shecar_last_update_timestamp_seconds.
+void PublishMetrics(const bool force = false);
+
+// The label set {key="value"} appended to a metric name.
+std::string MetricLabel(const std::string& key, const std::string& value);
+// The label set {key1="value1",key2="value2"}.
+std::string MetricLabel(const std::string& key1, const std::string& value1,
+                        const std::string& key2, const std::string& value2);
+
+#endif // CALIBRATION_METRICS_H
@@ -0,0 +1,386 @@
+#include "feature_cache.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <glog/logging.h>
+#include <fstream>
+#include <functional>
+#include <sstream>
+#include <thread>
+
+namespace
+{
+
+// Bump when the entry layout changes.
+const char kMagic[8] = { 'S', 'H', 'E', 'C', 'A', 'R', 'F', '1' };
+
+struct EntryHeader
+{
+    char magic[8];
+    uint64_t key;
+    uint32_t num_keypoints;
+    uint32_t descriptor_size;
+};
+
+enum KeypointFlags
+{
+    HAS_SCALE = 1,
+    HAS_ORIENTATION = 2,
+    HAS_STRENGTH = 4
+};
+
+struct EntryKeypoint
+{
+    double x;
+    double y;
+    double scale;
+    double orientation;
+    double strength;
+    int32_t type;
+    uint32_t flags;
+};
+
+// 64 bit FNV-1a.
+const uint64_t kFnvOffsetBasis = 14695981039346656037ULL;
+uint64_t Fnv1a(const char* data, const size_t size, uint64_t hash)
+{
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= static_cast<unsigned char>(data[i]);
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+// Read-only memory map of a whole file.
+class MappedFile
+{
+public:
+    explicit MappedFile(const std::string& filepath)
+        : data_(nullptr), size_(0)
+    {
+        const int fd = open(filepath.c_str(), O_RDONLY);
+        if (fd < 0)
+        {
+            return;
+        }
+        struct stat file_stat;
+        if (fstat(fd, &file_stat) == 0 && file_stat.st_size > 0)
+        {
+            void* data = mmap(nullptr, file_stat.st_size, PROT_READ, MAP_PRIVATE,
+                              fd, 0);
+            if (data != MAP_FAILED)
+            {
+                data_ = static_cast<const char*>(data);
+                size_ = file_stat.st_size;
+            }
+        }
+        close(fd);
+    }
+    ~MappedFile()
+    {
+        if (data_ != nullptr)
+        {
+            munmap(const_cast<char*>(data_), size_);
+        }
+    }
+
+    const char* data() const
+    {
+        return data_;
+    }
+    size_t size() const
+    {
+        return size_;
+    }
+
+private:
+    MappedFile(const MappedFile&);
+    MappedFile& operator=(const MappedFile&);
+
+    const char* data_;
+    size_t size_;
+};
+
+}  // namespace
+
+FeatureCache::FeatureCache(const std::string& directory)
+    : directory_(directory) {}
+
+bool FeatureCache::ComputeKey(const std::string& image_filepath,
+                              const std::string& extractor_settings,
+                              uint64_t* key)
+{
+    const MappedFile image(image_filepath);
+    if (image.data() == nullptr)
+    {
+        return false;
+    }
+    uint64_t hash = Fnv1a(image.data(), image.size(), kFnvOffsetBasis);
+    hash = Fnv1a(extractor_settings.data(), extractor_settings.size(), hash);
+    *key = hash;
+    return true;
+}
+
+std::string FeatureCache::EntryFilepath(const uint64_t key) const
+{
+    char filename[32];
+    snprintf(filename, sizeof(filename), "%016llx.features",
+             static_cast<unsigned long long>(key));
+    return directory_ + "/" + filename;
+}
+
+bool FeatureCache::Load(const uint64_t key,
+                        KeypointsAndDescriptors* features) const
+{
+    const MappedFile entry(EntryFilepath(key));
+    if (entry.data() == nullptr || entry.size() < sizeof(EntryHeader))
+    {
+        return false;
+    }
+    EntryHeader header;
+    memcpy(&header, entry.data(), sizeof(header));
+    // The counts come from the file, so the sizes are computed in 64 bits and
+    // checked against the file size before they are multiplied further.
+    const uint64_t payload_size = entry.size() - sizeof(header);
+    const uint64_t keypoints_size =
+        static_cast<uint64_t>(header.num_keypoints)*sizeof(EntryKeypoint);
+    const uint64_t num_descriptor_values =
+        static_cast<uint64_t>(header.num_keypoints)*header.descriptor_size;
+    if (memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 ||
+            header.key != key || keypoints_size > payload_size ||
+            num_descriptor_values > (payload_size - keypoints_size)/sizeof(float) ||
+            keypoints_size + num_descriptor_values*sizeof(float) != payload_size)
+    {
+        LOG(WARNING) << "Ignoring invalid feature cache entry "
+                     << EntryFilepath(key);
+        return false;
+    }
+
+    features->keypoints.clear();
+    features->descriptors.clear();
+    features->keypoints.reserve(header.num_keypoints);
+    features->descriptors.reserve(header.num_keypoints);
+    const char* keypoint_data = entry.data() + sizeof(header);
+    const char* descriptor_data = keypoint_data + keypoints_size;
+    for (uint32_t i = 0; i < header.num_keypoints; i++)
+    {
+        EntryKeypoint entry_keypoint;
+        memcpy(&entry_keypoint, keypoint_data + i*sizeof(EntryKeypoint),
+               sizeof(entry_keypoint));
+        Keypoint keypoint(entry_keypoint.x, entry_keypoint.y,
+                          static_cast<Keypoint::KeypointType>(entry_keypoint.type));
+        if (entry_keypoint.flags & HAS_SCALE)
+        {
+            keypoint.set_scale(entry_keypoint.scale);
+        }
+        if (entry_keypoint.flags & HAS_ORIENTATION)
+        {
+            keypoint.set_orientation(entry_keypoint.orientation);
+        }
+        if (entry_keypoint.flags & HAS_STRENGTH)
+        {
+            keypoint.set_strength(entry_keypoint.strength);
+        }
+        features->keypoints.emplace_back(keypoint);
+
+        Eigen::VectorXf descriptor(header.descriptor_size);
+        memcpy(descriptor.data(),
+               descriptor_data +
+               static_cast<size_t>(i)*header.descriptor_size*sizeof(float),
+               header.descriptor_size*sizeof(float));
+        features->descriptors.emplace_back(descriptor);
+    }
+    return true;
+}
+
+bool FeatureCache::Store(const uint64_t key,
+                         const KeypointsAndDescriptors& features) const
+{
+    CHECK_EQ(features.keypoints.size(), features.descriptors.size());
+    EntryHeader header;
+    memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.key = key;
+    header.num_keypoints = features.keypoints.size();
+    header.descriptor_size =
+        features.descriptors.empty() ? 0 : features.descriptors[0].size();
+
+    // Unique per process and thread, so concurrent writers of the same entry
+    // do not interleave.
+    std::ostringstream temporary_filepath;
+    temporary_filepath << EntryFilepath(key) << ".tmp." << getpid() << "."
+                       << std::hash<std::thread::id>()(std::this_thread::get_id());
+    {
+        std::ofstream entry(temporary_filepath.str(), std::ios::binary);
+        if (!entry.is_open())
+        {
+            return false;
+        }
+        entry.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        for (const Keypoint& keypoint : features.keypoints)
+        {
+            EntryKeypoint entry_keypoint;
+            memset(&entry_keypoint, 0, sizeof(entry_keypoint));
+            entry_keypoint.x = keypoint.x();
+            entry_keypoint.y = keypoint.y();
+            entry_keypoint.type = keypoint.keypoint_type();
+            if (keypoint.has_scale())
+            {
+                entry_keypoint.scale = keypoint.scale();
+                entry_keypoint.flags |= HAS_SCALE;
+            }
+            if (keypoint.has_orientation())
+            {
+                entry_keypoint.orientation = keypoint.orientation();
+                entry_keypoint.flags |= HAS_ORIENTATION;
+            }
+            if (keypoint.has_strength())
+            {
+                entry_keypoint.strength = keypoint.strength();
+                entry_keypoint.flags |= HAS_STRENGTH;
+            }
+            entry.write(reinterpret_cast<const char*>(&entry_keypoint),
+                        sizeof(entry_keypoint));
+        }
+        for (const Eigen::VectorXf& descriptor : features.descriptors)
+        {
+            CHECK_EQ(descriptor.size(), header.descriptor_size);
+            entry.write(reinterpret_cast<const char*>(descriptor.data()),
+                        descriptor.size()*sizeof(float));
+        }
+        if (!entry.good())
+        {
+            entry.close();
+            unlink(temporary_filepath.str().c_str());
+            return false;
+        }
+    }
+    return rename(temporary_filepath.str().c_str(), EntryFilepath(key).c_str()) == 0;
+}
+
+uint64_t ExtendCacheKey(const uint64_t key, const void* data, const size_t size)
+{
+    return Fnv1a(static_cast<const char*>(data), size, key);
+}
+
+FeatureMemoryCache::FeatureMemoryCache()
+    : calibration_(0), num_bytes_(0) {}
+
+void FeatureMemoryCache::BeginCalibration()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++calibration_;
+    statistics_ = FeatureMemoryCacheStatistics();
+}
+
+void FeatureMemoryCache::EndCalibration()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto it = features_.begin(); it != features_.end();)
+    {
+        if (it->second.calibration == calibration_)
+        {
+            ++it;
+            continue;
+        }
+        num_bytes_ -= it->second.num_bytes;
+        it = features_.erase(it);
+    }
+    for (auto it = matches_.begin(); it != matches_.end();)
+    {
+        if (it->second.calibration == calibration_)
+        {
+            ++it;
+            continue;
+        }
+        num_bytes_ -= it->second.num_bytes;
+        it = matches_.erase(it);
+    }
+}
+
+bool FeatureMemoryCache::LoadFeatures(const uint64_t key,
+                                      KeypointsAndDescriptors* features)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = features_.find(key);
+    if (it == features_.end())
+    {
+        ++statistics_.num_feature_misses;
+        return false;
+    }
+    ++statistics_.num_feature_hits;
+    it->second.calibration = calibration_;
+    features->keypoints = it->second.features.keypoints;
+    features->descriptors = it->second.features.descriptors;
+    return true;
+}
+
+void FeatureMemoryCache::StoreFeatures(const uint64_t key,
+                                       const KeypointsAndDescriptors& features)
+{
+    size_t num_bytes = sizeof(FeaturesEntry) +
+                       features.keypoints.size()*sizeof(Keypoint);
+    for (const Eigen::VectorXf& descriptor : features.descriptors)
+    {
+        num_bytes += sizeof(descriptor) + descriptor.size()*sizeof(float);
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    FeaturesEntry& entry = features_[key];
+    num_bytes_ += num_bytes - entry.num_bytes;
+    entry.features.keypoints = features.keypoints;
+    entry.features.descriptors = features.descriptors;
+    entry.num_bytes = num_bytes;
+    entry.calibration = calibration_;
+}
+
+bool FeatureMemoryCache::LoadMatch(const uint64_t key1, const uint64_t key2,
+                                   bool* verified, ImagePairMatch* match)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = matches_.find(std::make_pair(key1, key2));
+    if (it == matches_.end())
+    {
+        ++statistics_.num_match_misses;
+        return false;
+    }
+    ++statistics_.num_match_hits;
+    it->second.calibration = calibration_;
+    *verified = it->second.verified;
+    if (*verified)
+    {
+        *match = it->second.match;
+    }
+    return true;
+}
+
+void FeatureMemoryCache::StoreMatch(const uint64_t key1, const uint64_t key2,
+                                    const bool verified,
+                                    const ImagePairMatch& match)
+{
+    const size_t num_bytes =
+        sizeof(MatchEntry) +
+        (verified ? match.correspondences.size()*sizeof(FeatureCorrespondence) : 0);
+    std::lock_guard<std::mutex> lock(mutex_);
+    MatchEntry& entry = matches_[std::make_pair(key1, key2)];
+    num_bytes_ += num_bytes - entry.num_bytes;
+    entry.verified = verified;
+    entry.match = verified ? match : ImagePairMatch();
+    entry.num_bytes = num_bytes;
+    entry.calibration = calibration_;
+}
+
+size_t FeatureMemoryCache::NumBytes() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return num_bytes_;
+}
+
+FeatureMemoryCacheStatistics FeatureMemoryCache::Statistics() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return statistics_;
+}
@@ -0,0 +1,113 @@
+#ifndef FEATURE_CACHE_H
+#define FEATURE_CACHE_H
+
+#include <stdint.h>
+#include <theia/theia.h>
+#include <map>
+#include <mutex>  // NOLINT
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+using namespace theia;
+
+// On-disk cache of keypoints and descriptors that survives across runs. An
+// entry is addressed by the hash of the image file content and of the
+// extractor settings, so renamed or copied images hit the cache and changed
+// settings miss it. Entries are read through a memory map and written to a
+// temporary file that is renamed into place, so concurrent runs sharing a
+// directory never see a partial entry.
+class FeatureCache
+{
+public:
+    // The directory must exist.
+    explicit FeatureCache(const std::string& directory);
+
+    // The key of an image for the given extractor settings, or false if the
+    // image can not be read. Needs no directory.
+    static bool ComputeKey(const std::string& image_filepath,
+                           const std::string& extractor_settings,
+                           uint64_t* key);
+
+    // Loads the keypoints and descriptors of a key. The image name of the
+    // features is left unchanged.
+    bool Load(const uint64_t key, KeypointsAndDescriptors* features) const;
+    bool Store(const uint64_t key, const KeypointsAndDescriptors& features) const;
+
+private:
+    std::string EntryFilepath(const uint64_t key) const;
+
+    const std::string directory_;
+};
+
+// Extends a cache key by more data, e.g. the hand pose of the image for the
+// key of its matches.
+uint64_t ExtendCacheKey(const uint64_t key, const void* data, const size_t size);
+
+struct FeatureMemoryCacheStatistics
+{
+    int num_feature_hits = 0;
+    int num_feature_misses = 0;
+    int num_match_hits = 0;
+    int num_match_misses = 0;
+};
+
+// In-memory keypoints, descriptors and match verification outcomes of the
+// images of one scene, kept between its calibrations so that only new images
+// are extracted and only pairs with a new image are matched. Features are
+// addressed like those of FeatureCache, matches by the keys of their two
+// images in the order of the pair. Entries a calibration did not use are
+// dropped at its end, so the cache never holds more than one capture.
+// Thread safe.
+class FeatureMemoryCache
+{
+public:
+    FeatureMemoryCache();
+
+    // Entries that are neither loaded nor stored between BeginCalibration and
+    // EndCalibration are dropped by EndCalibration. Resets the statistics.
+    void BeginCalibration();
+    void EndCalibration();
+
+    // Loads the keypoints and descriptors of a key, leaving the image name
+    // unchanged.
+    bool LoadFeatures(const uint64_t key, KeypointsAndDescriptors* features);
+    void StoreFeatures(const uint64_t key, const KeypointsAndDescriptors& features);
+    // Returns false if the pair was never matched. Otherwise verified tells
+    // whether it passed the verification, and only then is the match set.
+    bool LoadMatch(const uint64_t key1, const uint64_t key2, bool* verified,
+                   ImagePairMatch* match);
+    void StoreMatch(const uint64_t key1, const uint64_t key2, const bool verified,
+                    const ImagePairMatch& match);
+
+    // Estimated memory of all entries.
+    size_t NumBytes() const;
+    // Since the last BeginCalibration.
+    FeatureMemoryCacheStatistics Statistics() const;
+
+private:
+    struct FeaturesEntry
+    {
+        KeypointsAndDescriptors features;
+        size_t num_bytes = 0;
+        int calibration = 0;
+    };
+    struct MatchEntry
+    {
+        bool verified = false;
+        ImagePairMatch match;
+        size_t num_bytes = 0;
+        int calibration = 0;
+    };
+
+    mutable std::mutex mutex_;
+    // Counts the calibrations, an entry is used by the current one if it
+    // carries its number.
+    int calibration_;
+    std::unordered_map<uint64_t, FeaturesEntry> features_;
+    std::map<std::pair<uint64_t, uint64_t>, MatchEntry> matches_;
+    size_t num_bytes_;
+    FeatureMemoryCacheStatistics statistics_;
+};
+
+#endif // FEATURE_CACHE_H
@@ -0,0 +1,220 @@
+#include "guided_feature_matcher.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <unordered_map>
+
+namespace
+{
+
+// Uniform grid of keypoint indices over the bounding box of the keypoints.
+class KeypointGrid
+{
+public:
+    KeypointGrid(const std::vector<Keypoint>& keypoints, const double cell_size)
+        : cell_size_(cell_size)
+    {
+        min_x_ = min_y_ = std::numeric_limits<double>::max();
+        double max_x = -std::numeric_limits<double>::max();
+        double max_y = -std::numeric_limits<double>::max();
+        for (const Keypoint& keypoint : keypoints)
+        {
+            min_x_ = std::min(min_x_, keypoint.x());
+            min_y_ = std::min(min_y_, keypoint.y());
+            max_x = std::max(max_x, keypoint.x());
+            max_y = std::max(max_y, keypoint.y());
+        }
+        if (keypoints.empty())
+        {
+            min_x_ = min_y_ = max_x = max_y = 0.0;
+        }
+        num_cols_ = static_cast<int>((max_x - min_x_)/cell_size_) + 1;
+        num_rows_ = static_cast<int>((max_y - min_y_)/cell_size_) + 1;
+        cells_.resize(num_cols_*num_rows_);
+        for (int i = 0; i < keypoints.size(); i++)
+        {
+            cells_[Cell(keypoints[i].x(), keypoints[i].y())].emplace_back(i);
+        }
+    }
+
+    // Appends the indices of all keypoints in cells that intersect the band
+    // |a*x+b*y+c|/sqrt(a^2+b^2) <= band.
+    void QueryBand(const Eigen::Vector3d& line, const double band,
+                   std::vector<int>* indices) const
+    {
+        const double norm = line.head<2>().norm();
+        if (norm == 0.0 || !line.allFinite() || !std::isfinite(band))
+        {
+            return;
+        }
+        // Walk along the axis the line is closer to, so each step covers a
+        // bounded number of cells.
+        const bool walk_columns = std::abs(line(1)) >= std::abs(line(0));
+        const int num_steps = walk_columns ? num_cols_ : num_rows_;
+        const int num_across = walk_columns ? num_rows_ : num_cols_;
+        const double a = walk_columns ? line(0) : line(1);
+        const double b = walk_columns ? line(1) : line(0);
+        const double along_origin = walk_columns ? min_x_ : min_y_;
+        const double across_origin = walk_columns ? min_y_ : min_x_;
+        const double half_width = band*norm/std::abs(b);
+
+        for (int step = 0; step < num_steps; step++)
+        {
+            const double along0 = along_origin + step*cell_size_;
+            const double along1 = along0 + cell_size_;
+            const double across0 = -(a*along0 + line(2))/b;
+            const double across1 = -(a*along1 + line(2))/b;
+            const double low = std::min(across0, across1) - half_width;
+            const double high = std::max(across0, across1) + half_width;
+            // A nearly parallel line puts low and high far outside the grid,
+            // so clamp them to it before converting to int.
+            const double first_cell = std::max(
+                0.0, std::floor((low - across_origin)/cell_size_));
+            const double last_cell = std::min(
+                num_across - 1.0, std::floor((high - across_origin)/cell_size_));
+            if (!(first_cell <= last_cell))
+            {
+                continue;
+            }
+            const int first = static_cast<int>(first_cell);
+            const int last = static_cast<int>(last_cell);
+            for (int across = first; across <= last; across++)
+            {
+                const std::vector<int>& cell = walk_columns
+                                               ? cells_[across*num_cols_ + step]
+                                               : cells_[step*num_cols_ + across];
+                indices->insert(indices->end(), cell.begin(), cell.end());
+            }
+        }
+    }
+
+private:
+    int Cell(const double x, const double y) const
+    {
+        const int col = std::min(num_cols_ - 1,
+                                 static_cast<int>((x - min_x_)/cell_size_));
+        const int row = std::min(num_rows_ - 1,
+                                 static_cast<int>((y - min_y_)/cell_size_));
+        return row*num_cols_ + col;
+    }
+
+    double cell_size_;
+    double min_x_, min_y_;
+    int num_cols_, num_rows_;
+    std::vector<std::vector<int> > cells_;
+};
+
+// Matches every feature of features1 to its nearest neighbor in features2
+// that passes the ratio test, searching only the epipolar band if F is given.
+void MatchOneWay(const GuidedFeatureMatcherOptions& options,
+                 const KeypointsAndDescriptors& features1,
+                 const KeypointsAndDescriptors& features2,
+                 const KeypointGrid& grid2,
+                 const Eigen::Matrix3d* fundamental_matrix,
+                 std::vector<IndexedFeatureMatch>* matches)
+{
+    const float sq_lowes_ratio = options.lowes_ratio*options.lowes_ratio;
+    std::vector<int> candidates;
+    for (int i = 0; i < features1.keypoints.size(); i++)
+    {
+        const Keypoint& keypoint = features1.keypoints[i];
+        Eigen::Vector3d line;
+        candidates.clear();
+        if (fundamental_matrix != nullptr)
+        {
+            line = *fundamental_matrix*
+                   Eigen::Vector3d(keypoint.x(), keypoint.y(), 1.0);
+            grid2.QueryBand(line, options.epipolar_band_pixels, &candidates);
+        }
+        else
+        {
+            candidates.resize(features2.keypoints.size());
+            for (int j = 0; j < candidates.size(); j++)
+            {
+                candidates[j] = j;
+            }
+        }
+
+        const double line_norm =
+            fundamental_matrix != nullptr ? line.head<2>().norm() : 0.0;
+        const Eigen::VectorXf& descriptor = features1.descriptors[i];
+        float best_distance = std::numeric_limits<float>::max();
+        float second_distance = std::numeric_limits<float>::max();
+        int best_index = -1;
+        for (const int j : candidates)
+        {
+            if (fundamental_matrix != nullptr)
+            {
+                const Keypoint& candidate = features2.keypoints[j];
+                const double distance_to_line =
+                    std::abs(line(0)*candidate.x() + line(1)*candidate.y() + line(2));
+                if (distance_to_line > options.epipolar_band_pixels*line_norm)
+                {
+                    continue;
+                }
+            }
+            const float distance =
+                (descriptor - features2.descriptors[j]).squaredNorm();
+            if (distance < best_distance)
+            {
+                second_distance = best_distance;
+                best_distance = distance;
+                best_index = j;
+            }
+            else if (distance < second_distance)
+            {
+                second_distance = distance;
+            }
+        }
+
+        // A single candidate in the band is accepted, the band itself already
+        // rejects most ambiguities.
+        if (best_index >= 0 && best_distance <= sq_lowes_ratio*second_distance)
+        {
+            matches->emplace_back(i, best_index, best_distance);
+        }
+    }
+}
+
+}  // namespace
+
+void GuidedMatchFeatures(const GuidedFeatureMatcherOptions& options,
+                         const KeypointsAndDescriptors& features1,
+                         const KeypointsAndDescriptors& features2,
+                         const Eigen::Matrix3d* fundamental_matrix,
+                         std::vector<IndexedFeatureMatch>* matches)
+{
+    matches->clear();
+    const KeypointGrid grid2(features2.keypoints, options.grid_cell_pixels);
+    MatchOneWay(options, features1, features2, grid2, fundamental_matrix, matches);
+    if (!options.keep_only_symmetric_matches)
+    {
+        return;
+    }
+
+    std::vector<IndexedFeatureMatch> reverse_matches;
+    const KeypointGrid grid1(features1.keypoints, options.grid_cell_pixels);
+    const Eigen::Matrix3d reverse_fundamental_matrix =
+        fundamental_matrix != nullptr ? Eigen::Matrix3d(fundamental_matrix->transpose())
+        : Eigen::Matrix3d::Zero();
+    MatchOneWay(options, features2, features1, grid1,
+                fundamental_matrix != nullptr ? &reverse_fundamental_matrix : nullptr,
+                &reverse_matches);
+
+    std::unordered_map<int, int> reverse_match_of;
+    for (const IndexedFeatureMatch& match : reverse_matches)
+    {
+        reverse_match_of[match.feature1_ind] = match.feature2_ind;
+    }
+    std::vector<IndexedFeatureMatch> symmetric_matches;
+    for (const IndexedFeatureMatch& match : *matches)
+    {
+        const auto it = reverse_match_of.find(match.feature2_ind);
+        if (it != reverse_match_of.end() && it->second == match.feature1_ind)
+        {
+            symmetric_matches.emplace_back(match);
+        }
+    }
+    matches->swap(symmetric_matches);
+}
@@ -0,0 +1,34 @@
+#ifndef GUIDED_FEATURE_MATCHER_H
+#define GUIDED_FEATURE_MATCHER_H
+
+#include <Eigen/Core>
+#include <theia/theia.h>
+#include <vector>
+
+using namespace theia;
+
+struct GuidedFeatureMatcherOptions
+{
+    // Lowe's ratio test on the L2 descriptor distances.
+    double lowes_ratio = 0.8;
+    bool keep_only_symmetric_matches = true;
+    // Half width in pixels of the band around the predicted epipolar line in
+    // which candidates are searched. It has to absorb the error of the
+    // predicted relative pose and the lens distortion.
+    double epipolar_band_pixels = 20.0;
+    // Side length in pixels of the cells of the spatial index.
+    double grid_cell_pixels = 64.0;
+};
+
+// Matches the features of two images. If a fundamental matrix F with
+// x2'*F*x1 = 0 is given, the candidates of each feature are restricted to the
+// band around its epipolar line, found through a uniform grid over the
+// keypoints of the other image. Without F all features are candidates, i.e.
+// brute force matching.
+void GuidedMatchFeatures(const GuidedFeatureMatcherOptions& options,
+                         const KeypointsAndDescriptors& features1,
+                         const KeypointsAndDescriptors& features2,
+                         const Eigen::Matrix3d* fundamental_matrix,
+                         std::vector<IndexedFeatureMatch>* matches);
+
+#endif // GUIDED_FEATURE_MATCHER_H
@@ -9,7 +9,43 @@
 #include <vector>
 
 #include "handeyecalibration_utils.h"
+#include "handeyepriorerror.h"
 #include "handeyereprojectionerror.h"
+#include "calibration_metrics.h"
+#include "trace_recorder.h"
+
+// Publishes the cost, step and current hand-eye parameters after every
+// iteration of a bundle adjustment.
+class MetricsIterationCallback : public ceres::IterationCallback
+{
+public:
+    explicit MetricsIterationCallback(const HandEyeTransformation* handeyetrans)
+        : handeyetrans_(handeyetrans) {}
+
+    ceres::CallbackReturnType operator()(const ceres::IterationSummary& summary)
+    {
+        static const char* kParameterNames[6] = {"rx", "ry", "rz", "tx", "ty", "tz"};
+        SetMetric("shecar_ba_iteration", summary.iteration);
+        SetMetric("shecar_ba_cost", summary.cost);
+        SetMetric("shecar_ba_cost_change", summary.cost_change);
+        SetMetric("shecar_ba_gradient_max_norm", summary.gradient_max_norm);
+        SetMetric("shecar_ba_step_norm", summary.step_norm);
+        SetMetric("shecar_ba_trust_region_radius", summary.trust_region_radius);
+        SetMetric("shecar_ba_elapsed_seconds", summary.cumulative_time_in_seconds);
+        const double* parameters = handeyetrans_->HandEyeParameter();
+        for (int i = 0; i < 6; i++)
+        {
+            SetMetric("shecar_handeye_parameter" +
+                      MetricLabel("parameter", kParameterNames[i]), parameters[i]);
+        }
+        IncrementMetric("shecar_ba_iterations_total");
+        PublishMetrics();
+        return ceres::SOLVER_CONTINUE;
+    }
+
+private:
+    const HandEyeTransformation* handeyetrans_;
+};
 
 void SetSolverOptions(const BundleAdjustmentOptions& options,
                       ceres::Solver::Options* solver_options)
@@ -181,9 +217,14 @@ void CopySharedIntrinsicsToViews(
 BundleAdjustmentSummary BundleAdjustPartialHandEye(const BundleAdjustmentOptions& options,
         const std::unordered_set<ViewId>& view_ids,
         const std::unordered_set<TrackId>& track_ids,
-        Reconstruction* reconstruction, Poses* handposes, HandEyeTransformation *handeyetrans)
+        Reconstruction* reconstruction, Poses* handposes, HandEyeTransformation *handeyetrans,
+        ceres::Solver::Summary* full_solver_summary, const HandEyePrior* prior)
 {
     CHECK_NOTNULL(reconstruction);
+    // Only the cameras-and-points problems get counters, the per-track
+    // problems of the track estimator are far too many.
+    ScopedTraceSpan span(view_ids.empty() ? "bundle_adjust_tracks" :
+                         "bundle_adjustment");
     BundleAdjustmentSummary summary;
     static const int kTrackSize = 4;
 
@@ -359,6 +400,16 @@ BundleAdjustmentSummary BundleAdjustPartialHandEye(const BundleAdjustmentOptions
         }
     }
 
+    // Unlike the reprojection errors, the prior has no loss function.
+    if (prior != nullptr && !view_ids.empty())
+    {
+        problem.AddResidualBlock(
+            HandEyePriorError::Create(prior->handeye,
+                                      prior->rotation_sigma_radians,
+                                      prior->translation_sigma),
+            nullptr, handeyetrans->Mutable_HandEyeParameter());
+    }
+
     // NOTE: cmsweeney found a thread on the Ceres Solver email group that
     // indicated using the reverse BA order (i.e., using cameras then points) is a
     // good idea for inner iterations.
@@ -369,10 +420,33 @@ BundleAdjustmentSummary BundleAdjustPartialHandEye(const BundleAdjustmentOptions
         solver_options.inner_iteration_ordering->Reverse();
     }
 
+    // The callback needs the parameters of the current iteration, which
+    // costs a copy per iteration, so only full problems are reported.
+    MetricsIterationCallback metrics_callback(handeyetrans);
+    if (IsMetricsExportEnabled() && !view_ids.empty())
+    {
+        solver_options.update_state_every_iteration = true;
+        solver_options.callbacks.push_back(&metrics_callback);
+        IncrementMetric("shecar_bundle_adjustments_total");
+        SetMetric("shecar_ba_max_iterations", solver_options.max_num_iterations);
+        SetMetric("shecar_ba_max_seconds",
+                  solver_options.max_solver_time_in_seconds);
+        SetMetric("shecar_ba_num_residual_blocks", problem.NumResidualBlocks());
+    }
+
     // Solve the problem.
     const double internal_setup_time = timer.ElapsedTimeInSeconds();
     ceres::Solver::Summary solver_summary;
-    ceres::Solve(solver_options, &problem, &solver_summary);
+    {
+        ScopedTraceSpan solve_span("ceres_solve");
+        ceres::Solve(solver_options, &problem, &solver_summary);
+    }
+    if (!view_ids.empty())
+    {
+        TraceCounter("bundle_adjustment/num_residuals",
+                     solver_summary.num_residuals);
+        TraceCounter("bundle_adjustment/final_cost", solver_summary.final_cost);
+    }
     LOG_IF(INFO, options.verbose) << solver_summary.FullReport();
 
     // Copy the shared intrinsics to all views that share those intrinsics.
@@ -387,13 +461,18 @@ BundleAdjustmentSummary BundleAdjustPartialHandEye(const BundleAdjustmentOptions
     // This only indicates whether the optimization was successfully run and makes
     // no guarantees on the quality or convergence.
     summary.success = solver_summary.IsSolutionUsable();
+    if (full_solver_summary != nullptr)
+    {
+        *full_solver_summary = solver_summary;
+    }
 
     return summary;
 }
 
 // Bundle adjust the specified views and all tracks observed by those views.
 BundleAdjustmentSummary BundleAdjusthandEye(
-    const BundleAdjustmentOptions& options, Reconstruction* reconstruction,Poses* handposes,HandEyeTransformation* handeyetrans)
+    const BundleAdjustmentOptions& options, Reconstruction* reconstruction,Poses* handposes,HandEyeTransformation* handeyetrans,
+    ceres::Solver::Summary* solver_summary, const HandEyePrior* prior)
 {
     const auto& view_ids = reconstruction->ViewIds();
     const auto& track_ids = reconstruction->TrackIds();
@@ -404,7 +483,8 @@ BundleAdjustmentSummary BundleAdjusthandEye(
     return BundleAdjustPartialHandEye(options,
                                       view_ids_set,
                                       track_ids_set,
-                                      reconstruction,handposes,handeyetrans);
+                                      reconstruction,handposes,handeyetrans,
+                                      solver_summary, prior);
 }
 
 // Bundle adjust a single view.
@@ -10,9 +10,24 @@
 #include "handeyetransformation.h"
 using namespace theia;
 
-// Bundle adjust all views and tracks in the reconstruction.
+// Gaussian prior on X, see HandEyePriorError.
+struct HandEyePrior
+{
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+    Pose handeye;
+    double rotation_sigma_radians = 0.0;
+    // In the unit of the hand poses.
+    double translation_sigma = 0.0;
+};
+
+// Bundle adjust all views and tracks in the reconstruction. If
+// solver_summary is not null, it receives the full ceres summary, e.g. the
+// problem size and number of iterations. If prior is not null, it adds a
+// residual that pulls X towards the prior.
 BundleAdjustmentSummary BundleAdjusthandEye(
-    const BundleAdjustmentOptions& options, Reconstruction* reconstruction,Poses* handposes,HandEyeTransformation* handeyetrans);
+    const BundleAdjustmentOptions& options, Reconstruction* reconstruction,Poses* handposes,HandEyeTransformation* handeyetrans,
+    ceres::Solver::Summary* solver_summary = nullptr,
+    const HandEyePrior* prior = nullptr);
 
 // Bundle adjust the specified views and all tracks observed by those views.
 BundleAdjustmentSummary BundleAdjustPartialHandEye(
@@ -20,7 +35,9 @@ BundleAdjustmentSummary BundleAdjustPartialHandEye(
     const std::unordered_set<ViewId>& views_to_optimize,
     const std::unordered_set<TrackId>& tracks_to_optimize,
     Reconstruction* reconstruction,
-    Poses* handposes,HandEyeTransformation* handeyetrans);
+    Poses* handposes,HandEyeTransformation* handeyetrans,
+    ceres::Solver::Summary* solver_summary = nullptr,
+    const HandEyePrior* prior = nullptr);
 
 BundleAdjustmentSummary BundleAdjustView(
     const BundleAdjustmentOptions& options,
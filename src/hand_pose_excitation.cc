@@ -0,0 +1,173 @@
+#include "hand_pose_excitation.h"
+
+#include <glog/logging.h>
+#include <Eigen/Eigenvalues>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <sstream>
+
+namespace
+{
+
+const double kRadToDeg = 180.0/M_PI;
+
+// Rotation angle in [0,pi] and unit axis of a rotation quaternion.
+double QuaternionToAngleAxis(const Eigen::Quaterniond& q, Eigen::Vector3d* axis)
+{
+    const double sin_half_angle = q.vec().norm();
+    const double angle = 2.0*std::atan2(sin_half_angle, std::abs(q.w()));
+    if (sin_half_angle > 0.0)
+    {
+        *axis = (q.w() < 0.0 ? -1.0 : 1.0)*q.vec()/sin_half_angle;
+    }
+    else
+    {
+        *axis = Eigen::Vector3d::UnitZ();
+    }
+    return angle;
+}
+
+}  // namespace
+
+bool StringToHandPoseExcitationCheck(const std::string& name,
+                                     HandPoseExcitationCheck* check)
+{
+    if (name == "NONE")
+    {
+        *check = HandPoseExcitationCheck::NONE;
+    }
+    else if (name == "WARN")
+    {
+        *check = HandPoseExcitationCheck::WARN;
+    }
+    else if (name == "FAIL")
+    {
+        *check = HandPoseExcitationCheck::FAIL;
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
+
+Eigen::Matrix3d HandMotionInformation(const Pose& handmotion)
+{
+    const Eigen::Matrix3d rotation = handmotion.Rotation();
+    return 2.0*Eigen::Matrix3d::Identity() - rotation - rotation.transpose();
+}
+
+HandPoseExcitationSummary AnalyzeHandPoseExcitation(
+    const Poses& handposes, const HandPoseExcitationOptions& options)
+{
+    HandPoseExcitationSummary summary;
+    Eigen::Matrix3d axis_scatter = Eigen::Matrix3d::Zero();
+    Eigen::Matrix3d information = Eigen::Matrix3d::Zero();
+    double sum_rotation_degrees = 0.0;
+
+    for (int i = 0; i < handposes.size(); i++)
+    {
+        const Pose inverse_handpose = handposes[i].Inverse();
+        for (int j = i + 1; j < handposes.size(); j++)
+        {
+            const Pose handmotion = inverse_handpose*handposes[j];
+            Eigen::Vector3d axis;
+            const double rotation_degrees =
+                kRadToDeg*QuaternionToAngleAxis(handmotion.Quaternion(), &axis);
+
+            ++summary.num_motions;
+            sum_rotation_degrees += rotation_degrees;
+            summary.max_rotation_degrees =
+                std::max(summary.max_rotation_degrees, rotation_degrees);
+            information += HandMotionInformation(handmotion);
+
+            if (rotation_degrees < options.min_rotation_degrees)
+            {
+                continue;
+            }
+            ++summary.num_informative_motions;
+            // axes are compared up to sign, so accumulate the outer product.
+            axis_scatter += axis*axis.transpose();
+        }
+    }
+
+    if (summary.num_motions > 0)
+    {
+        summary.mean_rotation_degrees = sum_rotation_degrees/summary.num_motions;
+    }
+
+    if (summary.num_informative_motions > 0)
+    {
+        Eigen::SelfAdjointEigenSolver<Eigen::Matrix3d> axis_solver(
+            axis_scatter/summary.num_informative_motions);
+        // eigenvalues are sorted in increasing order.
+        summary.axis_scatter_eigenvalues = axis_solver.eigenvalues().reverse();
+        summary.axis_spread = summary.axis_scatter_eigenvalues(1)/
+                              summary.axis_scatter_eigenvalues(0);
+    }
+
+    Eigen::SelfAdjointEigenSolver<Eigen::Matrix3d> information_solver(information);
+    const Eigen::Vector3d information_eigenvalues = information_solver.eigenvalues();
+    summary.condition_number =
+        information_eigenvalues(0) > 0.0
+        ? information_eigenvalues(2)/information_eigenvalues(0)
+        : std::numeric_limits<double>::infinity();
+
+    std::ostringstream problems;
+    if (summary.num_informative_motions < 2)
+    {
+        problems << "\n\tfewer than 2 motions rotate more than "
+                 << options.min_rotation_degrees << " degrees";
+    }
+    if (summary.axis_spread < options.min_axis_spread)
+    {
+        problems << "\n\trotation axes are nearly parallel (spread "
+                 << summary.axis_spread << " < " << options.min_axis_spread << ")";
+    }
+    if (!(summary.condition_number <= options.max_condition_number))
+    {
+        problems << "\n\tAX=XB rotation is ill-conditioned (condition number "
+                 << summary.condition_number << " > "
+                 << options.max_condition_number << ")";
+    }
+    summary.sufficient = problems.str().empty();
+
+    std::ostringstream string_stream;
+    string_stream
+            << "Hand pose excitation:"
+            << "\n\tNum hand poses = " << handposes.size()
+            << "\n\tNum relative motions = " << summary.num_motions
+            << "\n\tNum informative motions = " << summary.num_informative_motions
+            << "\n\tMean rotation (degrees) = " << summary.mean_rotation_degrees
+            << "\n\tMax rotation (degrees) = " << summary.max_rotation_degrees
+            << "\n\tRotation axis spread = " << summary.axis_spread
+            << "\n\tRotation condition number = " << summary.condition_number;
+    if (!summary.sufficient)
+    {
+        string_stream << "\nInsufficient excitation:" << problems.str();
+    }
+    summary.message = string_stream.str();
+    return summary;
+}
+
+bool CheckHandPoseExcitation(const Poses& handposes,
+                             const HandPoseExcitationOptions& options,
+                             const HandPoseExcitationCheck check,
+                             HandPoseExcitationSummary* summary)
+{
+    *summary = AnalyzeHandPoseExcitation(handposes, options);
+    if (check == HandPoseExcitationCheck::NONE)
+    {
+        return true;
+    }
+    LOG(INFO) << summary->message;
+    if (summary->sufficient)
+    {
+        return true;
+    }
+    LOG_IF(WARNING, check == HandPoseExcitationCheck::WARN)
+            << "Hand motions may not excite the hand-eye calibration "
+            "sufficiently.";
+    return check != HandPoseExcitationCheck::FAIL;
+}
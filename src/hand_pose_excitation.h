@@ -0,0 +1,72 @@
+#ifndef HAND_POSE_EXCITATION_H
+#define HAND_POSE_EXCITATION_H
+
+#include <Eigen/Core>
+#include <string>
+#include "type.h"
+
+// Thresholds for the pre-flight check of the hand motions. AX=XB needs at
+// least two relative motions with non-parallel rotation axes, and the
+// estimate degrades quickly when the rotations are small or the axes nearly
+// parallel.
+struct HandPoseExcitationOptions
+{
+    // Relative motions that rotate less than this carry almost no information
+    // about the hand-eye rotation and are not counted as informative.
+    double min_rotation_degrees = 5.0;
+    // Minimal ratio of the second to the largest eigenvalue of the rotation
+    // axis scatter matrix. 0 means all axes are parallel.
+    double min_axis_spread = 0.05;
+    // Maximal condition number of the information matrix of the rotation
+    // part of AX=XB.
+    double max_condition_number = 100.0;
+};
+
+// What a calibration does with insufficient excitation.
+enum class HandPoseExcitationCheck
+{
+    NONE,
+    WARN,
+    FAIL
+};
+
+// "NONE", "WARN" or "FAIL". Returns false for any other name.
+bool StringToHandPoseExcitationCheck(const std::string& name,
+                                     HandPoseExcitationCheck* check);
+
+struct HandPoseExcitationSummary
+{
+    int num_motions = 0;
+    int num_informative_motions = 0;
+    double mean_rotation_degrees = 0.0;
+    double max_rotation_degrees = 0.0;
+    // Eigenvalues of the normalized rotation axis scatter matrix, descending.
+    Eigen::Vector3d axis_scatter_eigenvalues = Eigen::Vector3d::Zero();
+    double axis_spread = 0.0;
+    double condition_number = 0.0;
+    bool sufficient = false;
+    std::string message;
+};
+
+// Information a relative hand motion B carries about the rotation (and, up to
+// the rotation X itself, the translation) of AX=XB. Linearizing
+// Ra*Rx = Rx*Rb and (Ra-I)*tx = Rx*tb-ta around X both give (I-Ra)'(I-Ra),
+// which is Rx*(2I-Rb-Rb')*Rx' and has the eigenvalues of 2I-Rb-Rb': 0 along
+// the rotation axis and 2-2cos(angle) twice.
+Eigen::Matrix3d HandMotionInformation(const Pose& handmotion);
+
+// Analyzes the relative motions between all pairs of hand poses. This only
+// needs the hand poses and is meant to reject bad captures before feature
+// extraction and matching.
+HandPoseExcitationSummary AnalyzeHandPoseExcitation(
+    const Poses& handposes, const HandPoseExcitationOptions& options);
+
+// Analyzes the hand poses and applies check to the result: logs the report
+// unless check is NONE, warns if the excitation is insufficient and returns
+// false only if it is and check is FAIL.
+bool CheckHandPoseExcitation(const Poses& handposes,
+                             const HandPoseExcitationOptions& options,
+                             const HandPoseExcitationCheck check,
+                             HandPoseExcitationSummary* summary);
+
+#endif // HAND_POSE_EXCITATION_H
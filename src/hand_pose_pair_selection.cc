@@ -0,0 +1,105 @@
+#include "hand_pose_pair_selection.h"
+
+#include <cmath>
+
+namespace
+{
+
+const double kDegToRad = M_PI/180.0;
+const int kNumFrustumSamples = 9;
+
+// Camera pose and frustum samples of one view in world coordinates.
+struct ViewFrustum
+{
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+    Pose camera_to_world;
+    Pose world_to_camera;
+    Eigen::Vector3d optical_axis;
+    Eigen::Vector3d samples[kNumFrustumSamples];
+};
+
+bool IsInFrustum(const ViewFrustum& view, const Eigen::Vector3d& point,
+                 const double tan_half_fov_x, const double tan_half_fov_y)
+{
+    const Eigen::Vector3d point_in_camera = view.world_to_camera*point;
+    if (point_in_camera.z() <= 0.0)
+    {
+        return false;
+    }
+    return std::abs(point_in_camera.x()) <= tan_half_fov_x*point_in_camera.z() &&
+           std::abs(point_in_camera.y()) <= tan_half_fov_y*point_in_camera.z();
+}
+
+double OverlapFraction(const ViewFrustum& source, const ViewFrustum& target,
+                       const double tan_half_fov_x, const double tan_half_fov_y)
+{
+    int num_visible = 0;
+    for (int i = 0; i < kNumFrustumSamples; i++)
+    {
+        if (IsInFrustum(target, source.samples[i], tan_half_fov_x, tan_half_fov_y))
+        {
+            ++num_visible;
+        }
+    }
+    return static_cast<double>(num_visible)/kNumFrustumSamples;
+}
+
+}  // namespace
+
+std::vector<std::pair<int, int> > SelectImagePairsFromHandPoses(
+    const Poses& handposes, const Pose& handeye,
+    const HandPosePairSelectionOptions& options)
+{
+    const double tan_half_fov_x =
+        std::tan(0.5*options.horizontal_fov_degrees*kDegToRad);
+    const double tan_half_fov_y =
+        std::tan(0.5*options.vertical_fov_degrees*kDegToRad);
+    const double min_cos_viewing_angle =
+        std::cos(options.max_viewing_angle_degrees*kDegToRad);
+
+    // camera pose = hand pose*X^-1
+    const Pose eyehand = handeye.Inverse();
+    std::vector<ViewFrustum, Eigen::aligned_allocator<ViewFrustum> > views(
+        handposes.size());
+    for (int i = 0; i < handposes.size(); i++)
+    {
+        ViewFrustum& view = views[i];
+        view.camera_to_world = handposes[i]*eyehand;
+        view.world_to_camera = view.camera_to_world.Inverse();
+        view.optical_axis = view.camera_to_world.Quaternion()*Eigen::Vector3d::UnitZ();
+        // samples at the center, edges and corners of the image, shrunk
+        // slightly so that they stay inside the view itself.
+        int sample = 0;
+        for (int y = -1; y <= 1; y++)
+        {
+            for (int x = -1; x <= 1; x++)
+            {
+                const Eigen::Vector3d ray(0.9*x*tan_half_fov_x,
+                                          0.9*y*tan_half_fov_y, 1.0);
+                view.samples[sample++] =
+                    view.camera_to_world*(options.scene_depth*ray);
+            }
+        }
+    }
+
+    std::vector<std::pair<int, int> > pairs;
+    for (int i = 0; i < views.size(); i++)
+    {
+        for (int j = i + 1; j < views.size(); j++)
+        {
+            if (views[i].optical_axis.dot(views[j].optical_axis) <
+                    min_cos_viewing_angle)
+            {
+                continue;
+            }
+            const double overlap = std::max(
+                OverlapFraction(views[i], views[j], tan_half_fov_x, tan_half_fov_y),
+                OverlapFraction(views[j], views[i], tan_half_fov_x, tan_half_fov_y));
+            if (overlap >= options.min_overlap)
+            {
+                pairs.emplace_back(i, j);
+            }
+        }
+    }
+    return pairs;
+}
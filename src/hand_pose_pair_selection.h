@@ -0,0 +1,36 @@
+#ifndef HAND_POSE_PAIR_SELECTION_H
+#define HAND_POSE_PAIR_SELECTION_H
+
+#include <utility>
+#include <vector>
+#include "type.h"
+
+struct HandPosePairSelectionOptions
+{
+    // Field of view of the camera, e.g. 2*atan(cx/f).
+    double horizontal_fov_degrees = 60.0;
+    double vertical_fov_degrees = 45.0;
+    // Expected distance from the cameras to the observed scene, in the unit of
+    // the hand pose translations.
+    double scene_depth = 0.5;
+    // Minimal fraction of one view's frustum samples that must be visible in
+    // the other view.
+    double min_overlap = 0.2;
+    // Pairs whose optical axes differ more than this are never matched, SIFT
+    // does not survive such viewpoint changes anyway.
+    double max_viewing_angle_degrees = 60.0;
+};
+
+// Predicts which views overlap from the robot kinematics. The camera poses are
+// hand pose*X^-1 with X the (prior) hand-eye transformation; identity means
+// the camera frame is assumed to coincide with the hand frame. For each view a
+// 3x3 grid of points spanning its frustum at scene_depth is projected into the
+// other view, and a pair is kept if either view sees at least min_overlap of
+// the other's samples.
+//
+// Returns pairs (i,j) with i<j of indices into handposes.
+std::vector<std::pair<int, int> > SelectImagePairsFromHandPoses(
+    const Poses& handposes, const Pose& handeye,
+    const HandPosePairSelectionOptions& options);
+
+#endif // HAND_POSE_PAIR_SELECTION_H
@@ -0,0 +1,122 @@
+#include "hand_pose_view_selection.h"
+
+#include <Eigen/LU>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "hand_pose_excitation.h"
+
+namespace
+{
+
+// Keeps the determinant positive while fewer than two independent rotation
+// axes have been selected.
+const double kInformationRegularization = 1e-6;
+
+double LogDetInformation(const Eigen::Matrix3d& information)
+{
+    return std::log((information +
+                     kInformationRegularization*Eigen::Matrix3d::Identity())
+                    .determinant());
+}
+
+}  // namespace
+
+std::vector<int> SelectInformativeHandPoses(const Poses& handposes,
+                                            const int num_views)
+{
+    const int num_handposes = handposes.size();
+    std::vector<int> selected;
+    if (num_views >= num_handposes)
+    {
+        for (int i = 0; i < num_handposes; i++)
+        {
+            selected.emplace_back(i);
+        }
+        return selected;
+    }
+    if (num_views <= 0)
+    {
+        return selected;
+    }
+
+    Poses inverse_handposes;
+    inverse_handposes.reserve(num_handposes);
+    for (const Pose& handpose : handposes)
+    {
+        inverse_handposes.emplace_back(handpose.Inverse());
+    }
+
+    // Seed with the pair of largest relative rotation. The trace of the
+    // motion information is 4-4cos(angle).
+    int seed_first = 0;
+    int seed_second = std::min(1, num_handposes - 1);
+    double best_trace = -1.0;
+    for (int i = 0; i < num_handposes; i++)
+    {
+        for (int j = i + 1; j < num_handposes; j++)
+        {
+            const double trace =
+                HandMotionInformation(inverse_handposes[i]*handposes[j]).trace();
+            if (trace > best_trace)
+            {
+                best_trace = trace;
+                seed_first = i;
+                seed_second = j;
+            }
+        }
+    }
+
+    // candidate_information[c] is the information gained from the motions
+    // between candidate c and every selected pose.
+    std::vector<Eigen::Matrix3d> candidate_information(
+        num_handposes, Eigen::Matrix3d::Zero());
+    std::vector<bool> is_selected(num_handposes, false);
+    Eigen::Matrix3d information = Eigen::Matrix3d::Zero();
+
+    auto select = [&](const int index)
+    {
+        information += candidate_information[index];
+        is_selected[index] = true;
+        selected.emplace_back(index);
+        for (int c = 0; c < num_handposes; c++)
+        {
+            if (!is_selected[c])
+            {
+                candidate_information[c] +=
+                    HandMotionInformation(inverse_handposes[index]*handposes[c]);
+            }
+        }
+    };
+
+    select(seed_first);
+    if (num_views > 1)
+    {
+        select(seed_second);
+    }
+
+    while (selected.size() < num_views)
+    {
+        int best_candidate = -1;
+        double best_log_det = -std::numeric_limits<double>::infinity();
+        for (int c = 0; c < num_handposes; c++)
+        {
+            if (is_selected[c])
+            {
+                continue;
+            }
+            const double log_det =
+                LogDetInformation(information + candidate_information[c]);
+            if (log_det > best_log_det)
+            {
+                best_log_det = log_det;
+                best_candidate = c;
+            }
+        }
+        select(best_candidate);
+    }
+
+    std::sort(selected.begin(), selected.end());
+    return selected;
+}
@@ -0,0 +1,22 @@
+#ifndef HAND_POSE_VIEW_SELECTION_H
+#define HAND_POSE_VIEW_SELECTION_H
+
+#include <vector>
+#include "type.h"
+
+// Selects num_views of the hand poses that maximize the observability of the
+// hand-eye transformation, using only the hand poses. The criterion is
+// D-optimal: the log determinant of the AX=XB information (see
+// HandMotionInformation) summed over all relative motions between selected
+// poses. It is maximized greedily, starting from the pair with the largest
+// relative rotation, which an O(N^2) search over all pairs finds; each greedy
+// step then costs O(N) since the information of every candidate with respect
+// to the selected set is updated incrementally. The total cost is
+// O(N^2 + num_views*N) for N hand poses, dominated by the seed search.
+//
+// Returns the indices of the selected hand poses in increasing order, or all
+// indices if num_views is not smaller than the number of hand poses.
+std::vector<int> SelectInformativeHandPoses(const Poses& handposes,
+                                            const int num_views);
+
+#endif // HAND_POSE_VIEW_SELECTION_H
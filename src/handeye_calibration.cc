@@ -0,0 +1,688 @@
+#include "handeye_calibration.h"
+
+#include <glog/logging.h>
+#include <cmath>
+#include <cstdlib>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "hand_pose_view_selection.h"
+#include "handeye_project_point_to_image.h"
+#include "handeyecalibration_utils.h"
+#include "handeyecalibrationbuilder.h"
+
+namespace
+{
+
+bool IsDecoded(const HandEyeCalibrationFrame& frame)
+{
+    return frame.image.pixels != nullptr;
+}
+
+// Images read from a file are named by their filename, as theia names them.
+std::string ViewName(const HandEyeCalibrationFrame& frame)
+{
+    if (IsDecoded(frame) || frame.image_filepath.empty())
+    {
+        return frame.name;
+    }
+    std::string filename;
+    CHECK(GetFilenameFromFilepath(frame.image_filepath, true, &filename));
+    return filename;
+}
+
+Poses HandPosesOfFrames(const HandEyeCalibrationFrames& frames,
+                        const std::vector<int>& frame_indices)
+{
+    Poses handposes;
+    for (const int index : frame_indices)
+    {
+        handposes.emplace_back(frames[index].handpose);
+    }
+    return handposes;
+}
+
+// All frames, or the num_views_to_select most informative ones.
+std::vector<int> SelectFrames(const HandEyeCalibrationOptions& options,
+                              const HandEyeCalibrationFrames& frames)
+{
+    std::vector<int> all_frames(frames.size());
+    for (int i = 0; i < frames.size(); i++)
+    {
+        all_frames[i] = i;
+    }
+    if (options.num_views_to_select <= 0 ||
+            options.num_views_to_select >= frames.size())
+    {
+        return all_frames;
+    }
+    const std::vector<int> selected = SelectInformativeHandPoses(
+                                          HandPosesOfFrames(frames, all_frames),
+                                          options.num_views_to_select);
+    LOG(INFO) << "Selected " << selected.size() << " of " << frames.size()
+              << " images.";
+    return selected;
+}
+
+// The frustums are predicted from the camera poses, i.e. from the hand poses
+// and X, so without a prior X all pairs are matched.
+bool SelectsPairsFromHandPoses(const HandEyeCalibrationOptions& options)
+{
+    if (!options.select_pairs_from_hand_poses)
+    {
+        return false;
+    }
+    LOG_IF(WARNING, !options.has_initial_hand_eye)
+            << "Pair selection from the hand poses needs an initial hand-eye "
+            "transformation, falling back to matching all pairs.";
+    return options.has_initial_hand_eye;
+}
+
+// Pairs of indices into frame_indices whose frustums are predicted to
+// overlap, taking the field of view from the first frame if it is calibrated
+// and assuming the principal point is close to the image center.
+std::vector<std::pair<int, int> > PredictOverlappingPairs(
+    const HandEyeCalibrationOptions& options,
+    const HandEyeCalibrationFrames& frames,
+    const std::vector<int>& frame_indices)
+{
+    HandPosePairSelectionOptions pair_options = options.pair_selection_options;
+    const CameraIntrinsicsPrior& prior = frames[frame_indices[0]].intrinsics;
+    if (prior.focal_length.is_set && prior.principal_point.is_set)
+    {
+        const double focal_length = prior.focal_length.value[0];
+        pair_options.horizontal_fov_degrees = RadToDeg(
+                2.0*std::atan(prior.principal_point.value[0]/focal_length));
+        pair_options.vertical_fov_degrees = RadToDeg(
+                2.0*std::atan(prior.principal_point.value[1]/focal_length));
+    }
+    const std::vector<std::pair<int, int> > pairs =
+        SelectImagePairsFromHandPoses(HandPosesOfFrames(frames, frame_indices),
+                                      options.initial_hand_eye, pair_options);
+    LOG(INFO) << "Matching " << pairs.size() << " of "
+              << frame_indices.size()*(frame_indices.size() - 1)/2
+              << " image pairs.";
+    return pairs;
+}
+
+// The intrinsics theia's feature extraction gives a view, which the hand-eye
+// front end bypasses: those of the frame, completed with the image size, the
+// image center as principal point and, for files, the EXIF focal length.
+std::vector<CameraIntrinsicsPrior> CompleteIntrinsics(
+    const HandEyeCalibrationFrames& frames,
+    const std::vector<int>& frame_indices)
+{
+    ExifReader exif_reader;
+    std::vector<CameraIntrinsicsPrior> intrinsics;
+    for (const int index : frame_indices)
+    {
+        const HandEyeCalibrationFrame& frame = frames[index];
+        CameraIntrinsicsPrior image_intrinsics;
+        if (IsDecoded(frame))
+        {
+            image_intrinsics.image_width = frame.image.width;
+            image_intrinsics.image_height = frame.image.height;
+            image_intrinsics.principal_point.is_set = true;
+            image_intrinsics.principal_point.value[0] = 0.5*frame.image.width;
+            image_intrinsics.principal_point.value[1] = 0.5*frame.image.height;
+        }
+        else if (!frame.image_filepath.empty() &&
+                 !exif_reader.ExtractEXIFMetadata(frame.image_filepath,
+                         &image_intrinsics))
+        {
+            LOG(WARNING) << "Could not read the image size and EXIF data of "
+                         << frame.image_filepath;
+        }
+
+        intrinsics.emplace_back(frame.intrinsics);
+        CameraIntrinsicsPrior& prior = intrinsics.back();
+        if (prior.image_width <= 0 || prior.image_height <= 0)
+        {
+            prior.image_width = image_intrinsics.image_width;
+            prior.image_height = image_intrinsics.image_height;
+        }
+        if (!prior.focal_length.is_set)
+        {
+            prior.focal_length = image_intrinsics.focal_length;
+        }
+        if (!prior.principal_point.is_set)
+        {
+            prior.principal_point = image_intrinsics.principal_point;
+        }
+    }
+    return intrinsics;
+}
+
+// Adds a view per frame. If intrinsics is not null, it holds the intrinsics
+// of every frame, otherwise theia reads those of the files that lack a focal
+// length from their EXIF data during feature extraction.
+bool AddViews(const HandEyeCalibrationOptions& options,
+              const HandEyeCalibrationFrames& frames,
+              const std::vector<int>& frame_indices,
+              const std::vector<CameraIntrinsicsPrior>* intrinsics,
+              HandEyeCalibrationBuilder* builder)
+{
+    // When the intrinsics group id is invalid, the reconstruction builder
+    // assumes that the view does not share its intrinsics with any other.
+    const CameraIntrinsicsGroupId intrinsics_group_id =
+        options.shared_calibration ? 0 : kInvalidCameraIntrinsicsGroupId;
+    for (int i = 0; i < frame_indices.size(); i++)
+    {
+        const HandEyeCalibrationFrame& frame = frames[frame_indices[i]];
+        const bool from_file = !IsDecoded(frame) && !frame.image_filepath.empty();
+        bool added;
+        if (intrinsics == nullptr && from_file &&
+                !frame.intrinsics.focal_length.is_set)
+        {
+            added = builder->AddImage(frame.image_filepath, intrinsics_group_id);
+        }
+        else
+        {
+            added = builder->AddImageWithCameraIntrinsicsPrior(
+                        from_file ? frame.image_filepath : frame.name,
+                        intrinsics != nullptr ? (*intrinsics)[i] : frame.intrinsics,
+                        intrinsics_group_id);
+        }
+        if (!added)
+        {
+            LOG(ERROR) << "Could not add the image " << ViewName(frame);
+            return false;
+        }
+    }
+    return true;
+}
+
+// Extracts, matches and verifies features with the hand-eye front end and
+// adds the verified matches to the builder, which already holds the views
+// with the given intrinsics. Like theia's feature extraction, it writes the
+// matches file of the builder options if one is given. On failure the
+// reason is returned in error_message.
+bool ExtractAndMatchWithFrontEnd(
+    const HandEyeCalibrationOptions& options,
+    const HandEyeCalibrationFrames& frames,
+    const std::vector<int>& frame_indices,
+    const std::vector<CameraIntrinsicsPrior>& intrinsics,
+    HandEyeCalibrationBuilder* builder,
+    std::string* error_message)
+{
+    HandEyeFeatureFrontEnd front_end(options.front_end_options);
+    for (int i = 0; i < frame_indices.size(); i++)
+    {
+        const HandEyeCalibrationFrame& frame = frames[frame_indices[i]];
+        if (IsDecoded(frame))
+        {
+            front_end.AddImage(frame.name, frame.image, intrinsics[i],
+                               frame.handpose);
+        }
+        else
+        {
+            front_end.AddImage(frame.image_filepath, intrinsics[i],
+                               frame.handpose);
+        }
+    }
+    if (options.has_initial_hand_eye)
+    {
+        front_end.SetHandEye(options.initial_hand_eye);
+    }
+    else
+    {
+        LOG_IF(WARNING, options.front_end_options.guided_matching)
+                << "Guided matching needs an initial hand-eye transformation, "
+                "falling back to brute force matching.";
+        LOG_IF(WARNING, options.front_end_options.verify_with_rotation_prior)
+                << "Rotation prior verification needs an initial hand-eye "
+                "transformation, falling back to theia's geometric verification.";
+    }
+    if (SelectsPairsFromHandPoses(options))
+    {
+        front_end.SetImagePairsToMatch(
+            PredictOverlappingPairs(options, frames, frame_indices));
+    }
+
+    std::vector<ImagePairMatch> matches;
+    if (!front_end.ExtractAndMatchFeatures(&matches))
+    {
+        *error_message = front_end.ErrorMessage();
+        return false;
+    }
+    const std::string& matches_file = options.builder_options.output_matches_file;
+    if (!matches_file.empty())
+    {
+        std::vector<std::string> view_names;
+        for (const int index : frame_indices)
+        {
+            view_names.emplace_back(ViewName(frames[index]));
+        }
+        if (!WriteMatchesAndGeometry(matches_file, view_names, intrinsics,
+                                     matches))
+        {
+            *error_message = "Could not write the matches to " + matches_file;
+            return false;
+        }
+    }
+    for (const ImagePairMatch& match : matches)
+    {
+        if (!builder->AddTwoViewMatch(match.image1, match.image2, match))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool ExtractAndMatchWithTheia(const HandEyeCalibrationOptions& options,
+                              const HandEyeCalibrationFrames& frames,
+                              const std::vector<int>& frame_indices,
+                              HandEyeCalibrationBuilder* builder)
+{
+    if (SelectsPairsFromHandPoses(options))
+    {
+        std::vector<std::pair<std::string, std::string> > image_pairs;
+        for (const auto& pair :
+                PredictOverlappingPairs(options, frames, frame_indices))
+        {
+            image_pairs.emplace_back(ViewName(frames[frame_indices[pair.first]]),
+                                     ViewName(frames[frame_indices[pair.second]]));
+        }
+        // theia matches all pairs when given none.
+        if (image_pairs.empty())
+        {
+            LOG(WARNING) << "No image pairs to match.";
+            return true;
+        }
+        builder->SetImagePairsToMatch(image_pairs);
+    }
+    return builder->ExtractAndMatchFeatures();
+}
+
+double MeanReprojectionError(const Reconstruction& reconstruction)
+{
+    double sum = 0.0;
+    int num_observations = 0;
+    // The estimated tracks of a view are projected as one batch.
+    std::vector<TrackId> track_ids;
+    std::vector<double> points;
+    std::vector<double> projections;
+    std::vector<double> depths;
+    for (const ViewId view_id : reconstruction.ViewIds())
+    {
+        const View* view = reconstruction.View(view_id);
+        if (!view->IsEstimated())
+        {
+            continue;
+        }
+        track_ids.clear();
+        points.clear();
+        for (const TrackId track_id : view->TrackIds())
+        {
+            const Track* track = reconstruction.Track(track_id);
+            if (!track->IsEstimated())
+            {
+                continue;
+            }
+            track_ids.emplace_back(track_id);
+            points.insert(points.end(), track->Point().data(),
+                          track->Point().data() + 4);
+        }
+        const int num_points = track_ids.size();
+        projections.resize(2*num_points);
+        depths.resize(num_points);
+        HandEyeProjectPointsToImage(view->Camera(), points.data(), num_points,
+                                    projections.data(), depths.data());
+        for (int i = 0; i < num_points; i++)
+        {
+            if (depths[i] <= 0.0)
+            {
+                continue;
+            }
+            const Eigen::Map<const Eigen::Vector2d> projection(
+                projections.data() + 2*i);
+            sum += (projection - *view->GetFeature(track_ids[i])).norm();
+            num_observations++;
+        }
+    }
+    return num_observations > 0 ? sum/num_observations : 0.0;
+}
+
+// Estimates X from the views and matches of the builder and fills the
+// result.
+bool EstimateHandEye(const HandEyeCalibrationOptions& options,
+                     const HandEyeCalibrationFrames& frames,
+                     const std::vector<int>& frame_indices,
+                     HandEyeCalibrationBuilder* builder,
+                     HandEyeCalibrationResult* result)
+{
+    result->num_verified_pairs = builder->NumTwoViewMatches();
+    if (result->num_verified_pairs == 0)
+    {
+        result->message = "No image pair could be verified.";
+        LOG(ERROR) << result->message;
+        return false;
+    }
+    std::vector<std::string> view_names;
+    for (const int index : frame_indices)
+    {
+        view_names.emplace_back(ViewName(frames[index]));
+    }
+    builder->SetHandPoses(view_names, HandPosesOfFrames(frames, frame_indices));
+    if (options.has_initial_hand_eye)
+    {
+        builder->SetInitialHandEye(options.initial_hand_eye,
+                                   options.warm_start_options);
+    }
+
+    ReconstructionEstimatorSummary summary;
+    if (!builder->BuildHandEyeCalibration(&result->handeye, &summary))
+    {
+        return false;
+    }
+    result->warm_started = builder->WarmStarted();
+    result->reconstruction = builder->GetReconstruction();
+    result->success = summary.success;
+    result->num_input_views = result->reconstruction->NumViews();
+    result->num_estimated_views = summary.estimated_views.size();
+    result->num_input_tracks = result->reconstruction->NumTracks();
+    result->num_estimated_tracks = summary.estimated_tracks.size();
+    result->mean_reprojection_error_pixels =
+        MeanReprojectionError(*result->reconstruction);
+    result->message = summary.message;
+    return result->success;
+}
+
+// The hand pose of an image named by the index of its hand pose.
+bool HandPoseOfImage(const Poses& handposes, const std::string& image,
+                     Pose* handpose)
+{
+    std::string image_filename;
+    CHECK(GetFilenameFromFilepath(image, false, &image_filename));
+    const int handpose_index = atoi(image_filename.c_str());
+    if (handpose_index < 0 || handpose_index >= handposes.size())
+    {
+        LOG(ERROR) << "No hand pose for image " << image;
+        return false;
+    }
+    *handpose = handposes[handpose_index];
+    return true;
+}
+
+}  // namespace
+
+HandEyeCalibrationStages::HandEyeCalibrationStages(
+    const HandEyeCalibrationOptions& options,
+    const HandEyeCalibrationFrames& frames)
+    : options_(options), frames_(frames), elapsed_seconds_(0.0)
+{
+}
+
+HandEyeCalibrationStages::~HandEyeCalibrationStages()
+{
+}
+
+bool HandEyeCalibrationStages::Fail(const std::string& message)
+{
+    LOG(ERROR) << message;
+    error_message_ = message;
+    return false;
+}
+
+bool HandEyeCalibrationStages::CheckExcitation()
+{
+    if (!CheckHandPoseExcitation(HandPosesOfFrames(frames_, frame_indices_),
+                                 options_.excitation_options,
+                                 options_.excitation_check, &excitation_))
+    {
+        return Fail("Hand motions do not excite the hand-eye calibration:\n" +
+                    excitation_.message);
+    }
+    return true;
+}
+
+bool HandEyeCalibrationStages::ExtractAndMatchFeatures()
+{
+    Timer timer;
+    if (builder_ != nullptr || frames_.size() < 2)
+    {
+        return Fail("The calibration needs at least 2 images, and features or "
+                    "matches can only be added once.");
+    }
+    frame_indices_ = SelectFrames(options_, frames_);
+    if (!CheckExcitation())
+    {
+        return false;
+    }
+
+    // theia only extracts features from files.
+    bool use_hand_eye_front_end = options_.use_hand_eye_front_end;
+    for (const int index : frame_indices_)
+    {
+        use_hand_eye_front_end |= IsDecoded(frames_[index]);
+    }
+
+    // The front end matches every pair by brute force or along the epipolar
+    // lines, and keeps all features in memory.
+    if (use_hand_eye_front_end &&
+            options_.builder_options.matching_strategy !=
+            MatchingStrategy::BRUTE_FORCE)
+    {
+        return Fail("The hand-eye front end only supports brute force matching.");
+    }
+
+    builder_.reset(new HandEyeCalibrationBuilder(options_.builder_options));
+    builder_->SetProfiler(options_.profiler);
+    {
+        ScopedStageTimer stage_timer(options_.profiler,
+                                     "feature_extraction_and_matching");
+        std::vector<CameraIntrinsicsPrior> intrinsics;
+        if (use_hand_eye_front_end)
+        {
+            intrinsics = CompleteIntrinsics(frames_, frame_indices_);
+        }
+        std::string error_message = "Could not extract and match the features.";
+        if (!AddViews(options_, frames_, frame_indices_,
+                      use_hand_eye_front_end ? &intrinsics : nullptr,
+                      builder_.get()) ||
+                !(use_hand_eye_front_end ?
+                  ExtractAndMatchWithFrontEnd(options_, frames_, frame_indices_,
+                                              intrinsics, builder_.get(),
+                                              &error_message) :
+                  ExtractAndMatchWithTheia(options_, frames_, frame_indices_,
+                                           builder_.get())))
+        {
+            return Fail(error_message);
+        }
+    }
+    elapsed_seconds_ += timer.ElapsedTimeInSeconds();
+    return true;
+}
+
+bool HandEyeCalibrationStages::AddMatches(
+    const std::vector<ImagePairMatch>& matches)
+{
+    Timer timer;
+    if (builder_ != nullptr || frames_.size() < 2)
+    {
+        return Fail("The calibration needs at least 2 images, and features or "
+                    "matches can only be added once.");
+    }
+    frame_indices_.resize(frames_.size());
+    for (int i = 0; i < frames_.size(); i++)
+    {
+        frame_indices_[i] = i;
+    }
+    if (!CheckExcitation())
+    {
+        return false;
+    }
+
+    builder_.reset(new HandEyeCalibrationBuilder(options_.builder_options));
+    builder_->SetProfiler(options_.profiler);
+    {
+        ScopedStageTimer stage_timer(options_.profiler, "read_matches");
+        if (!AddViews(options_, frames_, frame_indices_, nullptr,
+                      builder_.get()))
+        {
+            return Fail("Could not add the views.");
+        }
+        for (const ImagePairMatch& match : matches)
+        {
+            if (!builder_->AddTwoViewMatch(match.image1, match.image2, match))
+            {
+                return Fail("Could not add the matches of " + match.image1 +
+                            " and " + match.image2);
+            }
+        }
+    }
+    elapsed_seconds_ += timer.ElapsedTimeInSeconds();
+    return true;
+}
+
+bool HandEyeCalibrationStages::Estimate(HandEyeCalibrationResult* result)
+{
+    Timer timer;
+    if (builder_ == nullptr)
+    {
+        Fail("Features or matches must be added before the estimation.");
+        result->message = error_message_;
+        return false;
+    }
+    result->excitation = excitation_;
+    const bool success = EstimateHandEye(options_, frames_, frame_indices_,
+                                         builder_.get(), result);
+    // The builder gave its reconstruction to the result.
+    builder_.reset();
+    elapsed_seconds_ += timer.ElapsedTimeInSeconds();
+    result->total_time_seconds = elapsed_seconds_;
+    return success;
+}
+
+bool CalibrateHandEye(const HandEyeCalibrationOptions& options,
+                      const HandEyeCalibrationFrames& frames,
+                      HandEyeCalibrationResult* result)
+{
+    HandEyeCalibrationStages stages(options, frames);
+    if (!stages.ExtractAndMatchFeatures())
+    {
+        result->message = stages.ErrorMessage();
+        return false;
+    }
+    return stages.Estimate(result);
+}
+
+bool CalibrateHandEyeFromMatches(const HandEyeCalibrationOptions& options,
+                                 const HandEyeCalibrationFrames& frames,
+                                 const std::vector<ImagePairMatch>& matches,
+                                 HandEyeCalibrationResult* result)
+{
+    HandEyeCalibrationStages stages(options, frames);
+    if (!stages.AddMatches(matches))
+    {
+        result->message = stages.ErrorMessage();
+        return false;
+    }
+    return stages.Estimate(result);
+}
+
+ReconstructionBuilderOptions DefaultHandEyeBuilderOptions()
+{
+    ReconstructionBuilderOptions options;
+    options.min_num_inlier_matches = 30;
+    options.max_track_length = 50;
+    // The only strategy of the hand-eye front end.
+    options.matching_strategy = MatchingStrategy::BRUTE_FORCE;
+    options.matching_options.perform_geometric_verification = true;
+    options.matching_options.geometric_verification_options
+    .estimate_twoview_info_options.max_sampson_error_pixels = 4.0;
+    options.matching_options.geometric_verification_options
+    .triangulation_max_reprojection_error = 15.0;
+    options.matching_options.geometric_verification_options
+    .min_triangulation_angle_degrees = 4.0;
+    options.matching_options.geometric_verification_options
+    .final_max_reprojection_error = 4.0;
+
+    ReconstructionEstimatorOptions& estimator_options =
+        options.reconstruction_estimator_options;
+    estimator_options.min_num_two_view_inliers = 30;
+    estimator_options.intrinsics_to_optimize = OptimizeIntrinsicsType::NONE;
+    estimator_options.max_reprojection_error_in_pixels = 4.0;
+    estimator_options.min_triangulation_angle_degrees = 4.0;
+    estimator_options.triangulation_max_reprojection_error_in_pixels = 15.0;
+    return options;
+}
+
+bool ReadHandEyeCalibrationFrames(const std::string& hand_poses_file,
+                                  const std::string& image_wildcard,
+                                  const std::string& calibration_file,
+                                  HandEyeCalibrationFrames* frames)
+{
+    Poses handposes;
+    if (!ReadHandPoses(hand_poses_file, &handposes))
+    {
+        LOG(ERROR) << "Could not read the hand poses " << hand_poses_file;
+        return false;
+    }
+    std::vector<std::string> image_files;
+    if (!GetFilepathsFromWildcard(image_wildcard, &image_files) ||
+            image_files.empty())
+    {
+        LOG(ERROR) << "No images found in " << image_wildcard;
+        return false;
+    }
+    std::unordered_map<std::string, CameraIntrinsicsPrior> intrinsics;
+    if (calibration_file.size() != 0 &&
+            !ReadCalibration(calibration_file, &intrinsics))
+    {
+        LOG(ERROR) << "Could not read the calibration file " << calibration_file;
+        return false;
+    }
+    frames->resize(image_files.size());
+    for (int i = 0; i < image_files.size(); i++)
+    {
+        HandEyeCalibrationFrame& frame = (*frames)[i];
+        frame.image_filepath = image_files[i];
+        std::string image_filename;
+        CHECK(GetFilenameFromFilepath(image_files[i], true, &image_filename));
+        const CameraIntrinsicsPrior* prior = FindOrNull(intrinsics, image_filename);
+        if (prior != nullptr)
+        {
+            frame.intrinsics = *prior;
+        }
+        if (!HandPoseOfImage(handposes, image_files[i], &frame.handpose))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool ReadHandEyeCalibrationFramesFromMatches(
+    const std::string& hand_poses_file, const std::string& matches_file,
+    HandEyeCalibrationFrames* frames, std::vector<ImagePairMatch>* matches)
+{
+    Poses handposes;
+    if (!ReadHandPoses(hand_poses_file, &handposes))
+    {
+        LOG(ERROR) << "Could not read the hand poses " << hand_poses_file;
+        return false;
+    }
+    std::vector<std::string> image_files;
+    std::vector<CameraIntrinsicsPrior> intrinsics;
+    if (!ReadMatchesAndGeometry(matches_file, &image_files, &intrinsics,
+                                matches))
+    {
+        LOG(ERROR) << "Could not read the matches file " << matches_file;
+        return false;
+    }
+    frames->resize(image_files.size());
+    for (int i = 0; i < image_files.size(); i++)
+    {
+        HandEyeCalibrationFrame& frame = (*frames)[i];
+        frame.name = image_files[i];
+        frame.intrinsics = intrinsics[i];
+        if (!HandPoseOfImage(handposes, image_files[i], &frame.handpose))
+        {
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,189 @@
+#ifndef HANDEYE_CALIBRATION_H
+#define HANDEYE_CALIBRATION_H
+
+#include <Eigen/Core>
+#include <theia/theia.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "hand_pose_excitation.h"
+#include "hand_pose_pair_selection.h"
+#include "handeye_feature_frontend.h"
+#include "handeye_profiler.h"
+#include "handeyecalibration_estimator.h"
+#include "handeyetransformation.h"
+#include "image_buffer.h"
+#include "type.h"
+
+using namespace theia;
+
+// In-process hand-eye calibration by SfM, for applications that hold the
+// images, hand poses and intrinsics in memory and must not go through files
+// and a separate process. SHECAR is a command line front end to it.
+
+// One image of the capture with the hand pose it was taken at.
+struct HandEyeCalibrationFrame
+{
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+    // Unique name of the view. May be empty for images read from a file,
+    // whose filename is then the name.
+    std::string name;
+    // The decoded image, whose pixels must stay valid during the calibration.
+    // If it has no pixels, the image is read from image_filepath, and with
+    // CalibrateHandEyeFromMatches neither is needed.
+    ImageBuffer image;
+    std::string image_filepath;
+    // Unset intrinsics are completed from the image: its size, its center as
+    // principal point and, for files, the EXIF focal length.
+    CameraIntrinsicsPrior intrinsics;
+    Pose handpose;
+};
+
+typedef std::vector<HandEyeCalibrationFrame,
+        Eigen::aligned_allocator<HandEyeCalibrationFrame> > HandEyeCalibrationFrames;
+
+struct HandEyeCalibrationOptions
+{
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+    // Feature extraction, matching and estimation options, see
+    // theia/sfm/reconstruction_builder.h.
+    ReconstructionBuilderOptions builder_options;
+    // Extract and match with the hand-eye front end instead of theia's, which
+    // decoded images always use. It writes builder_options.output_matches_file
+    // like theia, but only supports brute force matching and matches in
+    // memory, ignoring match_out_of_core and the out of core cache.
+    bool use_hand_eye_front_end = false;
+    HandEyeFeatureFrontEndOptions front_end_options;
+    // Share one set of intrinsics between all views.
+    bool shared_calibration = false;
+
+    // Prior hand-eye transformation X, used by guided matching, rotation
+    // prior verification and pair selection, and as the initial X of the
+    // estimation if the motion pairs agree with it.
+    bool has_initial_hand_eye = false;
+    Pose initial_hand_eye;
+    HandEyeWarmStartOptions warm_start_options;
+
+    // If positive, only this many frames, chosen from the hand poses to
+    // maximize the observability of X, are used.
+    int num_views_to_select = 0;
+    // Only match the pairs of frames whose frustums are predicted to overlap
+    // from the hand poses and the initial X, all pairs are matched without
+    // it. The field of view is taken from the intrinsics of the first frame
+    // if they are known.
+    bool select_pairs_from_hand_poses = false;
+    HandPosePairSelectionOptions pair_selection_options;
+
+    // Checked on the hand poses of the calibrated frames before their
+    // features are extracted or their matches added.
+    HandPoseExcitationOptions excitation_options;
+    HandPoseExcitationCheck excitation_check = HandPoseExcitationCheck::WARN;
+    // Profiles all stages if not null. Not owned.
+    HandEyeProfiler* profiler = nullptr;
+};
+
+struct HandEyeCalibrationResult
+{
+    bool success = false;
+    HandEyeTransformation handeye;
+
+    // Diagnostics.
+    int num_input_views = 0;
+    int num_estimated_views = 0;
+    int num_verified_pairs = 0;
+    int num_input_tracks = 0;
+    int num_estimated_tracks = 0;
+    // Over all observations of the estimated tracks in the estimated views.
+    double mean_reprojection_error_pixels = 0.0;
+    // The estimation started from the initial X without RANSAC.
+    bool warm_started = false;
+    HandPoseExcitationSummary excitation;
+    double total_time_seconds = 0.0;
+    std::string message;
+
+    // The estimated views and tracks, named after the frames.
+    std::unique_ptr<Reconstruction> reconstruction;
+};
+
+class HandEyeCalibrationBuilder;
+
+// A calibration split into its two stages, for schedulers that interleave the
+// stages of several calibrations: ExtractAndMatchFeatures or AddMatches, then
+// Estimate. The frames must outlive the object.
+class HandEyeCalibrationStages
+{
+public:
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+    HandEyeCalibrationStages(const HandEyeCalibrationOptions& options,
+                             const HandEyeCalibrationFrames& frames);
+    ~HandEyeCalibrationStages();
+
+    // Selects the frames, and extracts and matches their features. Returns
+    // false, with the reason in ErrorMessage, e.g. if an image can not be
+    // read or the excitation check fails.
+    bool ExtractAndMatchFeatures();
+    // Adds verified matches between all frames, given by name, instead.
+    bool AddMatches(const std::vector<ImagePairMatch>& matches);
+    const std::string& ErrorMessage() const
+    {
+        return error_message_;
+    }
+    // Estimates X and the reconstruction from the matches. The time of both
+    // stages, without the time in between, is the total time of the result.
+    // Returns false with the reason in result->message.
+    bool Estimate(HandEyeCalibrationResult* result);
+
+private:
+    // Logs and keeps the message, returns false.
+    bool Fail(const std::string& message);
+    // Applies options_.excitation_check to the hand poses of frame_indices_.
+    bool CheckExcitation();
+
+    const HandEyeCalibrationOptions options_;
+    const HandEyeCalibrationFrames& frames_;
+    std::vector<int> frame_indices_;
+    std::unique_ptr<HandEyeCalibrationBuilder> builder_;
+    HandPoseExcitationSummary excitation_;
+    double elapsed_seconds_;
+    std::string error_message_;
+
+    HandEyeCalibrationStages(const HandEyeCalibrationStages&) = delete;
+    HandEyeCalibrationStages& operator=(const HandEyeCalibrationStages&) = delete;
+};
+
+// Extracts and matches the features of the frames, and estimates X and the
+// reconstruction. Returns false if there are fewer than two frames, an image
+// can not be read or there are no verified pairs, with the reason in
+// result->message.
+bool CalibrateHandEye(const HandEyeCalibrationOptions& options,
+                      const HandEyeCalibrationFrames& frames,
+                      HandEyeCalibrationResult* result);
+
+// The same from verified matches, e.g. of a matches file, between frames
+// given by name. num_views_to_select and pair selection do not apply.
+bool CalibrateHandEyeFromMatches(const HandEyeCalibrationOptions& options,
+                                 const HandEyeCalibrationFrames& frames,
+                                 const std::vector<ImagePairMatch>& matches,
+                                 HandEyeCalibrationResult* result);
+
+// The options of SHECAR with its default flags.
+ReconstructionBuilderOptions DefaultHandEyeBuilderOptions();
+
+// Reads one frame per image matching the wildcard, with its calibration from
+// calibration_file if it is not empty and lists the image. As for SHECAR,
+// images are named by the index of their hand pose in hand_poses_file.
+bool ReadHandEyeCalibrationFrames(const std::string& hand_poses_file,
+                                  const std::string& image_wildcard,
+                                  const std::string& calibration_file,
+                                  HandEyeCalibrationFrames* frames);
+// The same for the images of a matches file, whose matches are returned for
+// CalibrateHandEyeFromMatches.
+bool ReadHandEyeCalibrationFramesFromMatches(
+    const std::string& hand_poses_file, const std::string& matches_file,
+    HandEyeCalibrationFrames* frames, std::vector<ImagePairMatch>* matches);
+
+#endif // HANDEYE_CALIBRATION_H
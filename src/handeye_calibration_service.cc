@@ -0,0 +1,179 @@
+#include "handeye_calibration_service.h"
+
+#include <glog/logging.h>
+#include <algorithm>
+#include <utility>
+
+#include "trace_recorder.h"
+
+struct HandEyeCalibrationService::JobState
+{
+    std::unique_ptr<HandEyeCalibrationJob> job;
+    // Refers to the frames of job, so it is destroyed first.
+    std::unique_ptr<HandEyeCalibrationStages> stages;
+    std::unique_ptr<HandEyeCalibrationJobResult> result;
+    Timer timer;
+};
+
+HandEyeCalibrationService::HandEyeCalibrationService(
+    const HandEyeCalibrationServiceOptions& options)
+    : options_(options),
+      num_threads_per_stage_(std::max(1, options.num_threads_per_stage)),
+      stopping_(false), next_job_id_(0)
+{
+    int num_threads = options_.num_threads;
+    if (num_threads <= 0)
+    {
+        num_threads = std::thread::hardware_concurrency();
+    }
+    const int num_workers = std::max(1, num_threads/num_threads_per_stage_);
+    LOG(INFO) << "Running " << num_workers << " calibration stages of "
+              << num_threads_per_stage_ << " threads at a time.";
+    for (int i = 0; i < num_workers; i++)
+    {
+        workers_.emplace_back(&HandEyeCalibrationService::RunWorker, this, i);
+    }
+}
+
+HandEyeCalibrationService::~HandEyeCalibrationService()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    stage_available_.notify_all();
+    for (std::thread& worker : workers_)
+    {
+        worker.join();
+    }
+}
+
+int HandEyeCalibrationService::Submit(std::unique_ptr<HandEyeCalibrationJob> job)
+{
+    // The service bounds the threads, not the jobs. The estimation passes its
+    // num_threads on to Ceres and the triangulation, while the front end
+    // decodes on one more thread than it extracts and matches on.
+    HandEyeCalibrationOptions& options = job->options;
+    options.builder_options.num_threads = num_threads_per_stage_;
+    options.builder_options.reconstruction_estimator_options.num_threads =
+        num_threads_per_stage_;
+    options.front_end_options.num_threads =
+        std::max(1, num_threads_per_stage_ - 1);
+
+    std::unique_ptr<JobState> state(new JobState);
+    state->result.reset(new HandEyeCalibrationJobResult);
+    state->result->name = job->name;
+    const int priority = job->priority;
+    state->job = std::move(job);
+
+    int job_id;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        job_id = next_job_id_++;
+        state->result->job_id = job_id;
+        jobs_[job_id] = std::move(state);
+        stages_.push(Stage{priority, job_id});
+    }
+    stage_available_.notify_one();
+    return job_id;
+}
+
+std::unique_ptr<HandEyeCalibrationJobResult>
+HandEyeCalibrationService::WaitForNextResult()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    result_available_.wait(lock, [this]()
+    {
+        return !results_.empty() || jobs_.empty();
+    });
+    if (results_.empty())
+    {
+        return nullptr;
+    }
+    std::unique_ptr<HandEyeCalibrationJobResult> result =
+        std::move(results_.front());
+    results_.pop_front();
+    return result;
+}
+
+int HandEyeCalibrationService::NumPendingJobs() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return jobs_.size();
+}
+
+void HandEyeCalibrationService::RunWorker(const int worker_index)
+{
+    SetTraceThreadName("calibration worker " + std::to_string(worker_index));
+    while (true)
+    {
+        JobState* job;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            stage_available_.wait(lock, [this]()
+            {
+                return stopping_ || !stages_.empty();
+            });
+            if (stopping_)
+            {
+                return;
+            }
+            job = jobs_[stages_.top().job_id].get();
+            stages_.pop();
+        }
+        RunStage(job);
+    }
+}
+
+// Only one stage of a job is ever queued, so the job is not shared while its
+// stage runs.
+void HandEyeCalibrationService::RunStage(JobState* job)
+{
+    HandEyeCalibrationJob& calibration_job = *job->job;
+    HandEyeCalibrationJobResult* result = job->result.get();
+    if (job->stages == nullptr)
+    {
+        ScopedTraceSpan span(calibration_job.name + " matching");
+        job->stages.reset(new HandEyeCalibrationStages(calibration_job.options,
+                          calibration_job.frames));
+        bool matched;
+        if (calibration_job.calibrate_from_matches)
+        {
+            matched = job->stages->AddMatches(calibration_job.matches);
+            // The builder holds its own copy.
+            std::vector<ImagePairMatch>().swap(calibration_job.matches);
+        }
+        else
+        {
+            matched = job->stages->ExtractAndMatchFeatures();
+        }
+        if (matched)
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                stages_.push(Stage{calibration_job.priority, result->job_id});
+            }
+            stage_available_.notify_one();
+            return;
+        }
+        LOG(ERROR) << "Could not match the images of job " << result->name;
+        result->result.message = job->stages->ErrorMessage();
+    }
+    else
+    {
+        ScopedTraceSpan span(calibration_job.name + " estimation");
+        result->success = job->stages->Estimate(&result->result);
+    }
+    result->latency_seconds = job->timer.ElapsedTimeInSeconds();
+
+    // The images, matches and builder of the job are freed outside the lock.
+    std::unique_ptr<JobState> finished;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        results_.emplace_back(std::move(job->result));
+        auto it = jobs_.find(results_.back()->job_id);
+        finished = std::move(it->second);
+        jobs_.erase(it);
+    }
+    result_available_.notify_all();
+}
@@ -0,0 +1,125 @@
+#ifndef HANDEYE_CALIBRATION_SERVICE_H
+#define HANDEYE_CALIBRATION_SERVICE_H
+
+#include <Eigen/Core>
+#include <theia/theia.h>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "handeye_calibration.h"
+
+using namespace theia;
+
+// One independent calibration, e.g. of one robot cell.
+struct HandEyeCalibrationJob
+{
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+    std::string name;
+    // Stages of jobs with a higher priority run first, among equal priorities
+    // the stages of the job submitted first.
+    int priority = 0;
+    // The thread counts are overridden by the service. Give every job its own
+    // options.profiler, a shared one adds up the stages of all jobs.
+    HandEyeCalibrationOptions options;
+    HandEyeCalibrationFrames frames;
+    // Calibrate from these verified matches instead of extracting features.
+    bool calibrate_from_matches = false;
+    std::vector<ImagePairMatch> matches;
+};
+
+struct HandEyeCalibrationJobResult
+{
+    int job_id = -1;
+    std::string name;
+    bool success = false;
+    HandEyeCalibrationResult result;
+    // From the submission to the completion of the job, including the time
+    // its stages waited for a worker.
+    double latency_seconds = 0.0;
+};
+
+struct HandEyeCalibrationServiceOptions
+{
+    // Threads shared by all jobs, 0 for one per core.
+    int num_threads = 0;
+    // Threads of every stage, i.e. the num_threads of its feature extraction,
+    // matching and estimation, Ceres included. The front end spends one of
+    // them on decoding, so a stage of 1 thread still decodes on a second.
+    // num_threads/num_threads_per_stage stages run at the same time.
+    int num_threads_per_stage = 1;
+};
+
+// Calibrates independent jobs on one bounded set of threads, so that
+// concurrent calibrations neither oversubscribe the cores nor start a
+// process each. The feature extraction and matching and the estimation of
+// every job are scheduled separately by priority, and the estimation of a
+// job goes before the extraction of the jobs submitted after it, which bounds
+// its latency. Results are handed out as the jobs complete. Thread safe.
+//
+// Tracing and the progress metrics are process wide. The trace spans of the
+// stages carry the job name, but the metrics, e.g. shecar_frontend_images,
+// aggregate the jobs that run at the same time, and their gauges are those of
+// whichever job set them last.
+class HandEyeCalibrationService
+{
+public:
+    explicit HandEyeCalibrationService(
+        const HandEyeCalibrationServiceOptions& options);
+    // Waits for the running stages, the queued ones are dropped.
+    ~HandEyeCalibrationService();
+
+    // Returns the id of the job, which is in its result.
+    int Submit(std::unique_ptr<HandEyeCalibrationJob> job);
+
+    // Blocks until a job completes and returns its result. Returns null once
+    // the results of all submitted jobs have been returned.
+    std::unique_ptr<HandEyeCalibrationJobResult> WaitForNextResult();
+
+    int NumPendingJobs() const;
+
+private:
+    struct JobState;
+    struct Stage
+    {
+        int priority;
+        int job_id;
+        bool operator<(const Stage& other) const
+        {
+            // std::priority_queue pops the largest element.
+            if (priority != other.priority)
+            {
+                return priority < other.priority;
+            }
+            return job_id > other.job_id;
+        }
+    };
+
+    void RunWorker(const int worker_index);
+    void RunStage(JobState* job);
+
+    const HandEyeCalibrationServiceOptions options_;
+    const int num_threads_per_stage_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable stage_available_;
+    std::condition_variable result_available_;
+    bool stopping_;
+    int next_job_id_;
+    std::priority_queue<Stage> stages_;
+    std::unordered_map<int, std::unique_ptr<JobState> > jobs_;
+    std::deque<std::unique_ptr<HandEyeCalibrationJobResult> > results_;
+    std::vector<std::thread> workers_;
+
+    HandEyeCalibrationService(const HandEyeCalibrationService&) = delete;
+    HandEyeCalibrationService& operator=(const HandEyeCalibrationService&) = delete;
+};
+
+#endif // HANDEYE_CALIBRATION_SERVICE_H
@@ -0,0 +1,790 @@
+#include "handeye_feature_frontend.h"
+#include "scaled_jpeg_decoder.h"
+#include "calibration_metrics.h"
+#include "trace_recorder.h"
+
+#include <glog/logging.h>
+#include <Eigen/LU>
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <sstream>
+
+namespace
+{
+
+bool IsCalibrated(const CameraIntrinsicsPrior& intrinsics)
+{
+    return intrinsics.focal_length.is_set && intrinsics.principal_point.is_set;
+}
+
+Eigen::Matrix3d CalibrationMatrix(const CameraIntrinsicsPrior& intrinsics)
+{
+    const double focal_length = intrinsics.focal_length.value[0];
+    const double aspect_ratio =
+        intrinsics.aspect_ratio.is_set ? intrinsics.aspect_ratio.value[0] : 1.0;
+    const double skew = intrinsics.skew.is_set ? intrinsics.skew.value[0] : 0.0;
+    Eigen::Matrix3d calibration;
+    calibration << focal_length, skew, intrinsics.principal_point.value[0],
+                0.0, focal_length*aspect_ratio, intrinsics.principal_point.value[1],
+                0.0, 0.0, 1.0;
+    return calibration;
+}
+
+Eigen::Matrix3d CrossProductMatrix(const Eigen::Vector3d& u)
+{
+    Eigen::Matrix3d cross;
+    cross << 0.0, -u(2), u(1),
+          u(2), 0.0, -u(0),
+          -u(1), u(0), 0.0;
+    return cross;
+}
+
+// Extends a cache key by an intrinsics prior, whose value is only hashed if
+// it is set.
+template <typename PriorType>
+uint64_t ExtendCacheKeyByPrior(const uint64_t key, const PriorType& prior)
+{
+    const uint64_t extended_key = ExtendCacheKey(key, &prior.is_set, sizeof(bool));
+    return prior.is_set ?
+           ExtendCacheKey(extended_key, prior.value, sizeof(prior.value)) :
+           extended_key;
+}
+
+struct DecodedImage
+{
+    int image_index;
+    FloatImage image;
+    int downscale;
+};
+
+}  // namespace
+
+struct HandEyeFeatureFrontEnd::Pipeline
+{
+    std::mutex mutex;
+    // Signaled when there is a pair to match or a decoded image to extract,
+    // or when the last image got its features.
+    std::condition_variable work_available;
+    std::condition_variable decoded_image_taken;
+
+    std::deque<DecodedImage> decoded_images;
+    std::deque<int> pairs_to_match;
+
+    std::vector<std::vector<int> > pairs_of_image;
+    std::vector<int> num_images_of_pair_ready;
+    // The features of an image are released once this drops to 0.
+    std::vector<int> num_pairs_of_image_left;
+    int num_images_ready;
+    // Pairs are queued only once all images have features.
+    bool hold_pairs;
+    // An image could not be decoded or extracted, all stages stop.
+    bool failed;
+};
+
+HandEyeFeatureFrontEnd::HandEyeFeatureFrontEnd(
+    const HandEyeFeatureFrontEndOptions& options)
+    : options_(options), first_image_index_(0), has_handeye_(false),
+      has_image_pairs_(false)
+{
+    if (!options_.feature_cache_directory.empty())
+    {
+        feature_cache_.reset(new FeatureCache(options_.feature_cache_directory));
+    }
+    if (!options_.static_feature_mask_filepath.empty())
+    {
+        static_feature_mask_.reset(new StaticFeatureMask());
+        if (!static_feature_mask_->Read(options_.static_feature_mask_filepath))
+        {
+            // Reported by every extraction, which fails rather than keep the
+            // features the mask would remove.
+            static_feature_mask_error_ = "Could not read the static feature mask " +
+                                         options_.static_feature_mask_filepath;
+            LOG(ERROR) << static_feature_mask_error_;
+            static_feature_mask_.reset();
+        }
+    }
+}
+
+int HandEyeFeatureFrontEnd::AddImage(const std::string& image_filepath,
+                                     const CameraIntrinsicsPrior& intrinsics,
+                                     const Pose& handpose)
+{
+    Image image;
+    image.filepath = image_filepath;
+    image.intrinsics = intrinsics;
+    image.handpose = handpose;
+    CHECK(GetFilenameFromFilepath(image_filepath, true,
+                                  &image.features.image_name));
+    images_.emplace_back(image);
+    return NumImages() - 1;
+}
+
+int HandEyeFeatureFrontEnd::AddImage(const std::string& image_name,
+                                     const ImageBuffer& buffer,
+                                     const CameraIntrinsicsPrior& intrinsics,
+                                     const Pose& handpose)
+{
+    CHECK(buffer.pixels != nullptr) << "No pixels for image " << image_name;
+    Image image;
+    image.buffer = buffer;
+    image.intrinsics = intrinsics;
+    image.handpose = handpose;
+    image.features.image_name = image_name;
+    images_.emplace_back(image);
+    return NumImages() - 1;
+}
+
+void HandEyeFeatureFrontEnd::SetHandEye(const Pose& handeye)
+{
+    handeye_ = handeye;
+    has_handeye_ = true;
+}
+
+void HandEyeFeatureFrontEnd::SetImagePairsToMatch(
+    const std::vector<std::pair<int, int> >& image_pairs)
+{
+    image_pairs_ = image_pairs;
+    has_image_pairs_ = true;
+}
+
+bool HandEyeFeatureFrontEnd::ExtractAndMatchFeatures(
+    std::vector<ImagePairMatch>* matches)
+{
+    // The pipeline runs over all images, they are indexed from 0 on.
+    CHECK_EQ(first_image_index_, 0)
+            << "Images were removed before ExtractAndMatchFeatures.";
+    if (!static_feature_mask_error_.empty())
+    {
+        error_message_ = static_feature_mask_error_;
+        return false;
+    }
+    if (!has_image_pairs_)
+    {
+        for (int i = 0; i < images_.size(); i++)
+        {
+            for (int j = i + 1; j < images_.size(); j++)
+            {
+                image_pairs_.emplace_back(i, j);
+            }
+        }
+        has_image_pairs_ = true;
+    }
+    if (image_pairs_.empty())
+    {
+        LOG(WARNING) << "No image pairs to match.";
+        return true;
+    }
+
+    CHECK_GT(options_.max_num_decoded_images, 0);
+    match_settings_ = MatchSettings();
+    pair_matches_.clear();
+    pair_matches_.resize(image_pairs_.size());
+    pair_verified_.assign(image_pairs_.size(), false);
+
+    Pipeline pipeline;
+    pipeline.pairs_of_image.resize(images_.size());
+    for (int i = 0; i < image_pairs_.size(); i++)
+    {
+        pipeline.pairs_of_image[image_pairs_[i].first].emplace_back(i);
+        pipeline.pairs_of_image[image_pairs_[i].second].emplace_back(i);
+    }
+    pipeline.num_images_of_pair_ready.assign(image_pairs_.size(), 0);
+    pipeline.num_pairs_of_image_left.resize(images_.size());
+    for (int i = 0; i < images_.size(); i++)
+    {
+        pipeline.num_pairs_of_image_left[i] = pipeline.pairs_of_image[i].size();
+    }
+    pipeline.num_images_ready = 0;
+    pipeline.hold_pairs = options_.suppress_static_features;
+    pipeline.failed = false;
+    error_message_.clear();
+    SetMetric("shecar_frontend_images", images_.size());
+    SetMetric("shecar_frontend_image_pairs", image_pairs_.size());
+    SetMetric("shecar_frontend_images_ready", 0);
+    SetMetric("shecar_frontend_image_pairs_matched", 0);
+    {
+        // One thread decodes, the others extract and match.
+        ThreadPool pool(options_.num_threads + 1);
+        pool.Add(&HandEyeFeatureFrontEnd::DecodeImages, this, &pipeline);
+        for (int i = 0; i < options_.num_threads; i++)
+        {
+            pool.Add(&HandEyeFeatureFrontEnd::ExtractAndMatchTask, this, &pipeline);
+        }
+        pool.WaitForTasksToFinish();
+    }
+    if (pipeline.failed)
+    {
+        LOG(ERROR) << error_message_;
+        pair_matches_.clear();
+        return false;
+    }
+
+    for (int i = 0; i < image_pairs_.size(); i++)
+    {
+        if (pair_verified_[i])
+        {
+            matches->emplace_back(pair_matches_[i]);
+        }
+    }
+    pair_matches_.clear();
+    LOG(INFO) << matches->size() << " of " << image_pairs_.size()
+              << " image pairs were verified.";
+    return true;
+}
+
+void HandEyeFeatureFrontEnd::DecodeImages(Pipeline* pipeline)
+{
+    SetTraceThreadName("image decoder");
+    for (int i = 0; i < images_.size(); i++)
+    {
+        if (LoadCachedFeatures(i))
+        {
+            std::lock_guard<std::mutex> lock(pipeline->mutex);
+            if (pipeline->failed)
+            {
+                return;
+            }
+            SetImageReady(i, pipeline);
+            continue;
+        }
+
+        DecodedImage decoded_image;
+        decoded_image.image_index = i;
+        bool decoded;
+        {
+            ScopedTraceSpan span("decode_image");
+            decoded = DecodeImage(i, &decoded_image.image,
+                                  &decoded_image.downscale);
+        }
+        std::unique_lock<std::mutex> lock(pipeline->mutex);
+        if (!decoded)
+        {
+            Fail("Could not decode " + ImageName(i), pipeline);
+            return;
+        }
+        // Decoded images are large, so the decoder waits for the extraction
+        // to catch up.
+        {
+            ScopedTraceSpan span("wait_for_extraction");
+            pipeline->decoded_image_taken.wait(lock, [this, pipeline]
+            {
+                return pipeline->failed || pipeline->decoded_images.size() <
+                options_.max_num_decoded_images;
+            });
+        }
+        if (pipeline->failed)
+        {
+            return;
+        }
+        pipeline->decoded_images.emplace_back(std::move(decoded_image));
+        TraceCounter("decoded_images", pipeline->decoded_images.size());
+        pipeline->work_available.notify_one();
+    }
+}
+
+void HandEyeFeatureFrontEnd::ExtractAndMatchTask(Pipeline* pipeline)
+{
+    SetTraceThreadName("extract and match");
+    std::unique_lock<std::mutex> lock(pipeline->mutex);
+    while (true)
+    {
+        {
+            ScopedTraceSpan span("wait_for_work");
+            pipeline->work_available.wait(lock, [this, pipeline]
+            {
+                return pipeline->failed || !pipeline->pairs_to_match.empty() ||
+                !pipeline->decoded_images.empty() ||
+                pipeline->num_images_ready == images_.size();
+            });
+        }
+        if (pipeline->failed)
+        {
+            return;
+        }
+        // Matching goes first, it frees the features of an image as soon as
+        // its last pair is matched and never blocks the decoder.
+        if (!pipeline->pairs_to_match.empty())
+        {
+            const int pair_index = pipeline->pairs_to_match.front();
+            pipeline->pairs_to_match.pop_front();
+            lock.unlock();
+            {
+                ScopedTraceSpan span("match_pair");
+                MatchImagePairTask(pair_index);
+            }
+            IncrementMetric("shecar_frontend_image_pairs_matched");
+            PublishMetrics();
+            lock.lock();
+            ReleaseFeaturesIfMatched(image_pairs_[pair_index].first, pipeline);
+            ReleaseFeaturesIfMatched(image_pairs_[pair_index].second, pipeline);
+        }
+        else if (!pipeline->decoded_images.empty())
+        {
+            const DecodedImage decoded_image =
+                std::move(pipeline->decoded_images.front());
+            pipeline->decoded_images.pop_front();
+            pipeline->decoded_image_taken.notify_one();
+            lock.unlock();
+            bool extracted;
+            {
+                ScopedTraceSpan span("extract_features");
+                extracted = ExtractFeaturesFromImage(decoded_image.image_index,
+                                                     decoded_image.image,
+                                                     decoded_image.downscale);
+            }
+            lock.lock();
+            if (!extracted)
+            {
+                Fail("Could not extract features from " +
+                     ImageName(decoded_image.image_index), pipeline);
+                return;
+            }
+            SetImageReady(decoded_image.image_index, pipeline);
+        }
+        else
+        {
+            // All images have features and all their pairs are taken.
+            return;
+        }
+    }
+}
+
+void HandEyeFeatureFrontEnd::Fail(const std::string& message,
+                                  Pipeline* pipeline)
+{
+    if (!pipeline->failed)
+    {
+        pipeline->failed = true;
+        error_message_ = message;
+    }
+    pipeline->work_available.notify_all();
+    pipeline->decoded_image_taken.notify_all();
+}
+
+void HandEyeFeatureFrontEnd::SetImageReady(const int image_index,
+        Pipeline* pipeline)
+{
+    ++pipeline->num_images_ready;
+    if (pipeline->hold_pairs)
+    {
+        if (pipeline->num_images_ready < images_.size())
+        {
+            return;
+        }
+        // The other workers wait on the mutex meanwhile, there is nothing
+        // else to do before the pairs are released.
+        ScopedTraceSpan span("suppress_static_features");
+        SuppressStaticFeatures();
+        for (int i = 0; i < image_pairs_.size(); i++)
+        {
+            pipeline->pairs_to_match.emplace_back(i);
+        }
+        for (int i = 0; i < images_.size(); i++)
+        {
+            if (pipeline->num_pairs_of_image_left[i] == 0)
+            {
+                ReleaseFeatures(i);
+            }
+        }
+    }
+    else
+    {
+        for (const int pair_index : pipeline->pairs_of_image[image_index])
+        {
+            if (++pipeline->num_images_of_pair_ready[pair_index] == 2)
+            {
+                pipeline->pairs_to_match.emplace_back(pair_index);
+            }
+        }
+        if (pipeline->num_pairs_of_image_left[image_index] == 0)
+        {
+            ReleaseFeatures(image_index);
+        }
+    }
+    TraceCounter("pairs_to_match", pipeline->pairs_to_match.size());
+    SetMetric("shecar_frontend_images_ready", pipeline->num_images_ready);
+    PublishMetrics();
+    pipeline->work_available.notify_all();
+}
+
+void HandEyeFeatureFrontEnd::ReleaseFeaturesIfMatched(const int image_index,
+        Pipeline* pipeline)
+{
+    if (--pipeline->num_pairs_of_image_left[image_index] == 0)
+    {
+        ReleaseFeatures(image_index);
+    }
+}
+
+void HandEyeFeatureFrontEnd::MatchImagePairTask(const int pair_index)
+{
+    const int image_index1 = image_pairs_[pair_index].first;
+    const int image_index2 = image_pairs_[pair_index].second;
+    ImagePairMatch* match = &pair_matches_[pair_index];
+    // Static features are found from all images, so the matches of a pair
+    // also depend on the other images.
+    const bool use_memory_cache = options_.memory_cache != nullptr &&
+                                  !options_.suppress_static_features &&
+                                  GetImage(image_index1).has_cache_key &&
+                                  GetImage(image_index2).has_cache_key;
+    uint64_t key1, key2;
+    if (use_memory_cache)
+    {
+        key1 = MatchCacheKey(image_index1);
+        key2 = MatchCacheKey(image_index2);
+        bool verified;
+        if (options_.memory_cache->LoadMatch(key1, key2, &verified, match))
+        {
+            // The images may have been renamed.
+            match->image1 = ImageName(image_index1);
+            match->image2 = ImageName(image_index2);
+            pair_verified_[pair_index] = verified;
+            return;
+        }
+    }
+    pair_verified_[pair_index] = MatchImagePair(image_index1, image_index2,
+                                 match);
+    // A verified pair stays valid under any prior X, which only guides the
+    // search. A failed pair may pass with a better prior, so it is only kept
+    // if the prior played no part.
+    if (use_memory_cache && (pair_verified_[pair_index] || !UsesHandEyePrior()))
+    {
+        options_.memory_cache->StoreMatch(key1, key2, pair_verified_[pair_index],
+                                          *match);
+    }
+}
+
+uint64_t HandEyeFeatureFrontEnd::MatchCacheKey(const int image_index) const
+{
+    const Image& image = GetImage(image_index);
+    const Eigen::Matrix3d rotation = image.handpose.Rotation();
+    const Eigen::Vector3d translation = image.handpose.Translation();
+    uint64_t key = image.cache_key;
+    key = ExtendCacheKey(key, match_settings_.data(), match_settings_.size());
+    key = ExtendCacheKey(key, rotation.data(), 9*sizeof(double));
+    key = ExtendCacheKey(key, translation.data(), 3*sizeof(double));
+    key = ExtendCacheKeyByPrior(key, image.intrinsics.focal_length);
+    key = ExtendCacheKeyByPrior(key, image.intrinsics.principal_point);
+    key = ExtendCacheKeyByPrior(key, image.intrinsics.aspect_ratio);
+    key = ExtendCacheKeyByPrior(key, image.intrinsics.skew);
+    return ExtendCacheKeyByPrior(key, image.intrinsics.radial_distortion);
+}
+
+bool HandEyeFeatureFrontEnd::UsesHandEyePrior() const
+{
+    return has_handeye_ &&
+           (options_.guided_matching || options_.verify_with_rotation_prior);
+}
+
+std::string HandEyeFeatureFrontEnd::MatchSettings() const
+{
+    const GuidedFeatureMatcherOptions& matching = options_.matching_options;
+    const TwoViewMatchGeometricVerification::Options& verification =
+        options_.geometric_verification_options;
+    const EstimateTwoViewInfoOptions& twoview =
+        verification.estimate_twoview_info_options;
+    const RotationPriorVerificationOptions& rotation_prior =
+        options_.rotation_prior_verification_options;
+    std::ostringstream settings;
+    settings.precision(17);
+    settings << "uses_hand_eye_prior=" << UsesHandEyePrior()
+             << " guided_matching=" << options_.guided_matching
+             << " lowes_ratio=" << matching.lowes_ratio
+             << " keep_only_symmetric_matches="
+             << matching.keep_only_symmetric_matches
+             << " epipolar_band_pixels=" << matching.epipolar_band_pixels
+             << " grid_cell_pixels=" << matching.grid_cell_pixels
+             << " min_num_inlier_matches=" << options_.min_num_inlier_matches
+             << " max_sampson_error_pixels=" << twoview.max_sampson_error_pixels
+             << " min_ransac_iterations=" << twoview.min_ransac_iterations
+             << " max_ransac_iterations=" << twoview.max_ransac_iterations
+             << " use_mle=" << twoview.use_mle
+             << " bundle_adjustment=" << verification.bundle_adjustment
+             << " triangulation_max_reprojection_error="
+             << verification.triangulation_max_reprojection_error
+             << " min_triangulation_angle_degrees="
+             << verification.min_triangulation_angle_degrees
+             << " final_max_reprojection_error="
+             << verification.final_max_reprojection_error
+             << " verify_with_rotation_prior="
+             << options_.verify_with_rotation_prior
+             << " rotation_prior_max_sampson_error_pixels="
+             << rotation_prior.max_sampson_error_pixels
+             << " reestimate_relative_pose="
+             << rotation_prior.reestimate_relative_pose
+             << " refine_relative_pose=" << rotation_prior.refine_relative_pose
+             << " suppress_static_features=" << options_.suppress_static_features
+             << " static_feature_mask=" << options_.static_feature_mask_filepath;
+    return settings.str();
+}
+
+std::string HandEyeFeatureFrontEnd::ExtractorSettings() const
+{
+    std::ostringstream settings;
+    settings << "descriptor_type=" << static_cast<int>(options_.descriptor_type)
+             << " feature_density=" << static_cast<int>(options_.feature_density)
+             << " extraction_downscale=" << options_.extraction_downscale;
+    return settings.str();
+}
+
+bool HandEyeFeatureFrontEnd::ExtractFeatures(const int image_index)
+{
+    if (!static_feature_mask_error_.empty())
+    {
+        error_message_ = static_feature_mask_error_;
+        return false;
+    }
+    if (LoadCachedFeatures(image_index))
+    {
+        return true;
+    }
+    FloatImage image;
+    int downscale;
+    return DecodeImage(image_index, &image, &downscale) &&
+           ExtractFeaturesFromImage(image_index, image, downscale);
+}
+
+bool HandEyeFeatureFrontEnd::LoadCachedFeatures(const int image_index)
+{
+    ScopedTraceSpan span("load_cached_features");
+    Image& image = GetImage(image_index);
+    image.has_cache_key =
+        (feature_cache_ != nullptr || options_.memory_cache != nullptr) &&
+        image.buffer.pixels == nullptr &&
+        FeatureCache::ComputeKey(image.filepath, ExtractorSettings(),
+                                 &image.cache_key);
+    if (!image.has_cache_key)
+    {
+        return false;
+    }
+    if (options_.memory_cache != nullptr &&
+            options_.memory_cache->LoadFeatures(image.cache_key, &image.features))
+    {
+        VLOG(2) << "Reused the features of " << image.filepath << ".";
+    }
+    else if (feature_cache_ != nullptr &&
+             feature_cache_->Load(image.cache_key, &image.features))
+    {
+        VLOG(2) << "Loaded the features of " << image.filepath << " from the cache.";
+        if (options_.memory_cache != nullptr)
+        {
+            options_.memory_cache->StoreFeatures(image.cache_key, image.features);
+        }
+    }
+    else
+    {
+        return false;
+    }
+    ApplyStaticFeatureMask(image_index);
+    return true;
+}
+
+bool HandEyeFeatureFrontEnd::DecodeImage(const int image_index,
+        FloatImage* image, int* downscale) const
+{
+    const Image& source = GetImage(image_index);
+    if (source.buffer.pixels != nullptr)
+    {
+        *downscale = options_.extraction_downscale;
+        return ImageBufferToFloatImage(source.buffer, *downscale, image);
+    }
+    const std::string& filepath = source.filepath;
+    // Anything that is not a JPEG is decoded at full resolution.
+    if (options_.extraction_downscale > 1 &&
+            DecodeScaledJpeg(filepath, options_.extraction_downscale, image))
+    {
+        *downscale = options_.extraction_downscale;
+        return true;
+    }
+    *downscale = 1;
+    *image = FloatImage(filepath);
+    return image->Width() > 0;
+}
+
+bool HandEyeFeatureFrontEnd::ExtractFeaturesFromImage(const int image_index,
+        const FloatImage& float_image, const int downscale)
+{
+    Image& image = GetImage(image_index);
+    // The descriptor extractors are not thread safe, so every call creates
+    // its own.
+    std::unique_ptr<DescriptorExtractor> descriptor_extractor =
+        CreateDescriptorExtractor(options_.descriptor_type,
+                                  options_.feature_density);
+    if (!descriptor_extractor->Initialize())
+    {
+        return false;
+    }
+    image.features.keypoints.clear();
+    image.features.descriptors.clear();
+    if (!descriptor_extractor->DetectAndExtractDescriptors(
+                float_image, &image.features.keypoints,
+                &image.features.descriptors))
+    {
+        return false;
+    }
+    ScaleKeypointsToFullResolution(downscale, &image.features.keypoints);
+    LOG_IF(WARNING, image.has_cache_key && feature_cache_ != nullptr &&
+           !feature_cache_->Store(image.cache_key, image.features))
+            << "Could not cache the features of " << image.filepath;
+    if (image.has_cache_key && options_.memory_cache != nullptr)
+    {
+        options_.memory_cache->StoreFeatures(image.cache_key, image.features);
+    }
+    // The caches keep the unmasked features, the mask may change.
+    ApplyStaticFeatureMask(image_index);
+    return true;
+}
+
+void HandEyeFeatureFrontEnd::ApplyStaticFeatureMask(const int image_index)
+{
+    if (static_feature_mask_ == nullptr)
+    {
+        return;
+    }
+    KeypointsAndDescriptors& features = GetImage(image_index).features;
+    std::vector<char> masked(features.keypoints.size());
+    for (int i = 0; i < features.keypoints.size(); i++)
+    {
+        masked[i] = static_feature_mask_->IsMasked(features.keypoints[i].x(),
+                    features.keypoints[i].y());
+    }
+    RemoveFeatures(masked, &features);
+}
+
+void HandEyeFeatureFrontEnd::SuppressStaticFeatures()
+{
+    std::vector<const KeypointsAndDescriptors*> features;
+    for (const Image& image : images_)
+    {
+        features.emplace_back(&image.features);
+    }
+    const std::vector<std::vector<char> > is_static =
+        FindStaticFeatures(options_.static_feature_options, features);
+    int num_static_features = 0;
+    for (int i = 0; i < images_.size(); i++)
+    {
+        num_static_features +=
+            std::count(is_static[i].begin(), is_static[i].end(), true);
+        RemoveFeatures(is_static[i], &images_[i].features);
+    }
+    LOG(INFO) << "Removed " << num_static_features
+              << " static features from " << images_.size() << " images.";
+}
+
+void HandEyeFeatureFrontEnd::ReleaseFeatures(const int image_index)
+{
+    KeypointsAndDescriptors& features = GetImage(image_index).features;
+    std::vector<Keypoint>().swap(features.keypoints);
+    std::vector<Eigen::VectorXf>().swap(features.descriptors);
+}
+
+void HandEyeFeatureFrontEnd::RemoveImagesBefore(const int image_index)
+{
+    while (!images_.empty() && first_image_index_ < image_index)
+    {
+        images_.pop_front();
+        first_image_index_++;
+    }
+}
+
+bool HandEyeFeatureFrontEnd::MatchImagePair(const int image_index1,
+        const int image_index2,
+        ImagePairMatch* match)
+{
+    const Image& image1 = GetImage(image_index1);
+    const Image& image2 = GetImage(image_index2);
+
+    Eigen::Matrix3d fundamental_matrix;
+    const bool guided = options_.guided_matching &&
+                        PredictFundamentalMatrix(image_index1, image_index2,
+                                                 &fundamental_matrix);
+    std::vector<IndexedFeatureMatch> putative_matches;
+    GuidedMatchFeatures(options_.matching_options, image1.features,
+                        image2.features, guided ? &fundamental_matrix : nullptr,
+                        &putative_matches);
+    if (putative_matches.size() < options_.min_num_inlier_matches)
+    {
+        return false;
+    }
+
+    match->image1 = image1.features.image_name;
+    match->image2 = image2.features.image_name;
+    match->correspondences.clear();
+
+    Pose relative_pose;
+    if (options_.verify_with_rotation_prior && IsCalibrated(image1.intrinsics) &&
+            IsCalibrated(image2.intrinsics) &&
+            PredictRelativePose(image_index1, image_index2, &relative_pose))
+    {
+        std::vector<FeatureCorrespondence> correspondences;
+        correspondences.reserve(putative_matches.size());
+        for (const IndexedFeatureMatch& putative_match : putative_matches)
+        {
+            const Keypoint& keypoint1 =
+                image1.features.keypoints[putative_match.feature1_ind];
+            const Keypoint& keypoint2 =
+                image2.features.keypoints[putative_match.feature2_ind];
+            correspondences.emplace_back(
+                Feature(keypoint1.x(), keypoint1.y()),
+                Feature(keypoint2.x(), keypoint2.y()));
+        }
+        RotationPriorVerificationOptions verification_options =
+            options_.rotation_prior_verification_options;
+        verification_options.min_num_inlier_matches = options_.min_num_inlier_matches;
+        return VerifyMatchesWithRotationPrior(
+                   verification_options, image1.intrinsics, image2.intrinsics,
+                   correspondences, relative_pose.Rotation(),
+                   &match->correspondences, &match->twoview_info);
+    }
+
+    TwoViewMatchGeometricVerification geometric_verification(
+        options_.geometric_verification_options, image1.intrinsics,
+        image2.intrinsics, image1.features, image2.features, putative_matches);
+    if (!geometric_verification.VerifyMatches(&match->correspondences,
+            &match->twoview_info))
+    {
+        return false;
+    }
+    return match->twoview_info.num_verified_matches >=
+           options_.min_num_inlier_matches;
+}
+
+bool HandEyeFeatureFrontEnd::PredictRelativePose(
+    const int image_index1, const int image_index2, Pose* relative_pose) const
+{
+    if (!has_handeye_)
+    {
+        return false;
+    }
+    // camera pose = hand pose*X^-1, so a point in camera 1 maps to camera 2
+    // by x2 = R*x1+t with (R,t) = camera2^-1*camera1.
+    const Pose eyehand = handeye_.Inverse();
+    *relative_pose = (GetImage(image_index2).handpose*eyehand).Inverse()*
+                     (GetImage(image_index1).handpose*eyehand);
+    return true;
+}
+
+bool HandEyeFeatureFrontEnd::PredictFundamentalMatrix(
+    const int image_index1, const int image_index2,
+    Eigen::Matrix3d* fundamental_matrix) const
+{
+    const Image& image1 = GetImage(image_index1);
+    const Image& image2 = GetImage(image_index2);
+    Pose relative_pose;
+    if (!IsCalibrated(image1.intrinsics) || !IsCalibrated(image2.intrinsics) ||
+            !PredictRelativePose(image_index1, image_index2, &relative_pose))
+    {
+        return false;
+    }
+
+    // E = [t]x*R
+    const Eigen::Matrix3d essential_matrix =
+        CrossProductMatrix(relative_pose.Translation())*relative_pose.Rotation();
+    *fundamental_matrix =
+        CalibrationMatrix(image2.intrinsics).inverse().transpose()*
+        essential_matrix*CalibrationMatrix(image1.intrinsics).inverse();
+    return true;
+}
@@ -0,0 +1,218 @@
+#ifndef HANDEYE_FEATURE_FRONTEND_H
+#define HANDEYE_FEATURE_FRONTEND_H
+
+#include <Eigen/Core>
+#include <glog/logging.h>
+#include <theia/theia.h>
+#include <deque>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "feature_cache.h"
+#include "guided_feature_matcher.h"
+#include "image_buffer.h"
+#include "rotation_prior_verification.h"
+#include "static_feature_suppression.h"
+#include "type.h"
+
+using namespace theia;
+
+struct HandEyeFeatureFrontEndOptions
+{
+    // Threads that extract features and match pairs; one more thread decodes
+    // the images.
+    int num_threads = 1;
+    // Bound on the images that are decoded but not yet extracted.
+    int max_num_decoded_images = 8;
+    DescriptorExtractorType descriptor_type = DescriptorExtractorType::SIFT;
+    FeatureDensity feature_density = FeatureDensity::NORMAL;
+    // Decode JPEG images at 1/extraction_downscale (1, 2, 4 or 8) of their
+    // resolution for extraction. Keypoints are mapped back to full resolution,
+    // so the intrinsics stay those of the full resolution images.
+    int extraction_downscale = 1;
+    // Keypoints and descriptors are reused from and saved to this directory
+    // if it is not empty, see FeatureCache.
+    std::string feature_cache_directory;
+    // Features and verified matches are reused from and kept in this cache
+    // if it is not null, see FeatureMemoryCache. Not owned.
+    FeatureMemoryCache* memory_cache = nullptr;
+
+    // Drop features that persist at the same pixels across the images, e.g.
+    // on the gripper or on lens dirt. This waits for the features of all
+    // images before any pair is matched.
+    bool suppress_static_features = false;
+    StaticFeatureSuppressionOptions static_feature_options;
+    // Drop features where this image is zero, if not empty.
+    std::string static_feature_mask_filepath;
+
+    GuidedFeatureMatcherOptions matching_options;
+    // Search candidates only along the epipolar line predicted from the hand
+    // poses and the hand-eye prior. Pairs without a prior or without known
+    // intrinsics are matched by brute force.
+    bool guided_matching = false;
+
+    TwoViewMatchGeometricVerification::Options geometric_verification_options;
+    int min_num_inlier_matches = 30;
+
+    // Verify calibrated pairs with a hand-eye prior by estimating only the
+    // translation direction under the relative rotation predicted from the
+    // hand poses, instead of the 5-point essential matrix and two-view bundle
+    // adjustment on all matches. Other pairs use
+    // geometric_verification_options.
+    bool verify_with_rotation_prior = false;
+    RotationPriorVerificationOptions rotation_prior_verification_options;
+};
+
+// Feature extraction, matching and geometric verification that, unlike
+// theia's FeatureExtractorAndMatcher, knows the hand pose of every image. Its
+// output is the same as a matches file: ImagePairMatch for every verified
+// pair, named by image filename, to be added with
+// ReconstructionBuilder::AddTwoViewMatch. Features are kept in memory and
+// optionally cached on disk across runs, or with their matches in memory
+// across calibrations.
+class HandEyeFeatureFrontEnd
+{
+public:
+    explicit HandEyeFeatureFrontEnd(const HandEyeFeatureFrontEndOptions& options);
+
+    // Returns the index of the image.
+    int AddImage(const std::string& image_filepath,
+                 const CameraIntrinsicsPrior& intrinsics,
+                 const Pose& handpose);
+    // Adds an image decoded in memory, whose pixels must stay valid until its
+    // features are extracted. It is never cached.
+    int AddImage(const std::string& image_name, const ImageBuffer& buffer,
+                 const CameraIntrinsicsPrior& intrinsics,
+                 const Pose& handpose);
+    // Prior hand-eye transformation X, i.e. camera pose = hand pose*X^-1.
+    void SetHandEye(const Pose& handeye);
+    // Pairs of image indices to match, all pairs if never called. An empty
+    // list matches no pair.
+    void SetImagePairsToMatch(const std::vector<std::pair<int, int> >& image_pairs);
+
+    // Decoding, extraction and matching run as a pipeline: an image pair is
+    // matched as soon as both of its images have features, and the features
+    // of an image are freed once all of its pairs are matched. Returns false,
+    // with the reason in ErrorMessage, if the static feature mask could not be
+    // read, or an image can not be decoded or its features extracted.
+    bool ExtractAndMatchFeatures(std::vector<ImagePairMatch>* matches);
+    const std::string& ErrorMessage() const
+    {
+        return error_message_;
+    }
+
+    // The stages of ExtractAndMatchFeatures for a single image or pair.
+    bool ExtractFeatures(const int image_index);
+    bool MatchImagePair(const int image_index1, const int image_index2,
+                        ImagePairMatch* match);
+    // Removes the static features from all images, which must have features.
+    void SuppressStaticFeatures();
+    // Frees the features of an image that will not be matched anymore.
+    void ReleaseFeatures(const int image_index);
+    // Forgets the images before image_index, which will neither be matched
+    // nor extracted anymore, so that a stream of images takes bounded memory.
+    // Image indices are not reused.
+    void RemoveImagesBefore(const int image_index);
+
+    // Predicts (R,t) with x2 = R*x1+t in camera coordinates from the hand
+    // poses and the hand-eye prior. Returns false if there is no prior.
+    bool PredictRelativePose(const int image_index1, const int image_index2,
+                             Pose* relative_pose) const;
+    // Predicts F with x2'*F*x1 = 0 from the hand poses, the hand-eye prior and
+    // the calibration. Returns false if any of them is unknown.
+    bool PredictFundamentalMatrix(const int image_index1, const int image_index2,
+                                  Eigen::Matrix3d* fundamental_matrix) const;
+
+    // Includes the removed images.
+    int NumImages() const
+    {
+        return first_image_index_ + images_.size();
+    }
+    const std::string& ImageName(const int image_index) const
+    {
+        return GetImage(image_index).features.image_name;
+    }
+
+private:
+    struct Image
+    {
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+        std::string filepath;
+        // Decoded instead of the file if it has pixels.
+        ImageBuffer buffer;
+        CameraIntrinsicsPrior intrinsics;
+        Pose handpose;
+        KeypointsAndDescriptors features;
+        bool has_cache_key = false;
+        uint64_t cache_key;
+    };
+    // State shared by the stages of ExtractAndMatchFeatures.
+    struct Pipeline;
+
+    Image& GetImage(const int image_index)
+    {
+        DCHECK_GE(image_index, first_image_index_) << "The image was removed.";
+        return images_[image_index - first_image_index_];
+    }
+    const Image& GetImage(const int image_index) const
+    {
+        DCHECK_GE(image_index, first_image_index_) << "The image was removed.";
+        return images_[image_index - first_image_index_];
+    }
+
+    // Identifies the extractor settings in the feature cache keys.
+    std::string ExtractorSettings() const;
+    bool LoadCachedFeatures(const int image_index);
+    bool DecodeImage(const int image_index, FloatImage* image,
+                     int* downscale) const;
+    bool ExtractFeaturesFromImage(const int image_index,
+                                  const FloatImage& image,
+                                  const int downscale);
+    void ApplyStaticFeatureMask(const int image_index);
+
+    // The key of the matches of an image, which also depend on its hand pose,
+    // its intrinsics and the matching and verification settings.
+    uint64_t MatchCacheKey(const int image_index) const;
+    // Whether matching and verification use the hand-eye prior.
+    bool UsesHandEyePrior() const;
+    // Identifies the matching and verification settings in the match cache
+    // keys. The prior X itself is left out, see MatchImagePairTask.
+    std::string MatchSettings() const;
+
+    // Pipeline stages.
+    void DecodeImages(Pipeline* pipeline);
+    void ExtractAndMatchTask(Pipeline* pipeline);
+    // Must be called with the pipeline mutex held.
+    void SetImageReady(const int image_index, Pipeline* pipeline);
+    // Counts a matched pair of the image and frees its features after the
+    // last one. Must be called with the pipeline mutex held.
+    void ReleaseFeaturesIfMatched(const int image_index, Pipeline* pipeline);
+    // Stops all stages. Must be called with the pipeline mutex held.
+    void Fail(const std::string& message, Pipeline* pipeline);
+    void MatchImagePairTask(const int pair_index);
+
+    const HandEyeFeatureFrontEndOptions options_;
+    std::unique_ptr<FeatureCache> feature_cache_;
+    std::unique_ptr<StaticFeatureMask> static_feature_mask_;
+    // Set if static_feature_mask_filepath could not be read.
+    std::string static_feature_mask_error_;
+    // The images from first_image_index_ on, see RemoveImagesBefore.
+    std::deque<Image, Eigen::aligned_allocator<Image> > images_;
+    int first_image_index_;
+    bool has_handeye_;
+    Pose handeye_;
+    std::vector<std::pair<int, int> > image_pairs_;
+    // SetImagePairsToMatch was called, or all pairs were listed.
+    bool has_image_pairs_;
+    std::string match_settings_;
+    // Of the first failure of ExtractAndMatchFeatures.
+    std::string error_message_;
+
+    // Per-pair results of the threaded matching.
+    std::vector<ImagePairMatch> pair_matches_;
+    std::vector<char> pair_verified_;
+};
+
+#endif // HANDEYE_FEATURE_FRONTEND_H
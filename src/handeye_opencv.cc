@@ -0,0 +1,213 @@
+#include "handeye_opencv.h"
+
+#include <glog/logging.h>
+#include <Eigen/Core>
+#include <opencv2/opencv.hpp>
+#include <opencv2/calib3d.hpp>
+#include <opencv2/core/eigen.hpp>
+#include <algorithm>
+#include <cmath>
+
+// reference : https://answers.opencv.org/question/215449/wrong-result-in-calibratehandeye-function-answered/
+
+std::vector<Eigen::Vector3d> ChessboardPoints(const ChessboardOptions& options)
+{
+    std::vector<Eigen::Vector3d> points;
+    for (int i = 0; i < options.num_corners_y; ++i)
+    {
+        for (int j = 0; j < options.num_corners_x; ++j)
+        {
+            points.emplace_back(j*options.square_size, i*options.square_size, 0.0);
+        }
+    }
+    return points;
+}
+
+bool DetectChessboard(const ChessboardOptions& options,
+                      const std::string& image_filepath,
+                      std::vector<Feature>* corners)
+{
+    const cv::Mat image = cv::imread(image_filepath, cv::IMREAD_GRAYSCALE);
+    if (image.empty())
+    {
+        LOG(WARNING) << "Could not read " << image_filepath;
+        return false;
+    }
+
+    // Detection is the expensive part, so it runs on a downscaled copy.
+    const double scale = std::max(
+        1.0, static_cast<double>(std::max(image.cols, image.rows))/
+        options.max_detection_image_size);
+    cv::Mat detection_image = image;
+    if (scale > 1.0)
+    {
+        cv::resize(image, detection_image,
+                   cv::Size(std::round(image.cols/scale), std::round(image.rows/scale)),
+                   0, 0, cv::INTER_AREA);
+    }
+    const cv::Size pattern_size(options.num_corners_x, options.num_corners_y);
+    std::vector<cv::Point2f> detected_corners;
+    if (!cv::findChessboardCorners(detection_image, pattern_size, detected_corners,
+                                   cv::CALIB_CB_ADAPTIVE_THRESH |
+                                   cv::CALIB_CB_NORMALIZE_IMAGE |
+                                   cv::CALIB_CB_FAST_CHECK))
+    {
+        return false;
+    }
+
+    // Back to full resolution, pixel centers map as (x+0.5)*scale-0.5, and
+    // refine there. The window covers the uncertainty of the downscaled
+    // corners.
+    const double scale_x = static_cast<double>(image.cols)/detection_image.cols;
+    const double scale_y = static_cast<double>(image.rows)/detection_image.rows;
+    for (cv::Point2f& corner : detected_corners)
+    {
+        corner.x = (corner.x + 0.5)*scale_x - 0.5;
+        corner.y = (corner.y + 0.5)*scale_y - 0.5;
+    }
+    const int half_window = std::max(5, static_cast<int>(std::ceil(2.0*scale)));
+    cv::cornerSubPix(image, detected_corners, cv::Size(half_window, half_window),
+                     cv::Size(-1, -1),
+                     cv::TermCriteria(cv::TermCriteria::EPS + cv::TermCriteria::COUNT,
+                                      30, 0.01));
+
+    corners->clear();
+    for (const cv::Point2f& corner : detected_corners)
+    {
+        corners->emplace_back(corner.x, corner.y);
+    }
+    return true;
+}
+
+bool EstimateChessboardPose(const ChessboardOptions& options,
+                            const std::vector<Feature>& corners,
+                            const CameraIntrinsicsPrior& intrinsics,
+                            Pose* target_to_camera)
+{
+    CHECK(intrinsics.focal_length.is_set && intrinsics.principal_point.is_set)
+            << "The chessboard pose needs calibrated intrinsics.";
+    const double focal_length = intrinsics.focal_length.value[0];
+    const double aspect_ratio =
+        intrinsics.aspect_ratio.is_set ? intrinsics.aspect_ratio.value[0] : 1.0;
+    const double skew = intrinsics.skew.is_set ? intrinsics.skew.value[0] : 0.0;
+    const cv::Mat camera_matrix = (cv::Mat_<double>(3, 3) <<
+                                   focal_length, skew, intrinsics.principal_point.value[0],
+                                   0.0, focal_length*aspect_ratio, intrinsics.principal_point.value[1],
+                                   0.0, 0.0, 1.0);
+    // theia's two parameter radial distortion is OpenCV's k1, k2.
+    double k1 = 0.0, k2 = 0.0;
+    if (intrinsics.radial_distortion.is_set)
+    {
+        k1 = intrinsics.radial_distortion.value[0];
+        k2 = intrinsics.radial_distortion.value[1];
+    }
+    const cv::Mat distortion = (cv::Mat_<double>(4, 1) << k1, k2, 0.0, 0.0);
+
+    std::vector<cv::Point3d> object_points;
+    for (const Eigen::Vector3d& point : ChessboardPoints(options))
+    {
+        object_points.emplace_back(point.x(), point.y(), point.z());
+    }
+    std::vector<cv::Point2d> image_points;
+    for (const Feature& corner : corners)
+    {
+        image_points.emplace_back(corner.x(), corner.y());
+    }
+    cv::Mat rvec, tvec;
+    if (!cv::solvePnP(object_points, image_points, camera_matrix, distortion,
+                      rvec, tvec, false, cv::SOLVEPNP_ITERATIVE))
+    {
+        return false;
+    }
+    cv::Mat rotation_cv;
+    cv::Rodrigues(rvec, rotation_cv);
+    Eigen::Matrix3d rotation;
+    Eigen::Vector3d translation;
+    cv::cv2eigen(rotation_cv, rotation);
+    cv::cv2eigen(tvec, translation);
+    *target_to_camera = Pose(rotation, translation);
+    return true;
+}
+
+ChessboardViews DetectChessboards(
+    const ChessboardOptions& options,
+    const std::vector<std::string>& image_files,
+    const std::vector<CameraIntrinsicsPrior>& intrinsics)
+{
+    CHECK_EQ(image_files.size(), intrinsics.size());
+    ChessboardViews views(image_files.size());
+    {
+        ThreadPool pool(options.num_threads);
+        for (int i = 0; i < image_files.size(); i++)
+        {
+            pool.Add([&options, &image_files, &intrinsics, &views, i]()
+            {
+                ChessboardView& view = views[i];
+                view.found =
+                    DetectChessboard(options, image_files[i], &view.corners) &&
+                    EstimateChessboardPose(options, view.corners, intrinsics[i],
+                                           &view.target_to_camera);
+            });
+        }
+        pool.WaitForTasksToFinish();
+    }
+
+    int num_found = 0;
+    for (int i = 0; i < views.size(); i++)
+    {
+        VLOG(1) << image_files[i] << ": chessboard "
+                << (views[i].found ? "found" : "not found");
+        num_found += views[i].found;
+    }
+    LOG(INFO) << "Found the chessboard in " << num_found << " of "
+              << views.size() << " images.";
+    return views;
+}
+
+bool CalibrateHandEyeOpenCV(const ChessboardViews& views,
+                            const Poses& image_handposes,
+                            Pose* handeye)
+{
+    CHECK_EQ(views.size(), image_handposes.size());
+    std::vector<cv::Mat> R_gripper2base, t_gripper2base;
+    std::vector<cv::Mat> R_target2cam, t_target2cam;
+    for (int i = 0; i < views.size(); i++)
+    {
+        if (!views[i].found)
+        {
+            continue;
+        }
+        // cv::Mat copies share their data, so every pose gets its own Mats.
+        cv::Mat hand_rotation, hand_translation;
+        cv::eigen2cv(Eigen::Matrix3d(image_handposes[i].Rotation()), hand_rotation);
+        cv::eigen2cv(Eigen::Vector3d(image_handposes[i].Translation()),
+                     hand_translation);
+        R_gripper2base.push_back(hand_rotation);
+        t_gripper2base.push_back(hand_translation);
+        cv::Mat target_rotation, target_translation;
+        cv::eigen2cv(Eigen::Matrix3d(views[i].target_to_camera.Rotation()),
+                     target_rotation);
+        cv::eigen2cv(Eigen::Vector3d(views[i].target_to_camera.Translation()),
+                     target_translation);
+        R_target2cam.push_back(target_rotation);
+        t_target2cam.push_back(target_translation);
+    }
+    if (R_gripper2base.size() < 3)
+    {
+        LOG(WARNING) << "Hand-eye calibration needs the chessboard in at least "
+                     "3 images.";
+        return false;
+    }
+
+    cv::Mat R_cam2gripper, t_cam2gripper;
+    cv::calibrateHandEye(R_gripper2base, t_gripper2base, R_target2cam,
+                         t_target2cam, R_cam2gripper, t_cam2gripper,
+                         cv::CALIB_HAND_EYE_TSAI);
+    Eigen::Matrix3d rotation;
+    Eigen::Vector3d translation;
+    cv::cv2eigen(R_cam2gripper, rotation);
+    cv::cv2eigen(t_cam2gripper, translation);
+    // X maps the hand frame to the camera frame.
+    *handeye = Pose(rotation, translation).Inverse();
+    return true;
+}
@@ -0,0 +1,69 @@
+#ifndef HANDEYE_OPENCV_H
+#define HANDEYE_OPENCV_H
+
+#include <Eigen/Core>
+#include <Eigen/StdVector>
+#include <theia/theia.h>
+#include <string>
+#include <vector>
+
+#include "type.h"
+
+using namespace theia;
+
+// Target-based hand-eye calibration with a chessboard and OpenCV, as a
+// baseline for the SfM pipeline.
+
+struct ChessboardOptions
+{
+    // Number of inner corners along a row and a column.
+    int num_corners_x = 8;
+    int num_corners_y = 6;
+    // Side length of a square, in the unit of the hand poses.
+    double square_size = 0.028;
+    // Corners are detected on a copy of the image whose longer side has at most
+    // this many pixels and then refined at full resolution.
+    int max_detection_image_size = 1024;
+    int num_threads = 1;
+};
+
+struct ChessboardView
+{
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+    bool found = false;
+    // Full resolution pixels, in the order of ChessboardPoints.
+    std::vector<Feature> corners;
+    // x_camera = R*x_target+t
+    Pose target_to_camera;
+};
+typedef std::vector<ChessboardView, Eigen::aligned_allocator<ChessboardView> >
+ChessboardViews;
+
+// Inner corners in the target frame, row by row on the z = 0 plane.
+std::vector<Eigen::Vector3d> ChessboardPoints(const ChessboardOptions& options);
+
+bool DetectChessboard(const ChessboardOptions& options,
+                      const std::string& image_filepath,
+                      std::vector<Feature>* corners);
+
+// PnP with the calibrated intrinsics, including the radial distortion.
+bool EstimateChessboardPose(const ChessboardOptions& options,
+                            const std::vector<Feature>& corners,
+                            const CameraIntrinsicsPrior& intrinsics,
+                            Pose* target_to_camera);
+
+// Detects the chessboard and estimates its pose in all images in parallel.
+// intrinsics[i] must be calibrated for every image.
+ChessboardViews DetectChessboards(
+    const ChessboardOptions& options,
+    const std::vector<std::string>& image_files,
+    const std::vector<CameraIntrinsicsPrior>& intrinsics);
+
+// cv::calibrateHandEye (Tsai) on the views where the chessboard was found.
+// image_handposes[i] is the hand pose of views[i]. Returns the hand-eye
+// transformation X, i.e. camera pose = hand pose*X^-1.
+bool CalibrateHandEyeOpenCV(const ChessboardViews& views,
+                            const Poses& image_handposes,
+                            Pose* handeye);
+
+#endif // HANDEYE_OPENCV_H
@@ -0,0 +1,195 @@
+#include "handeye_profiler.h"
+#include "calibration_metrics.h"
+
+#include <sys/resource.h>
+#include <time.h>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+namespace
+{
+
+double ProcessCpuTimeInSeconds()
+{
+    timespec time;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &time);
+    return time.tv_sec + 1e-9*time.tv_nsec;
+}
+
+// ru_maxrss is in kilobytes on Linux.
+long PeakRssKb()
+{
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+}  // namespace
+
+HandEyeProfiler::HandEyeProfiler()
+    : start_(std::chrono::steady_clock::now()) {}
+
+void HandEyeProfiler::Record(const std::string& stage,
+                             const StageMeasurement& measurement)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<StageMeasurement>& measurements = measurements_[stage];
+    if (measurements.empty())
+    {
+        stage_names_.emplace_back(stage);
+    }
+    measurements.emplace_back(measurement);
+}
+
+double HandEyeProfiler::TotalWallTimeInSeconds() const
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                         start_).count();
+}
+
+std::string HandEyeProfiler::Report() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::ostringstream report;
+    report << "Hand-eye calibration stage timings:";
+    for (const std::string& stage : stage_names_)
+    {
+        double wall_time = 0.0, cpu_time = 0.0;
+        for (const StageMeasurement& measurement : measurements_.at(stage))
+        {
+            wall_time += measurement.wall_time_seconds;
+            cpu_time += measurement.process_cpu_time_seconds;
+        }
+        report << "\n\t" << stage << ": " << measurements_.at(stage).size()
+               << " calls, wall time = " << wall_time
+               << ", process cpu time = " << cpu_time;
+    }
+    return report.str();
+}
+
+bool HandEyeProfiler::WriteJson(const std::string& filepath) const
+{
+    std::ofstream file(filepath);
+    if (!file.is_open())
+    {
+        return false;
+    }
+    const double total_wall_time = TotalWallTimeInSeconds();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    file << "{\n  \"total_wall_time_seconds\": " << JsonNumber(total_wall_time)
+         << ",\n  \"peak_rss_kb\": " << PeakRssKb()
+         << ",\n  \"stages\": [";
+    for (int s = 0; s < stage_names_.size(); s++)
+    {
+        const std::vector<StageMeasurement>& measurements =
+            measurements_.at(stage_names_[s]);
+        double wall_time = 0.0, cpu_time = 0.0;
+        long peak_rss_kb = 0;
+        for (const StageMeasurement& measurement : measurements)
+        {
+            wall_time += measurement.wall_time_seconds;
+            cpu_time += measurement.process_cpu_time_seconds;
+            peak_rss_kb = std::max(peak_rss_kb, measurement.peak_rss_kb);
+        }
+        file << (s == 0 ? "\n" : ",\n")
+             << "    {\"name\": " << JsonString(stage_names_[s])
+             << ", \"num_calls\": " << measurements.size()
+             << ", \"wall_time_seconds\": " << JsonNumber(wall_time)
+             << ", \"process_cpu_time_seconds\": " << JsonNumber(cpu_time)
+             << ", \"peak_rss_kb\": " << peak_rss_kb
+             << ",\n     \"calls\": [";
+        for (int c = 0; c < measurements.size(); c++)
+        {
+            const StageMeasurement& measurement = measurements[c];
+            file << (c == 0 ? "\n" : ",\n")
+                 << "       {\"iteration\": " << measurement.iteration
+                 << ", \"wall_time_seconds\": "
+                 << JsonNumber(measurement.wall_time_seconds)
+                 << ", \"process_cpu_time_seconds\": "
+                 << JsonNumber(measurement.process_cpu_time_seconds)
+                 << ", \"peak_rss_kb\": " << measurement.peak_rss_kb
+                 << ", \"counters\": {";
+            for (int k = 0; k < measurement.counters.size(); k++)
+            {
+                file << (k == 0 ? "" : ", ")
+                     << JsonString(measurement.counters[k].first) << ": "
+                     << JsonNumber(measurement.counters[k].second);
+            }
+            file << "}}";
+        }
+        file << "]}";
+    }
+    file << "\n  ]\n}\n";
+    return file.good();
+}
+
+ScopedStageTimer::ScopedStageTimer(HandEyeProfiler* profiler,
+                                   const std::string& stage,
+                                   const int iteration)
+    : profiler_(profiler), stage_(stage), span_(stage),
+      wall_start_(std::chrono::steady_clock::now()),
+      cpu_start_(ProcessCpuTimeInSeconds())
+{
+    measurement_.iteration = iteration;
+    if (IsMetricsExportEnabled())
+    {
+        SetMetric("shecar_stage_running" + MetricLabel("stage", stage_), 1.0);
+        PublishMetrics();
+    }
+}
+
+ScopedStageTimer::~ScopedStageTimer()
+{
+    if (IsTracingEnabled())
+    {
+        for (const auto& counter : measurement_.counters)
+        {
+            TraceCounter(stage_ + "/" + counter.first, counter.second);
+        }
+    }
+    if (IsMetricsExportEnabled())
+    {
+        const std::string label = MetricLabel("stage", stage_);
+        SetMetric("shecar_stage_running" + label, 0.0);
+        IncrementMetric("shecar_stage_calls_total" + label);
+        IncrementMetric("shecar_stage_wall_seconds_total" + label,
+                        ElapsedTimeInSeconds());
+        for (const auto& counter : measurement_.counters)
+        {
+            SetMetric("shecar_stage_counter" +
+                      MetricLabel("stage", stage_, "counter", counter.first),
+                      counter.second);
+        }
+        PublishMetrics();
+    }
+    if (profiler_ == nullptr)
+    {
+        return;
+    }
+    measurement_.wall_time_seconds = ElapsedTimeInSeconds();
+    measurement_.process_cpu_time_seconds =
+        ProcessCpuTimeInSeconds() - cpu_start_;
+    measurement_.peak_rss_kb = PeakRssKb();
+    profiler_->Record(stage_, measurement_);
+}
+
+void ScopedStageTimer::SetCounter(const std::string& name, const double value)
+{
+    for (auto& counter : measurement_.counters)
+    {
+        if (counter.first == name)
+        {
+            counter.second = value;
+            return;
+        }
+    }
+    measurement_.counters.emplace_back(name, value);
+}
+
+double ScopedStageTimer::ElapsedTimeInSeconds() const
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                         wall_start_).count();
+}
@@ -0,0 +1,84 @@
+#ifndef HANDEYE_PROFILER_H
+#define HANDEYE_PROFILER_H
+
+#include <chrono>  // NOLINT
+#include <mutex>  // NOLINT
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "trace_recorder.h"
+
+// One call of a pipeline stage. iteration is the retriangulation iteration
+// the call belongs to, -1 outside of the retriangulation loop.
+struct StageMeasurement
+{
+    int iteration = -1;
+    double wall_time_seconds = 0.0;
+    // CPU time of the whole process during the call: of the stage's worker
+    // threads, but also of anything else running concurrently, e.g. another
+    // calibration of the service.
+    double process_cpu_time_seconds = 0.0;
+    // Peak resident set size of the process at the end of the call, which
+    // includes all earlier stages.
+    long peak_rss_kb = 0;
+    // Problem sizes such as the number of residuals, parameters or tracks.
+    std::vector<std::pair<std::string, double> > counters;
+};
+
+// Collects the measurements of the pipeline stages and writes them as a text
+// summary or a JSON report. Thread safe, stages are kept in the order they
+// are first recorded.
+class HandEyeProfiler
+{
+public:
+    HandEyeProfiler();
+
+    void Record(const std::string& stage, const StageMeasurement& measurement);
+
+    // Wall time since construction.
+    double TotalWallTimeInSeconds() const;
+
+    // One line per stage with the number of calls and the total times.
+    std::string Report() const;
+
+    // {"total_wall_time_seconds", "peak_rss_kb", "stages": [{"name",
+    // "num_calls", "wall_time_seconds", "process_cpu_time_seconds",
+    // "peak_rss_kb", "calls": [{"iteration", ..., "counters": {}}]}]}. Times
+    // and counters that are not finite are null.
+    bool WriteJson(const std::string& filepath) const;
+
+private:
+    mutable std::mutex mutex_;
+    std::chrono::steady_clock::time_point start_;
+    std::vector<std::string> stage_names_;
+    std::unordered_map<std::string, std::vector<StageMeasurement> > measurements_;
+};
+
+// Measures the enclosing scope as one call of a stage. Does nothing but
+// keep time if profiler is null, so callers need not check for it. While
+// tracing, the stage is also a span and its counters are trace counters, and
+// while exporting metrics it updates the shecar_stage_* metrics.
+class ScopedStageTimer
+{
+public:
+    ScopedStageTimer(HandEyeProfiler* profiler, const std::string& stage,
+                     const int iteration = -1);
+    ~ScopedStageTimer();
+
+    void SetCounter(const std::string& name, const double value);
+    double ElapsedTimeInSeconds() const;
+
+private:
+    HandEyeProfiler* profiler_;
+    const std::string stage_;
+    ScopedTraceSpan span_;
+    StageMeasurement measurement_;
+    std::chrono::steady_clock::time_point wall_start_;
+    double cpu_start_;
+
+    ScopedStageTimer(const ScopedStageTimer&) = delete;
+    ScopedStageTimer& operator=(const ScopedStageTimer&) = delete;
+};
+
+#endif // HANDEYE_PROFILER_H
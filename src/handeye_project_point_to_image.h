@@ -6,6 +6,10 @@
 #include <ceres/rotation.h>
 #include<theia/theia.h>
 
+#if defined(__AVX2__) || defined(__AVX512F__)
+#include <immintrin.h>
+#endif
+
 using namespace theia;
 // Projects a homogeneous 3D point to an image by assuming a camera model
 // defined by the Camera class. This function is templated so that it can be
@@ -16,8 +20,8 @@ using namespace theia;
 // depth of the point assuming the image plane is at a depth of 1). The depth is
 // useful, for instance, to determine if the point reprojects behind the image.
 //
-// NOTE: The unit test for this method is included in
-// theia/sfm/camera/camera_test.cc
+// NOTE: The unit test for this method and its batched counterpart below is
+// src/test/handeye_project_point_to_image_test.cc
 template <typename T>
 T HandEyeProjectPointToImage(const T* extrinsic_parameters,
                              const T* intrinsic_parameters,
@@ -33,21 +37,17 @@ T HandEyeProjectPointToImage(const T* extrinsic_parameters,
         ConstMap3T(point) -
         point[3] * ConstMap3T(extrinsic_parameters + Camera::POSITION);
 
-    // Rotate the point.
+    // Rotate the point. Camera::ORIENTATION is the world-to-camera rotation,
+    // the same convention ProjectPointToImage and HandEyeReprojectionError use.
     T rotated_point[3];
-    T rotm_para[3];
-    rotm_para[0] = - *(extrinsic_parameters + Camera::ORIENTATION);
-    rotm_para[1] = - *(extrinsic_parameters + Camera::ORIENTATION+1);
-    rotm_para[2] = - *(extrinsic_parameters + Camera::ORIENTATION+2);
-
-    ceres::AngleAxisRotatePoint(/*extrinsic_parameters + Camera::ORIENTATION*/rotm_para,
-            adjusted_point.data(),
-            rotated_point);
+    ceres::AngleAxisRotatePoint(extrinsic_parameters + Camera::ORIENTATION,
+                                adjusted_point.data(),
+                                rotated_point);
 
     // Get normalized pixel projection at image plane depth = 1.
-    const T& depth = adjusted_point(2);
-    const T normalized_pixel[2] = { adjusted_point(0) / depth,
-                                    adjusted_point(1) / depth
+    const T& depth = rotated_point[2];
+    const T normalized_pixel[2] = { rotated_point[0] / depth,
+                                    rotated_point[1] / depth
                                   };
 
     // Apply radial distortion.
@@ -74,4 +74,244 @@ T HandEyeProjectPointToImage(const T* extrinsic_parameters,
     return depth / point[3];
 }
 
+namespace handeye_internal
+{
+
+// Thin wrappers over the arithmetic used by the batched projection kernel, so
+// that the same kernel body can be instantiated for scalars and SIMD lanes.
+// Every pack loads kWidth homogeneous points stored as x,y,z,w and stores
+// kWidth pixels stored as x,y.
+struct ScalarPack
+{
+    typedef double Type;
+    static const int kWidth = 1;
+
+    static Type Set1(const double value) { return value; }
+    static Type Add(const Type a, const Type b) { return a + b; }
+    static Type Sub(const Type a, const Type b) { return a - b; }
+    static Type Mul(const Type a, const Type b) { return a * b; }
+    static Type Div(const Type a, const Type b) { return a / b; }
+
+    static void LoadPoints(const double* points,
+                           Type* x, Type* y, Type* z, Type* w)
+    {
+        *x = points[0];
+        *y = points[1];
+        *z = points[2];
+        *w = points[3];
+    }
+    static void StorePixels(const Type u, const Type v, double* pixels)
+    {
+        pixels[0] = u;
+        pixels[1] = v;
+    }
+    static void Store(const Type a, double* out) { *out = a; }
+};
+
+#if defined(__AVX2__)
+struct Avx2Pack
+{
+    typedef __m256d Type;
+    static const int kWidth = 4;
+
+    static Type Set1(const double value) { return _mm256_set1_pd(value); }
+    static Type Add(const Type a, const Type b) { return _mm256_add_pd(a, b); }
+    static Type Sub(const Type a, const Type b) { return _mm256_sub_pd(a, b); }
+    static Type Mul(const Type a, const Type b) { return _mm256_mul_pd(a, b); }
+    static Type Div(const Type a, const Type b) { return _mm256_div_pd(a, b); }
+
+    // Loads four points and transposes them from xyzw rows to coordinate lanes.
+    static void LoadPoints(const double* points,
+                           Type* x, Type* y, Type* z, Type* w)
+    {
+        const __m256d r0 = _mm256_loadu_pd(points);
+        const __m256d r1 = _mm256_loadu_pd(points + 4);
+        const __m256d r2 = _mm256_loadu_pd(points + 8);
+        const __m256d r3 = _mm256_loadu_pd(points + 12);
+        const __m256d xz01 = _mm256_unpacklo_pd(r0, r1);
+        const __m256d yw01 = _mm256_unpackhi_pd(r0, r1);
+        const __m256d xz23 = _mm256_unpacklo_pd(r2, r3);
+        const __m256d yw23 = _mm256_unpackhi_pd(r2, r3);
+        *x = _mm256_permute2f128_pd(xz01, xz23, 0x20);
+        *z = _mm256_permute2f128_pd(xz01, xz23, 0x31);
+        *y = _mm256_permute2f128_pd(yw01, yw23, 0x20);
+        *w = _mm256_permute2f128_pd(yw01, yw23, 0x31);
+    }
+    // Interleaves four u and v lanes back to u0 v0 u1 v1 u2 v2 u3 v3.
+    static void StorePixels(const Type u, const Type v, double* pixels)
+    {
+        const __m256d uv02 = _mm256_unpacklo_pd(u, v);
+        const __m256d uv13 = _mm256_unpackhi_pd(u, v);
+        _mm256_storeu_pd(pixels, _mm256_permute2f128_pd(uv02, uv13, 0x20));
+        _mm256_storeu_pd(pixels + 4, _mm256_permute2f128_pd(uv02, uv13, 0x31));
+    }
+    static void Store(const Type a, double* out) { _mm256_storeu_pd(out, a); }
+};
+#endif  // __AVX2__
+
+#if defined(__AVX512F__)
+struct Avx512Pack
+{
+    typedef __m512d Type;
+    static const int kWidth = 8;
+
+    static Type Set1(const double value) { return _mm512_set1_pd(value); }
+    static Type Add(const Type a, const Type b) { return _mm512_add_pd(a, b); }
+    static Type Sub(const Type a, const Type b) { return _mm512_sub_pd(a, b); }
+    static Type Mul(const Type a, const Type b) { return _mm512_mul_pd(a, b); }
+    static Type Div(const Type a, const Type b) { return _mm512_div_pd(a, b); }
+
+    static void LoadPoints(const double* points,
+                           Type* x, Type* y, Type* z, Type* w)
+    {
+        const __m512i index = _mm512_set_epi64(28, 24, 20, 16, 12, 8, 4, 0);
+        *x = _mm512_i64gather_pd(index, points, 8);
+        *y = _mm512_i64gather_pd(index, points + 1, 8);
+        *z = _mm512_i64gather_pd(index, points + 2, 8);
+        *w = _mm512_i64gather_pd(index, points + 3, 8);
+    }
+    static void StorePixels(const Type u, const Type v, double* pixels)
+    {
+        const __m512i index = _mm512_set_epi64(14, 12, 10, 8, 6, 4, 2, 0);
+        _mm512_i64scatter_pd(pixels, index, u, 8);
+        _mm512_i64scatter_pd(pixels + 1, index, v, 8);
+    }
+    static void Store(const Type a, double* out) { _mm512_storeu_pd(out, a); }
+};
+#endif  // __AVX512F__
+
+// Projects the points [start, end) with one camera. The rotation is passed as a
+// row-major world-to-camera matrix so it is only built once per batch. The
+// arithmetic follows HandEyeProjectPointToImage term by term.
+template <class Pack>
+int ProjectPointBlock(const double* rotation,
+                      const double* position,
+                      const double* intrinsic_parameters,
+                      const double* points,
+                      const int start,
+                      const int end,
+                      double* pixels,
+                      double* depths)
+{
+    typedef typename Pack::Type T;
+    const T r00 = Pack::Set1(rotation[0]), r01 = Pack::Set1(rotation[1]),
+            r02 = Pack::Set1(rotation[2]), r10 = Pack::Set1(rotation[3]),
+            r11 = Pack::Set1(rotation[4]), r12 = Pack::Set1(rotation[5]),
+            r20 = Pack::Set1(rotation[6]), r21 = Pack::Set1(rotation[7]),
+            r22 = Pack::Set1(rotation[8]);
+    const T cx = Pack::Set1(position[0]);
+    const T cy = Pack::Set1(position[1]);
+    const T cz = Pack::Set1(position[2]);
+    const T one = Pack::Set1(1.0);
+    const T k1 = Pack::Set1(intrinsic_parameters[Camera::RADIAL_DISTORTION_1]);
+    const T k2 = Pack::Set1(intrinsic_parameters[Camera::RADIAL_DISTORTION_2]);
+    const T focal_length =
+        Pack::Set1(intrinsic_parameters[Camera::FOCAL_LENGTH]);
+    const T skew = Pack::Set1(intrinsic_parameters[Camera::SKEW]);
+    const T focal_length_y =
+        Pack::Set1(intrinsic_parameters[Camera::FOCAL_LENGTH] *
+                   intrinsic_parameters[Camera::ASPECT_RATIO]);
+    const T principal_point_x =
+        Pack::Set1(intrinsic_parameters[Camera::PRINCIPAL_POINT_X]);
+    const T principal_point_y =
+        Pack::Set1(intrinsic_parameters[Camera::PRINCIPAL_POINT_Y]);
+
+    int i = start;
+    for (; i + Pack::kWidth <= end; i += Pack::kWidth)
+    {
+        T x, y, z, w;
+        Pack::LoadPoints(points + 4 * i, &x, &y, &z, &w);
+
+        // Remove the translation.
+        const T ax = Pack::Sub(x, Pack::Mul(w, cx));
+        const T ay = Pack::Sub(y, Pack::Mul(w, cy));
+        const T az = Pack::Sub(z, Pack::Mul(w, cz));
+
+        // Rotate the point.
+        const T px = Pack::Add(Pack::Add(Pack::Mul(r00, ax), Pack::Mul(r01, ay)),
+                               Pack::Mul(r02, az));
+        const T py = Pack::Add(Pack::Add(Pack::Mul(r10, ax), Pack::Mul(r11, ay)),
+                               Pack::Mul(r12, az));
+        const T depth =
+            Pack::Add(Pack::Add(Pack::Mul(r20, ax), Pack::Mul(r21, ay)),
+                      Pack::Mul(r22, az));
+
+        // Get normalized pixel projection at image plane depth = 1.
+        const T nx = Pack::Div(px, depth);
+        const T ny = Pack::Div(py, depth);
+
+        // Apply radial distortion.
+        const T r_sq = Pack::Add(Pack::Mul(nx, nx), Pack::Mul(ny, ny));
+        const T d = Pack::Add(one, Pack::Mul(r_sq, Pack::Add(k1, Pack::Mul(k2, r_sq))));
+        const T dx = Pack::Mul(nx, d);
+        const T dy = Pack::Mul(ny, d);
+
+        // Apply calibration parameters to transform normalized units into pixels.
+        const T u = Pack::Add(Pack::Add(Pack::Mul(focal_length, dx),
+                                        Pack::Mul(skew, dy)),
+                              principal_point_x);
+        const T v = Pack::Add(Pack::Mul(focal_length_y, dy), principal_point_y);
+        Pack::StorePixels(u, v, pixels + 2 * i);
+        if (depths != nullptr)
+        {
+            Pack::Store(Pack::Div(depth, w), depths + i);
+        }
+    }
+    return i;
+}
+
+}  // namespace handeye_internal
+
+// Projects num_points homogeneous 3D points through a single camera. This is
+// the batched counterpart of HandEyeProjectPointToImage for the non-autodiff
+// paths: points are stored contiguously as x,y,z,w (the layout of
+// Track::Point()), pixels are written as x,y and depths, if not null, receive
+// the same value HandEyeProjectPointToImage returns for each point.
+//
+// The rotation is converted to a matrix once per batch and the points are then
+// processed in AVX-512 or AVX2 lanes when the compiler targets those
+// instruction sets (see SHECAR_ENABLE_NATIVE_ARCH), with a scalar loop for the
+// remainder and for other targets. Results agree with the scalar template up
+// to floating point rounding of the rotation, which
+// handeye_project_point_to_image_test.cc checks.
+inline void HandEyeProjectPointsToImage(const double* extrinsic_parameters,
+                                        const double* intrinsic_parameters,
+                                        const double* points,
+                                        const int num_points,
+                                        double* pixels,
+                                        double* depths)
+{
+    // Camera::ORIENTATION stores the world-to-camera rotation as angle-axis.
+    Eigen::Matrix<double, 3, 3, Eigen::RowMajor> rotation;
+    ceres::AngleAxisToRotationMatrix(
+        extrinsic_parameters + Camera::ORIENTATION,
+        ceres::RowMajorAdapter3x3(rotation.data()));
+    const double* position = extrinsic_parameters + Camera::POSITION;
+
+    int i = 0;
+#if defined(__AVX512F__)
+    i = handeye_internal::ProjectPointBlock<handeye_internal::Avx512Pack>(
+            rotation.data(), position, intrinsic_parameters, points, i,
+            num_points, pixels, depths);
+#endif
+#if defined(__AVX2__)
+    i = handeye_internal::ProjectPointBlock<handeye_internal::Avx2Pack>(
+            rotation.data(), position, intrinsic_parameters, points, i,
+            num_points, pixels, depths);
+#endif
+    handeye_internal::ProjectPointBlock<handeye_internal::ScalarPack>(
+        rotation.data(), position, intrinsic_parameters, points, i,
+        num_points, pixels, depths);
+}
+
+inline void HandEyeProjectPointsToImage(const Camera& camera,
+                                        const double* points,
+                                        const int num_points,
+                                        double* pixels,
+                                        double* depths)
+{
+    HandEyeProjectPointsToImage(camera.extrinsics(), camera.intrinsics(),
+                                points, num_points, pixels, depths);
+}
+
 #endif // HANDEYE_PROJECT_POINT_TO_IMAGE_H
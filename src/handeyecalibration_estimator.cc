@@ -4,6 +4,8 @@
 #include "hand_eye_bundle_adjustment.h"
 #include "handeyecalibration_utils.h"
 #include "axxb/axxbestimator.h"
+#include "handeye_profiler.h"
+#include "calibration_metrics.h"
 #include <Eigen/Core>
 #include <Eigen/Geometry>
 #include <memory>
@@ -13,18 +15,6 @@
 namespace
 {
 
-// All times are given in seconds.
-struct GlobalReconstructionEstimatorTimings
-{
-    double initial_view_graph_filtering_time = 0.0;
-    double camera_intrinsics_calibration_time = 0.0;
-    double rotation_estimation_time = 0.0;
-    double rotation_filtering_time = 0.0;
-    double relative_translation_optimization_time = 0.0;
-    double relative_translation_filtering_time = 0.0;
-    double position_estimation_time = 0.0;
-};
-
 FilterViewPairsFromRelativeTranslationOptions
 SetRelativeTranslationFilteringOptions(
     const ReconstructionEstimatorOptions& options)
@@ -58,6 +48,19 @@ HandEyeCalibrationEstimator::HandEyeCalibrationEstimator(
 
 }
 
+void HandEyeCalibrationEstimator::SetProfiler(HandEyeProfiler* profiler)
+{
+    profiler_ = profiler;
+}
+
+void HandEyeCalibrationEstimator::SetInitialHandEye(
+    const Pose& handeye, const HandEyeWarmStartOptions& options)
+{
+    has_initial_handeye_ = true;
+    initial_handeye_ = handeye;
+    warm_start_options_ = options;
+}
+
 // The pipeline for estimating camera poses and structure is as follows:
 //   1) Filter potentially bad pairwise geometries by enforcing a loop
 //      constaint on rotations that form a triplet.
@@ -82,69 +85,91 @@ ReconstructionEstimatorSummary HandEyeCalibrationEstimator::Estimate(
     view_graph_ = view_graph;
     orientations_.clear();
     positions_.clear();
+    warm_started_ = false;
 
     ReconstructionEstimatorSummary summary;
-    GlobalReconstructionEstimatorTimings global_estimator_timings;
-    Timer total_timer;
-    Timer timer;
+    // Without a profiler the stages are still measured for summary.message.
+    HandEyeProfiler local_profiler;
+    HandEyeProfiler* profiler =
+        profiler_ != nullptr ? profiler_ : &local_profiler;
+    ScopedStageTimer total_timer(profiler, "reconstruction_estimation");
 
     // Step 1. Filter the initial view graph and remove any bad two view
     // geometries.
     LOG(INFO) << "Filtering the inial view graph.";
-    timer.Reset();
-    if (!FilterTooFewerInlierViewPair())
     {
-        LOG(INFO) << "Insufficient view pairs to perform estimation.";
-        return summary;
+        ScopedStageTimer timer(profiler, "view_graph_filtering");
+        timer.SetCounter("num_view_pairs", view_graph_->NumEdges());
+        if (!FilterTooFewerInlierViewPair())
+        {
+            LOG(INFO) << "Insufficient view pairs to perform estimation.";
+            return summary;
+        }
+        timer.SetCounter("num_remaining_view_pairs", view_graph_->NumEdges());
     }
-    global_estimator_timings.initial_view_graph_filtering_time =
-        timer.ElapsedTimeInSeconds();
 
     // Step 2. Calibrate any uncalibrated cameras.
     LOG(INFO) << "Calibrating any uncalibrated cameras.";
-    timer.Reset();
-    CalibrateCameras();
-    summary.camera_intrinsics_calibration_time = timer.ElapsedTimeInSeconds();
+    {
+        ScopedStageTimer timer(profiler, "camera_intrinsics_calibration");
+        CalibrateCameras();
+        summary.camera_intrinsics_calibration_time = timer.ElapsedTimeInSeconds();
+    }
 
 
     //step 3. solve AX=XB
-    auto edges = view_graph->GetAllEdges();
-    Poses handmotions, cameramotions;
-
-    Eigen::Matrix3d temp;
-    for(auto edge: edges)
     {
-        handmotions.emplace_back( handposes->at(edge.first.first).inverse()*handposes->at(edge.first.second));
-
-        //ceres::AngleAxisToRotationMatrix(edge.second.rotation_2.data(),ceres::ColumnMajorAdapter3x3(temp.data()));
-        Eigen::AngleAxisd angleaxis(edge.second.rotation_2.norm(),edge.second.rotation_2/edge.second.rotation_2.norm());
-        // it is remarkable that theia and visualSFM use the transpose of rotation, i.e.
-        // a point whose coordinate is xw in world frame and xc in camera frame,
-        // we have xc = R(xw-t), hence we need transpose rotation part
-        cameramotions.emplace_back( Rt2hom(angleaxis.toRotationMatrix().transpose(),edge.second.position_2) );
-    }
+        ScopedStageTimer timer(profiler, "axxb_ransac");
+        auto edges = view_graph->GetAllEdges();
+        Poses handmotions, cameramotions;
+
+        for(auto edge: edges)
+        {
+            handmotions.emplace_back( handposes->at(edge.first.first).Inverse()*handposes->at(edge.first.second));
+
+            //ceres::AngleAxisToRotationMatrix(edge.second.rotation_2.data(),ceres::ColumnMajorAdapter3x3(temp.data()));
+            Eigen::AngleAxisd angleaxis(edge.second.rotation_2.norm(),edge.second.rotation_2/edge.second.rotation_2.norm());
+            // it is remarkable that theia and visualSFM use the transpose of rotation, i.e.
+            // a point whose coordinate is xw in world frame and xc in camera frame,
+            // we have xc = R(xw-t), hence we need transpose rotation part
+            cameramotions.emplace_back( angleaxis.toRotationMatrix().transpose(),edge.second.position_2 );
+        }
+
+        std::vector<MotionPair> motionpairs;
+        for(int i=0; i<handmotions.size(); i++)
+            motionpairs.emplace_back(cameramotions[i],handmotions[i]);
 
-    std::vector<MotionPair> motionpairs;
-    for(int i=0; i<handmotions.size(); i++)
-        motionpairs.emplace_back(cameramotions[i],handmotions[i]);
-
-    AXXBEstimator axxb_estimator;
-    RansacParameters params;
-    params.error_thresh = 0.01;
-    params.failure_probability = 0.001;
-    params.max_iterations = 500;
-    //  params.min_inlier_ratio = 0.6;
-    params.min_iterations = 50;
-    params.use_mle = true;
-    Ransac<AXXBEstimator> ransac_estimator(params,axxb_estimator);
-    // Initialize must always be called!
-    ransac_estimator.Initialize();
-    RansacSummary ransacsummary;
-    Pose x;
-    ransac_estimator.Estimate(motionpairs, &x, &ransacsummary);
-
-    handeyetrans->SetHandEyeRotationFromRotationMatrix(x.topLeftCorner(3,3));
-    handeyetrans->SetHandEyeTranslatation(x.topRightCorner(3,1));
+        timer.SetCounter("num_motion_pairs", motionpairs.size());
+        Pose x;
+        if (has_initial_handeye_ && !motionpairs.empty())
+        {
+            const int num_prior_inliers = CountHandEyeInliers(
+                                              motionpairs, initial_handeye_,
+                                              warm_start_options_.max_motion_pair_error);
+            timer.SetCounter("num_prior_inliers", num_prior_inliers);
+            warm_started_ = num_prior_inliers >=
+                            warm_start_options_.min_inlier_ratio*motionpairs.size();
+            LOG(INFO) << num_prior_inliers << " of " << motionpairs.size()
+                      << " motion pairs agree with the initial hand-eye "
+                      "transformation, "
+                      << (warm_started_ ? "skipping" : "running") << " RANSAC.";
+        }
+        if (warm_started_)
+        {
+            x = initial_handeye_;
+        }
+        else
+        {
+            RansacSummary ransacsummary;
+            EstimateHandEyeWithRansac(motionpairs, &x, &ransacsummary);
+            timer.SetCounter("num_inliers", ransacsummary.inliers.size());
+            timer.SetCounter("num_ransac_iterations", ransacsummary.num_iterations);
+        }
+        timer.SetCounter("warm_start", warm_started_);
+        summary.pose_estimation_time = timer.ElapsedTimeInSeconds();
+
+        handeyetrans->SetHandEyePose(x);
+    }
 
     // Set the poses in the reconstruction object.
     SetCameraPosesFromHandPoses(*handposes,handeyetrans, reconstruction_);
@@ -154,36 +179,61 @@ ReconstructionEstimatorSummary HandEyeCalibrationEstimator::Estimate(
     double old_handeyetrans[6];
     std::memcpy(old_handeyetrans,handeyetrans->HandEyeParameter(),6*sizeof(double));
 
+    SetMetric("shecar_retriangulation_iterations_max",
+              options_.num_retriangulation_iterations + 1);
     for (int i = 0; i < options_.num_retriangulation_iterations + 1; i++)
     {
+        SetMetric("shecar_retriangulation_iteration", i);
         // Step 4. Triangulate features.
         LOG(INFO) << "Triangulating all features.";
-        timer.Reset();
-        EstimateStructure(handposes,handeyetrans);
-        summary.triangulation_time += timer.ElapsedTimeInSeconds();
-
-        SetUnderconstrainedAsUnestimated(reconstruction_);
+        {
+            ScopedStageTimer timer(profiler, "triangulation", i);
+            const TrackEstimator::Summary track_summary =
+                EstimateStructure(handposes,handeyetrans);
+            SetUnderconstrainedAsUnestimated(reconstruction_);
+            timer.SetCounter("num_tracks", reconstruction_->NumTracks());
+            timer.SetCounter("num_triangulation_attempts",
+                             track_summary.num_triangulation_attempts);
+            timer.SetCounter("num_estimated_tracks",
+                             track_summary.estimated_tracks.size());
+            summary.triangulation_time += timer.ElapsedTimeInSeconds();
+        }
 
         // Step 5. Bundle Adjustment.
         LOG(INFO) << "Performing bundle adjustment.";
-        timer.Reset();
-
-        if (!HandEyeBundleAdjustment(handposes, handeyetrans))
         {
-            summary.success = false;
-            LOG(WARNING) << "Bundle adjustment failed!";
-            return summary;
+            ScopedStageTimer timer(profiler, "bundle_adjustment", i);
+            ceres::Solver::Summary solver_summary;
+            const bool success =
+                HandEyeBundleAdjustment(handposes, handeyetrans, &solver_summary);
+            timer.SetCounter("num_residuals", solver_summary.num_residuals);
+            timer.SetCounter("num_parameters", solver_summary.num_parameters);
+            timer.SetCounter("num_parameter_blocks",
+                             solver_summary.num_parameter_blocks);
+            timer.SetCounter("num_iterations", solver_summary.iterations.size());
+            timer.SetCounter("initial_cost", solver_summary.initial_cost);
+            timer.SetCounter("final_cost", solver_summary.final_cost);
+            if (!success)
+            {
+                summary.success = false;
+                LOG(WARNING) << "Bundle adjustment failed!";
+                return summary;
+            }
+            summary.bundle_adjustment_time += timer.ElapsedTimeInSeconds();
         }
-        summary.bundle_adjustment_time += timer.ElapsedTimeInSeconds();
 
         // Set the poses in the reconstruction object.
         SetCameraPosesFromHandPoses(*handposes,handeyetrans, reconstruction_);
 
-        int num_points_removed = RemoveOutlierFeatures(
-                                     options_.max_reprojection_error_in_pixels,
-                                     options_.min_triangulation_angle_degrees,
-                                     reconstruction_);
-        LOG(INFO) << num_points_removed << " outlier points were removed.";
+        {
+            ScopedStageTimer timer(profiler, "outlier_removal", i);
+            int num_points_removed = RemoveOutlierFeatures(
+                                         options_.max_reprojection_error_in_pixels,
+                                         options_.min_triangulation_angle_degrees,
+                                         reconstruction_);
+            LOG(INFO) << num_points_removed << " outlier points were removed.";
+            timer.SetCounter("num_points_removed", num_points_removed);
+        }
 
         // if handeyetrans changes less than threshold, break the iteration.
         if( (Eigen::Map<Eigen::Matrix<double,3,1>>(old_handeyetrans+HandEyeTransformation::TRANSLATION)
@@ -200,31 +250,15 @@ ReconstructionEstimatorSummary HandEyeCalibrationEstimator::Estimate(
                                          &summary.estimated_tracks);
     summary.success = true;
     summary.total_time = total_timer.ElapsedTimeInSeconds();
-
-    // Output some timing statistics.
-    std::ostringstream string_stream;
-    string_stream
-            << "Global Reconstruction Estimator timings:"
-            << "\n\tInitial view graph filtering time = "
-            << global_estimator_timings.initial_view_graph_filtering_time
-            << "\n\tCamera intrinsic calibration time = "
-            << summary.camera_intrinsics_calibration_time
-            << "\n\tRotation estimation time = "
-            << global_estimator_timings.rotation_estimation_time
-            << "\n\tRotation filtering time = "
-            << global_estimator_timings.rotation_filtering_time
-            << "\n\tRelative translation optimization time = "
-            << global_estimator_timings.relative_translation_optimization_time
-            << "\n\tRelative translation filtering time = "
-            << global_estimator_timings.relative_translation_filtering_time
-            << "\n\tPosition estimation time = "
-            << global_estimator_timings.position_estimation_time;
-    summary.message = string_stream.str();
+    total_timer.SetCounter("num_estimated_views", summary.estimated_views.size());
+    total_timer.SetCounter("num_estimated_tracks",
+                           summary.estimated_tracks.size());
+    summary.message = profiler->Report();
 
     return summary;
 }
 
-void HandEyeCalibrationEstimator::EstimateStructure(
+TrackEstimator::Summary HandEyeCalibrationEstimator::EstimateStructure(
     Poses* handposes,HandEyeTransformation* handeyetrans)
 {
     // Estimate all tracks.
@@ -239,17 +273,30 @@ void HandEyeCalibrationEstimator::EstimateStructure(
     triangulation_options.ba_options.verbose = false;
     triangulation_options.num_threads = options_.num_threads;
     HandEyeTrackEstimator track_estimator(triangulation_options, reconstruction_,handposes,handeyetrans);
-    const TrackEstimator::Summary summary = track_estimator.HandEyeEstimateAllTracks();
+    return track_estimator.HandEyeEstimateAllTracks();
 }
 
-bool HandEyeCalibrationEstimator::HandEyeBundleAdjustment(Poses* handposes,HandEyeTransformation* handeyetrans)
+bool HandEyeCalibrationEstimator::HandEyeBundleAdjustment(Poses* handposes,HandEyeTransformation* handeyetrans,
+        ceres::Solver::Summary* solver_summary)
 {
     // Bundle adjustment.
     int size = positions_.size();
     bundle_adjustment_options_ =
         SetBundleAdjustmentOptions(options_, positions_.size());
+    const bool use_prior = has_initial_handeye_ &&
+                           warm_start_options_.rotation_sigma_degrees > 0.0 &&
+                           warm_start_options_.translation_sigma > 0.0;
+    HandEyePrior prior;
+    if (use_prior)
+    {
+        prior.handeye = initial_handeye_;
+        prior.rotation_sigma_radians =
+            DegToRad(warm_start_options_.rotation_sigma_degrees);
+        prior.translation_sigma = warm_start_options_.translation_sigma;
+    }
     const auto& bundle_adjustment_summary =
-        BundleAdjusthandEye(bundle_adjustment_options_, reconstruction_,handposes,handeyetrans);
+        BundleAdjusthandEye(bundle_adjustment_options_, reconstruction_,handposes,handeyetrans,
+                            solver_summary, use_prior ? &prior : nullptr);
     return bundle_adjustment_summary.success;
 }
 
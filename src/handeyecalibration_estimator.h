@@ -3,21 +3,61 @@
 
 #include<theia/theia.h>
 #include "handeyetransformation.h"
+#include "handeye_profiler.h"
 
 using namespace theia;
 
+// How a prior X, e.g. of an earlier calibration of the same cell, is used.
+struct HandEyeWarmStartOptions
+{
+    // RANSAC on the motion pairs is skipped, and the prior used as the
+    // initial X, if at least this fraction of the motion pairs agrees with
+    // it. Above 1 RANSAC always runs.
+    double min_inlier_ratio = 0.8;
+    // AXXBEstimator error of an agreeing motion pair, the RANSAC threshold.
+    double max_motion_pair_error = 0.01;
+    // If both are positive, bundle adjustment keeps X close to the prior
+    // with these standard deviations, the translation in the unit of the
+    // hand poses. It is used whether or not RANSAC was skipped.
+    double rotation_sigma_degrees = 0.0;
+    double translation_sigma = 0.0;
+};
+
 class HandEyeCalibrationEstimator:public GlobalReconstructionEstimator
 {
 public:
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
     HandEyeCalibrationEstimator(
         const ReconstructionEstimatorOptions& options);
 
+    // Records the wall and process cpu time and the problem size of every stage, and
+    // of every retriangulation iteration, in profiler. Not owned, may be null.
+    void SetProfiler(HandEyeProfiler* profiler);
+    // Starts from the prior X instead of RANSAC if the motion pairs agree
+    // with it, see HandEyeWarmStartOptions.
+    void SetInitialHandEye(const Pose& handeye,
+                           const HandEyeWarmStartOptions& options);
+    // Whether the last Estimate skipped RANSAC.
+    bool WarmStarted() const
+    {
+        return warm_started_;
+    }
+
     ReconstructionEstimatorSummary Estimate(ViewGraph* view_graph,
                                             Reconstruction* reconstruction,Poses* handposes,HandEyeTransformation* handeyetrans);
-    void EstimateStructure(Poses* handposes,HandEyeTransformation* handeyetrans);
-    bool HandEyeBundleAdjustment(Poses* handposes,HandEyeTransformation* handeyetrans);
+    TrackEstimator::Summary EstimateStructure(Poses* handposes,HandEyeTransformation* handeyetrans);
+    bool HandEyeBundleAdjustment(Poses* handposes,HandEyeTransformation* handeyetrans,
+                                 ceres::Solver::Summary* solver_summary = nullptr);
     bool FilterTooFewerInlierViewPair();
     DISALLOW_COPY_AND_ASSIGN(HandEyeCalibrationEstimator);
+
+private:
+    HandEyeProfiler* profiler_ = nullptr;
+    bool has_initial_handeye_ = false;
+    Pose initial_handeye_;
+    HandEyeWarmStartOptions warm_start_options_;
+    bool warm_started_ = false;
 };
 
 #endif  // HANDEYECALIBRATION_ESTIMATOR_H_
@@ -1,6 +1,8 @@
 #include "handeyecalibration_utils.h"
 #include<ceres/ceres.h>
 #include<Eigen/SVD>
+#include<fstream>
+#include<sstream>
 
 using Eigen::Map;
 
@@ -27,21 +29,11 @@ Eigen::Matrix<T,4,4> Rt2hom(Eigen::Matrix<T, 3, 3> R, Eigen::Matrix<T, 3, 1> t)
     return trans_hom;
 }
 
-Pose Rt2hom(Eigen::Matrix3d R, Eigen::Vector3d t)
-{
-    Pose trans_hom = Pose::Identity(4,4);
-    trans_hom.topLeftCorner(3,3) = R;
-    trans_hom.topRightCorner(3,1) = t;
-
-    return trans_hom;
-}
-
 void SetCameraPosesFromHandPoses(const Poses& handposes,
                                  HandEyeTransformation* handeyetrans, Reconstruction* reconstruction)
 {
-
-    Eigen::Matrix3d handeyerotation = handeyetrans->GetHandEyeRotationAsRotationMatrix();
-    Eigen::Vector3d handeyetranslation = handeyetrans->GetHandEyeTranslation();
+    // camera pose = hand pose*X^-1, X^-1 is shared by all views.
+    const Pose eyehand = handeyetrans->GetHandEyePose().Inverse();
 
     for (int i=0; i<handposes.size(); i++)
     {
@@ -55,19 +47,17 @@ void SetCameraPosesFromHandPoses(const Poses& handposes,
         //    CHECK(!view->IsEstimated()) << "Cannot set the pose of a view that has "
         //                                   "already been estimated. View Id "
         //                                << i;
-        //Pose camerapose = handeyetrans*handposes[i];
+        // it is remarkable that theia uses the transpose of rotation, i.e.
+        // R=Rx*Rh', t = th-Rh*Rx'*tx
+        const Pose camerapose = handposes[i]*eyehand;
 
-        Eigen::Matrix3d handorientation = handposes[i].topLeftCorner(3,3);
-        Eigen::Vector3d handeyeposition = handposes[i].topRightCorner(3,1);
-
-        view->MutableCamera()->SetPosition(handeyeposition-handorientation*handeyerotation.transpose()*handeyetranslation);
-        view->MutableCamera()->SetOrientationFromRotationMatrix(handeyerotation*handorientation.transpose());
-        //    view->MutableCamera()->SetOrientationFromRotationMatrix(handorientation*handeyerotation.transpose());
+        view->MutableCamera()->SetPosition(camerapose.Translation());
+        view->MutableCamera()->SetOrientationFromRotationMatrix(camerapose.Rotation().transpose());
         view->SetEstimated(true);
     }
 }
 
-void SetCameraPoseFromHandPose(View* view, Pose handpose,
+void SetCameraPoseFromHandPose(View* view, const Pose& handpose,
                                HandEyeTransformation* handeyetrans)
 {
 
@@ -79,13 +69,10 @@ void SetCameraPoseFromHandPose(View* view, Pose handpose,
     //    CHECK(!view->IsEstimated()) << "Cannot set the pose of a view that has "
     //                                   "already been estimated.";
 
-    Eigen::Matrix3d handeyerotation = handeyetrans->GetHandEyeRotationAsRotationMatrix();
-    Eigen::Vector3d handeyetranslation = handeyetrans->GetHandEyeTranslation();
-    Eigen::Matrix3d handorientation = handpose.topLeftCorner(3,3);
-    Eigen::Vector3d handeyeposition = handpose.topRightCorner(3,1);
+    const Pose camerapose = handpose*handeyetrans->GetHandEyePose().Inverse();
 
-    view->MutableCamera()->SetPosition(handeyeposition-handorientation*handeyerotation.transpose()*handeyetranslation);
-    view->MutableCamera()->SetOrientationFromRotationMatrix(handeyerotation*handorientation.transpose());
+    view->MutableCamera()->SetPosition(camerapose.Translation());
+    view->MutableCamera()->SetOrientationFromRotationMatrix(camerapose.Rotation().transpose());
     view->SetEstimated(true);
 }
 
@@ -104,6 +91,85 @@ double L2Norm(Eigen::MatrixXd m)
     return (svd.singularValues())(0);
 }
 
+bool ReadHandPoses(const std::string& filename, Poses* handposes)
+{
+    std::ifstream indata(filename);
+    if (!indata.is_open())
+    {
+        LOG(ERROR) << "Could not open hand poses file " << filename;
+        return false;
+    }
+
+//  Pose
+
+//  [r11 r12 r13 tx]
+//  [r21 r22 r23 ty]
+//  [r31 r32 r33 tz]
+//  [0   0   0   1 ]
+
+//  In handposes.txt
+
+//  r11 r21 r31 r12 r22 r32 r13 r23 r33 tx ty tz # for image 1
+//  r11 r21 r31 r12 r22 r32 r13 r23 r33 tx ty tz # for image 2
+//  ...
+//  r11 r21 r31 r12 r22 r32 r13 r23 r33 tx ty tz # for image N
+
+    std::string line;
+    while (std::getline(indata, line))
+    {
+        if (line.empty())
+        {
+            continue;
+        }
+        std::stringstream lineStream(line);
+        std::string cell;
+        Eigen::Matrix3d rotation;
+        Eigen::Vector3d translation;
+        int count = 0;
+        while (std::getline(lineStream, cell, ',') && count < 12)
+        {
+            if (count < 9)
+            {
+                rotation(count%3,count/3) = std::stod(cell);
+            }
+            else
+            {
+                translation(count-9) = std::stod(cell);
+            }
+            count++;
+        }
+        if (count != 12)
+        {
+            LOG(ERROR) << "Invalid hand pose in " << filename << ": " << line;
+            return false;
+        }
+        handposes->emplace_back(rotation, translation);
+    }
+    return true;
+}
+
+bool WriteHandPoses(const std::string& filename, const Poses& handposes)
+{
+    std::ofstream outdata(filename);
+    if (!outdata.is_open())
+    {
+        LOG(ERROR) << "Could not open " << filename;
+        return false;
+    }
+    outdata.precision(17);
+    for (const Pose& handpose : handposes)
+    {
+        const Eigen::Matrix3d rotation = handpose.Rotation();
+        for (int count = 0; count < 9; count++)
+        {
+            outdata << rotation(count%3,count/3) << ",";
+        }
+        outdata << handpose.Translation()(0) << "," << handpose.Translation()(1)
+                << "," << handpose.Translation()(2) << "\n";
+    }
+    return outdata.good();
+}
+
 
 
 
@@ -2,6 +2,7 @@
 #define HANDEYECALIBRATION_UTILS_H
 
 #include<Eigen/Core>
+#include<string>
 #include"type.h"
 #include <theia/theia.h>
 #include "handeyetransformation.h"
@@ -12,12 +13,17 @@ Eigen::Matrix3d skew(Eigen::Vector3d u);
 template<typename T>
 Eigen::Matrix<T,4,4> Rt2hom(Eigen::Matrix<T, 3, 3> R, Eigen::Matrix<T, 3, 1> t);
 
-Pose Rt2hom(Eigen::Matrix3d R, Eigen::Vector3d t);
-
 void SetCameraPosesFromHandPoses(const Poses& handposes,
                                  HandEyeTransformation* handeyetrans, Reconstruction* reconstruction);
 
-void SetCameraPoseFromHandPose(View *view, Pose handpose, HandEyeTransformation* handeyetrans);
+void SetCameraPoseFromHandPose(View *view, const Pose& handpose, HandEyeTransformation* handeyetrans);
+
+// Reads hand poses, one per line, stored as
+// r11,r21,r31,r12,r22,r32,r13,r23,r33,tx,ty,tz
+bool ReadHandPoses(const std::string& filename, Poses* handposes);
+
+// Writes hand poses in the format read by ReadHandPoses.
+bool WriteHandPoses(const std::string& filename, const Poses& handposes);
 
 template<typename T> void pose2array(const Eigen::Matrix<T,4,4> &, T *ar);
 
@@ -9,12 +9,13 @@ HandEyeCalibrationBuilder::HandEyeCalibrationBuilder(const ReconstructionBuilder
 
 void HandEyeCalibrationBuilder::SetHandPoses(Poses* poses)
 {
-    CHECK(reconstruction_->NumViews()==poses->size())
-            <<"numer of views "<<reconstruction_->NumViews()<<" is unequal to that of hand poses";
+    // the views may be a subset of the hand poses, see --num_views_to_select.
+    CHECK(reconstruction_->NumViews()<=poses->size())
+            <<"numer of views "<<reconstruction_->NumViews()<<" is larger than that of hand poses";
 
     // the sort of hand poses is different to that of views
     // so we need to resort hand poses according to name and ID of views
-    hand_poses_.resize(poses->size());
+    hand_poses_.resize(reconstruction_->NumViews());
     for(auto view_id: reconstruction_->ViewIds())
     {
         std::string name = reconstruction_->View(view_id)->Name();
@@ -22,7 +23,40 @@ void HandEyeCalibrationBuilder::SetHandPoses(Poses* poses)
     }
 }
 
-bool HandEyeCalibrationBuilder::BuildHandEyeCalibration(HandEyeTransformation* handeyetrans)
+void HandEyeCalibrationBuilder::SetHandPoses(
+    const std::vector<std::string>& view_names, const Poses& poses)
+{
+    CHECK_EQ(view_names.size(), poses.size());
+    hand_poses_.resize(reconstruction_->NumViews());
+    for (int i = 0; i < view_names.size(); i++)
+    {
+        const ViewId view_id = reconstruction_->ViewIdFromName(view_names[i]);
+        CHECK_NE(view_id, kInvalidViewId) << "No view named " << view_names[i];
+        hand_poses_[view_id] = poses[i];
+    }
+}
+
+void HandEyeCalibrationBuilder::SetImagePairsToMatch(
+    const std::vector<std::pair<std::string, std::string> >& image_pairs)
+{
+    feature_extractor_and_matcher_->SetPairsToMatch(image_pairs);
+}
+
+void HandEyeCalibrationBuilder::SetProfiler(HandEyeProfiler* profiler)
+{
+    profiler_ = profiler;
+}
+
+void HandEyeCalibrationBuilder::SetInitialHandEye(
+    const Pose& handeye, const HandEyeWarmStartOptions& options)
+{
+    has_initial_handeye_ = true;
+    initial_handeye_ = handeye;
+    warm_start_options_ = options;
+}
+
+bool HandEyeCalibrationBuilder::BuildHandEyeCalibration(HandEyeTransformation* handeyetrans,
+        ReconstructionEstimatorSummary* summary_out)
 {
     CHECK_GE(view_graph_->NumViews(), 2) << "At least 2 images must be provided "
                                          "in order to create a "
@@ -31,7 +65,9 @@ bool HandEyeCalibrationBuilder::BuildHandEyeCalibration(HandEyeTransformation* h
     // Build tracks if they were not explicitly specified.
     if (reconstruction_->NumTracks() == 0)
     {
+        ScopedStageTimer timer(profiler_, "track_building");
         track_builder_->BuildTracks(reconstruction_.get());
+        timer.SetCounter("num_tracks", reconstruction_->NumTracks());
     }
 
     // Remove uncalibrated views from the reconstruction and view graph.
@@ -49,9 +85,16 @@ bool HandEyeCalibrationBuilder::BuildHandEyeCalibration(HandEyeTransformation* h
     std::unique_ptr<HandEyeCalibrationEstimator> handeyecalibrationestimator=
         std::unique_ptr<HandEyeCalibrationEstimator>(
             new HandEyeCalibrationEstimator(options_.reconstruction_estimator_options));
+    handeyecalibrationestimator->SetProfiler(profiler_);
+    if (has_initial_handeye_)
+    {
+        handeyecalibrationestimator->SetInitialHandEye(initial_handeye_,
+                warm_start_options_);
+    }
 
     const auto& summary = handeyecalibrationestimator->Estimate(
                               view_graph_.get(), reconstruction_.get(),&hand_poses_,handeyetrans);
+    warm_started_ = handeyecalibrationestimator->WarmStarted();
 
     //  if (!summary.success) {
     //    return false;
@@ -69,5 +112,9 @@ bool HandEyeCalibrationBuilder::BuildHandEyeCalibration(HandEyeTransformation* h
             << "\n\tTotal time = " << summary.total_time
             << "\n\n" << summary.message;
 
+    if (summary_out != nullptr)
+    {
+        *summary_out = summary;
+    }
     return true;
 }
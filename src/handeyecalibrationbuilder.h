@@ -3,24 +3,62 @@
 
 #include<theia/theia.h>
 #include"handeyetransformation.h"
+#include"handeyecalibration_estimator.h"
+#include"handeye_profiler.h"
 #include"type.h"
+#include<string>
+#include<utility>
+#include<vector>
 
 using namespace theia;
 
 class HandEyeCalibrationBuilder:public ReconstructionBuilder
 {
 public:
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
     explicit HandEyeCalibrationBuilder(const ReconstructionBuilderOptions& options);
-    bool BuildHandEyeCalibration(HandEyeTransformation* handeyetrans);
+    // The estimation statistics are returned in summary if it is not null.
+    bool BuildHandEyeCalibration(HandEyeTransformation* handeyetrans,
+                                 ReconstructionEstimatorSummary* summary = nullptr);
     std::unique_ptr<Reconstruction> GetReconstruction()
     {
         return std::move(reconstruction_);
     }
     void SetHandPoses(Poses* poses);
+    // Sets the hand pose of every view by its name, for views that are not
+    // named by the index of their hand pose.
+    void SetHandPoses(const std::vector<std::string>& view_names,
+                      const Poses& poses);
+    // Restricts feature matching to the given pairs of image filenames, all
+    // pairs are matched if this is never called. Must be called after the
+    // images are added and before ExtractAndMatchFeatures.
+    void SetImagePairsToMatch(
+        const std::vector<std::pair<std::string, std::string> >& image_pairs);
+    // Number of verified image pairs added so far.
+    int NumTwoViewMatches() const
+    {
+        return view_graph_->NumEdges();
+    }
+    // Profiles track building and every stage of the estimator. Not owned.
+    void SetProfiler(HandEyeProfiler* profiler);
+    // Prior X of the estimator, see HandEyeWarmStartOptions.
+    void SetInitialHandEye(const Pose& handeye,
+                           const HandEyeWarmStartOptions& options);
+    // Whether the last estimation started from the prior X without RANSAC.
+    bool WarmStarted() const
+    {
+        return warm_started_;
+    }
 
 private:
     // the pose of hand
     Poses hand_poses_;
+    HandEyeProfiler* profiler_ = nullptr;
+    bool has_initial_handeye_ = false;
+    Pose initial_handeye_;
+    HandEyeWarmStartOptions warm_start_options_;
+    bool warm_started_ = false;
 };
 
 #endif // HANDEYECALIBRATIONBUILDER_H
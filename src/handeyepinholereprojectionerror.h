@@ -12,8 +12,9 @@ using namespace theia;
 struct HandEyePinholeReprojectionError
 {
 public:
-    explicit HandEyePinholeReprojectionError(const Feature& feature,const Pose handpose)
-        : feature_(feature),handpose_(handpose) {}
+    explicit HandEyePinholeReprojectionError(const Feature& feature,const Pose& handpose)
+        : feature_(feature),handorientation_(handpose.Rotation()),
+          handposition_(handpose.Translation()) {}
 
     template<typename T> bool operator()(const T* handeyetrans,
                                          const T* camera_intrinsics,
@@ -36,10 +37,13 @@ public:
         // Rx[Rh'(x-th)]+tx = R(x-t)
         // that is R=Rx*Rh', t = th-Rh*Rx'*tx
 
-        // transform type of handpose_ to T.
-        Eigen::Matrix<T, 4, 4> handpose_t;
-        for(int i=0; i<16; i++)
-            handpose_t.data()[i] = (T) handpose_.data()[i];
+        // transform type of hand pose to T.
+        Eigen::Matrix<T, 3, 3> handorientation_t;
+        for(int i=0; i<9; i++)
+            handorientation_t.data()[i] = (T) handorientation_.data()[i];
+        Eigen::Matrix<T, 3, 1> handposition_t;
+        for(int i=0; i<3; i++)
+            handposition_t.data()[i] = (T) handposition_.data()[i];
         // transform hand eye rotation part to rotation matrix format.
         Eigen::Matrix<T, 3, 3> handeyerotation;
         ceres::AngleAxisToRotationMatrix(
@@ -48,9 +52,9 @@ public:
         //
         Eigen::Matrix<T,3,1> handeyetranslation = Eigen::Map<const Eigen::Matrix<T,3,1>>(handeyetrans+HandEyeTransformation::TRANSLATION);
         // solve camera orientation R=Rx*Rh'
-        Eigen::Matrix<T, 3, 3> cameraorientation = handeyerotation*handpose_t.topLeftCorner(3,3).transpose();
+        Eigen::Matrix<T, 3, 3> cameraorientation = handeyerotation*handorientation_t.transpose();
         // solve camera position t = th-Rh*Rx'*tx = th-R'*tx
-        Eigen::Matrix<T,3,1> cameraposition = handpose_t.topRightCorner(3,1) - cameraorientation.transpose()*handeyetranslation;
+        Eigen::Matrix<T,3,1> cameraposition = handposition_t - cameraorientation.transpose()*handeyetranslation;
         // map camera orientation to camera pose parameter
         ceres::RotationMatrixToAngleAxis(
             (const T*)cameraorientation.data(),
@@ -70,7 +74,10 @@ public:
 
 private:
     const Feature feature_;
-    const Pose handpose_;
+    // the hand rotation matrix is expanded once here rather than in every
+    // residual evaluation.
+    const Eigen::Matrix3d handorientation_;
+    const Eigen::Vector3d handposition_;
 };
 
 #endif // HANDEYEPINHOLEREPROJECTIONERROR_H
@@ -0,0 +1,60 @@
+#ifndef HANDEYEPRIORERROR_H
+#define HANDEYEPRIORERROR_H
+#include <ceres/ceres.h>
+#include <ceres/rotation.h>
+#include <theia/theia.h>
+#include "type.h"
+#include "handeyetransformation.h"
+
+using namespace theia;
+
+// Prior residual on the hand-eye parameters, e.g. from an earlier
+// calibration: the angle axis of Rx*Rprior' over rotation_sigma in radians
+// and the translation difference over translation_sigma.
+struct HandEyePriorError
+{
+public:
+    HandEyePriorError(const Pose& prior, const double rotation_sigma,
+                      const double translation_sigma)
+        : prior_rotation_(prior.Rotation()),
+          prior_translation_(prior.Translation()),
+          rotation_sigma_(rotation_sigma),
+          translation_sigma_(translation_sigma) {}
+
+    template<typename T> bool operator()(const T* handeyetrans,
+                                         T* residuals) const
+    {
+        Eigen::Matrix<T, 3, 3> handeyerotation;
+        ceres::AngleAxisToRotationMatrix(
+            handeyetrans+HandEyeTransformation::ROTATION,
+            ceres::ColumnMajorAdapter3x3(handeyerotation.data()));
+        const Eigen::Matrix<T, 3, 3> difference =
+            handeyerotation*prior_rotation_.transpose().cast<T>();
+        ceres::RotationMatrixToAngleAxis(
+            ceres::ColumnMajorAdapter3x3(difference.data()), residuals);
+        for (int i = 0; i < 3; i++)
+        {
+            residuals[i] /= T(rotation_sigma_);
+            residuals[3 + i] =
+                (handeyetrans[HandEyeTransformation::TRANSLATION + i] -
+                 T(prior_translation_[i]))/T(translation_sigma_);
+        }
+        return true;
+    }
+
+    static ceres::CostFunction* Create(const Pose& prior,
+                                       const double rotation_sigma,
+                                       const double translation_sigma)
+    {
+        return new ceres::AutoDiffCostFunction<HandEyePriorError, 6, 6>(
+                   new HandEyePriorError(prior, rotation_sigma, translation_sigma));
+    }
+
+private:
+    const Eigen::Matrix3d prior_rotation_;
+    const Eigen::Vector3d prior_translation_;
+    const double rotation_sigma_;
+    const double translation_sigma_;
+};
+
+#endif // HANDEYEPRIORERROR_H
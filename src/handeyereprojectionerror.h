@@ -8,10 +8,10 @@ using namespace theia;
 struct HandEyeReprojectionError
 {
 public:
-    explicit HandEyeReprojectionError(const Feature& feature, const Pose handpose) :
+    explicit HandEyeReprojectionError(const Feature& feature, const Pose& handpose) :
         feature_(feature),handpose_(handpose) {}
 
-    static ceres::CostFunction* Create(const Feature& feature, const Pose handpose)
+    static ceres::CostFunction* Create(const Feature& feature, const Pose& handpose)
     {
         static const int kPointSize = 4;
         return new ceres::AutoDiffCostFunction<HandEyePinholeReprojectionError,
@@ -1,6 +1,9 @@
 #include "handeyetrackestimator.h"
 #include "hand_eye_bundle_adjustment.h"
 #include "handeye_project_point_to_image.h"
+#include "trace_recorder.h"
+
+#include <map>
 
 namespace
 {
@@ -35,38 +38,71 @@ void GetObservationsFromTrackViews(
     }
 }
 
-// Returns false if the reprojection error of the triangulated point is greater
-// than the max allowable reprojection error (for any observation) and true
-// otherwise.
-bool AcceptableReprojectionError(
+// For each of the triangulated tracks, whether its mean squared reprojection
+// error is below sq_max_reprojection_error_pixels and it is in front of all
+// estimated views. The observations are grouped by view, so every view
+// projects all of its tracks with one call of the batched kernel.
+void AcceptableReprojectionErrors(
     const Reconstruction& reconstruction,
-    const TrackId& track_id,
-    const double sq_max_reprojection_error_pixels)
+    const std::vector<TrackId>& track_ids,
+    const double sq_max_reprojection_error_pixels,
+    std::vector<char>* acceptable)
 {
-    const Track& track = *reconstruction.Track(track_id);
-    int num_projections = 0;
-    double mean_sq_reprojection_error = 0;
-    for (const ViewId view_id : track.ViewIds())
+    // Ordered, so the errors are summed in the same order on every run.
+    std::map<ViewId, std::vector<int> > tracks_of_view;
+    for (int i = 0; i < track_ids.size(); i++)
     {
-        const View* view = reconstruction.View(view_id);
-        if (view == nullptr || !view->IsEstimated())
+        for (const ViewId view_id : reconstruction.Track(track_ids[i])->ViewIds())
         {
-            continue;
+            const View* view = reconstruction.View(view_id);
+            if (view != nullptr && view->IsEstimated())
+            {
+                tracks_of_view[view_id].emplace_back(i);
+            }
         }
-        const Camera& camera = view->Camera();
-        const Feature* feature = view->GetFeature(track_id);
-        Eigen::Vector2d reprojection;
-        if (camera.ProjectPoint(track.Point(), &reprojection) < 0)
+    }
+
+    std::vector<double> sq_reprojection_errors(track_ids.size(), 0.0);
+    std::vector<int> num_projections(track_ids.size(), 0);
+    acceptable->assign(track_ids.size(), true);
+    std::vector<double> points, reprojections, depths;
+    for (const auto& view_tracks : tracks_of_view)
+    {
+        const View* view = reconstruction.View(view_tracks.first);
+        const std::vector<int>& indices = view_tracks.second;
+        const int num_points = indices.size();
+        points.resize(4*num_points);
+        reprojections.resize(2*num_points);
+        depths.resize(num_points);
+        for (int k = 0; k < num_points; k++)
         {
-            return false;
+            Eigen::Map<Eigen::Vector4d>(points.data() + 4*k) =
+                reconstruction.Track(track_ids[indices[k]])->Point();
+        }
+        HandEyeProjectPointsToImage(view->Camera(), points.data(), num_points,
+                                    reprojections.data(), depths.data());
+        for (int k = 0; k < num_points; k++)
+        {
+            const int i = indices[k];
+            if (depths[k] < 0)
+            {
+                (*acceptable)[i] = false;
+                continue;
+            }
+            const Feature* feature = view->GetFeature(track_ids[i]);
+            sq_reprojection_errors[i] +=
+                (*feature - Eigen::Map<const Eigen::Vector2d>(
+                     reprojections.data() + 2*k)).squaredNorm();
+            ++num_projections[i];
         }
-
-        mean_sq_reprojection_error += (*feature - reprojection).squaredNorm();
-        ++num_projections;
     }
 
-    return (mean_sq_reprojection_error / static_cast<double>(num_projections)) <
-           sq_max_reprojection_error_pixels;
+    for (int i = 0; i < track_ids.size(); i++)
+    {
+        (*acceptable)[i] = (*acceptable)[i] &&
+                           sq_reprojection_errors[i]/num_projections[i] <
+                           sq_max_reprojection_error_pixels;
+    }
 }
 
 int NumEstimatedViewsObservingTrack(const Reconstruction& reconstruction,
@@ -142,6 +178,8 @@ TrackEstimator::Summary HandEyeTrackEstimator::HandEyeEstimateTracks(
         std::min(options_.multithreaded_step_size,
                  static_cast<int>(tracks_to_estimate_.size()) / num_threads);
 
+    ScopedTraceSpan span("estimate_tracks");
+    TraceCounter("tracks_to_estimate", tracks_to_estimate_.size());
     ThreadPool pool(num_threads);
     for (int i = 0; i < tracks_to_estimate_.size(); i += interval_step)
     {
@@ -170,13 +208,30 @@ TrackEstimator::Summary HandEyeTrackEstimator::HandEyeEstimateTracks(
 
 void HandEyeTrackEstimator::HandEyeEstimateTrackSet(const int start, const int end)
 {
+    SetTraceThreadName("track estimation");
+    ScopedTraceSpan span("estimate_track_set");
+    std::vector<TrackId> triangulated_tracks;
     for (int i = start; i < end; i++)
     {
-        HandEyeEstimateTrack(tracks_to_estimate_[i]);
+        if (HandEyeTriangulateTrack(tracks_to_estimate_[i]))
+        {
+            triangulated_tracks.emplace_back(tracks_to_estimate_[i]);
+        }
     }
+    SetEstimatedIfAcceptable(triangulated_tracks);
 }
 
 bool HandEyeTrackEstimator::HandEyeEstimateTrack(const TrackId track_id)
+{
+    if (!HandEyeTriangulateTrack(track_id))
+    {
+        return false;
+    }
+    SetEstimatedIfAcceptable(std::vector<TrackId>(1, track_id));
+    return reconstruction_->Track(track_id)->IsEstimated();
+}
+
+bool HandEyeTrackEstimator::HandEyeTriangulateTrack(const TrackId track_id)
 {
     Track* track = reconstruction_->MutableTrack(track_id);
     CHECK(!track->IsEstimated()) << "Track " << track_id
@@ -204,15 +259,6 @@ bool HandEyeTrackEstimator::HandEyeEstimateTrack(const TrackId track_id)
         return false;
     }
 
-    for(auto view_id : view_ids)
-    {
-        Camera a = reconstruction_->View(view_id)->Camera();
-        double pixel[2];
-        ProjectPointToImage(a.extrinsics(),a.intrinsics(),track->Point().data(),pixel);
-        const Feature* feature = CHECK_NOTNULL(reconstruction_->View(view_id)->GetFeature(track_id));
-    }
-
-
     // Bundle adjust the track. The 2-view triangulation method is optimal so we
     // do not need to run BA for that case.
     if (options_.bundle_adjustment)
@@ -227,20 +273,26 @@ bool HandEyeTrackEstimator::HandEyeEstimateTrack(const TrackId track_id)
         }
     }
 
+    return true;
+}
+
+void HandEyeTrackEstimator::SetEstimatedIfAcceptable(
+    const std::vector<TrackId>& track_ids)
+{
     // Ensure the reprojection errors are acceptable.
     const double sq_max_reprojection_error_pixels =
         options_.max_acceptable_reprojection_error_pixels *
         options_.max_acceptable_reprojection_error_pixels;
-
-    if (!AcceptableReprojectionError(*reconstruction_,
-                                     track_id,
-                                     sq_max_reprojection_error_pixels))
+    std::vector<char> acceptable;
+    AcceptableReprojectionErrors(*reconstruction_, track_ids,
+                                 sq_max_reprojection_error_pixels, &acceptable);
+    for (int i = 0; i < track_ids.size(); i++)
     {
-        return false;
+        if (acceptable[i])
+        {
+            reconstruction_->MutableTrack(track_ids[i])->SetEstimated(true);
+        }
     }
-
-    track->SetEstimated(true);
-    return true;
 }
 
 
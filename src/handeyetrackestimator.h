@@ -17,9 +17,17 @@ public:
     TrackEstimator::Summary HandEyeEstimateAllTracks();
     TrackEstimator::Summary HandEyeEstimateTracks(
         const std::unordered_set<TrackId>& track_ids);
+    // Triangulates the tracks [start, end) of tracks_to_estimate_, then checks
+    // the reprojection errors of all of them together.
     void HandEyeEstimateTrackSet(const int start, const int end);
     bool HandEyeEstimateTrack(const TrackId track_id);
 private:
+    // Triangulates and bundle adjusts the track, without setting it
+    // estimated.
+    bool HandEyeTriangulateTrack(const TrackId track_id);
+    // Sets the tracks estimated whose reprojection errors are acceptable.
+    void SetEstimatedIfAcceptable(const std::vector<TrackId>& track_ids);
+
     HandEyeTransformation *handeyetrans_;
     Poses* handpose_;
 };
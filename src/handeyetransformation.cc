@@ -56,3 +56,14 @@ Eigen::Vector3d HandEyeTransformation::GetHandEyeRotationAsAngleAxis() const
     return Eigen::Map<const Eigen::Vector3d>(hand_eye_parameter_);
 }
 
+void HandEyeTransformation::SetHandEyePose(const Pose& pose)
+{
+    SetHandEyeRotationFromRotationMatrix(pose.Rotation());
+    SetHandEyeTranslatation(pose.Translation());
+}
+
+Pose HandEyeTransformation::GetHandEyePose() const
+{
+    return Pose(GetHandEyeRotationAsRotationMatrix(), GetHandEyeTranslation());
+}
+
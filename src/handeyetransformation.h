@@ -20,6 +20,11 @@ public:
     Eigen::Matrix3d GetHandEyeRotationAsRotationMatrix() const;
     Eigen::Vector3d GetHandEyeRotationAsAngleAxis() const;
 
+    // the hand-eye transformation X as a rigid transformation, i.e. the
+    // camera pose is hand pose*X^-1.
+    void SetHandEyePose(const Pose& pose);
+    Pose GetHandEyePose() const;
+
     enum ParametersIndex
     {
         ROTATION = 0,
@@ -0,0 +1,43 @@
+#include "image_buffer.h"
+
+#include <algorithm>
+#include <vector>
+
+bool ImageBufferToFloatImage(const ImageBuffer& buffer, const int downscale,
+                             FloatImage* image)
+{
+    if (buffer.pixels == nullptr || buffer.width < downscale ||
+            buffer.height < downscale || downscale < 1 ||
+            (buffer.channels != 1 && buffer.channels != 3 && buffer.channels != 4))
+    {
+        return false;
+    }
+    const int stride =
+        buffer.stride > 0 ? buffer.stride : buffer.width*buffer.channels;
+    const int width = buffer.width/downscale;
+    const int height = buffer.height/downscale;
+    // Rec. 601 luma, as libjpeg converts color to grayscale.
+    const float normalization = 1.0f/(255.0f*downscale*downscale);
+    std::vector<float> row(width);
+    *image = FloatImage(width, height, 1);
+    for (int y = 0; y < height; y++)
+    {
+        std::fill(row.begin(), row.end(), 0.0f);
+        for (int dy = 0; dy < downscale; dy++)
+        {
+            const unsigned char* pixel =
+                buffer.pixels + static_cast<size_t>(y*downscale + dy)*stride;
+            for (int x = 0; x < width*downscale; x++, pixel += buffer.channels)
+            {
+                row[x/downscale] += buffer.channels == 1 ?
+                                    pixel[0] :
+                                    0.299f*pixel[0] + 0.587f*pixel[1] + 0.114f*pixel[2];
+            }
+        }
+        for (int x = 0; x < width; x++)
+        {
+            image->SetXY(x, y, 0, row[x]*normalization);
+        }
+    }
+    return true;
+}
@@ -0,0 +1,28 @@
+#ifndef IMAGE_BUFFER_H
+#define IMAGE_BUFFER_H
+
+#include <theia/theia.h>
+
+using namespace theia;
+
+// An 8-bit image already decoded in memory, e.g. a camera frame, so that it
+// never goes through a file. Grayscale, or interleaved RGB or RGBA. The
+// pixels are not owned.
+struct ImageBuffer
+{
+    const unsigned char* pixels = nullptr;
+    int width = 0;
+    int height = 0;
+    int channels = 1;
+    // Bytes from one row to the next, width*channels if 0.
+    int stride = 0;
+};
+
+// Converts the buffer to the grayscale image the descriptor extractors take,
+// averaging blocks of downscale x downscale pixels like DecodeScaledJpeg, so
+// that ScaleKeypointsToFullResolution maps the keypoints back. Returns false
+// if the buffer is empty or has an unsupported number of channels.
+bool ImageBufferToFloatImage(const ImageBuffer& buffer, const int downscale,
+                             FloatImage* image);
+
+#endif // IMAGE_BUFFER_H
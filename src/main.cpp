@@ -1,11 +1,3 @@
-#define COMPARE_2_OPENCV
-
-#ifdef COMPARE_2_OPENCV
-#include "opencv2/opencv.hpp"
-#include <opencv2/calib3d.hpp>
-using namespace cv;
-#endif  //  COMPARE_2_OPENCV
-
 #include <glog/logging.h>
 #include <gflags/gflags.h>
 #include <time.h>
@@ -14,10 +6,20 @@ using namespace cv;
 #include <string>
 #include <vector>
 #include <fstream>
+#include <sstream>
 #include "type.h"
 #include "command_line_helpers.h"
-#include "handeyecalibrationbuilder.h"
+#include "handeye_calibration.h"
 #include "handeyecalibration_utils.h"
+#include "hand_pose_excitation.h"
+#include "next_best_hand_pose.h"
+#include "handeye_feature_frontend.h"
+#include "handeye_opencv.h"
+#include "handeye_profiler.h"
+#include "trace_recorder.h"
+#include "calibration_metrics.h"
+#include "online_handeye_calibrator.h"
+#include "target_calibration.h"
 using namespace std;
 
 void cout_indented(int n_space, const string& str)
@@ -38,9 +40,50 @@ DEFINE_int32(chessboard_ny, -1,
              "Number of grids in Y direction of chessboard.");
 DEFINE_double(cell_mm, -1.0,
              "length of chessboard grid in millimeter.");
+DEFINE_int32(chessboard_detection_image_size, 1024,
+             "Chessboard corners are detected on images downscaled to at most "
+             "this size and refined at full resolution.");
+DEFINE_string(calibration_mode, "SFM",
+              "SFM to calibrate from the structure of the scene, or TARGET to "
+              "calibrate from a chessboard (--chessboard_nx, --chessboard_ny, "
+              "--cell_mm) without feature matching and SfM, or ONLINE to feed "
+              "the images one at a time to the streaming calibrator. TARGET "
+              "and ONLINE need --calibration_file.");
+DEFINE_int32(online_window_size, 8,
+             "ONLINE mode: number of recent images each new image is matched "
+             "against and bundle adjusted with.");
+DEFINE_double(online_forgetting_factor, 1.0,
+              "ONLINE mode: weight decay of old motion pairs in the AX=XB "
+              "accumulator, below 1 to track drift.");
+DEFINE_double(online_max_bundle_adjustment_seconds, 0.5,
+              "ONLINE mode: time limit of the sliding window bundle "
+              "adjustment per frame.");
+DEFINE_bool(compare_to_opencv, false,
+            "Also calibrate with OpenCV's calibrateHandEye from chessboard "
+            "detections and print the result before running the pipeline. "
+            "Needs --calibration_file.");
 
 DEFINE_string(hand_poses_file, "",
               "hand poses file containing hand poses");
+DEFINE_string(initial_hand_eye, "",
+              "Optional file with a prior hand-eye transformation, one line in "
+              "the format of the hand poses file. It is used to predict the "
+              "camera poses from the hand poses, and replaces RANSAC on the "
+              "motion pairs if they agree with it.");
+DEFINE_double(warm_start_min_inlier_ratio, 0.8,
+              "Fraction of the motion pairs that must agree with "
+              "--initial_hand_eye to skip RANSAC. Above 1 RANSAC always runs.");
+DEFINE_double(hand_eye_prior_rotation_sigma_degrees, 0.0,
+              "If positive, together with --hand_eye_prior_translation_sigma, "
+              "bundle adjustment keeps the hand-eye transformation close to "
+              "--initial_hand_eye with this rotation standard deviation.");
+DEFINE_double(hand_eye_prior_translation_sigma, 0.0,
+              "Translation standard deviation of the prior on "
+              "--initial_hand_eye, in the units of the hand poses.");
+DEFINE_int32(num_views_to_select, 0,
+             "If positive, only this many images are used. They are chosen "
+             "from the hand poses alone to maximize the observability of the "
+             "hand-eye transformation, before any feature extraction.");
 DEFINE_string(
     output_matches_file, "",
     "File to write the two-view matches to. This file can be used in "
@@ -63,13 +106,35 @@ DEFINE_string(
 DEFINE_string(feature_density, "NORMAL",
               "Set to SPARSE, NORMAL, or DENSE to extract fewer or more "
               "features from each image.");
+DEFINE_int32(feature_extraction_downscale, 1,
+             "Decode JPEG images at 1/2, 1/4 or 1/8 of their resolution for "
+             "feature extraction with libjpeg's DCT scaling. Keypoints are "
+             "mapped back to full resolution. Uses the hand-eye front end.");
+DEFINE_string(feature_cache_directory, "",
+              "Directory of a persistent feature cache keyed by image content "
+              "and extractor settings. Cached images are not extracted again "
+              "in later runs. Uses the hand-eye front end.");
+DEFINE_bool(suppress_static_features, false,
+            "Remove features that persist at the same pixels across the "
+            "images, e.g. on the gripper or lens dirt, before matching. Uses "
+            "the hand-eye front end.");
+DEFINE_double(static_feature_min_view_fraction, 0.6,
+              "Fraction of the images a feature must persist in to be "
+              "considered static.");
+DEFINE_double(static_feature_max_pixel_distance, 2.0,
+              "Maximum pixel distance of a persisting static feature.");
+DEFINE_string(static_feature_mask, "",
+              "Image, of the size of the input images, that is zero where "
+              "features must be removed before matching. Uses the hand-eye "
+              "front end.");
 DEFINE_string(matching_strategy, "BRUTE_FORCE",
               "Strategy used to match features. Must be BRUTE_FORCE "
-              " or CASCADE_HASHING");
+              " or CASCADE_HASHING. The hand-eye front end only supports "
+              "BRUTE_FORCE.");
 DEFINE_bool(match_out_of_core, true,
             "Perform matching out of core by saving features to disk and "
             "reading them as needed. Set to false to perform matching all in "
-            "memory.");
+            "memory. The hand-eye front end always matches in memory.");
 DEFINE_string(matching_working_directory, "",
               "Directory used during matching to store features for "
               "out-of-core matching.");
@@ -89,6 +154,33 @@ DEFINE_bool(bundle_adjust_two_view_geometry, true,
             "Set to false to turn off 2-view BA.");
 DEFINE_bool(keep_only_symmetric_matches, true,
             "Performs two-way matching and keeps symmetric matches.");
+DEFINE_bool(guided_matching, false,
+            "Match features with the hand-eye front end, which searches the "
+            "candidates of each feature only in a band around the epipolar "
+            "line predicted from the hand poses and --initial_hand_eye. "
+            "Requires calibrated images.");
+DEFINE_double(guided_matching_epipolar_band_pixels, 20.0,
+              "Half width of the band around the predicted epipolar line.");
+DEFINE_double(guided_matching_grid_cell_pixels, 64.0,
+              "Cell size of the spatial index used by guided matching.");
+DEFINE_bool(verify_with_rotation_prior, false,
+            "Verify the matches of calibrated image pairs by estimating only "
+            "the translation direction under the relative rotation predicted "
+            "from the hand poses and --initial_hand_eye, skipping 2-view BA.");
+DEFINE_bool(select_pairs_from_hand_poses, false,
+            "Only match image pairs whose frustums are predicted to overlap "
+            "from the hand poses and --initial_hand_eye, instead of all "
+            "pairs. Needs --initial_hand_eye, all pairs are matched "
+            "without it.");
+DEFINE_double(pair_selection_scene_depth, 0.5,
+              "Expected distance from the cameras to the scene, in the unit of "
+              "the hand poses, used to predict frustum overlap.");
+DEFINE_double(pair_selection_min_overlap, 0.2,
+              "Minimal predicted frustum overlap for an image pair to be "
+              "matched.");
+DEFINE_double(pair_selection_max_viewing_angle_degrees, 60.0,
+              "Image pairs whose optical axes differ more than this are not "
+              "matched.");
 
 // Reconstruction building options.
 DEFINE_string(reconstruction_estimator, "GLOBAL",
@@ -165,6 +257,55 @@ DEFINE_double(bundle_adjustment_robust_loss_width, 10.0,
               "where the robust loss begins with respect to reprojection error "
               "in pixels.");
 
+// Hand pose excitation check.
+DEFINE_string(hand_pose_excitation_check, "WARN",
+              "Checks the rotation diversity of the hand motions before "
+              "feature extraction. Set to NONE to skip the check, WARN to log "
+              "a warning or FAIL to stop when the excitation is insufficient.");
+DEFINE_double(min_motion_rotation_degrees, 5.0,
+              "Relative hand motions rotating less than this are not counted "
+              "as informative for AX=XB.");
+DEFINE_double(min_rotation_axis_spread, 0.05,
+              "Minimal spread of the relative hand motion rotation axes, 0 "
+              "meaning all axes are parallel.");
+DEFINE_double(max_rotation_condition_number, 100.0,
+              "Maximal condition number of the rotation part of AX=XB.");
+
+DEFINE_bool(write_profile_report, true,
+            "Writes the wall and process cpu time, call count, problem size "
+            "and peak memory of every stage as JSON to "
+            "<output_reconstruction>.profile.json.");
+
+DEFINE_string(trace_file, "",
+              "Records the spans of every stage and worker thread and writes "
+              "them to this file in the Chrome trace event format, for "
+              "chrome://tracing or Perfetto. Tracing is off if empty.");
+
+DEFINE_string(metrics_file, "",
+              "Publishes the progress (stage, bundle adjustment cost and "
+              "hand-eye parameters per iteration, front end counts) to this "
+              "file in the Prometheus text format, replaced atomically.");
+DEFINE_string(metrics_socket, "",
+              "Serves the same metrics to every client of this Unix socket.");
+DEFINE_double(metrics_interval_seconds, 1.0,
+              "Minimal time between two writes of --metrics_file.");
+
+// Next best hand pose options.
+DEFINE_string(next_best_pose_candidates, "",
+              "File of reachable hand poses, in the format of the hand poses "
+              "file, to rank by how much each would reduce the uncertainty of "
+              "the hand-eye transformation. Without --images and "
+              "--matches_file only the candidates are ranked, around "
+              "--initial_hand_eye, otherwise they are ranked after the "
+              "calibration using its reconstruction.");
+DEFINE_int32(num_next_best_poses, 5,
+             "Number of ranked candidate hand poses to print.");
+DEFINE_double(next_best_pose_rotation_sigma_degrees, 0.1,
+              "Rotation noise of a relative hand and camera motion.");
+DEFINE_double(next_best_pose_translation_sigma, 0.001,
+              "Translation noise of a relative hand and camera motion, in the "
+              "units of the hand poses.");
+
 using namespace std;
 using theia::Reconstruction;
 using theia::ReconstructionBuilder;
@@ -265,47 +406,161 @@ ReconstructionBuilderOptions SetReconstructionBuilderOptions()
     return options;
 }
 
-void AddMatchesToReconstructionBuilder(
-    ReconstructionBuilder* reconstruction_builder)
+// Returns the hand pose of each image. As in
+// HandEyeCalibrationBuilder::SetHandPoses, the image name is the index of its
+// hand pose.
+Poses HandPosesOfImages(const Poses& handposes,
+                        const std::vector<std::string>& image_files)
 {
-    // Load matches from file.
-    std::vector<std::string> image_files;
-    std::vector<theia::CameraIntrinsicsPrior> camera_intrinsics_prior;
-    std::vector<theia::ImagePairMatch> image_matches;
-
-    // Read in match file.
-    theia::ReadMatchesAndGeometry(FLAGS_matches_file,
-                                  &image_files,
-                                  &camera_intrinsics_prior,
-                                  &image_matches);
-
-    // Add all the views. When the intrinsics group id is invalid, the
-    // reconstruction builder will assume that the view does not share its
-    // intrinsics with any other views.
-    theia::CameraIntrinsicsGroupId intrinsics_group_id =
-        theia::kInvalidCameraIntrinsicsGroupId;
-    if (FLAGS_shared_calibration)
+    Poses image_handposes;
+    for (const std::string& image_file : image_files)
     {
-        intrinsics_group_id = 0;
+        std::string image_filename;
+        CHECK(theia::GetFilenameFromFilepath(image_file, false, &image_filename));
+        const int handpose_index = atoi(image_filename.c_str());
+        CHECK_LT(handpose_index, handposes.size())
+                << "No hand pose for image " << image_file;
+        image_handposes.emplace_back(handposes[handpose_index]);
     }
+    return image_handposes;
+}
 
-    for (int i = 0; i < image_files.size(); i++)
+// Returns the prior hand-eye transformation, identity if none is given.
+Pose ReadInitialHandEye()
+{
+    if (FLAGS_initial_hand_eye.size() == 0)
     {
-        reconstruction_builder->AddImageWithCameraIntrinsicsPrior(
-            image_files[i], camera_intrinsics_prior[i], intrinsics_group_id);
+        return Pose::Identity();
+    }
+    Poses initial_hand_eye;
+    CHECK(ReadHandPoses(FLAGS_initial_hand_eye, &initial_hand_eye) &&
+          initial_hand_eye.size() == 1)
+            << "Could not read the hand-eye transformation in "
+            << FLAGS_initial_hand_eye;
+    return initial_hand_eye[0];
+}
+
+HandEyeFeatureFrontEndOptions SetHandEyeFeatureFrontEndOptions()
+{
+    const ReconstructionBuilderOptions builder_options =
+        SetReconstructionBuilderOptions();
+    HandEyeFeatureFrontEndOptions options;
+    options.num_threads = FLAGS_num_threads;
+    options.descriptor_type = builder_options.descriptor_type;
+    options.feature_density = builder_options.feature_density;
+    options.extraction_downscale = FLAGS_feature_extraction_downscale;
+    options.suppress_static_features = FLAGS_suppress_static_features;
+    options.static_feature_options.min_view_fraction =
+        FLAGS_static_feature_min_view_fraction;
+    options.static_feature_options.max_pixel_distance =
+        FLAGS_static_feature_max_pixel_distance;
+    options.static_feature_mask_filepath = FLAGS_static_feature_mask;
+    if (FLAGS_feature_cache_directory.size() != 0)
+    {
+        if (!theia::DirectoryExists(FLAGS_feature_cache_directory))
+        {
+            CHECK(theia::CreateNewDirectory(FLAGS_feature_cache_directory))
+                    << "Could not create the feature cache directory "
+                    << FLAGS_feature_cache_directory;
+        }
+        options.feature_cache_directory = FLAGS_feature_cache_directory;
     }
+    options.matching_options.lowes_ratio = FLAGS_lowes_ratio;
+    options.matching_options.keep_only_symmetric_matches =
+        FLAGS_keep_only_symmetric_matches;
+    options.matching_options.epipolar_band_pixels =
+        FLAGS_guided_matching_epipolar_band_pixels;
+    options.matching_options.grid_cell_pixels =
+        FLAGS_guided_matching_grid_cell_pixels;
+    options.guided_matching = FLAGS_guided_matching;
+    options.geometric_verification_options =
+        builder_options.matching_options.geometric_verification_options;
+    options.min_num_inlier_matches = FLAGS_min_num_inliers_for_valid_match;
+    options.verify_with_rotation_prior = FLAGS_verify_with_rotation_prior;
+    options.rotation_prior_verification_options.max_sampson_error_pixels =
+        FLAGS_max_sampson_error_for_verified_match;
+    return options;
+}
+
+// The hand-eye front end replaces theia's feature extraction and matching
+// whenever a feature that needs the hand poses is requested.
+bool UseHandEyeFeatureFrontEnd()
+{
+    return FLAGS_guided_matching || FLAGS_verify_with_rotation_prior ||
+           FLAGS_feature_cache_directory.size() != 0 ||
+           FLAGS_feature_extraction_downscale > 1 ||
+           FLAGS_suppress_static_features || FLAGS_static_feature_mask.size() != 0;
+}
+
+// Rejects theia's matching flags that the hand-eye front end cannot honor.
+// The out of core default is ignored, but asking for it is an error.
+void CheckHandEyeFeatureFrontEndFlags()
+{
+    CHECK_EQ(FLAGS_matching_strategy, "BRUTE_FORCE")
+            << "The hand-eye front end, used for --guided_matching, "
+            "--verify_with_rotation_prior, --feature_cache_directory, "
+            "--feature_extraction_downscale and the static feature options, "
+            "only supports brute force matching.";
+    const bool out_of_core_requested =
+        FLAGS_match_out_of_core &&
+        !google::GetCommandLineFlagInfoOrDie("match_out_of_core").is_default;
+    CHECK(!out_of_core_requested && FLAGS_matching_working_directory.empty())
+            << "The hand-eye front end matches in memory, set "
+            "--match_out_of_core=false and no --matching_working_directory.";
+}
+
+HandPoseExcitationOptions SetHandPoseExcitationOptions()
+{
+    HandPoseExcitationOptions options;
+    options.min_rotation_degrees = FLAGS_min_motion_rotation_degrees;
+    options.min_axis_spread = FLAGS_min_rotation_axis_spread;
+    options.max_condition_number = FLAGS_max_rotation_condition_number;
+    return options;
+}
+
+HandPoseExcitationCheck GetHandPoseExcitationCheck()
+{
+    HandPoseExcitationCheck check;
+    CHECK(StringToHandPoseExcitationCheck(FLAGS_hand_pose_excitation_check,
+                                          &check))
+            << "--hand_pose_excitation_check must be NONE, WARN or FAIL.";
+    return check;
+}
 
-    // Add the matches.
-    for (const auto& match : image_matches)
+// Sets the options of the calibration library from the command line flags.
+HandEyeCalibrationOptions SetHandEyeCalibrationOptions(HandEyeProfiler* profiler)
+{
+    HandEyeCalibrationOptions options;
+    options.builder_options = SetReconstructionBuilderOptions();
+    options.use_hand_eye_front_end = UseHandEyeFeatureFrontEnd();
+    if (options.use_hand_eye_front_end)
     {
-        CHECK(reconstruction_builder->AddTwoViewMatch(match.image1,
-                match.image2,
-                match));
+        CheckHandEyeFeatureFrontEndFlags();
     }
+    options.front_end_options = SetHandEyeFeatureFrontEndOptions();
+    options.shared_calibration = FLAGS_shared_calibration;
+    options.has_initial_hand_eye = FLAGS_initial_hand_eye.size() != 0;
+    options.initial_hand_eye = ReadInitialHandEye();
+    options.warm_start_options.min_inlier_ratio = FLAGS_warm_start_min_inlier_ratio;
+    options.warm_start_options.rotation_sigma_degrees =
+        FLAGS_hand_eye_prior_rotation_sigma_degrees;
+    options.warm_start_options.translation_sigma =
+        FLAGS_hand_eye_prior_translation_sigma;
+    options.num_views_to_select = FLAGS_num_views_to_select;
+    options.select_pairs_from_hand_poses = FLAGS_select_pairs_from_hand_poses;
+    options.pair_selection_options.scene_depth = FLAGS_pair_selection_scene_depth;
+    options.pair_selection_options.min_overlap = FLAGS_pair_selection_min_overlap;
+    options.pair_selection_options.max_viewing_angle_degrees =
+        FLAGS_pair_selection_max_viewing_angle_degrees;
+    options.excitation_options = SetHandPoseExcitationOptions();
+    options.excitation_check = GetHandPoseExcitationCheck();
+    options.profiler = profiler;
+    return options;
 }
 
-void AddImagesToReconstructionBuilder(
-    ReconstructionBuilder* reconstruction_builder, int n_sp)
+// One frame per image of --images, with its calibration from
+// --calibration_file if it is there.
+HandEyeCalibrationFrames ReadImageFrames(const Poses& handposes, int n_sp)
 {
     std::vector<std::string> image_files;
     CHECK(theia::GetFilepathsFromWildcard(FLAGS_images, &image_files))
@@ -323,140 +578,263 @@ void AddImagesToReconstructionBuilder(
         CHECK(theia::ReadCalibration(FLAGS_calibration_file,
                                      &camera_intrinsics_prior))
                 << "Could not read calibration file.";
-        //exit(0);          
-    }
-
-    // Add images with possible calibration. When the intrinsics group id is
-    // invalid, the reconstruction builder will assume that the view does not
-    // share its intrinsics with any other views.
-    theia::CameraIntrinsicsGroupId intrinsics_group_id =
-        theia::kInvalidCameraIntrinsicsGroupId;
-    if (FLAGS_shared_calibration)
-    {
-        intrinsics_group_id = 0;
     }
 
-    for (const std::string& image_file : image_files)
+    const Poses image_handposes = HandPosesOfImages(handposes, image_files);
+    HandEyeCalibrationFrames frames(image_files.size());
+    for (int i = 0; i < image_files.size(); i++)
     {
         std::string image_filename;
-        cout<<image_file<<endl;
-        CHECK(theia::GetFilenameFromFilepath(image_file, true, &image_filename));
-
+        cout<<image_files[i]<<endl;
+        CHECK(theia::GetFilenameFromFilepath(image_files[i], true, &image_filename));
+        frames[i].image_filepath = image_files[i];
+        frames[i].handpose = image_handposes[i];
         const theia::CameraIntrinsicsPrior* image_camera_intrinsics_prior =
             FindOrNull(camera_intrinsics_prior, image_filename);
         if (image_camera_intrinsics_prior != nullptr)
         {
-            CHECK(reconstruction_builder->AddImageWithCameraIntrinsicsPrior(
-                      image_file, *image_camera_intrinsics_prior, intrinsics_group_id));
-        }
-        else
-        {
-            CHECK(reconstruction_builder->AddImage(image_file, intrinsics_group_id));
+            frames[i].intrinsics = *image_camera_intrinsics_prior;
         }
     }
-
-    // Extract and match features.
-    CHECK(reconstruction_builder->ExtractAndMatchFeatures());
+    return frames;
 }
 
-#ifdef COMPARE_2_OPENCV
-
-vector<Mat> read_hand_poses_from_file(const string& hand_poses_file)
+// One frame per image of --matches_file, named as in the matches.
+HandEyeCalibrationFrames ReadMatchesFrames(
+    const Poses& handposes, std::vector<theia::ImagePairMatch>* image_matches)
 {
-    vector<Mat> li_hand_pose;
-    std::ifstream indata;
-    indata.open(hand_poses_file);
-    std::string line;
-    //Poses handposes;
-    uint count = 0;
-    while (getline(indata, line))
+    std::vector<std::string> image_files;
+    std::vector<theia::CameraIntrinsicsPrior> camera_intrinsics_prior;
+    CHECK(theia::ReadMatchesAndGeometry(FLAGS_matches_file,
+                                        &image_files,
+                                        &camera_intrinsics_prior,
+                                        image_matches))
+            << "Could not read the matches file " << FLAGS_matches_file;
+
+    const Poses image_handposes = HandPosesOfImages(handposes, image_files);
+    HandEyeCalibrationFrames frames(image_files.size());
+    for (int i = 0; i < image_files.size(); i++)
     {
+        frames[i].name = image_files[i];
+        frames[i].intrinsics = camera_intrinsics_prior[i];
+        frames[i].handpose = image_handposes[i];
+    }
+    return frames;
+}
 
-//  Pose
-
-//  [r11 r12 r13 tx]
-//  [r21 r22 r23 ty]
-//  [r31 r32 r33 tz]
-//  [0   0   0   1 ]
-
-//  In handposes.txt
-
-//  r11 r21 r31 r12 r22 r32 r13 r23 r33 tx ty tz # for image 1
-//  r11 r21 r31 r12 r22 r32 r13 r23 r33 tx ty tz # for image 2
-//  ...
-//  r11 r21 r31 r12 r22 r32 r13 r23 r33 tx ty tz # for image N
+ChessboardOptions SetChessboardOptions()
+{
+    CHECK_GT(FLAGS_chessboard_nx, 0) << "Set --chessboard_nx.";
+    CHECK_GT(FLAGS_chessboard_ny, 0) << "Set --chessboard_ny.";
+    CHECK_GT(FLAGS_cell_mm, 0.0) << "Set --cell_mm.";
+    ChessboardOptions options;
+    options.num_corners_x = FLAGS_chessboard_nx;
+    options.num_corners_y = FLAGS_chessboard_ny;
+    // The hand poses are in meters.
+    options.square_size = FLAGS_cell_mm/1000.0;
+    options.max_detection_image_size = FLAGS_chessboard_detection_image_size;
+    options.num_threads = FLAGS_num_threads;
+    return options;
+}
 
-        std::stringstream lineStream(line);
-        std::string cell;
-        Pose pose = Pose::Identity(4,4);
-        count = 0;
-        while (std::getline(lineStream, cell, ','))
-        {
-            pose(count%3,count/3) = std::stod(cell);
-            count++;
-        }
-        handposes.push_back(pose);
+// Reads the images and their calibration, which the chessboard poses need.
+void ReadCalibratedImages(std::vector<std::string>* image_files,
+                          std::vector<theia::CameraIntrinsicsPrior>* intrinsics)
+{
+    CHECK(theia::GetFilepathsFromWildcard(FLAGS_images, image_files))
+            << "Could not find images that matched the filepath: " << FLAGS_images
+            << ". NOTE that the ~ filepath is not supported.";
+    CHECK_GT(image_files->size(), 0) << "No images found in: " << FLAGS_images;
+    CHECK_GT(FLAGS_calibration_file.size(), 0)
+            << "The chessboard poses need --calibration_file.";
+    std::unordered_map<std::string, theia::CameraIntrinsicsPrior>
+    camera_intrinsics_prior;
+    CHECK(theia::ReadCalibration(FLAGS_calibration_file, &camera_intrinsics_prior))
+            << "Could not read calibration file.";
+    intrinsics->clear();
+    for (const std::string& image_file : *image_files)
+    {
+        std::string image_filename;
+        CHECK(theia::GetFilenameFromFilepath(image_file, true, &image_filename));
+        const theia::CameraIntrinsicsPrior* prior =
+            FindOrNull(camera_intrinsics_prior, image_filename);
+        CHECK(prior != nullptr) << "No calibration for " << image_filename;
+        intrinsics->emplace_back(*prior);
     }
+}
 
-    return li_hand_pose;
-}    
+// Calibrates from chessboard detections with OpenCV's calibrateHandEye, as a
+// baseline for the SfM pipeline.
+void CompareToOpenCV(const Poses& handposes, int n_sp)
+{
+    cout_indented(n_sp, "CompareToOpenCV START");
+    std::vector<std::string> image_files;
+    std::vector<theia::CameraIntrinsicsPrior> intrinsics;
+    ReadCalibratedImages(&image_files, &intrinsics);
+
+    const ChessboardViews views =
+        DetectChessboards(SetChessboardOptions(), image_files, intrinsics);
+    Pose handeye;
+    if (CalibrateHandEyeOpenCV(views, HandPosesOfImages(handposes, image_files),
+                               &handeye))
+    {
+        Eigen::IOFormat fmt;
+        fmt.precision = Eigen::FullPrecision;
+        cout << "OpenCV hand-eye transform:" << handeye.Rotation().format(fmt)
+             << std::endl << handeye.Translation().format(fmt) << endl;
+    }
+    cout_indented(n_sp, "CompareToOpenCV END");
+}
 
+// Calibrates from the chessboard instead of SfM and writes the same outputs
+// as the SfM pipeline.
+void CalibrateFromTarget(const Poses& handposes, int n_sp)
+{
+    cout_indented(n_sp, "CalibrateFromTarget START");
+    Timer timer;
+    timer.Reset();
+    std::vector<std::string> image_files;
+    std::vector<theia::CameraIntrinsicsPrior> intrinsics;
+    ReadCalibratedImages(&image_files, &intrinsics);
 
+    const ReconstructionBuilderOptions builder_options =
+        SetReconstructionBuilderOptions();
+    TargetCalibrationOptions options;
+    options.chessboard_options = SetChessboardOptions();
+    options.bundle_adjustment_options = theia::SetBundleAdjustmentOptions(
+                                            builder_options.reconstruction_estimator_options,
+                                            image_files.size());
 
+    Reconstruction reconstruction;
+    HandEyeTransformation handeyetrans;
+    CHECK(CalibrateHandEyeFromTarget(options, image_files, intrinsics,
+                                     HandPosesOfImages(handposes, image_files),
+                                     &reconstruction, &handeyetrans))
+            << "Could not calibrate from the chessboard.";
+    cout << "runtime: " << timer.ElapsedTimeInSeconds() << endl;
 
-// reference : https://answers.opencv.org/question/215449/wrong-result-in-calibratehandeye-function-answered/
+    CHECK(theia::WriteReconstruction(reconstruction, FLAGS_output_reconstruction))
+            << "Could not write reconstruction to file.";
+    Eigen::IOFormat fmt;
+    fmt.precision = Eigen::FullPrecision;
+    cout << "Estimated hand-eye transform:"
+         << handeyetrans.GetHandEyeRotationAsRotationMatrix().format(fmt) << std::endl
+         << handeyetrans.GetHandEyeTranslation().format(fmt) << endl;
+    cout_indented(n_sp, "CalibrateFromTarget END");
+}
 
-Mat handeye_opencv(const vector<string>& li_fn, const string& hand_poses_file, const Size& patternsize, float cell_size, int n_sp)
+// Feeds the images in order to the streaming calibrator, as if they were
+// captured live, and prints the estimate published after every frame.
+void CalibrateOnline(const Poses& handposes, int n_sp)
 {
-    cout_indented(n_sp, "handeye_opencv START");
-    vector<Mat> R_gripper2base, t_gripper2base;
-    Mat pose_cam_2_gripper, rvec(3, 1, CV_32F), tvec(3, 1, CV_32F), cameraMatrix(3, 3, CV_32FC1);
-    int num_images = li_fn.size();
-    vector<double> distortionCoefficients(5);
-    vector<Point3f> obj_points;
-    vector<Point2f> centers;
-    //Size patternsize(6, 8); //number of centers
-    std::vector<Mat> R_target2cam, t_target2cam;
-    for (int i = 0; i < patternsize.height; ++i)
-        for (int j = 0; j < patternsize.width; ++j)
-            obj_points.push_back(Point3f(float(j*cell_size), float(i*cell_size), 0.f));
-
-    for (size_t iI = 0; iI < num_images; iI++)
+    cout_indented(n_sp, "CalibrateOnline START");
+    std::vector<std::string> image_files;
+    std::vector<theia::CameraIntrinsicsPrior> intrinsics;
+    ReadCalibratedImages(&image_files, &intrinsics);
+    const Poses image_handposes = HandPosesOfImages(handposes, image_files);
+
+    const ReconstructionBuilderOptions builder_options =
+        SetReconstructionBuilderOptions();
+    OnlineHandEyeCalibratorOptions options;
+    options.front_end_options = SetHandEyeFeatureFrontEndOptions();
+    options.window_size = FLAGS_online_window_size;
+    options.forgetting_factor = FLAGS_online_forgetting_factor;
+    options.bundle_adjustment_options = theia::SetBundleAdjustmentOptions(
+                                            builder_options.reconstruction_estimator_options,
+                                            FLAGS_online_window_size);
+    options.bundle_adjustment_options.max_solver_time_in_seconds =
+        FLAGS_online_max_bundle_adjustment_seconds;
+    options.min_triangulation_angle_degrees = FLAGS_min_triangulation_angle_degrees;
+
+    // One camera, the intrinsics of the first image are used for all.
+    OnlineHandEyeCalibrator calibrator(options, intrinsics[0]);
+    if (FLAGS_initial_hand_eye.size() != 0)
+    {
+        calibrator.SetInitialHandEye(ReadInitialHandEye());
+    }
+    calibrator.SetUpdateCallback([n_sp](const OnlineHandEyeUpdate& update)
     {
-        Mat frame = imread(li_fn[iI]); //source image
-        bool patternfound = findChessboardCorners(frame, patternsize, centers);
-        if (patternfound)
+        std::ostringstream message;
+        message << "frame " << update.frame_index << ": "
+                << update.num_verified_pairs << " verified pairs, "
+                << update.num_motion_pairs << " motion pairs ("
+                << update.num_rejected_motion_pairs << " rejected), "
+                << update.num_window_tracks << " tracks";
+        if (update.has_estimate)
         {
-            drawChessboardCorners(frame, patternsize, Mat(centers), patternfound);
-                                                                //imshow("window", frame);
-                                                                            //int key = cv::waitKey(0) & 0xff;
-                
-            solvePnP(Mat(obj_points), Mat(centers), cameraMatrix, distortionCoefficients, rvec, tvec);
-            Mat R;
-            Rodrigues(rvec, R); // R is 3x3
-            R_target2cam.push_back(R);
-            t_target2cam.push_back(tvec);
-            Mat T = Mat::eye(4, 4, R.type()); // T is 4x4
-            T(Range(0, 3), Range(0, 3)) = R * 1; // copies R into T
-            T(Range(0, 3), Range(3, 4)) = tvec * 1; // copies tvec into T
-                
-            cout << "T = " << endl << " " << T << endl << endl;
-
+            message << ", X translation = "
+                    << update.handeye.Translation().transpose();
         }
-        //cout << patternfound << endl;
-        cout_indented(n_sp + 1, "iI : " + to_string(iI) + " / " + to_string(num_images) + " : patternfound = " + to_string(patternfound));
+        cout_indented(n_sp + 1, message.str());
+    });
+    for (int i = 0; i < image_files.size(); i++)
+    {
+        calibrator.AddFrame(image_files[i], image_handposes[i]);
     }
-   
-    //Mat R_cam2gripper = (Mat_<float>(3, 3)), t_cam2gripper = (Mat_<float>(3, 1));
-    Mat R_cam2gripper, t_cam2gripper;
 
-    calibrateHandEye(R_gripper2base, t_gripper2base, R_target2cam, t_target2cam, R_cam2gripper, t_cam2gripper, CALIB_HAND_EYE_TSAI);
+    CHECK(calibrator.HasEstimate()) << "Could not calibrate online.";
+    CHECK(theia::WriteReconstruction(calibrator.GetReconstruction(),
+                                     FLAGS_output_reconstruction))
+            << "Could not write reconstruction to file.";
+    Eigen::IOFormat fmt;
+    fmt.precision = Eigen::FullPrecision;
+    const Pose handeye = calibrator.HandEye();
+    cout << "Estimated hand-eye transform:" << handeye.Rotation().format(fmt)
+         << std::endl << handeye.Translation().format(fmt) << endl;
+    cout_indented(n_sp, "CalibrateOnline END");
+}
 
-    cout_indented(n_sp, "handeye_opencv END");
-    return pose_cam_2_gripper;
-}    
-#endif  //  COMPARE_2_OPENCV
+// Prints the best candidates of --next_best_pose_candidates to capture next.
+void SuggestNextBestHandPoses(const Poses& handposes, const Pose& handeye,
+                              const Reconstruction* reconstruction, int n_sp)
+{
+    cout_indented(n_sp, "SuggestNextBestHandPoses START");
+    Poses candidates;
+    CHECK(ReadHandPoses(FLAGS_next_best_pose_candidates, &candidates))
+            << "Could not read the candidate hand poses in "
+            << FLAGS_next_best_pose_candidates;
+
+    NextBestHandPoseOptions options;
+    options.motion_rotation_sigma_degrees =
+        FLAGS_next_best_pose_rotation_sigma_degrees;
+    options.motion_translation_sigma = FLAGS_next_best_pose_translation_sigma;
+
+    Eigen::Vector3d rotation_degrees, translation;
+    HandEyeStandardDeviations(
+        HandEyeInformation(options, handposes, handeye, reconstruction),
+        &rotation_degrees, &translation);
+    cout << "Current hand-eye standard deviations, rotation (deg): "
+         << rotation_degrees.transpose() << ", translation: "
+         << translation.transpose() << endl;
+
+    const std::vector<HandPoseCandidateScore> scores =
+        RankCandidateHandPoses(options, handposes, candidates, handeye,
+                               reconstruction);
+    for (int i = 0; i < std::min<int>(FLAGS_num_next_best_poses, scores.size());
+            i++)
+    {
+        const HandPoseCandidateScore& score = scores[i];
+        cout << "candidate " << score.candidate_index
+             << ": information gain " << score.information_gain
+             << ", rotation (deg): "
+             << score.rotation_standard_deviation_degrees.transpose()
+             << ", translation: "
+             << score.translation_standard_deviation.transpose() << endl;
+    }
+    cout_indented(n_sp, "SuggestNextBestHandPoses END");
+}
 
+// Writes the trace and the final metrics.
+void FinishInstrumentation()
+{
+    if (FLAGS_trace_file.size() != 0)
+    {
+        LOG_IF(WARNING, !WriteTrace(FLAGS_trace_file))
+                << "Could not write the trace to " << FLAGS_trace_file;
+    }
+    SetMetric("shecar_done", 1.0);
+    StopMetricsExport();
+}
 
 int main(int argc, char *argv[])
 {
@@ -467,15 +845,6 @@ int main(int argc, char *argv[])
     for(int i = 0; i < argc; i++) printf("%s ", argv[i]);    printf("\n");
     //exit(0);   
     google::InitGoogleLogging(argv[0]);
-#ifdef COMPARE_2_OPENCV
-    std::vector<std::string> image_files;
-    CHECK(theia::GetFilepathsFromWildcard(FLAGS_images, &image_files))
-            << "Could not find images that matched the filepath: " << FLAGS_images
-            << ". NOTE that the ~ filepath is not supported.";
-    CHECK_GT(image_files.size(), 0) << "No images found in: " << FLAGS_images;
-    Mat pose_cam_2_gripper = handeye_opencv(image_files, FLAGS_hand_poses_file, Size(FLAGS_chessboard_nx, FLAGS_chessboard_ny), FLAGS_cell_mm, 1);
-    exit(0);
-#endif  //  COMPARE_2_OPENCV
 #if 0    
     cout << "FLAGS_output_reconstruction.size() : " << FLAGS_output_reconstruction.size() << endl;
     cout << "FLAGS_output_reconstruction : " << FLAGS_output_reconstruction << endl;
@@ -483,81 +852,127 @@ int main(int argc, char *argv[])
 #endif    
     CHECK_GT(FLAGS_output_reconstruction.size(), 0)
             << "Must specify a filepath to output the reconstruction.";
+    const HandPoseExcitationCheck excitation_check = GetHandPoseExcitationCheck();
+    if (FLAGS_trace_file.size() != 0)
+    {
+        StartTracing();
+        SetTraceThreadName("main");
+    }
+    if (FLAGS_metrics_file.size() != 0 || FLAGS_metrics_socket.size() != 0)
+    {
+        CHECK(StartMetricsExport(FLAGS_metrics_file, FLAGS_metrics_socket,
+                                 FLAGS_metrics_interval_seconds))
+                << "Could not start the metrics export.";
+        SetMetric("shecar_done", 0.0);
+    }
 
     const ReconstructionBuilderOptions options =
         SetReconstructionBuilderOptions();
 
-    std::ifstream indata;
-    indata.open(FLAGS_hand_poses_file);
-    std::string line;
     Poses handposes;
-    uint count = 0;
-    while (getline(indata, line))
+    CHECK(ReadHandPoses(FLAGS_hand_poses_file, &handposes))
+            << "Could not read hand poses file.";
+
+    // Reject captures with degenerate hand motions before the expensive part
+    // of the pipeline. CalibrateHandEye checks the frames it calibrates from
+    // itself, the other modes are checked here.
+    const bool calibrates_in_library =
+        FLAGS_calibration_mode == "SFM" &&
+        (FLAGS_images.size() != 0 || FLAGS_matches_file.size() != 0);
+    if (!calibrates_in_library)
     {
-
-//  Pose
-
-//  [r11 r12 r13 tx]
-//  [r21 r22 r23 ty]
-//  [r31 r32 r33 tz]
-//  [0   0   0   1 ]
-
-//  In handposes.txt
-
-//  r11 r21 r31 r12 r22 r32 r13 r23 r33 tx ty tz # for image 1
-//  r11 r21 r31 r12 r22 r32 r13 r23 r33 tx ty tz # for image 2
-//  ...
-//  r11 r21 r31 r12 r22 r32 r13 r23 r33 tx ty tz # for image N
-
-        std::stringstream lineStream(line);
-        std::string cell;
-        Pose pose = Pose::Identity(4,4);
-        count = 0;
-        while (std::getline(lineStream, cell, ','))
-        {
-            pose(count%3,count/3) = std::stod(cell);
-            count++;
-        }
-        handposes.push_back(pose);
+        HandPoseExcitationSummary excitation;
+        CHECK(CheckHandPoseExcitation(handposes, SetHandPoseExcitationOptions(),
+                                      excitation_check, &excitation))
+                << "Hand motions do not excite the hand-eye calibration, "
+                "see the excitation report above.";
     }
 
+    // Ranking the candidates from the hand poses alone is cheap enough to run
+    // between captures.
+    if (FLAGS_next_best_pose_candidates.size() != 0 &&
+            FLAGS_images.size() == 0 && FLAGS_matches_file.size() == 0)
+    {
+        SuggestNextBestHandPoses(handposes, ReadInitialHandEye(), nullptr, 0);
+        return 0;
+    }
 
+    if (FLAGS_compare_to_opencv)
+    {
+        CompareToOpenCV(handposes, 0);
+    }
 
-    Timer timer;
-    timer.Reset();
-    cout_indented(0, "BBB");
-    HandEyeCalibrationBuilder reconstruction_builder(options);
-    cout_indented(0, "CCC");   // exit(0);
-
+    if (FLAGS_calibration_mode == "TARGET")
+    {
+        CalibrateFromTarget(handposes, 0);
+        FinishInstrumentation();
+        return 0;
+    }
+    if (FLAGS_calibration_mode == "ONLINE")
+    {
+        CalibrateOnline(handposes, 0);
+        FinishInstrumentation();
+        return 0;
+    }
+    CHECK_EQ(FLAGS_calibration_mode, "SFM")
+            << "--calibration_mode must be SFM, TARGET or ONLINE.";
+
+    HandEyeProfiler profiler;
+    const HandEyeCalibrationOptions calibration_options =
+        SetHandEyeCalibrationOptions(&profiler);
+    HandEyeCalibrationResult result;
+    bool calibrated = false;
     // If matches are provided, load matches otherwise load images.
     if (FLAGS_matches_file.size() != 0)
     {
-        AddMatchesToReconstructionBuilder(&reconstruction_builder);
+        std::vector<theia::ImagePairMatch> image_matches;
+        const HandEyeCalibrationFrames frames =
+            ReadMatchesFrames(handposes, &image_matches);
+        calibrated = CalibrateHandEyeFromMatches(calibration_options, frames,
+                     image_matches, &result);
     }
     else if (FLAGS_images.size() != 0)
     {
-        AddImagesToReconstructionBuilder(&reconstruction_builder, 0);
+        calibrated = CalibrateHandEye(calibration_options,
+                                      ReadImageFrames(handposes, 0), &result);
     }
     else
     {
         LOG(FATAL)
                 << "You must specifiy either images to reconstruct or a match file.";
     }
-
-    reconstruction_builder.SetHandPoses(&handposes);
-
-    HandEyeTransformation handeyetrans;
-    CHECK(reconstruction_builder.BuildHandEyeCalibration(&handeyetrans))
-            << "Could not create a reconstruction.";
-
-    cout<<"runtime: "<<timer.ElapsedTimeInSeconds()<<endl;
-    std::unique_ptr<Reconstruction> reconstructions =  reconstruction_builder.GetReconstruction();
+    CHECK(result.reconstruction != nullptr)
+            << "Could not create a reconstruction. " << result.message;
+    LOG_IF(WARNING, !calibrated) << "The hand-eye calibration did not converge.";
+    const HandEyeTransformation& handeyetrans = result.handeye;
+
+    cout<<"runtime: "<<result.total_time_seconds<<endl;
+    cout << "estimated " << result.num_estimated_views << " of "
+         << result.num_input_views << " views and " << result.num_estimated_tracks
+         << " of " << result.num_input_tracks << " tracks from "
+         << result.num_verified_pairs << " image pairs, mean reprojection error "
+         << result.mean_reprojection_error_pixels << " pixels" << endl;
+    LOG_IF(INFO, result.warm_started)
+            << "Started from --initial_hand_eye without RANSAC.";
     const std::string output_file =
         theia::StringPrintf("%s", FLAGS_output_reconstruction.c_str());
-    CHECK(theia::WriteReconstruction(*reconstructions, output_file))
+    CHECK(theia::WriteReconstruction(*result.reconstruction, output_file))
             << "Could not write reconstruction to file.";
+    if (FLAGS_write_profile_report)
+    {
+        const std::string profile_file = output_file + ".profile.json";
+        LOG_IF(WARNING, !profiler.WriteJson(profile_file))
+                << "Could not write the profile report to " << profile_file;
+    }
 
     Eigen::IOFormat fmt;
     fmt.precision = Eigen::FullPrecision;
     cout<<"Estimated hand-eye transform:"<<handeyetrans.GetHandEyeRotationAsRotationMatrix().format(fmt)<<std::endl<<handeyetrans.GetHandEyeTranslation().format(fmt)<<endl;
+
+    if (FLAGS_next_best_pose_candidates.size() != 0)
+    {
+        SuggestNextBestHandPoses(handposes, handeyetrans.GetHandEyePose(),
+                                 result.reconstruction.get(), 0);
+    }
+    FinishInstrumentation();
 }
@@ -0,0 +1,261 @@
+#include "next_best_hand_pose.h"
+
+#include <Eigen/Cholesky>
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+
+typedef Eigen::Matrix<double, 6, 6> Matrix6d;
+
+const double kDegToRad = M_PI/180.0;
+
+// Keeps the information invertible while some direction of the hand-eye
+// parameters is not observed yet.
+const double kInformationRegularization = 1e-6;
+
+// [u]x with [u]x*v = u x v.
+Eigen::Matrix3d CrossProductMatrix(const Eigen::Vector3d& u)
+{
+    Eigen::Matrix3d matrix;
+    matrix << 0.0, -u.z(), u.y(),
+           u.z(), 0.0, -u.x(),
+           -u.y(), u.x(), 0.0;
+    return matrix;
+}
+
+// Adds the information of the AX=XB residuals of the relative hand motion B,
+// with A = X*B*X^-1. The rotation residual Ra*Rx*Rb'*Rx' becomes
+// Ra*exp(dr)*Ra'*exp(-dr) = exp((Ra-I)*dr) when Rx is perturbed to
+// exp(dr)*Rx, and the translation residual (Ra-I)*tx-Rx*tb+ta changes by
+// [Rx*tb]x*dr+(Ra-I)*dt.
+void AddMotionInformation(const NextBestHandPoseOptions& options,
+                          const Pose& handeye, const Pose& handmotion,
+                          Matrix6d* information)
+{
+    const Eigen::Matrix3d rotation_x = handeye.Rotation();
+    const Eigen::Matrix3d rotation_a_minus_identity =
+        rotation_x*handmotion.Rotation()*rotation_x.transpose() -
+        Eigen::Matrix3d::Identity();
+    const double rotation_weight =
+        1.0/(options.motion_rotation_sigma_degrees*kDegToRad);
+    const double translation_weight = 1.0/options.motion_translation_sigma;
+
+    Matrix6d jacobian = Matrix6d::Zero();
+    jacobian.block<3, 3>(0, 0) = rotation_weight*rotation_a_minus_identity;
+    jacobian.block<3, 3>(3, 0) = translation_weight*
+                                 CrossProductMatrix(rotation_x*handmotion.Translation());
+    jacobian.block<3, 3>(3, 3) = translation_weight*rotation_a_minus_identity;
+    *information += jacobian.transpose()*jacobian;
+}
+
+// Adds the information of the reprojection of a known point, given in the
+// hand frame of the view, into a pinhole camera with the given focal length.
+// The point in the camera is Rx*point_in_hand+tx. Returns false if it is
+// behind the camera.
+bool AddPointInformation(const NextBestHandPoseOptions& options,
+                         const Pose& handeye,
+                         const Eigen::Vector3d& point_in_hand,
+                         const double focal_length, const double weight,
+                         Matrix6d* information)
+{
+    const Eigen::Vector3d rotated_point = handeye.Quaternion()*point_in_hand;
+    const Eigen::Vector3d point = rotated_point + handeye.Translation();
+    if (point.z() <= 0.0)
+    {
+        return false;
+    }
+    Eigen::Matrix<double, 2, 3> projection;
+    projection << 1.0, 0.0, -point.x()/point.z(),
+               0.0, 1.0, -point.y()/point.z();
+    projection *= focal_length/(point.z()*options.reprojection_sigma_pixels);
+
+    Eigen::Matrix<double, 2, 6> jacobian;
+    jacobian.leftCols<3>() = -projection*CrossProductMatrix(rotated_point);
+    jacobian.rightCols<3>() = projection;
+    *information += weight*jacobian.transpose()*jacobian;
+    return true;
+}
+
+double LogDetInformation(const Matrix6d& information)
+{
+    const Eigen::LLT<Matrix6d> llt(
+        information + kInformationRegularization*Matrix6d::Identity());
+    return 2.0*llt.matrixL().toDenseMatrix().diagonal().array().log().sum();
+}
+
+// Estimated tracks of the reconstruction, subsampled to at most max_num_points.
+std::vector<Eigen::Vector3d> SamplePoints(const Reconstruction& reconstruction,
+                                          const int max_num_points,
+                                          int* num_points)
+{
+    std::vector<Eigen::Vector3d> points;
+    for (const TrackId track_id : reconstruction.TrackIds())
+    {
+        const Track* track = reconstruction.Track(track_id);
+        if (track->IsEstimated() && std::abs(track->Point().w()) > 1e-10)
+        {
+            points.emplace_back(track->Point().hnormalized());
+        }
+    }
+    *num_points = points.size();
+    if (points.size() <= max_num_points)
+    {
+        return points;
+    }
+    std::vector<Eigen::Vector3d> sampled_points;
+    sampled_points.reserve(max_num_points);
+    for (int i = 0; i < max_num_points; i++)
+    {
+        sampled_points.emplace_back(points[(i*points.size())/max_num_points]);
+    }
+    return sampled_points;
+}
+
+}  // namespace
+
+Eigen::Matrix<double, 6, 6> HandEyeInformation(
+    const NextBestHandPoseOptions& options, const Poses& handposes,
+    const Pose& handeye, const Reconstruction* reconstruction)
+{
+    Matrix6d information = Matrix6d::Zero();
+    for (int i = 0; i < handposes.size(); i++)
+    {
+        const Pose inverse_handpose = handposes[i].Inverse();
+        for (int j = i + 1; j < handposes.size(); j++)
+        {
+            AddMotionInformation(options, handeye, inverse_handpose*handposes[j],
+                                 &information);
+        }
+    }
+    if (reconstruction == nullptr)
+    {
+        return information;
+    }
+
+    for (const ViewId view_id : reconstruction->ViewIds())
+    {
+        const View* view = reconstruction->View(view_id);
+        if (!view->IsEstimated() || view_id >= handposes.size())
+        {
+            continue;
+        }
+        const Pose inverse_handpose = handposes[view_id].Inverse();
+        const double focal_length = view->Camera().FocalLength();
+        for (const TrackId track_id : view->TrackIds())
+        {
+            const Track* track = reconstruction->Track(track_id);
+            if (!track->IsEstimated() || std::abs(track->Point().w()) < 1e-10)
+            {
+                continue;
+            }
+            AddPointInformation(options, handeye,
+                                inverse_handpose*Eigen::Vector3d(track->Point().hnormalized()),
+                                focal_length, 1.0, &information);
+        }
+    }
+    return information;
+}
+
+void HandEyeStandardDeviations(const Eigen::Matrix<double, 6, 6>& information,
+                               Eigen::Vector3d* rotation_degrees,
+                               Eigen::Vector3d* translation)
+{
+    const Matrix6d covariance =
+        (information + kInformationRegularization*Matrix6d::Identity())
+        .ldlt().solve(Matrix6d::Identity());
+    const Eigen::Matrix<double, 6, 1> standard_deviations =
+        covariance.diagonal().cwiseMax(0.0).cwiseSqrt();
+    *rotation_degrees = standard_deviations.head<3>()/kDegToRad;
+    *translation = standard_deviations.tail<3>();
+}
+
+std::vector<HandPoseCandidateScore> RankCandidateHandPoses(
+    const NextBestHandPoseOptions& options, const Poses& handposes,
+    const Poses& candidates, const Pose& handeye,
+    const Reconstruction* reconstruction)
+{
+    const Matrix6d information =
+        HandEyeInformation(options, handposes, handeye, reconstruction);
+    const double log_det = LogDetInformation(information);
+
+    // A candidate is predicted to observe the sampled points that project
+    // inside the image of the first estimated camera, each weighted by the
+    // inverse of the sampling rate.
+    const theia::Camera* camera = nullptr;
+    std::vector<Eigen::Vector3d> points;
+    double point_weight = 0.0;
+    if (reconstruction != nullptr && options.max_num_candidate_tracks > 0)
+    {
+        for (const ViewId view_id : reconstruction->ViewIds())
+        {
+            if (reconstruction->View(view_id)->IsEstimated())
+            {
+                camera = &reconstruction->View(view_id)->Camera();
+                break;
+            }
+        }
+        int num_points = 0;
+        points = SamplePoints(*reconstruction, options.max_num_candidate_tracks,
+                              &num_points);
+        if (points.size() > 0)
+        {
+            point_weight = static_cast<double>(num_points)/points.size();
+        }
+    }
+
+    std::vector<HandPoseCandidateScore> scores(candidates.size());
+    for (int c = 0; c < candidates.size(); c++)
+    {
+        Matrix6d candidate_information = information;
+        const Pose inverse_candidate = candidates[c].Inverse();
+        // In the order of HandEyeInformation with the candidate appended, so
+        // the prediction equals its information once captured.
+        for (const Pose& handpose : handposes)
+        {
+            AddMotionInformation(options, handeye, handpose.Inverse()*candidates[c],
+                                 &candidate_information);
+        }
+        if (camera != nullptr)
+        {
+            const double focal_length = camera->FocalLength();
+            for (const Eigen::Vector3d& point : points)
+            {
+                const Eigen::Vector3d point_in_camera =
+                    handeye*(inverse_candidate*point);
+                if (point_in_camera.z() <= 0.0)
+                {
+                    continue;
+                }
+                const double x = camera->PrincipalPointX() +
+                                 focal_length*point_in_camera.x()/point_in_camera.z();
+                const double y = camera->PrincipalPointY() +
+                                 focal_length*point_in_camera.y()/point_in_camera.z();
+                if (x < 0.0 || y < 0.0 || x >= camera->ImageWidth() ||
+                        y >= camera->ImageHeight())
+                {
+                    continue;
+                }
+                AddPointInformation(options, handeye, inverse_candidate*point,
+                                    focal_length, point_weight,
+                                    &candidate_information);
+            }
+        }
+
+        HandPoseCandidateScore& score = scores[c];
+        score.candidate_index = c;
+        score.information_gain = LogDetInformation(candidate_information) - log_det;
+        HandEyeStandardDeviations(candidate_information,
+                                  &score.rotation_standard_deviation_degrees,
+                                  &score.translation_standard_deviation);
+    }
+
+    std::stable_sort(scores.begin(), scores.end(),
+                     [](const HandPoseCandidateScore& a,
+                        const HandPoseCandidateScore& b)
+    {
+        return a.information_gain > b.information_gain;
+    });
+    return scores;
+}
@@ -0,0 +1,68 @@
+#ifndef NEXT_BEST_HAND_POSE_H
+#define NEXT_BEST_HAND_POSE_H
+
+#include <Eigen/Core>
+#include <theia/theia.h>
+#include <vector>
+#include "type.h"
+using namespace theia;
+
+// Noise model of the approximate Fisher information of the hand-eye
+// parameters. Only the ratios matter for the ranking, the absolute values
+// scale the predicted standard deviations.
+struct NextBestHandPoseOptions
+{
+    // Standard deviation of the rotation of a relative motion, hand and camera
+    // noise combined.
+    double motion_rotation_sigma_degrees = 0.1;
+    // Standard deviation of the translation of a relative motion, in the units
+    // of the hand poses.
+    double motion_translation_sigma = 0.001;
+    double reprojection_sigma_pixels = 1.0;
+    // Number of reconstructed points projected into each candidate to predict
+    // its observations. 0 ranks from the hand motions only.
+    int max_num_candidate_tracks = 1000;
+};
+
+struct HandPoseCandidateScore
+{
+    int candidate_index = -1;
+    // Increase of the log determinant of the information matrix (D-optimal,
+    // like SelectInformativeHandPoses).
+    double information_gain = 0.0;
+    // Predicted standard deviations of the hand-eye rotation (around the
+    // camera axes) and translation once the candidate has been captured.
+    Eigen::Vector3d rotation_standard_deviation_degrees = Eigen::Vector3d::Zero();
+    Eigen::Vector3d translation_standard_deviation = Eigen::Vector3d::Zero();
+};
+
+// Fisher information of the hand-eye transformation X, parameterized by a
+// small rotation dr applied on the left of its rotation (the first three
+// rows) and its translation (the last three). It sums the linearized AX=XB
+// residuals of the relative motions between all pairs of hand poses, with A
+// predicted as X*B*X^-1, and, if reconstruction is not null, the
+// reprojections of its estimated tracks into its estimated views. View ids
+// must index handposes, as in BundleAdjustPartialHandEye. The points are
+// treated as known, which makes the information optimistic but is cheap.
+Eigen::Matrix<double, 6, 6> HandEyeInformation(
+    const NextBestHandPoseOptions& options, const Poses& handposes,
+    const Pose& handeye, const Reconstruction* reconstruction);
+
+// Rotation (in degrees) and translation standard deviations from the
+// diagonal of the inverse of the information.
+void HandEyeStandardDeviations(const Eigen::Matrix<double, 6, 6>& information,
+                               Eigen::Vector3d* rotation_degrees,
+                               Eigen::Vector3d* translation);
+
+// Ranks the reachable candidate hand poses by how much capturing an image at
+// each would add to HandEyeInformation, without re-solving anything. Every
+// candidate adds its motions to all current hand poses and, if
+// reconstruction is not null, the reprojections of the points that would be
+// in front of it and inside the image of the first view's camera. Returns one
+// score per candidate, best first.
+std::vector<HandPoseCandidateScore> RankCandidateHandPoses(
+    const NextBestHandPoseOptions& options, const Poses& handposes,
+    const Poses& candidates, const Pose& handeye,
+    const Reconstruction* reconstruction);
+
+#endif // NEXT_BEST_HAND_POSE_H
@@ -0,0 +1,302 @@
+#include "online_handeye_calibrator.h"
+
+#include <glog/logging.h>
+#include <Eigen/Geometry>
+#include <algorithm>
+#include <unordered_set>
+#include <utility>
+
+#include "axxb/axxbestimator.h"
+#include "hand_eye_bundle_adjustment.h"
+#include "handeyecalibration_utils.h"
+
+OnlineHandEyeCalibrator::OnlineHandEyeCalibrator(
+    const OnlineHandEyeCalibratorOptions& options,
+    const CameraIntrinsicsPrior& intrinsics)
+    : options_(options),
+      intrinsics_(intrinsics),
+      front_end_(options.front_end_options),
+      axxb_solver_(options.forgetting_factor),
+      has_estimate_(false)
+{
+    CHECK_GT(options_.window_size, 0);
+}
+
+void OnlineHandEyeCalibrator::SetUpdateCallback(const UpdateCallback& callback)
+{
+    callback_ = callback;
+}
+
+void OnlineHandEyeCalibrator::SetInitialHandEye(const Pose& handeye)
+{
+    handeyetrans_.SetHandEyePose(handeye);
+    front_end_.SetHandEye(handeye);
+    has_estimate_ = true;
+}
+
+bool OnlineHandEyeCalibrator::AddFrame(const std::string& image_filepath,
+                                       const Pose& handpose)
+{
+    OnlineHandEyeUpdate update;
+    const int image_index =
+        front_end_.AddImage(image_filepath, intrinsics_, handpose);
+    const ViewId view_id =
+        reconstruction_.AddView(front_end_.ImageName(image_index), 0);
+    CHECK_EQ(image_index, handposes_.size());
+    CHECK_EQ(view_id, image_index);
+    handposes_.emplace_back(handpose);
+    update.frame_index = image_index;
+
+    View* view = reconstruction_.MutableView(view_id);
+    *view->MutableCameraIntrinsicsPrior() = intrinsics_;
+    view->MutableCamera()->SetFromCameraIntrinsicsPriors(intrinsics_);
+
+    if (!front_end_.ExtractFeatures(image_index))
+    {
+        LOG(WARNING) << "Could not extract features from " << image_filepath;
+        reconstruction_.RemoveView(view_id);
+        update.has_estimate = has_estimate_;
+        update.handeye = HandEye();
+        if (callback_)
+        {
+            callback_(update);
+        }
+        return false;
+    }
+
+    std::vector<ImagePairMatch> matches;
+    std::vector<int> window_image_indices;
+    MatchWithWindow(image_index, &matches, &window_image_indices);
+    update.num_verified_pairs = matches.size();
+
+    // Same motions as in the batch estimator: A is the pose of the new
+    // camera in the old one, B = H_old^-1*H_new. Without RANSAC, a wrong
+    // relative pose would bias the solver for good, so once there is an
+    // estimate the motions that disagree with it are left out.
+    const AXXBEstimator axxb_estimator;
+    const Pose current_handeye = HandEye();
+    for (int i = 0; i < matches.size(); i++)
+    {
+        const TwoViewInfo& info = matches[i].twoview_info;
+        const Eigen::AngleAxisd angleaxis(info.rotation_2.norm(),
+                                          info.rotation_2.normalized());
+        const MotionPair motionpair(
+            Pose(Eigen::Matrix3d(angleaxis.toRotationMatrix().transpose()),
+                 info.position_2),
+            handposes_[window_image_indices[i]].Inverse()*handpose);
+        if (has_estimate_ &&
+                axxb_estimator.Error(motionpair, current_handeye) >=
+                options_.max_motion_pair_error)
+        {
+            update.num_rejected_motion_pairs++;
+            continue;
+        }
+        axxb_solver_.AddMotionPair(motionpair.A, motionpair.B);
+    }
+    update.num_motion_pairs = axxb_solver_.NumMotionPairs();
+
+    // The linear solution follows X over the whole stream, forgetting old
+    // motions by forgetting_factor, and the bundle adjustment refines it on
+    // the window.
+    Pose linear_handeye;
+    if (axxb_solver_.SolveX(&linear_handeye))
+    {
+        handeyetrans_.SetHandEyePose(linear_handeye);
+        has_estimate_ = true;
+    }
+
+    window_.emplace_back(view_id);
+    if (has_estimate_)
+    {
+        front_end_.SetHandEye(HandEye());
+        SetWindowCameraPoses();
+        // Pairs verified before X was known are triangulated now.
+        for (const PendingPair& pending_pair : pending_pairs_)
+        {
+            AddTracks(pending_pair.view_id1, pending_pair.view_id2,
+                      pending_pair.match);
+        }
+        pending_pairs_.clear();
+        for (int i = 0; i < matches.size(); i++)
+        {
+            AddTracks(window_image_indices[i], view_id, matches[i]);
+        }
+    }
+    else
+    {
+        for (int i = 0; i < matches.size(); i++)
+        {
+            pending_pairs_.emplace_back(
+                PendingPair{window_image_indices[i], view_id, matches[i]});
+        }
+    }
+    SlideWindow();
+
+    if (options_.bundle_adjust && has_estimate_)
+    {
+        update.bundle_adjusted = BundleAdjustWindow(&update);
+        front_end_.SetHandEye(HandEye());
+    }
+    for (const ViewId window_view_id : window_)
+    {
+        update.num_window_tracks += tracks_of_view_[window_view_id].size();
+    }
+    // Every track is in two views.
+    update.num_window_tracks /= 2;
+
+    update.has_estimate = has_estimate_;
+    update.handeye = HandEye();
+    if (callback_)
+    {
+        callback_(update);
+    }
+    return true;
+}
+
+void OnlineHandEyeCalibrator::MatchWithWindow(
+    const int image_index, std::vector<ImagePairMatch>* matches,
+    std::vector<int>* window_image_indices)
+{
+    const std::vector<ViewId> window(window_.begin(), window_.end());
+    std::vector<ImagePairMatch> pair_matches(window.size());
+    std::vector<char> verified(window.size(), false);
+    {
+        ThreadPool pool(std::max(1, std::min<int>(
+                                     options_.front_end_options.num_threads,
+                                     window.size())));
+        for (int i = 0; i < window.size(); i++)
+        {
+            pool.Add([this, &window, &pair_matches, &verified, image_index, i]()
+            {
+                verified[i] = front_end_.MatchImagePair(window[i], image_index,
+                                                        &pair_matches[i]);
+            });
+        }
+        pool.WaitForTasksToFinish();
+    }
+    for (int i = 0; i < window.size(); i++)
+    {
+        if (verified[i])
+        {
+            matches->emplace_back(pair_matches[i]);
+            window_image_indices->emplace_back(window[i]);
+        }
+    }
+}
+
+void OnlineHandEyeCalibrator::AddTracks(const ViewId view_id1,
+                                        const ViewId view_id2,
+                                        const ImagePairMatch& match)
+{
+    const Camera& camera1 = reconstruction_.View(view_id1)->Camera();
+    const Camera& camera2 = reconstruction_.View(view_id2)->Camera();
+    std::vector<Eigen::Vector3d> origins(2), directions(2);
+    origins[0] = camera1.GetPosition();
+    origins[1] = camera2.GetPosition();
+    for (const FeatureCorrespondence& correspondence : match.correspondences)
+    {
+        directions[0] = camera1.PixelToUnitDepthRay(correspondence.feature1).normalized();
+        directions[1] = camera2.PixelToUnitDepthRay(correspondence.feature2).normalized();
+        Eigen::Vector4d point;
+        if (!SufficientTriangulationAngle(directions,
+                                          options_.min_triangulation_angle_degrees) ||
+                !TriangulateMidpoint(origins, directions, &point))
+        {
+            continue;
+        }
+        Eigen::Vector2d pixel;
+        if (camera1.ProjectPoint(point, &pixel) <= 0.0 ||
+                camera2.ProjectPoint(point, &pixel) <= 0.0)
+        {
+            continue;
+        }
+
+        std::vector<std::pair<ViewId, Feature> > observations;
+        observations.emplace_back(view_id1, correspondence.feature1);
+        observations.emplace_back(view_id2, correspondence.feature2);
+        const TrackId track_id = reconstruction_.AddTrack(observations);
+        if (track_id == kInvalidTrackId)
+        {
+            continue;
+        }
+        Track* track = reconstruction_.MutableTrack(track_id);
+        *track->MutablePoint() = point;
+        track->SetEstimated(true);
+        tracks_of_view_[view_id1].emplace_back(track_id);
+        tracks_of_view_[view_id2].emplace_back(track_id);
+    }
+}
+
+void OnlineHandEyeCalibrator::SlideWindow()
+{
+    if (window_.size() <= options_.window_size)
+    {
+        return;
+    }
+    while (window_.size() > options_.window_size)
+    {
+        const ViewId view_id = window_.front();
+        window_.pop_front();
+        for (const TrackId track_id : tracks_of_view_[view_id])
+        {
+            reconstruction_.RemoveTrack(track_id);
+        }
+        tracks_of_view_.erase(view_id);
+        reconstruction_.RemoveView(view_id);
+    }
+    // Also forgets the images whose features could not be extracted.
+    front_end_.RemoveImagesBefore(window_.front());
+    pending_pairs_.erase(
+        std::remove_if(pending_pairs_.begin(), pending_pairs_.end(),
+                       [this](const PendingPair& pending_pair)
+    {
+        return pending_pair.view_id1 < window_.front();
+    }), pending_pairs_.end());
+    // The removed tracks were shared with views that are still in the window.
+    for (const ViewId view_id : window_)
+    {
+        std::vector<TrackId>& tracks = tracks_of_view_[view_id];
+        tracks.erase(std::remove_if(tracks.begin(), tracks.end(),
+                                    [this](const TrackId track_id)
+        {
+            return reconstruction_.Track(track_id) == nullptr;
+        }), tracks.end());
+    }
+}
+
+bool OnlineHandEyeCalibrator::BundleAdjustWindow(OnlineHandEyeUpdate* update)
+{
+    std::unordered_set<ViewId> view_ids;
+    std::unordered_set<TrackId> track_ids;
+    for (const ViewId view_id : window_)
+    {
+        view_ids.insert(view_id);
+        const std::vector<TrackId>& tracks = tracks_of_view_[view_id];
+        track_ids.insert(tracks.begin(), tracks.end());
+    }
+    if (track_ids.empty())
+    {
+        return false;
+    }
+
+    const BundleAdjustmentSummary summary = BundleAdjustPartialHandEye(
+            options_.bundle_adjustment_options, view_ids, track_ids,
+            &reconstruction_, &handposes_, &handeyetrans_);
+    if (!summary.success)
+    {
+        LOG(WARNING) << "Sliding window bundle adjustment failed.";
+        return false;
+    }
+    update->bundle_adjustment_cost = summary.final_cost;
+    SetWindowCameraPoses();
+    return true;
+}
+
+void OnlineHandEyeCalibrator::SetWindowCameraPoses()
+{
+    for (const ViewId view_id : window_)
+    {
+        SetCameraPoseFromHandPose(reconstruction_.MutableView(view_id),
+                                  handposes_[view_id], &handeyetrans_);
+    }
+}
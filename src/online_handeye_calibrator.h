@@ -0,0 +1,132 @@
+#ifndef ONLINE_HANDEYE_CALIBRATOR_H
+#define ONLINE_HANDEYE_CALIBRATOR_H
+
+#include <Eigen/Core>
+#include <theia/theia.h>
+#include <deque>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "axxb/axxbincrementalsolver.h"
+#include "handeye_feature_frontend.h"
+#include "handeyetransformation.h"
+#include "type.h"
+
+using namespace theia;
+
+struct OnlineHandEyeCalibratorOptions
+{
+    HandEyeFeatureFrontEndOptions front_end_options;
+    // Every new image is matched against this many previous images, which
+    // are also the views of the sliding window bundle adjustment.
+    int window_size = 8;
+    // See AXXBIncrementalSolver, below 1 to track a drifting hand-eye
+    // transformation.
+    double forgetting_factor = 1.0;
+    // Once X is estimated, a new motion pair is only added to the solver if
+    // its AXXBEstimator error for the current X is below this, as in
+    // CountHandEyeInliers.
+    double max_motion_pair_error = 0.01;
+
+    // Refine the linear estimate of X by hand-eye bundle adjustment of the
+    // window after every frame. Bound its cost with max_solver_time_in_seconds.
+    bool bundle_adjust = true;
+    BundleAdjustmentOptions bundle_adjustment_options;
+    double min_triangulation_angle_degrees = 2.0;
+};
+
+// Published after every frame.
+struct OnlineHandEyeUpdate
+{
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+    int frame_index = -1;
+    bool has_estimate = false;
+    Pose handeye;
+    // Pairs of the new image with the window that passed verification.
+    int num_verified_pairs = 0;
+    int num_motion_pairs = 0;
+    // Verified pairs of this frame whose motion disagreed with X.
+    int num_rejected_motion_pairs = 0;
+    int num_window_tracks = 0;
+    bool bundle_adjusted = false;
+    double bundle_adjustment_cost = 0.0;
+};
+
+// Online hand-eye calibration from a stream of (image, hand pose) frames.
+// Each new image is matched against a window of recent images; the verified
+// pairs add motion pairs to an incremental AX=XB solver and 2-view tracks to a
+// reconstruction that only holds the window, which is refined by
+// BundleAdjustPartialHandEye. Time per frame is bounded by the window size,
+// and so is memory but for the hand pose of every frame, which the views are
+// indexed into.
+class OnlineHandEyeCalibrator
+{
+public:
+    typedef std::function<void(const OnlineHandEyeUpdate&)> UpdateCallback;
+
+    // All frames come from one camera with these intrinsics.
+    OnlineHandEyeCalibrator(const OnlineHandEyeCalibratorOptions& options,
+                            const CameraIntrinsicsPrior& intrinsics);
+
+    // Called with the new estimate at the end of every AddFrame.
+    void SetUpdateCallback(const UpdateCallback& callback);
+    // Prior hand-eye transformation, used for guided matching and as the
+    // estimate until the motion pairs determine X.
+    void SetInitialHandEye(const Pose& handeye);
+
+    // Returns false if no features could be extracted from the image.
+    bool AddFrame(const std::string& image_filepath, const Pose& handpose);
+
+    bool HasEstimate() const
+    {
+        return has_estimate_;
+    }
+    Pose HandEye() const
+    {
+        return handeyetrans_.GetHandEyePose();
+    }
+    // Holds the views and tracks of the current window.
+    const Reconstruction& GetReconstruction() const
+    {
+        return reconstruction_;
+    }
+
+private:
+    void MatchWithWindow(const int image_index,
+                         std::vector<ImagePairMatch>* matches,
+                         std::vector<int>* window_image_indices);
+    void AddTracks(const ViewId view_id1, const ViewId view_id2,
+                   const ImagePairMatch& match);
+    void SlideWindow();
+    bool BundleAdjustWindow(OnlineHandEyeUpdate* update);
+    void SetWindowCameraPoses();
+
+    const OnlineHandEyeCalibratorOptions options_;
+    const CameraIntrinsicsPrior intrinsics_;
+    HandEyeFeatureFrontEnd front_end_;
+    AXXBIncrementalSolver axxb_solver_;
+
+    // View ids, front end image indices and indices of handposes_ coincide.
+    Reconstruction reconstruction_;
+    Poses handposes_;
+    HandEyeTransformation handeyetrans_;
+    bool has_estimate_;
+
+    // A verified pair of the window from before X was estimated, whose tracks
+    // are added once it is.
+    struct PendingPair
+    {
+        ViewId view_id1;
+        ViewId view_id2;
+        ImagePairMatch match;
+    };
+    std::vector<PendingPair> pending_pairs_;
+
+    std::deque<ViewId> window_;
+    std::unordered_map<ViewId, std::vector<TrackId> > tracks_of_view_;
+    UpdateCallback callback_;
+};
+
+#endif // ONLINE_HANDEYE_CALIBRATOR_H
@@ -0,0 +1,284 @@
+#include "rotation_prior_verification.h"
+
+#include <ceres/ceres.h>
+#include <ceres/rotation.h>
+#include <glog/logging.h>
+#include <Eigen/Eigenvalues>
+#include <memory>
+
+namespace
+{
+
+// Our "data": the normalized image rays of a match.
+struct RayPair
+{
+    Eigen::Vector3d ray1;
+    Eigen::Vector3d ray2;
+    RayPair() {}
+    RayPair(const Eigen::Vector3d& r1, const Eigen::Vector3d& r2)
+        : ray1(r1), ray2(r2) {}
+};
+
+// Squared sampson error of a normalized match for E = [t]x*R.
+double SquaredSampsonError(const RayPair& rays,
+                           const Eigen::Matrix3d& rotation,
+                           const Eigen::Vector3d& t)
+{
+    // E*x1 = t x (R*x1), E'*x2 = R'*(x2 x t)
+    const Eigen::Vector3d ex1 = t.cross(rotation*rays.ray1);
+    const Eigen::Vector3d etx2 = rotation.transpose()*rays.ray2.cross(t);
+    const double numerator = rays.ray2.dot(ex1);
+    const double denominator = ex1.head<2>().squaredNorm() +
+                               etx2.head<2>().squaredNorm();
+    return numerator*numerator/denominator;
+}
+
+// Estimator class for the translation direction under a known rotation.
+class KnownRotationTranslationEstimator
+    : public Estimator<RayPair, Eigen::Vector3d>
+{
+public:
+    explicit KnownRotationTranslationEstimator(const Eigen::Matrix3d& rotation)
+        : rotation_(rotation) {}
+
+    double SampleSize() const
+    {
+        return 2;
+    }
+
+    bool EstimateModel(const std::vector<RayPair>& data,
+                       std::vector<Eigen::Vector3d>* models) const
+    {
+        // t is orthogonal to the epipolar plane normal of every match.
+        const Eigen::Vector3d n1 = (rotation_*data[0].ray1).cross(data[0].ray2);
+        const Eigen::Vector3d n2 = (rotation_*data[1].ray1).cross(data[1].ray2);
+        const Eigen::Vector3d t = n1.cross(n2);
+        if (t.squaredNorm() < 1e-20)
+        {
+            return false;
+        }
+        models->emplace_back(t.normalized());
+        return true;
+    }
+
+    double Error(const RayPair& rays, const Eigen::Vector3d& t) const
+    {
+        return SquaredSampsonError(rays, rotation_, t);
+    }
+
+private:
+    const Eigen::Matrix3d rotation_;
+};
+
+// Sampson error of a normalized match, parameterized by the relative rotation
+// as angle-axis and the translation direction.
+struct SampsonEpipolarError
+{
+    SampsonEpipolarError(const Eigen::Vector3d& ray1, const Eigen::Vector3d& ray2)
+        : ray1_(ray1), ray2_(ray2) {}
+
+    template<typename T> bool operator()(const T* rotation,
+                                         const T* translation,
+                                         T* residual) const
+    {
+        const T x1[3] = { T(ray1_(0)), T(ray1_(1)), T(ray1_(2)) };
+        const T x2[3] = { T(ray2_(0)), T(ray2_(1)), T(ray2_(2)) };
+        T rotated_x1[3];
+        ceres::AngleAxisRotatePoint(rotation, x1, rotated_x1);
+        T ex1[3];
+        ceres::CrossProduct(translation, rotated_x1, ex1);
+        // E'*x2 = R'*(x2 x t)
+        T x2_cross_t[3];
+        ceres::CrossProduct(x2, translation, x2_cross_t);
+        const T inverse_rotation[3] = { -rotation[0], -rotation[1], -rotation[2] };
+        T etx2[3];
+        ceres::AngleAxisRotatePoint(inverse_rotation, x2_cross_t, etx2);
+
+        const T numerator = ceres::DotProduct(x2, ex1);
+        const T denominator = ex1[0]*ex1[0] + ex1[1]*ex1[1] +
+                              etx2[0]*etx2[0] + etx2[1]*etx2[1];
+        residual[0] = numerator/ceres::sqrt(denominator);
+        return true;
+    }
+
+    static ceres::CostFunction* Create(const Eigen::Vector3d& ray1,
+                                       const Eigen::Vector3d& ray2)
+    {
+        return new ceres::AutoDiffCostFunction<SampsonEpipolarError, 1, 3, 3>(
+                   new SampsonEpipolarError(ray1, ray2));
+    }
+
+private:
+    const Eigen::Vector3d ray1_;
+    const Eigen::Vector3d ray2_;
+};
+
+// Number of matches triangulated in front of both cameras for x2 = R*x1+t.
+int NumPointsInFront(const std::vector<RayPair>& rays,
+                     const std::vector<int>& inliers,
+                     const Eigen::Matrix3d& rotation,
+                     const Eigen::Vector3d& t)
+{
+    int num_in_front = 0;
+    for (const int i : inliers)
+    {
+        // d2*x2 = d1*R*x1+t, solved in the least squares sense.
+        Eigen::Matrix<double, 3, 2> system;
+        system.col(0) = rotation*rays[i].ray1;
+        system.col(1) = -rays[i].ray2;
+        const Eigen::Vector2d depths =
+            system.colPivHouseholderQr().solve(-t);
+        if (depths(0) > 0.0 && depths(1) > 0.0)
+        {
+            ++num_in_front;
+        }
+    }
+    return num_in_front;
+}
+
+}  // namespace
+
+bool VerifyMatchesWithRotationPrior(
+    const RotationPriorVerificationOptions& options,
+    const CameraIntrinsicsPrior& intrinsics1,
+    const CameraIntrinsicsPrior& intrinsics2,
+    const std::vector<FeatureCorrespondence>& correspondences,
+    const Eigen::Matrix3d& rotation,
+    std::vector<FeatureCorrespondence>* verified_matches,
+    TwoViewInfo* twoview_info)
+{
+    if (correspondences.size() < options.min_num_inlier_matches)
+    {
+        return false;
+    }
+
+    // The cameras are at the origin, so their rays are in camera coordinates
+    // and at unit depth. PixelToUnitDepthRay also removes radial distortion.
+    Camera camera1, camera2;
+    camera1.SetFromCameraIntrinsicsPriors(intrinsics1);
+    camera2.SetFromCameraIntrinsicsPriors(intrinsics2);
+    std::vector<RayPair> rays;
+    rays.reserve(correspondences.size());
+    for (const FeatureCorrespondence& correspondence : correspondences)
+    {
+        rays.emplace_back(camera1.PixelToUnitDepthRay(correspondence.feature1),
+                          camera2.PixelToUnitDepthRay(correspondence.feature2));
+    }
+
+    // The sampson error is squared and in normalized units.
+    const double error_thresh =
+        options.max_sampson_error_pixels*options.max_sampson_error_pixels/
+        (camera1.FocalLength()*camera2.FocalLength());
+
+    KnownRotationTranslationEstimator translation_estimator(rotation);
+    RansacParameters params;
+    params.error_thresh = error_thresh;
+    params.failure_probability = 0.001;
+    params.max_iterations = 1000;
+    params.min_iterations = 10;
+    params.use_mle = true;
+    Ransac<KnownRotationTranslationEstimator> ransac_estimator(
+        params, translation_estimator);
+    // Initialize must always be called!
+    ransac_estimator.Initialize();
+    RansacSummary ransac_summary;
+    Eigen::Vector3d translation;
+    if (!ransac_estimator.Estimate(rays, &translation, &ransac_summary) ||
+            ransac_summary.inliers.size() < options.min_num_inlier_matches)
+    {
+        return false;
+    }
+    std::vector<int> inliers = ransac_summary.inliers;
+
+    Eigen::Matrix3d refined_rotation = rotation;
+    if (options.reestimate_relative_pose)
+    {
+        std::vector<FeatureCorrespondence> normalized_inliers;
+        normalized_inliers.reserve(inliers.size());
+        for (const int i : inliers)
+        {
+            normalized_inliers.emplace_back(Feature(rays[i].ray1.hnormalized()),
+                                            Feature(rays[i].ray2.hnormalized()));
+        }
+        RelativePose relative_pose;
+        RansacSummary relative_pose_summary;
+        if (!EstimateRelativePose(params, RansacType::RANSAC, normalized_inliers,
+                                  &relative_pose, &relative_pose_summary) ||
+                relative_pose_summary.inliers.size() <
+                options.min_num_inlier_matches)
+        {
+            return false;
+        }
+        std::vector<int> relative_pose_inliers;
+        relative_pose_inliers.reserve(relative_pose_summary.inliers.size());
+        for (const int j : relative_pose_summary.inliers)
+        {
+            relative_pose_inliers.emplace_back(inliers[j]);
+        }
+        inliers.swap(relative_pose_inliers);
+        // theia's x2 = R*(x1-c), so t = -R*c.
+        refined_rotation = relative_pose.rotation;
+        translation = -(relative_pose.rotation*relative_pose.position).normalized();
+    }
+    Eigen::Vector3d angle_axis;
+    ceres::RotationMatrixToAngleAxis(
+        ceres::ColumnMajorAdapter3x3(refined_rotation.data()), angle_axis.data());
+    if (options.refine_relative_pose)
+    {
+        ceres::Problem problem;
+        for (const int i : inliers)
+        {
+            problem.AddResidualBlock(
+                SampsonEpipolarError::Create(rays[i].ray1, rays[i].ray2), nullptr,
+                angle_axis.data(), translation.data());
+        }
+        problem.SetParameterization(translation.data(),
+                                    new ceres::HomogeneousVectorParameterization(3));
+        ceres::Solver::Options solver_options;
+        solver_options.linear_solver_type = ceres::DENSE_QR;
+        solver_options.max_num_iterations = 10;
+        solver_options.logging_type = ceres::SILENT;
+        ceres::Solver::Summary solver_summary;
+        ceres::Solve(solver_options, &problem, &solver_summary);
+        ceres::AngleAxisToRotationMatrix(
+            angle_axis.data(), ceres::ColumnMajorAdapter3x3(refined_rotation.data()));
+
+        // Re-evaluate the inliers with the refined relative pose.
+        inliers.clear();
+        for (int i = 0; i < rays.size(); i++)
+        {
+            if (SquaredSampsonError(rays[i], refined_rotation, translation) < error_thresh)
+            {
+                inliers.emplace_back(i);
+            }
+        }
+        if (inliers.size() < options.min_num_inlier_matches)
+        {
+            return false;
+        }
+    }
+
+    // t and -t satisfy the epipolar constraint equally, keep the one that
+    // puts the points in front of the cameras.
+    if (NumPointsInFront(rays, inliers, refined_rotation, -translation) >
+            NumPointsInFront(rays, inliers, refined_rotation, translation))
+    {
+        translation = -translation;
+    }
+
+    twoview_info->focal_length_1 = camera1.FocalLength();
+    twoview_info->focal_length_2 = camera2.FocalLength();
+    twoview_info->rotation_2 = angle_axis;
+    // the center of camera 2 in camera 1 is -R'*t.
+    twoview_info->position_2 = -(refined_rotation.transpose()*translation).normalized();
+    twoview_info->num_verified_matches = inliers.size();
+    twoview_info->visibility_score = inliers.size();
+
+    verified_matches->clear();
+    verified_matches->reserve(inliers.size());
+    for (const int i : inliers)
+    {
+        verified_matches->emplace_back(correspondences[i]);
+    }
+    return true;
+}
@@ -0,0 +1,45 @@
+#ifndef ROTATION_PRIOR_VERIFICATION_H
+#define ROTATION_PRIOR_VERIFICATION_H
+
+#include <Eigen/Core>
+#include <theia/theia.h>
+#include <vector>
+
+using namespace theia;
+
+struct RotationPriorVerificationOptions
+{
+    // Maximum sampson error for a match to be considered an inlier.
+    double max_sampson_error_pixels = 4.0;
+    int min_num_inlier_matches = 30;
+    // Re-estimate the relative pose from the inliers with the 5-point method,
+    // so the rotation does not come from the prior. The pair's motion feeds
+    // AX=XB, which would otherwise get back the X it was verified with.
+    bool reestimate_relative_pose = true;
+    // Refine the rotation and translation direction on the inliers by
+    // minimizing the sampson error. Without it or the re-estimation the
+    // relative rotation is the prior itself.
+    bool refine_relative_pose = true;
+};
+
+// Geometric verification of a calibrated image pair whose relative rotation R
+// (x2 = R*x1+t in camera coordinates) is approximately known, e.g. from the
+// hand poses and a hand-eye prior. With R fixed every correspondence gives a
+// linear constraint t.((R*x1) x x2) = 0, so RANSAC only samples 2 matches
+// and no two-view bundle adjustment is run.
+//
+// The prior only selects the inliers, see reestimate_relative_pose. On
+// success the inliers are returned in verified_matches and twoview_info
+// follows theia's convention, i.e. rotation_2 is R as angle-axis and
+// position_2 the unit direction of the second camera center in the first
+// camera frame.
+bool VerifyMatchesWithRotationPrior(
+    const RotationPriorVerificationOptions& options,
+    const CameraIntrinsicsPrior& intrinsics1,
+    const CameraIntrinsicsPrior& intrinsics2,
+    const std::vector<FeatureCorrespondence>& correspondences,
+    const Eigen::Matrix3d& rotation,
+    std::vector<FeatureCorrespondence>* verified_matches,
+    TwoViewInfo* twoview_info);
+
+#endif // ROTATION_PRIOR_VERIFICATION_H
@@ -0,0 +1,101 @@
+#include "scaled_jpeg_decoder.h"
+
+#include <setjmp.h>
+#include <stdio.h>
+#include <jpeglib.h>
+#include <glog/logging.h>
+
+namespace
+{
+
+// libjpeg reports fatal errors through error_exit, which must not return.
+struct JpegErrorManager
+{
+    jpeg_error_mgr manager;
+    jmp_buf jump_buffer;
+};
+
+void JpegErrorExit(j_common_ptr info)
+{
+    char message[JMSG_LENGTH_MAX];
+    (*info->err->format_message)(info, message);
+    VLOG(1) << "libjpeg: " << message;
+    longjmp(reinterpret_cast<JpegErrorManager*>(info->err)->jump_buffer, 1);
+}
+
+}  // namespace
+
+bool DecodeScaledJpeg(const std::string& image_filepath,
+                      const int scale_denominator,
+                      FloatImage* image)
+{
+    CHECK(scale_denominator == 1 || scale_denominator == 2 ||
+          scale_denominator == 4 || scale_denominator == 8)
+            << "JPEG images can only be decoded at 1/1, 1/2, 1/4 or 1/8 scale.";
+    FILE* file = fopen(image_filepath.c_str(), "rb");
+    if (file == nullptr)
+    {
+        return false;
+    }
+
+    // Declared before setjmp, so a longjmp does not skip their destructors.
+    FloatImage decoded;
+    std::vector<JSAMPLE> row;
+    jpeg_decompress_struct info;
+    JpegErrorManager error_manager;
+    info.err = jpeg_std_error(&error_manager.manager);
+    error_manager.manager.error_exit = JpegErrorExit;
+    if (setjmp(error_manager.jump_buffer))
+    {
+        jpeg_destroy_decompress(&info);
+        fclose(file);
+        return false;
+    }
+    jpeg_create_decompress(&info);
+    jpeg_stdio_src(&info, file);
+    jpeg_read_header(&info, TRUE);
+    info.scale_num = 1;
+    info.scale_denom = scale_denominator;
+    // The descriptor extractors work on grayscale images anyway.
+    info.out_color_space = JCS_GRAYSCALE;
+    info.dct_method = JDCT_ISLOW;
+    jpeg_start_decompress(&info);
+
+    decoded = FloatImage(info.output_width, info.output_height, 1);
+    row.resize(info.output_width*info.output_components);
+    JSAMPROW row_pointer = row.data();
+    while (info.output_scanline < info.output_height)
+    {
+        const int y = info.output_scanline;
+        jpeg_read_scanlines(&info, &row_pointer, 1);
+        for (int x = 0; x < info.output_width; x++)
+        {
+            decoded.SetXY(x, y, 0, row[x]/255.0f);
+        }
+    }
+    jpeg_finish_decompress(&info);
+    jpeg_destroy_decompress(&info);
+    fclose(file);
+
+    *image = decoded;
+    return true;
+}
+
+void ScaleKeypointsToFullResolution(const int scale_denominator,
+                                    std::vector<Keypoint>* keypoints)
+{
+    if (scale_denominator == 1)
+    {
+        return;
+    }
+    const double scale = scale_denominator;
+    for (Keypoint& keypoint : *keypoints)
+    {
+        keypoint.set_x((keypoint.x() + 0.5)*scale - 0.5);
+        keypoint.set_y((keypoint.y() + 0.5)*scale - 0.5);
+        if (keypoint.has_scale())
+        {
+            keypoint.set_scale(keypoint.scale()*scale);
+        }
+    }
+}
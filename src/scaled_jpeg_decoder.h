@@ -0,0 +1,23 @@
+#ifndef SCALED_JPEG_DECODER_H
+#define SCALED_JPEG_DECODER_H
+
+#include <theia/theia.h>
+#include <string>
+#include <vector>
+
+using namespace theia;
+
+// Decodes a JPEG to a grayscale image at 1/scale_denominator of its size
+// (1, 2, 4 or 8) with libjpeg's DCT scaling, so the discarded resolution is
+// never decoded. Returns false if the file is not a readable JPEG.
+bool DecodeScaledJpeg(const std::string& image_filepath,
+                      const int scale_denominator,
+                      FloatImage* image);
+
+// Maps keypoints detected in an image decoded at 1/scale_denominator back to
+// full resolution pixel coordinates. Pixel i of the scaled image covers the
+// full resolution pixels [i*s, (i+1)*s), so its center is at (i+0.5)*s-0.5.
+void ScaleKeypointsToFullResolution(const int scale_denominator,
+                                    std::vector<Keypoint>* keypoints);
+
+#endif // SCALED_JPEG_DECODER_H
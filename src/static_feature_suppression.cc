@@ -0,0 +1,168 @@
+#include "static_feature_suppression.h"
+
+#include <stdint.h>
+#include <glog/logging.h>
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+#include <utility>
+
+namespace
+{
+
+// Keypoints of all images hashed by grid cell.
+class KeypointCellIndex
+{
+public:
+    explicit KeypointCellIndex(const double cell_size) : cell_size_(cell_size) {}
+
+    void Add(const double x, const double y, const int image_index,
+             const int feature_index)
+    {
+        cells_[Key(Cell(x), Cell(y))].emplace_back(image_index, feature_index);
+    }
+
+    // The cell of the point and its 8 neighbours cover every point within
+    // cell_size.
+    template<typename Function>
+    void ForEachNear(const double x, const double y, Function function) const
+    {
+        const int cell_x = Cell(x);
+        const int cell_y = Cell(y);
+        for (int dy = -1; dy <= 1; dy++)
+        {
+            for (int dx = -1; dx <= 1; dx++)
+            {
+                const auto cell = cells_.find(Key(cell_x + dx, cell_y + dy));
+                if (cell == cells_.end())
+                {
+                    continue;
+                }
+                for (const std::pair<int, int>& entry : cell->second)
+                {
+                    function(entry.first, entry.second);
+                }
+            }
+        }
+    }
+
+private:
+    int Cell(const double coordinate) const
+    {
+        return static_cast<int>(std::floor(coordinate/cell_size_));
+    }
+    static int64_t Key(const int cell_x, const int cell_y)
+    {
+        return (static_cast<int64_t>(cell_x) << 32) ^
+               static_cast<uint32_t>(cell_y);
+    }
+
+    const double cell_size_;
+    std::unordered_map<int64_t, std::vector<std::pair<int, int> > > cells_;
+};
+
+}  // namespace
+
+std::vector<std::vector<char> > FindStaticFeatures(
+    const StaticFeatureSuppressionOptions& options,
+    const std::vector<const KeypointsAndDescriptors*>& features)
+{
+    std::vector<std::vector<char> > is_static(features.size());
+    for (int i = 0; i < features.size(); i++)
+    {
+        is_static[i].assign(features[i]->keypoints.size(), false);
+    }
+    if (features.size() < 3)
+    {
+        return is_static;
+    }
+
+    KeypointCellIndex index(options.max_pixel_distance);
+    for (int i = 0; i < features.size(); i++)
+    {
+        for (int j = 0; j < features[i]->keypoints.size(); j++)
+        {
+            index.Add(features[i]->keypoints[j].x(), features[i]->keypoints[j].y(),
+                      i, j);
+        }
+    }
+
+    const int min_num_views =
+        std::max(2, static_cast<int>(std::ceil(options.min_view_fraction*
+                                     features.size())));
+    const double max_squared_pixel_distance =
+        options.max_pixel_distance*options.max_pixel_distance;
+    const double max_squared_descriptor_distance =
+        options.max_descriptor_distance*options.max_descriptor_distance;
+    // Marks the images already counted for the current feature.
+    std::vector<int> last_counted_for(features.size(), -1);
+    int query = 0;
+    for (int i = 0; i < features.size(); i++)
+    {
+        for (int j = 0; j < features[i]->keypoints.size(); j++, query++)
+        {
+            const Keypoint& keypoint = features[i]->keypoints[j];
+            const Eigen::VectorXf& descriptor = features[i]->descriptors[j];
+            last_counted_for[i] = query;
+            int num_views = 1;
+            index.ForEachNear(
+                keypoint.x(), keypoint.y(),
+                [&](const int other_image, const int other_feature)
+            {
+                if (last_counted_for[other_image] == query)
+                {
+                    return;
+                }
+                const Keypoint& other = features[other_image]->keypoints[other_feature];
+                const double dx = other.x() - keypoint.x();
+                const double dy = other.y() - keypoint.y();
+                if (dx*dx + dy*dy > max_squared_pixel_distance ||
+                        (features[other_image]->descriptors[other_feature] -
+                         descriptor).squaredNorm() > max_squared_descriptor_distance)
+                {
+                    return;
+                }
+                last_counted_for[other_image] = query;
+                ++num_views;
+            });
+            is_static[i][j] = num_views >= min_num_views;
+        }
+    }
+    return is_static;
+}
+
+bool StaticFeatureMask::Read(const std::string& mask_filepath)
+{
+    mask_ = FloatImage(mask_filepath);
+    return mask_.Width() > 0 && mask_.Height() > 0;
+}
+
+bool StaticFeatureMask::IsMasked(const double x, const double y) const
+{
+    const int column = static_cast<int>(std::floor(x + 0.5));
+    const int row = static_cast<int>(std::floor(y + 0.5));
+    if (column < 0 || row < 0 || column >= mask_.Width() || row >= mask_.Height())
+    {
+        return false;
+    }
+    return mask_.GetXY(column, row, 0) == 0.0f;
+}
+
+void RemoveFeatures(const std::vector<char>& remove,
+                    KeypointsAndDescriptors* features)
+{
+    CHECK_EQ(remove.size(), features->keypoints.size());
+    int num_kept = 0;
+    for (int i = 0; i < remove.size(); i++)
+    {
+        if (remove[i])
+        {
+            continue;
+        }
+        features->keypoints[num_kept] = features->keypoints[i];
+        features->descriptors[num_kept] = features->descriptors[i];
+        ++num_kept;
+    }
+    features->keypoints.resize(num_kept);
+    features->descriptors.resize(num_kept);
+}
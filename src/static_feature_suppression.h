@@ -0,0 +1,46 @@
+#ifndef STATIC_FEATURE_SUPPRESSION_H
+#define STATIC_FEATURE_SUPPRESSION_H
+
+#include <theia/theia.h>
+#include <string>
+#include <vector>
+
+using namespace theia;
+
+struct StaticFeatureSuppressionOptions
+{
+    // A feature is static if a feature with a similar descriptor is found at
+    // about the same pixel in at least this fraction of the images.
+    double min_view_fraction = 0.6;
+    double max_pixel_distance = 2.0;
+    // L2 distance of the (unit norm) descriptors.
+    double max_descriptor_distance = 0.5;
+};
+
+// In an eye-in-hand setup the gripper and dirt on the lens stay at the same
+// pixels in every image. Their features match trivially but are not
+// consistent with the scene, so they are removed before matching.
+//
+// Returns for every image which of its features are static. Needs the
+// features of all images, at least 3 of them.
+std::vector<std::vector<char> > FindStaticFeatures(
+    const StaticFeatureSuppressionOptions& options,
+    const std::vector<const KeypointsAndDescriptors*>& features);
+
+// Binary image that is zero where features must be dropped, in the
+// resolution of the images.
+class StaticFeatureMask
+{
+public:
+    bool Read(const std::string& mask_filepath);
+    bool IsMasked(const double x, const double y) const;
+
+private:
+    FloatImage mask_;
+};
+
+// Removes the features whose flag is set.
+void RemoveFeatures(const std::vector<char>& remove,
+                    KeypointsAndDescriptors* features);
+
+#endif // STATIC_FEATURE_SUPPRESSION_H
@@ -0,0 +1,289 @@
+#include "synthetic_scene.h"
+
+#include <ceres/rotation.h>
+#include <glog/logging.h>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <map>
+#include <random>
+#include <string>
+#include <utility>
+
+#include "handeyecalibration_utils.h"
+#include "handeyetransformation.h"
+
+namespace
+{
+
+const double kDegToRad = M_PI/180.0;
+
+// Camera to world pose of a camera at distance from the origin, in a random
+// direction within max_angle of the z axis, looking at the origin with a
+// random roll.
+Pose RandomCameraPose(const double distance, const double max_angle,
+                      std::mt19937* random)
+{
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    // Uniform on the spherical cap.
+    const double cos_angle = 1.0 - uniform(*random)*(1.0 - std::cos(max_angle));
+    const double sin_angle = std::sqrt(1.0 - cos_angle*cos_angle);
+    const double azimuth = 2.0*M_PI*uniform(*random);
+    const Eigen::Vector3d direction(sin_angle*std::cos(azimuth),
+                                    sin_angle*std::sin(azimuth), cos_angle);
+
+    const Eigen::Vector3d z_axis = -direction;
+    Eigen::Vector3d x_axis = z_axis.unitOrthogonal();
+    x_axis = Eigen::AngleAxisd(2.0*M_PI*uniform(*random), z_axis)*x_axis;
+    Eigen::Matrix3d rotation;
+    rotation.col(0) = x_axis;
+    rotation.col(1) = z_axis.cross(x_axis);
+    rotation.col(2) = z_axis;
+    return Pose(rotation, distance*direction);
+}
+
+// Bound on the distance along x between a visible point and the point its
+// view looks at. A camera is at most camera_distance from its target, and a
+// ray in the image is within the viewing angle plus half the diagonal field
+// of view from the -z axis, so it leaves the slab of the points within
+// (camera height + scene_size/2)*tan(that angle) along x. Infinite if the
+// rays can be horizontal.
+double MaxViewingReach(const SyntheticSceneOptions& options)
+{
+    const double half_diagonal =
+        0.5*std::hypot(options.image_width, options.image_height);
+    const double max_ray_angle = options.max_viewing_angle_degrees*kDegToRad +
+                                 std::atan(half_diagonal/options.focal_length);
+    if (max_ray_angle >= 0.5*M_PI)
+    {
+        return std::numeric_limits<double>::infinity();
+    }
+    return options.camera_distance*
+           std::sin(options.max_viewing_angle_degrees*kDegToRad) +
+           (options.camera_distance + 0.5*options.scene_size)*
+           std::tan(max_ray_angle);
+}
+
+typedef std::pair<ViewId, ViewId> ViewIdPair;
+
+Eigen::Matrix3d RandomRotation(const double angle, std::mt19937* random)
+{
+    std::normal_distribution<double> normal(0.0, 1.0);
+    const Eigen::Vector3d axis(normal(*random), normal(*random), normal(*random));
+    return Eigen::AngleAxisd(angle, axis.normalized()).toRotationMatrix();
+}
+
+// The two-view geometry of the pair of cameras, in the convention of Theia:
+// x2 = R*x1 + t with rotation_2 the angle-axis of R and position_2 the unit
+// direction of the second camera center seen from the first camera.
+TwoViewInfo TrueTwoViewInfo(const Camera& camera1, const Camera& camera2)
+{
+    const Eigen::Matrix3d rotation1 = camera1.GetOrientationAsRotationMatrix();
+    const Eigen::Matrix3d rotation2 = camera2.GetOrientationAsRotationMatrix();
+    const Eigen::AngleAxisd relative_rotation(rotation2*rotation1.transpose());
+
+    TwoViewInfo info;
+    info.focal_length_1 = camera1.FocalLength();
+    info.focal_length_2 = camera2.FocalLength();
+    info.rotation_2 = relative_rotation.angle()*relative_rotation.axis();
+    info.position_2 =
+        (rotation1*(camera2.GetPosition() - camera1.GetPosition())).normalized();
+    return info;
+}
+
+// Perturbs the relative rotation by Gaussian noise, or replaces the whole
+// relative pose by a random one for an outlier pair.
+void PerturbTwoViewInfo(const SyntheticMatchesOptions& options,
+                        const bool outlier, std::mt19937* random,
+                        TwoViewInfo* info)
+{
+    std::normal_distribution<double> normal(0.0, 1.0);
+    if (outlier)
+    {
+        std::uniform_real_distribution<double> angle(0.0, M_PI);
+        const Eigen::AngleAxisd rotation(RandomRotation(angle(*random), random));
+        info->rotation_2 = rotation.angle()*rotation.axis();
+        info->position_2 =
+            Eigen::Vector3d(normal(*random), normal(*random), normal(*random))
+            .normalized();
+        return;
+    }
+    if (options.relative_rotation_noise_degrees <= 0.0)
+    {
+        return;
+    }
+    const Eigen::Vector3d noise =
+        options.relative_rotation_noise_degrees*kDegToRad*
+        Eigen::Vector3d(normal(*random), normal(*random), normal(*random));
+    Eigen::Matrix3d rotation;
+    ceres::AngleAxisToRotationMatrix(info->rotation_2.data(), rotation.data());
+    const Eigen::AngleAxisd noisy_rotation(
+        Eigen::AngleAxisd(noise.norm(), noise.normalized())*rotation);
+    info->rotation_2 = noisy_rotation.angle()*noisy_rotation.axis();
+}
+
+}  // namespace
+
+void GenerateSyntheticScene(const SyntheticSceneOptions& options,
+                            SyntheticScene* scene,
+                            Reconstruction* reconstruction)
+{
+    CHECK_EQ(reconstruction->NumViews(), 0)
+            << "The synthetic scene needs an empty reconstruction.";
+    std::mt19937 random(options.seed);
+
+    CameraIntrinsicsPrior intrinsics;
+    intrinsics.image_width = options.image_width;
+    intrinsics.image_height = options.image_height;
+    intrinsics.focal_length.is_set = true;
+    intrinsics.focal_length.value[0] = options.focal_length;
+    intrinsics.principal_point.is_set = true;
+    intrinsics.principal_point.value[0] = 0.5*options.image_width;
+    intrinsics.principal_point.value[1] = 0.5*options.image_height;
+    intrinsics.aspect_ratio.is_set = true;
+    intrinsics.aspect_ratio.value[0] = 1.0;
+    intrinsics.skew.is_set = true;
+    intrinsics.skew.value[0] = 0.0;
+    intrinsics.radial_distortion.is_set = true;
+    intrinsics.radial_distortion.value[0] = 0.0;
+    intrinsics.radial_distortion.value[1] = 0.0;
+
+    // The camera pose is hand pose*X^-1, so the hand pose is camera pose*X.
+    scene->handeye = options.handeye;
+    scene->handposes.clear();
+    scene->points.clear();
+    // x of the point view i looks at.
+    const double view_spacing = options.num_views > 1 ?
+                                options.path_length/(options.num_views - 1) : 0.0;
+    for (int i = 0; i < options.num_views; i++)
+    {
+        const Pose camera_pose =
+            Pose(Eigen::Matrix3d::Identity(),
+                 Eigen::Vector3d(i*view_spacing, 0.0, 0.0))*
+            RandomCameraPose(options.camera_distance,
+                             options.max_viewing_angle_degrees*kDegToRad, &random);
+        scene->handposes.emplace_back(camera_pose*options.handeye);
+
+        const ViewId view_id = reconstruction->AddView(std::to_string(i), 0);
+        CHECK_EQ(view_id, i);
+        View* view = reconstruction->MutableView(view_id);
+        *view->MutableCameraIntrinsicsPrior() = intrinsics;
+        view->MutableCamera()->SetFromCameraIntrinsicsPriors(intrinsics);
+        view->SetEstimated(true);
+    }
+    HandEyeTransformation handeyetrans;
+    handeyetrans.SetHandEyePose(options.handeye);
+    SetCameraPosesFromHandPoses(scene->handposes, &handeyetrans, reconstruction);
+
+    std::uniform_real_distribution<double> x_coordinate(
+        -0.5*options.scene_size, options.path_length + 0.5*options.scene_size);
+    std::uniform_real_distribution<double> coordinate(-0.5*options.scene_size,
+            0.5*options.scene_size);
+    std::normal_distribution<double> noise(0.0, options.pixel_noise);
+    // Only the views whose target is within reach of a point can see it, which
+    // keeps long paths linear in the number of points.
+    const double reach = MaxViewingReach(options);
+    std::vector<std::pair<ViewId, Feature> > observations;
+    for (int p = 0; p < options.num_points; p++)
+    {
+        const Eigen::Vector3d point(x_coordinate(random), coordinate(random),
+                                    coordinate(random));
+        int first_view = 0;
+        int last_view = options.num_views - 1;
+        if (view_spacing > 0.0 && std::isfinite(reach))
+        {
+            first_view = std::max(first_view, static_cast<int>(
+                                      std::ceil((point.x() - reach)/view_spacing)));
+            last_view = std::min(last_view, static_cast<int>(
+                                     std::floor((point.x() + reach)/view_spacing)));
+        }
+        observations.clear();
+        for (int i = first_view; i <= last_view; i++)
+        {
+            Eigen::Vector2d pixel;
+            const double depth =
+                reconstruction->View(i)->Camera().ProjectPoint(point.homogeneous(),
+                        &pixel);
+            if (depth <= 0.0 || pixel.x() < 0.0 || pixel.y() < 0.0 ||
+                    pixel.x() >= options.image_width ||
+                    pixel.y() >= options.image_height)
+            {
+                continue;
+            }
+            observations.emplace_back(i, Feature(pixel.x() + noise(random),
+                                                 pixel.y() + noise(random)));
+        }
+        if (observations.size() < 2)
+        {
+            continue;
+        }
+        const TrackId track_id = reconstruction->AddTrack(observations);
+        CHECK_EQ(track_id, scene->points.size());
+        Track* track = reconstruction->MutableTrack(track_id);
+        *track->MutablePoint() = point.homogeneous();
+        track->SetEstimated(true);
+        scene->points.emplace_back(point);
+    }
+}
+
+std::vector<ImagePairMatch> GenerateSyntheticMatches(
+    const SyntheticMatchesOptions& options,
+    const Reconstruction& reconstruction)
+{
+    std::map<ViewIdPair, std::vector<FeatureCorrespondence> > correspondences;
+    std::vector<ViewId> track_view_ids;
+    for (TrackId track_id = 0; track_id < reconstruction.NumTracks(); track_id++)
+    {
+        const Track* track = reconstruction.Track(track_id);
+        track_view_ids.assign(track->ViewIds().begin(), track->ViewIds().end());
+        std::sort(track_view_ids.begin(), track_view_ids.end());
+        for (int i = 0; i < track_view_ids.size(); i++)
+        {
+            for (int j = i + 1; j < track_view_ids.size(); j++)
+            {
+                if (options.max_view_distance > 0 &&
+                        track_view_ids[j] - track_view_ids[i] > options.max_view_distance)
+                {
+                    break;
+                }
+                correspondences[ViewIdPair(track_view_ids[i], track_view_ids[j])]
+                .emplace_back(*reconstruction.View(track_view_ids[i])->GetFeature(track_id),
+                              *reconstruction.View(track_view_ids[j])->GetFeature(track_id));
+            }
+        }
+    }
+
+    std::mt19937 random(options.seed);
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    std::vector<ImagePairMatch> matches;
+    for (auto& view_pair : correspondences)
+    {
+        if (view_pair.second.size() < options.min_num_matches)
+        {
+            continue;
+        }
+        const View* view1 = reconstruction.View(view_pair.first.first);
+        const View* view2 = reconstruction.View(view_pair.first.second);
+        const CameraIntrinsicsPrior& prior2 = view2->CameraIntrinsicsPrior();
+        ImagePairMatch match;
+        match.image1 = view1->Name();
+        match.image2 = view2->Name();
+        match.twoview_info = TrueTwoViewInfo(view1->Camera(), view2->Camera());
+        PerturbTwoViewInfo(options, uniform(random) < options.outlier_pair_ratio,
+                           &random, &match.twoview_info);
+        for (FeatureCorrespondence& correspondence : view_pair.second)
+        {
+            if (uniform(random) < options.outlier_ratio)
+            {
+                correspondence.feature2 =
+                    Feature(uniform(random)*prior2.image_width,
+                            uniform(random)*prior2.image_height);
+            }
+        }
+        match.twoview_info.num_verified_matches = view_pair.second.size();
+        match.twoview_info.visibility_score = view_pair.second.size();
+        match.correspondences.swap(view_pair.second);
+        matches.emplace_back(std::move(match));
+    }
+    return matches;
+}
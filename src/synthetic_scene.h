@@ -0,0 +1,94 @@
+#ifndef SYNTHETIC_SCENE_H
+#define SYNTHETIC_SCENE_H
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+#include <theia/theia.h>
+#include <vector>
+#include "type.h"
+using namespace theia;
+
+// A synthetic hand-eye capture: cameras on a spherical cap looking at a cube
+// of points, the hand poses that put them there through a known hand-eye
+// transformation, and the noisy projections of the points. Used by the
+// benchmarks and tools, where no images are needed.
+//
+// For large scenes the cap is swept along the x axis, so that every view only
+// sees a stretch of the points and the number of observations grows linearly
+// with the number of views instead of quadratically.
+struct SyntheticSceneOptions
+{
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+    int num_views = 20;
+    int num_points = 2000;
+    // Distance of the cameras to the center of the scene, and the edge of the
+    // cube the points are drawn from.
+    double camera_distance = 1.0;
+    double scene_size = 0.6;
+    // Maximal angle between a viewing direction and the z axis of the scene.
+    double max_viewing_angle_degrees = 35.0;
+    // Length of the stretch of the x axis the cameras look at, view i looks
+    // at i/(num_views-1)*path_length. The points fill the cube swept along it.
+    double path_length = 0.0;
+
+    int image_width = 1280;
+    int image_height = 960;
+    double focal_length = 1000.0;
+    // Standard deviation of the Gaussian noise added to the projections.
+    double pixel_noise = 0.5;
+
+    // Ground truth hand-eye transformation X, the camera pose is hand
+    // pose*X^-1.
+    Pose handeye = Pose(Eigen::Matrix3d(Eigen::AngleAxisd(
+                                            0.3, Eigen::Vector3d(1.0, -2.0, 0.5).normalized())),
+                        Eigen::Vector3d(0.05, -0.03, 0.12));
+    unsigned int seed = 0;
+};
+
+struct SyntheticScene
+{
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+    Pose handeye;
+    // Indexed by view id.
+    Poses handposes;
+    // Ground truth position of every track, indexed by track id.
+    std::vector<Eigen::Vector3d> points;
+};
+
+// Fills the empty reconstruction with one view per hand pose, named by its
+// index so that view ids index scene->handposes, posed and with the true
+// intrinsics, and one estimated track per point seen by at least two views,
+// at its true position and with noisy features.
+void GenerateSyntheticScene(const SyntheticSceneOptions& options,
+                            SyntheticScene* scene,
+                            Reconstruction* reconstruction);
+
+// How the tracks of a synthetic scene are turned into verified two-view
+// matches, as feature matching and geometric verification would give them.
+struct SyntheticMatchesOptions
+{
+    // Fraction of the matches whose second feature is replaced by a random
+    // one.
+    double outlier_ratio = 0.0;
+    // Standard deviation of the noise of the relative rotations about each
+    // axis, and fraction of the view pairs given a random relative pose.
+    double relative_rotation_noise_degrees = 0.0;
+    double outlier_pair_ratio = 0.0;
+    // Only views i and j with |i - j| <= max_view_distance are matched, all
+    // pairs sharing tracks if 0.
+    int max_view_distance = 0;
+    // Pairs sharing fewer tracks are dropped.
+    int min_num_matches = 30;
+    unsigned int seed = 1;
+};
+
+// The matches of every pair of views of the reconstruction, which must come
+// from GenerateSyntheticScene, with the true two-view geometry in the
+// convention of theia, in the order of the view ids.
+std::vector<ImagePairMatch> GenerateSyntheticMatches(
+    const SyntheticMatchesOptions& options,
+    const Reconstruction& reconstruction);
+
+#endif // SYNTHETIC_SCENE_H
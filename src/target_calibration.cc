@@ -0,0 +1,119 @@
+#include "target_calibration.h"
+
+#include <glog/logging.h>
+#include <utility>
+
+#include "axxb/axxbestimator.h"
+#include "hand_eye_bundle_adjustment.h"
+#include "handeyecalibration_utils.h"
+
+bool CalibrateHandEyeFromTarget(const TargetCalibrationOptions& options,
+                                const std::vector<std::string>& image_files,
+                                const std::vector<CameraIntrinsicsPrior>& intrinsics,
+                                const Poses& image_handposes,
+                                Reconstruction* reconstruction,
+                                HandEyeTransformation* handeyetrans)
+{
+    CHECK_EQ(image_files.size(), image_handposes.size());
+    const ChessboardViews boards =
+        DetectChessboards(options.chessboard_options, image_files, intrinsics);
+    std::vector<int> found;
+    for (int i = 0; i < boards.size(); i++)
+    {
+        if (boards[i].found)
+        {
+            found.emplace_back(i);
+        }
+    }
+    if (found.size() < 3)
+    {
+        LOG(WARNING) << "Hand-eye calibration needs the chessboard in at least "
+                     "3 images.";
+        return false;
+    }
+
+    // The camera motion from view i to view j is the pose of camera j in
+    // camera i, T_ci_cj = T_ci_board*T_cj_board^-1, and the hand motion is
+    // H_i^-1*H_j, as in the SfM pipeline.
+    std::vector<MotionPair> motionpairs;
+    for (int i = 0; i < found.size(); i++)
+    {
+        for (int j = i + 1; j < found.size(); j++)
+        {
+            const int view1 = found[i];
+            const int view2 = found[j];
+            motionpairs.emplace_back(
+                boards[view1].target_to_camera*boards[view2].target_to_camera.Inverse(),
+                image_handposes[view1].Inverse()*image_handposes[view2]);
+        }
+    }
+    RansacSummary ransacsummary;
+    Pose x;
+    if (!EstimateHandEyeWithRansac(motionpairs, &x, &ransacsummary))
+    {
+        LOG(WARNING) << "AX=XB RANSAC failed.";
+        return false;
+    }
+    LOG(INFO) << ransacsummary.inliers.size() << " of " << motionpairs.size()
+              << " motion pairs are AX=XB inliers.";
+    handeyetrans->SetHandEyePose(x);
+
+    // View ids index the hand poses in the hand-eye bundle adjustment, so
+    // they are handed out in the order of view_handposes.
+    Poses view_handposes;
+    std::vector<ViewId> view_ids;
+    for (const int image_index : found)
+    {
+        std::string image_filename;
+        CHECK(GetFilenameFromFilepath(image_files[image_index], true,
+                                      &image_filename));
+        // One camera, so all views share the intrinsics.
+        const ViewId view_id = reconstruction->AddView(image_filename, 0);
+        CHECK_EQ(view_id, view_handposes.size())
+                << "Target calibration needs an empty reconstruction.";
+        View* view = reconstruction->MutableView(view_id);
+        *view->MutableCameraIntrinsicsPrior() = intrinsics[image_index];
+        view->MutableCamera()->SetFromCameraIntrinsicsPriors(intrinsics[image_index]);
+        view_handposes.emplace_back(image_handposes[image_index]);
+        view_ids.emplace_back(view_id);
+    }
+    SetCameraPosesFromHandPoses(view_handposes, handeyetrans, reconstruction);
+
+    // The board is not posed in the robot base frame, so every corner starts
+    // at the mean of its positions predicted by the views.
+    const std::vector<Eigen::Vector3d> board_points =
+        ChessboardPoints(options.chessboard_options);
+    const Pose eyehand = x.Inverse();
+    for (int c = 0; c < board_points.size(); c++)
+    {
+        std::vector<std::pair<ViewId, Feature> > observations;
+        Eigen::Vector3d point = Eigen::Vector3d::Zero();
+        for (int k = 0; k < found.size(); k++)
+        {
+            const ChessboardView& board = boards[found[k]];
+            observations.emplace_back(view_ids[k], board.corners[c]);
+            point += view_handposes[k]*(eyehand*(board.target_to_camera*board_points[c]));
+        }
+        point /= found.size();
+        const TrackId track_id = reconstruction->AddTrack(observations);
+        CHECK_NE(track_id, kInvalidTrackId);
+        Track* track = reconstruction->MutableTrack(track_id);
+        *track->MutablePoint() = point.homogeneous();
+        track->SetEstimated(true);
+    }
+
+    if (!options.bundle_adjust)
+    {
+        return true;
+    }
+    const BundleAdjustmentSummary summary =
+        BundleAdjusthandEye(options.bundle_adjustment_options, reconstruction,
+                            &view_handposes, handeyetrans);
+    if (!summary.success)
+    {
+        LOG(WARNING) << "Bundle adjustment failed!";
+        return false;
+    }
+    SetCameraPosesFromHandPoses(view_handposes, handeyetrans, reconstruction);
+    return true;
+}
@@ -0,0 +1,39 @@
+#ifndef TARGET_CALIBRATION_H
+#define TARGET_CALIBRATION_H
+
+#include <theia/theia.h>
+#include <string>
+#include <vector>
+
+#include "handeye_opencv.h"
+#include "handeyetransformation.h"
+#include "type.h"
+
+using namespace theia;
+
+struct TargetCalibrationOptions
+{
+    ChessboardOptions chessboard_options;
+    BundleAdjustmentOptions bundle_adjustment_options;
+    // Refine the AX=XB estimate by hand-eye bundle adjustment of the board
+    // corners.
+    bool bundle_adjust = true;
+};
+
+// Hand-eye calibration from a chessboard instead of SfM. The camera poses
+// relative to the board come from PnP, so the camera motions are metric and
+// no features are extracted or matched. X is estimated from all pairs of
+// views with AX=XB in RANSAC and refined by BundleAdjustPartialHandEye with
+// the board corners as tracks, whose correspondences are known exactly.
+//
+// intrinsics and image_handposes are per image. On success the reconstruction
+// holds a view per image where the board was found, posed from its hand pose,
+// and a track per board corner.
+bool CalibrateHandEyeFromTarget(const TargetCalibrationOptions& options,
+                                const std::vector<std::string>& image_files,
+                                const std::vector<CameraIntrinsicsPrior>& intrinsics,
+                                const Poses& image_handposes,
+                                Reconstruction* reconstruction,
+                                HandEyeTransformation* handeyetrans);
+
+#endif // TARGET_CALIBRATION_H
@@ -0,0 +1,141 @@
+// Checks that the incremental AX=XB solver of the online calibrator finds the
+// same X as the batch SVD solver it replaces, and that old motions fade out
+// with a forgetting factor below 1.
+
+#include <glog/logging.h>
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+#include <cmath>
+#include <random>
+
+#include "axxb/axxbincrementalsolver.h"
+#include "axxb/axxbsvdsolver.h"
+
+namespace
+{
+
+const int kNumMotionPairs = 30;
+
+Pose RandomPose(std::mt19937* random, const double max_angle)
+{
+    std::uniform_real_distribution<double> unit(-1.0, 1.0);
+    const Eigen::Vector3d axis =
+        Eigen::Vector3d(unit(*random), unit(*random), unit(*random)).normalized();
+    const Eigen::AngleAxisd rotation(max_angle*std::abs(unit(*random)), axis);
+    return Pose(rotation.toRotationMatrix(),
+                Eigen::Vector3d(unit(*random), unit(*random), unit(*random)));
+}
+
+double RotationDifferenceDegrees(const Pose& x1, const Pose& x2)
+{
+    return Eigen::AngleAxisd(x1.Quaternion().conjugate()*x2.Quaternion()).angle()*
+           180.0/M_PI;
+}
+
+// Hand motions B and camera motions A = X*B*X^-1, the rotation of A perturbed
+// by up to noise_degrees.
+void MotionPairs(std::mt19937* random, const Pose& x, const double noise_degrees,
+                 Poses* A, Poses* B)
+{
+    for (int i = 0; i < kNumMotionPairs; i++)
+    {
+        const Pose b = RandomPose(random, M_PI/2.0);
+        const Pose noise = RandomPose(random, noise_degrees*M_PI/180.0);
+        const Pose a = x*b*x.Inverse();
+        A->emplace_back(Pose(noise.Quaternion()*a.Quaternion(), a.Translation()));
+        B->emplace_back(b);
+    }
+}
+
+void TestMatchesBatchSolver(std::mt19937* random, const double noise_degrees)
+{
+    const Pose x = RandomPose(random, M_PI);
+    Poses A, B;
+    MotionPairs(random, x, noise_degrees, &A, &B);
+
+    AXXBIncrementalSolver incremental_solver;
+    for (int i = 0; i < A.size(); i++)
+    {
+        incremental_solver.AddMotionPair(A[i], B[i]);
+    }
+    CHECK_EQ(incremental_solver.NumMotionPairs(), kNumMotionPairs);
+    Pose incremental_x;
+    CHECK(incremental_solver.SolveX(&incremental_x));
+    AXXBSVDSolver batch_solver(A, B);
+    const Pose batch_x = batch_solver.SolveX();
+
+    // Both take the smallest singular vector of the same stacked system.
+    CHECK_LT(RotationDifferenceDegrees(incremental_x, batch_x), 1e-6);
+    CHECK_LT((incremental_x.Translation() - batch_x.Translation()).norm(),
+             1e-6*std::max(1.0, batch_x.Translation().norm()));
+    if (noise_degrees == 0.0)
+    {
+        CHECK_LT(RotationDifferenceDegrees(incremental_x, x), 1e-6);
+        CHECK_LT((incremental_x.Translation() - x.Translation()).norm(), 1e-6);
+    }
+}
+
+void TestNeedsTwoMotionPairs(std::mt19937* random)
+{
+    const Pose x = RandomPose(random, M_PI);
+    Poses A, B;
+    MotionPairs(random, x, 0.0, &A, &B);
+    AXXBIncrementalSolver solver;
+    Pose solution;
+    CHECK(!solver.SolveX(&solution));
+    solver.AddMotionPair(A[0], B[0]);
+    CHECK(!solver.SolveX(&solution));
+    solver.AddMotionPair(A[1], B[1]);
+    CHECK(solver.SolveX(&solution));
+    solver.Reset();
+    CHECK_EQ(solver.NumMotionPairs(), 0);
+    CHECK(!solver.SolveX(&solution));
+}
+
+// After X changes, the motions of the new X outweigh the old ones.
+void TestForgetsOldMotions(std::mt19937* random)
+{
+    const Pose old_x = RandomPose(random, M_PI);
+    const Pose new_x = RandomPose(random, M_PI);
+    Poses old_A, old_B, new_A, new_B;
+    MotionPairs(random, old_x, 0.0, &old_A, &old_B);
+    MotionPairs(random, new_x, 0.0, &new_A, &new_B);
+
+    AXXBIncrementalSolver forgetting_solver(0.5);
+    AXXBIncrementalSolver solver(1.0);
+    for (int i = 0; i < kNumMotionPairs; i++)
+    {
+        forgetting_solver.AddMotionPair(old_A[i], old_B[i]);
+        solver.AddMotionPair(old_A[i], old_B[i]);
+    }
+    for (int i = 0; i < kNumMotionPairs; i++)
+    {
+        forgetting_solver.AddMotionPair(new_A[i], new_B[i]);
+        solver.AddMotionPair(new_A[i], new_B[i]);
+    }
+    Pose forgetting_x, x;
+    CHECK(forgetting_solver.SolveX(&forgetting_x));
+    CHECK(solver.SolveX(&x));
+    CHECK_LT(RotationDifferenceDegrees(forgetting_x, new_x), 1e-3);
+    CHECK_LT(RotationDifferenceDegrees(forgetting_x, new_x),
+             RotationDifferenceDegrees(x, new_x));
+}
+
+}  // namespace
+
+int main(int argc, char* argv[])
+{
+    google::InitGoogleLogging(argv[0]);
+    FLAGS_logtostderr = true;
+
+    std::mt19937 random(39);
+    for (int i = 0; i < 10; i++)
+    {
+        TestMatchesBatchSolver(&random, 0.0);
+        TestMatchesBatchSolver(&random, 1.0);
+    }
+    TestNeedsTwoMotionPairs(&random);
+    TestForgetsOldMotions(&random);
+    LOG(INFO) << "AXXBIncrementalSolver matches AXXBSVDSolver.";
+    return 0;
+}
@@ -0,0 +1,120 @@
+// Checks that the cell cache of the calibration daemon accounts for the
+// memory of its cells and evicts the least recently used ones first.
+
+#include <glog/logging.h>
+#include <Eigen/Core>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "calibration_cell_cache.h"
+
+namespace
+{
+
+const int kDescriptorSize = 128;
+
+// Stores num_features features in the cell, as a calibration would.
+void AddFeatures(const int num_features, CalibrationCell* cell)
+{
+    KeypointsAndDescriptors features;
+    features.keypoints.resize(num_features);
+    features.descriptors.assign(num_features,
+                                Eigen::VectorXf::Zero(kDescriptorSize));
+    cell->feature_cache.BeginCalibration();
+    cell->feature_cache.StoreFeatures(cell->num_calibrations, features);
+    cell->feature_cache.EndCalibration();
+    cell->num_calibrations++;
+}
+
+size_t NumBytes(const std::vector<std::shared_ptr<CalibrationCell> >& cells)
+{
+    size_t num_bytes = 0;
+    for (const std::shared_ptr<CalibrationCell>& cell : cells)
+    {
+        num_bytes += CalibrationCellNumBytes(*cell);
+    }
+    return num_bytes;
+}
+
+void TestAccountsForTheFeatures()
+{
+    CalibrationCellCache cache(1 << 30);
+    std::shared_ptr<CalibrationCell> cell = cache.Cell("cell");
+    const size_t empty_num_bytes = CalibrationCellNumBytes(*cell);
+    CHECK_EQ(cache.NumBytes(), empty_num_bytes);
+
+    AddFeatures(100, cell.get());
+    CHECK_GE(CalibrationCellNumBytes(*cell),
+             empty_num_bytes + 100*kDescriptorSize*sizeof(float));
+    CHECK_EQ(cache.NumBytes(), CalibrationCellNumBytes(*cell));
+
+    // The cache holds the same cell.
+    CHECK(cache.Cell("cell") == cell);
+    std::shared_ptr<CalibrationCell> other_cell = cache.Cell("other cell");
+    AddFeatures(10, other_cell.get());
+    CHECK_EQ(cache.NumBytes(), NumBytes({cell, other_cell}));
+    CHECK(cache.Evict("cell"));
+    CHECK(!cache.Evict("cell"));
+    CHECK_EQ(cache.NumBytes(), CalibrationCellNumBytes(*other_cell));
+}
+
+void TestEvictsTheLeastRecentlyUsed()
+{
+    std::vector<std::shared_ptr<CalibrationCell> > cells;
+    {
+        CalibrationCellCache unbounded_cache(1 << 30);
+        for (const std::string& name : {"a", "b", "c"})
+        {
+            cells.emplace_back(unbounded_cache.Cell(name));
+            AddFeatures(100, cells.back().get());
+        }
+    }
+
+    // Room for two of the cells, not three.
+    const size_t max_num_bytes = NumBytes({cells[0], cells[1]});
+    CHECK_LT(max_num_bytes, NumBytes(cells));
+    CalibrationCellCache cache(max_num_bytes);
+    for (const std::string& name : {"a", "b", "c"})
+    {
+        AddFeatures(100, cache.Cell(name).get());
+    }
+    CHECK(cache.CellNames() == std::vector<std::string>({"c", "b", "a"}));
+
+    // Using a makes b the least recently used.
+    std::shared_ptr<CalibrationCell> cell_a = cache.Cell("a");
+    CHECK(cache.CellNames() == std::vector<std::string>({"a", "c", "b"}));
+    std::shared_ptr<CalibrationCell> cell_b = cache.Cell("b");
+    cache.Cell("a");
+    cache.Cell("c");
+    CHECK(cache.CellNames() == std::vector<std::string>({"c", "a", "b"}));
+    cache.Shrink();
+    CHECK(cache.CellNames() == std::vector<std::string>({"c", "a"}));
+    CHECK_LE(cache.NumBytes(), max_num_bytes);
+
+    // An evicted cell lives on while it is used, but is empty once used again.
+    CHECK_EQ(cell_b->num_calibrations, 1);
+    CHECK_GT(cell_b->feature_cache.NumBytes(), 0);
+    CHECK_EQ(cache.Cell("b")->num_calibrations, 0);
+    CHECK(cache.CellNames() == std::vector<std::string>({"b", "c", "a"}));
+
+    // The most recently used cell is kept even if it exceeds the bound alone.
+    AddFeatures(1000, cache.Cell("a").get());
+    CHECK_GT(CalibrationCellNumBytes(*cell_a), max_num_bytes);
+    cache.Shrink();
+    CHECK(cache.CellNames() == std::vector<std::string>({"a"}));
+    CHECK_EQ(cache.NumBytes(), CalibrationCellNumBytes(*cell_a));
+}
+
+}  // namespace
+
+int main(int argc, char* argv[])
+{
+    google::InitGoogleLogging(argv[0]);
+    FLAGS_logtostderr = true;
+
+    TestAccountsForTheFeatures();
+    TestEvictsTheLeastRecentlyUsed();
+    LOG(INFO) << "The cell cache evicts the least recently used cells.";
+    return 0;
+}
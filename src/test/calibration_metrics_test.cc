@@ -0,0 +1,149 @@
+// Checks the Prometheus text that the metrics export writes to its file and
+// serves on its socket, and that concurrent publishers leave the newest
+// snapshot in the file.
+
+#include <glog/logging.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "calibration_metrics.h"
+
+namespace
+{
+
+const char kTextfilePath[] = "shecar_metrics_test.prom";
+const char kSocketPath[] = "shecar_metrics_test.sock";
+const int kNumThreads = 8;
+
+std::string ReadFile(const std::string& filepath)
+{
+    std::ifstream file(filepath);
+    CHECK(file.is_open()) << filepath;
+    std::ostringstream text;
+    text << file.rdbuf();
+    return text.str();
+}
+
+std::string ReadSocket(const std::string& socket_path)
+{
+    sockaddr_un address;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    std::strcpy(address.sun_path, socket_path.c_str());
+    const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    CHECK_GE(fd, 0);
+    CHECK_EQ(connect(fd, reinterpret_cast<const sockaddr*>(&address),
+                     sizeof(address)), 0);
+    std::string text;
+    char buffer[256];
+    ssize_t n;
+    while ((n = read(fd, buffer, sizeof(buffer))) > 0)
+    {
+        text.append(buffer, n);
+    }
+    close(fd);
+    return text;
+}
+
+bool Contains(const std::string& text, const std::string& part)
+{
+    return text.find(part) != std::string::npos;
+}
+
+void TestLabels()
+{
+    CHECK_EQ(MetricLabel("stage", "triangulation"),
+             "{stage=\"triangulation\"}");
+    CHECK_EQ(MetricLabel("stage", "a \"b\"\\c\nd"),
+             "{stage=\"a \\\"b\\\"\\\\c\\nd\"}");
+    CHECK_EQ(MetricLabel("stage", "ba", "counter", "num_residuals"),
+             "{stage=\"ba\",counter=\"num_residuals\"}");
+}
+
+void TestExport()
+{
+    // Nothing is kept while the export is off.
+    SetMetric("shecar_off", 1.0);
+    CHECK(!IsMetricsExportEnabled());
+
+    CHECK(StartMetricsExport(kTextfilePath, kSocketPath, 3600.0));
+    CHECK(IsMetricsExportEnabled());
+    std::string text = ReadFile(kTextfilePath);
+    CHECK(Contains(text, "# TYPE shecar_start_timestamp_seconds gauge\n"));
+    CHECK(!Contains(text, "shecar_off"));
+
+    const std::string label = MetricLabel("stage", "triangulation");
+    SetMetric("shecar_stage_running" + label, 1.0);
+    IncrementMetric("shecar_stage_calls_total" + label);
+    IncrementMetric("shecar_stage_calls_total" + label, 2.0);
+    IncrementMetric("shecar_stage_calls_total" +
+                    MetricLabel("stage", "bundle adjustment"));
+
+    // Within the interval only a forced publish writes the file.
+    PublishMetrics();
+    CHECK(!Contains(ReadFile(kTextfilePath), "shecar_stage_running"));
+    PublishMetrics(true);
+    text = ReadFile(kTextfilePath);
+    CHECK(Contains(text, "# TYPE shecar_stage_running gauge\n"
+                   "shecar_stage_running{stage=\"triangulation\"} 1\n"));
+    // One TYPE line per family, before all of its label sets.
+    CHECK(Contains(text, "# TYPE shecar_stage_calls_total counter\n"
+                   "shecar_stage_calls_total{stage=\"bundle adjustment\"} 1\n"
+                   "shecar_stage_calls_total{stage=\"triangulation\"} 3\n"));
+    CHECK(Contains(text, "shecar_last_update_timestamp_seconds "));
+
+    // The socket serves the current metrics, published or not.
+    SetMetric("shecar_stage_running" + label, 0.0);
+    CHECK(Contains(ReadSocket(kSocketPath),
+                   "shecar_stage_running{stage=\"triangulation\"} 0\n"));
+
+    // Whichever publisher writes last, the file holds the newest snapshot.
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kNumThreads; t++)
+    {
+        threads.emplace_back([]()
+        {
+            for (int i = 0; i < 100; i++)
+            {
+                IncrementMetric("shecar_publishes_total");
+                PublishMetrics(true);
+            }
+        });
+    }
+    for (std::thread& thread : threads)
+    {
+        thread.join();
+    }
+    CHECK(Contains(ReadFile(kTextfilePath),
+                   "shecar_publishes_total " + std::to_string(100*kNumThreads) +
+                   "\n"));
+
+    // Stopping publishes a last time and removes the socket.
+    SetMetric("shecar_done", 1.0);
+    StopMetricsExport();
+    CHECK(!IsMetricsExportEnabled());
+    CHECK(Contains(ReadFile(kTextfilePath), "shecar_done 1\n"));
+    CHECK_NE(access(kSocketPath, F_OK), 0);
+    std::remove(kTextfilePath);
+}
+
+}  // namespace
+
+int main(int argc, char* argv[])
+{
+    google::InitGoogleLogging(argv[0]);
+    FLAGS_logtostderr = true;
+
+    TestLabels();
+    TestExport();
+    LOG(INFO) << "The metrics are exported in the Prometheus text format.";
+    return 0;
+}
@@ -0,0 +1,127 @@
+// Checks the two uses of a prior hand-eye transformation: the count of the
+// motion pairs that agree with it, which decides whether RANSAC is skipped,
+// and the prior residual of the bundle adjustment.
+
+#include <glog/logging.h>
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "axxb/axxbestimator.h"
+#include "handeyepriorerror.h"
+
+namespace
+{
+
+const double kDegToRad = M_PI/180.0;
+// HandEyeWarmStartOptions::max_motion_pair_error, the RANSAC threshold.
+const double kMaxMotionPairError = 0.01;
+
+Pose RandomPose(std::mt19937* random, const double min_angle,
+                const double max_angle)
+{
+    std::uniform_real_distribution<double> unit(-1.0, 1.0);
+    const Eigen::Vector3d axis =
+        Eigen::Vector3d(unit(*random), unit(*random), unit(*random)).normalized();
+    const Eigen::AngleAxisd rotation(
+        min_angle + (max_angle - min_angle)*std::abs(unit(*random)), axis);
+    return Pose(rotation.toRotationMatrix(),
+                Eigen::Vector3d(unit(*random), unit(*random), unit(*random)));
+}
+
+// Rotates x by angle_degrees around axis, on the left like the prior residual.
+Pose RotateHandEye(const Pose& x, const Eigen::Vector3d& axis,
+                   const double angle_degrees)
+{
+    return Pose(Eigen::AngleAxisd(angle_degrees*kDegToRad, axis.normalized())*
+                x.Quaternion(), x.Translation());
+}
+
+// Hand motions of 30 to 90 degrees. The camera motion of a reconstruction is
+// only known up to scale.
+std::vector<MotionPair> MotionPairs(std::mt19937* random, const Pose& x,
+                                    const int num_inliers, const int num_outliers)
+{
+    std::vector<MotionPair> motionpairs;
+    for (int i = 0; i < num_inliers + num_outliers; i++)
+    {
+        const Pose b = RandomPose(random, M_PI/6.0, M_PI/2.0);
+        Pose a = i < num_inliers ? x*b*x.Inverse() :
+                 RandomPose(random, 0.0, M_PI/2.0);
+        a = Pose(a.Quaternion(), 0.3*a.Translation());
+        motionpairs.emplace_back(a, b);
+    }
+    return motionpairs;
+}
+
+void TestCountsTheAgreeingMotionPairs(std::mt19937* random)
+{
+    const Pose x = RandomPose(random, 0.0, M_PI);
+    const std::vector<MotionPair> motionpairs = MotionPairs(random, x, 16, 4);
+    CHECK_EQ(CountHandEyeInliers(motionpairs, x, kMaxMotionPairError), 16);
+    CHECK_EQ(CountHandEyeInliers(std::vector<MotionPair>(), x,
+                                 kMaxMotionPairError), 0);
+    // A prior that is off by a few degrees only agrees with the rare motions
+    // around the axis of its error.
+    const Pose wrong_x = RotateHandEye(x, Eigen::Vector3d(1.0, 2.0, 3.0), 5.0);
+    CHECK_LE(CountHandEyeInliers(motionpairs, wrong_x, kMaxMotionPairError), 2);
+}
+
+void TestPriorResidual(std::mt19937* random)
+{
+    const double rotation_sigma = 0.5*kDegToRad;
+    const double translation_sigma = 0.002;
+    const Pose prior = RandomPose(random, 0.0, M_PI);
+    const HandEyePriorError prior_error(prior, rotation_sigma, translation_sigma);
+
+    const Eigen::Vector3d axis = Eigen::Vector3d(-1.0, 0.5, 2.0).normalized();
+    const Eigen::Vector3d translation_offset(0.001, -0.004, 0.0);
+    const Pose x = RotateHandEye(prior, axis, 2.0);
+
+    double handeyetrans[6];
+    const Eigen::AngleAxisd angle_axis(x.Quaternion());
+    for (int i = 0; i < 3; i++)
+    {
+        handeyetrans[HandEyeTransformation::ROTATION + i] =
+            angle_axis.angle()*angle_axis.axis()[i];
+        handeyetrans[HandEyeTransformation::TRANSLATION + i] =
+            x.Translation()[i] + translation_offset[i];
+    }
+    double residuals[6];
+    CHECK(prior_error(handeyetrans, residuals));
+    const Eigen::Map<const Eigen::Matrix<double, 6, 1> > residual(residuals);
+    CHECK_LT((residual.head<3>() - 2.0*kDegToRad/rotation_sigma*axis).norm(), 1e-9);
+    CHECK_LT((residual.tail<3>() - translation_offset/translation_sigma).norm(),
+             1e-9);
+
+    // The prior itself costs nothing.
+    const Eigen::AngleAxisd prior_angle_axis(prior.Quaternion());
+    for (int i = 0; i < 3; i++)
+    {
+        handeyetrans[HandEyeTransformation::ROTATION + i] =
+            prior_angle_axis.angle()*prior_angle_axis.axis()[i];
+        handeyetrans[HandEyeTransformation::TRANSLATION + i] =
+            prior.Translation()[i];
+    }
+    CHECK(prior_error(handeyetrans, residuals));
+    CHECK_LT(residual.norm(), 1e-9);
+}
+
+}  // namespace
+
+int main(int argc, char* argv[])
+{
+    google::InitGoogleLogging(argv[0]);
+    FLAGS_logtostderr = true;
+
+    std::mt19937 random(50);
+    for (int i = 0; i < 10; i++)
+    {
+        TestCountsTheAgreeingMotionPairs(&random);
+        TestPriorResidual(&random);
+    }
+    LOG(INFO) << "A prior hand-eye transformation is checked and kept.";
+    return 0;
+}
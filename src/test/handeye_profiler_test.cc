@@ -0,0 +1,100 @@
+// Checks the stage measurements of the profiler and its JSON report, which
+// must stay valid JSON whatever the stage and counter names and values.
+
+#include <glog/logging.h>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include <string>
+
+#include "handeye_profiler.h"
+
+namespace
+{
+
+const char kJsonFilepath[] = "shecar_profiler_test.json";
+
+std::string ReadFile(const std::string& filepath)
+{
+    std::ifstream file(filepath);
+    CHECK(file.is_open()) << filepath;
+    std::ostringstream text;
+    text << file.rdbuf();
+    return text.str();
+}
+
+bool Contains(const std::string& text, const std::string& part)
+{
+    return text.find(part) != std::string::npos;
+}
+
+void TestJsonValues()
+{
+    CHECK_EQ(JsonString("triangulation"), "\"triangulation\"");
+    CHECK_EQ(JsonString("a \"b\" \\c"), "\"a \\\"b\\\" \\\\c\"");
+    CHECK_EQ(JsonString("line\nbreak\ttab"), "\"line\\u000abreak\\u0009tab\"");
+    CHECK_EQ(JsonNumber(0.5), "0.5");
+    CHECK_EQ(JsonNumber(-3.0), "-3");
+    CHECK_EQ(JsonNumber(std::numeric_limits<double>::quiet_NaN()), "null");
+    CHECK_EQ(JsonNumber(std::numeric_limits<double>::infinity()), "null");
+    CHECK_EQ(JsonNumber(-std::numeric_limits<double>::infinity()), "null");
+}
+
+void TestRecordsStagesInOrder()
+{
+    HandEyeProfiler profiler;
+    {
+        ScopedStageTimer timer(&profiler, "feature extraction");
+        timer.SetCounter("num_images", 4.0);
+        timer.SetCounter("num_images", 5.0);
+    }
+    for (int iteration = 0; iteration < 2; iteration++)
+    {
+        ScopedStageTimer timer(&profiler, "bundle \"adjustment\"", iteration);
+        timer.SetCounter("final_cost",
+                         std::numeric_limits<double>::quiet_NaN());
+    }
+    {
+        ScopedStageTimer timer(&profiler, "feature extraction");
+    }
+    // Without a profiler the timer only keeps time.
+    {
+        ScopedStageTimer timer(nullptr, "ignored");
+        timer.SetCounter("ignored", 1.0);
+        CHECK_GE(timer.ElapsedTimeInSeconds(), 0.0);
+    }
+
+    const std::string report = profiler.Report();
+    CHECK(Contains(report, "feature extraction: 2 calls"));
+    CHECK(Contains(report, "bundle \"adjustment\": 2 calls"));
+    CHECK(!Contains(report, "ignored"));
+    CHECK_LT(report.find("feature extraction"), report.find("bundle"));
+
+    CHECK(profiler.WriteJson(kJsonFilepath));
+    const std::string json = ReadFile(kJsonFilepath);
+    std::remove(kJsonFilepath);
+    CHECK(Contains(json, "\"name\": \"feature extraction\", \"num_calls\": 2"));
+    CHECK(Contains(json,
+                   "\"name\": \"bundle \\\"adjustment\\\"\", \"num_calls\": 2"));
+    CHECK(Contains(json, "\"counters\": {\"num_images\": 5}"));
+    CHECK(Contains(json, "{\"iteration\": 1, "));
+    CHECK(Contains(json, "\"counters\": {\"final_cost\": null}"));
+    CHECK(Contains(json, "\"process_cpu_time_seconds\": "));
+    CHECK(!Contains(json, "nan"));
+    CHECK(!Contains(json, "ignored"));
+}
+
+}  // namespace
+
+int main(int argc, char* argv[])
+{
+    google::InitGoogleLogging(argv[0]);
+    FLAGS_logtostderr = true;
+
+    TestJsonValues();
+    TestRecordsStagesInOrder();
+    LOG(INFO) << "The profiler writes valid JSON reports.";
+    return 0;
+}
@@ -0,0 +1,158 @@
+// Checks that the batched projection kernel agrees with the scalar template
+// it batches. Build with -DSHECAR_ENABLE_NATIVE_ARCH=ON to cover the AVX2 and
+// AVX-512 lanes as well as the scalar tail.
+
+#include <glog/logging.h>
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "handeye_project_point_to_image.h"
+
+namespace
+{
+
+// Not a multiple of any lane width, so every batch also has a scalar tail.
+const int kNumPoints = 1003;
+const int kNumCameras = 20;
+const double kPixelTolerance = 1e-8;
+const double kDepthTolerance = 1e-10;
+
+void RandomCamera(std::mt19937* random, Camera* camera)
+{
+    std::uniform_real_distribution<double> unit(-1.0, 1.0);
+    const Eigen::Vector3d orientation =
+        M_PI*std::abs(unit(*random))*Eigen::Vector3d(
+            unit(*random), unit(*random), unit(*random)).normalized();
+    camera->SetOrientationFromAngleAxis(orientation);
+    camera->SetPosition(Eigen::Vector3d(unit(*random), unit(*random),
+                                        unit(*random)));
+    camera->SetFocalLength(800.0 + 400.0*unit(*random));
+    camera->SetAspectRatio(1.0 + 0.05*unit(*random));
+    camera->SetSkew(0.5*unit(*random));
+    camera->SetPrincipalPoint(640.0 + 20.0*unit(*random),
+                              480.0 + 20.0*unit(*random));
+    camera->SetRadialDistortion(0.1*unit(*random), 0.01*unit(*random));
+}
+
+// Points in front of and behind the camera, but not on its image plane, with a
+// non-unit homogeneous coordinate, in the x,y,z,w layout of Track::Point().
+void RandomPoints(std::mt19937* random, const Camera& camera,
+                  std::vector<double>* points)
+{
+    std::uniform_real_distribution<double> unit(-1.0, 1.0);
+    points->resize(4*kNumPoints);
+    for (int i = 0; i < kNumPoints; i++)
+    {
+        const double z = unit(*random);
+        const Eigen::Vector3d in_camera(unit(*random), unit(*random),
+                                        std::copysign(0.5 + 3.5*std::abs(z), z));
+        const Eigen::Vector3d in_world =
+            camera.GetOrientationAsRotationMatrix().transpose()*in_camera +
+            camera.GetPosition();
+        const double w = 0.5 + std::abs(unit(*random));
+        Eigen::Map<Eigen::Vector4d>(points->data() + 4*i) =
+            w*in_world.homogeneous();
+    }
+}
+
+void TestMatchesScalarTemplate(const Camera& camera,
+                               const std::vector<double>& points)
+{
+    std::vector<double> pixels(2*kNumPoints);
+    std::vector<double> depths(kNumPoints);
+    HandEyeProjectPointsToImage(camera, points.data(), kNumPoints,
+                                pixels.data(), depths.data());
+    for (int i = 0; i < kNumPoints; i++)
+    {
+        double pixel[2];
+        const double depth = HandEyeProjectPointToImage(camera.extrinsics(),
+                             camera.intrinsics(),
+                             points.data() + 4*i,
+                             pixel);
+        CHECK_NEAR(depths[i], depth, kDepthTolerance*std::abs(depth))
+                << "point " << i;
+        // Points off the optical axis project far away, so the tolerance is
+        // relative to the pixel.
+        const double scale = std::max(1.0, std::abs(pixel[0]) +
+                                      std::abs(pixel[1]));
+        CHECK_NEAR(pixels[2*i], pixel[0], kPixelTolerance*scale)
+                << "point " << i;
+        CHECK_NEAR(pixels[2*i + 1], pixel[1], kPixelTolerance*scale)
+                << "point " << i;
+    }
+}
+
+// The scalar template follows the convention of Camera::ProjectPoint, which
+// the rest of the pipeline uses.
+void TestMatchesCamera(const Camera& camera, const std::vector<double>& points)
+{
+    for (int i = 0; i < kNumPoints; i++)
+    {
+        double pixel[2];
+        const double depth = HandEyeProjectPointToImage(camera.extrinsics(),
+                             camera.intrinsics(),
+                             points.data() + 4*i,
+                             pixel);
+        Eigen::Vector2d expected_pixel;
+        const double expected_depth = camera.ProjectPoint(
+                                          Eigen::Map<const Eigen::Vector4d>(points.data() + 4*i),
+                                          &expected_pixel);
+        CHECK_NEAR(depth, expected_depth, kDepthTolerance*std::abs(depth))
+                << "point " << i;
+        const double scale = std::max(1.0, expected_pixel.lpNorm<1>());
+        CHECK_NEAR(pixel[0], expected_pixel.x(), kPixelTolerance*scale)
+                << "point " << i;
+        CHECK_NEAR(pixel[1], expected_pixel.y(), kPixelTolerance*scale)
+                << "point " << i;
+    }
+}
+
+// Batches shorter than a lane only take the scalar tail.
+void TestShortBatches(const Camera& camera, const std::vector<double>& points)
+{
+    for (int num_points = 0; num_points <= 17; num_points++)
+    {
+        std::vector<double> pixels(2*num_points + 2, -1.0);
+        HandEyeProjectPointsToImage(camera, points.data(), num_points,
+                                    pixels.data(), nullptr);
+        for (int i = 0; i < num_points; i++)
+        {
+            double pixel[2];
+            HandEyeProjectPointToImage(camera.extrinsics(), camera.intrinsics(),
+                                       points.data() + 4*i, pixel);
+            const double scale = std::max(1.0, std::abs(pixel[0]) +
+                                          std::abs(pixel[1]));
+            CHECK_NEAR(pixels[2*i], pixel[0], kPixelTolerance*scale);
+            CHECK_NEAR(pixels[2*i + 1], pixel[1], kPixelTolerance*scale);
+        }
+        // Nothing is written past the last pixel.
+        CHECK_EQ(pixels[2*num_points], -1.0);
+        CHECK_EQ(pixels[2*num_points + 1], -1.0);
+    }
+}
+
+}  // namespace
+
+int main(int argc, char* argv[])
+{
+    google::InitGoogleLogging(argv[0]);
+    FLAGS_logtostderr = true;
+
+    std::mt19937 random(38);
+    std::vector<double> points;
+    for (int i = 0; i < kNumCameras; i++)
+    {
+        Camera camera;
+        RandomCamera(&random, &camera);
+        RandomPoints(&random, camera, &points);
+        TestMatchesScalarTemplate(camera, points);
+        TestMatchesCamera(camera, points);
+        TestShortBatches(camera, points);
+    }
+    LOG(INFO) << "HandEyeProjectPointsToImage matches HandEyeProjectPointToImage.";
+    return 0;
+}
@@ -0,0 +1,170 @@
+// Checks the approximate Fisher information of next_best_hand_pose against
+// finite differences of the AX=XB residuals it linearizes, and that the
+// candidates are ranked by the increase of its log determinant.
+
+#include <glog/logging.h>
+#include <Eigen/Cholesky>
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+#include <cmath>
+#include <vector>
+
+#include "next_best_hand_pose.h"
+
+namespace
+{
+
+typedef Eigen::Matrix<double, 6, 6> Matrix6d;
+typedef Eigen::Matrix<double, 6, 1> Vector6d;
+
+const double kDegToRad = M_PI/180.0;
+const double kStep = 1e-6;
+
+Pose HandPose(const Eigen::Vector3d& angle_axis, const Eigen::Vector3d& translation)
+{
+    const double angle = angle_axis.norm();
+    const Eigen::Matrix3d rotation = angle > 0.0 ?
+                                     Eigen::AngleAxisd(angle, angle_axis/angle).toRotationMatrix() :
+                                     Eigen::Matrix3d::Identity();
+    return Pose(rotation, translation);
+}
+
+// Weighted AX=XB residuals of the hand motion B with A = X*B*X^-1 held fixed,
+// at X perturbed to exp(dr)*Rx and tx+dt.
+Vector6d MotionResidual(const NextBestHandPoseOptions& options,
+                        const Pose& handeye, const Pose& handmotion,
+                        const Vector6d& delta)
+{
+    const Pose camera_motion = handeye*handmotion*handeye.Inverse();
+    const Eigen::Matrix3d rotation_x =
+        HandPose(delta.head<3>(), Eigen::Vector3d::Zero()).Rotation()*
+        handeye.Rotation();
+    const Eigen::Vector3d translation_x = handeye.Translation() + delta.tail<3>();
+    const Eigen::Matrix3d rotation_a = camera_motion.Rotation();
+
+    const Eigen::AngleAxisd rotation_residual(
+        rotation_a*rotation_x*handmotion.Rotation().transpose()*
+        rotation_x.transpose());
+    Vector6d residual;
+    residual.head<3>() = rotation_residual.angle()*rotation_residual.axis()/
+                         (options.motion_rotation_sigma_degrees*kDegToRad);
+    residual.tail<3>() = ((rotation_a - Eigen::Matrix3d::Identity())*translation_x -
+                          rotation_x*handmotion.Translation() +
+                          camera_motion.Translation())/
+                         options.motion_translation_sigma;
+    return residual;
+}
+
+double LogDet(const Matrix6d& information)
+{
+    const Eigen::LLT<Matrix6d> llt(information + 1e-6*Matrix6d::Identity());
+    return 2.0*llt.matrixL().toDenseMatrix().diagonal().array().log().sum();
+}
+
+void TestInformationMatchesFiniteDifferences()
+{
+    NextBestHandPoseOptions options;
+    const Pose handeye = HandPose(Eigen::Vector3d(0.3, -0.2, 1.1),
+                                  Eigen::Vector3d(0.05, -0.02, 0.1));
+    Poses handposes;
+    handposes.emplace_back(HandPose(Eigen::Vector3d(0.1, 0.2, 0.0),
+                                    Eigen::Vector3d(0.4, 0.1, 0.3)));
+    handposes.emplace_back(HandPose(Eigen::Vector3d(-0.4, 0.3, 0.5),
+                                    Eigen::Vector3d(0.2, -0.3, 0.5)));
+    const Pose handmotion = handposes[0].Inverse()*handposes[1];
+
+    Matrix6d jacobian;
+    for (int i = 0; i < 6; i++)
+    {
+        Vector6d delta = Vector6d::Zero();
+        delta(i) = kStep;
+        jacobian.col(i) = (MotionResidual(options, handeye, handmotion, delta) -
+                           MotionResidual(options, handeye, handmotion, -delta))/
+                          (2.0*kStep);
+    }
+    CHECK_LT(MotionResidual(options, handeye, handmotion, Vector6d::Zero()).norm(),
+             1e-6);
+
+    const Matrix6d expected = jacobian.transpose()*jacobian;
+    const Matrix6d information =
+        HandEyeInformation(options, handposes, handeye, nullptr);
+    CHECK_LT((information - expected).norm(), 1e-5*expected.norm())
+            << "\n" << information << "\n\n" << expected;
+}
+
+void TestRanksByLogDetGain()
+{
+    NextBestHandPoseOptions options;
+    const Pose handeye = HandPose(Eigen::Vector3d(0.0, 0.2, 0.1),
+                                  Eigen::Vector3d(0.0, 0.05, 0.1));
+    // Rotations around the z axis only, which leave the translation of X along
+    // it unobserved.
+    Poses handposes;
+    handposes.emplace_back(HandPose(Eigen::Vector3d(0.0, 0.0, 0.0),
+                                    Eigen::Vector3d(0.5, 0.0, 0.3)));
+    handposes.emplace_back(HandPose(Eigen::Vector3d(0.0, 0.0, 0.6),
+                                    Eigen::Vector3d(0.4, 0.2, 0.3)));
+    handposes.emplace_back(HandPose(Eigen::Vector3d(0.0, 0.0, -0.5),
+                                    Eigen::Vector3d(0.4, -0.2, 0.3)));
+
+    Poses candidates;
+    // Only repeats the motions between the existing poses.
+    candidates.emplace_back(handposes[1]);
+    // A further rotation around the same z axis.
+    candidates.emplace_back(HandPose(Eigen::Vector3d(0.0, 0.0, 1.2),
+                                     Eigen::Vector3d(0.3, 0.3, 0.3)));
+    // A rotation around a new axis.
+    candidates.emplace_back(HandPose(Eigen::Vector3d(0.7, 0.0, 0.2),
+                                     Eigen::Vector3d(0.5, 0.1, 0.4)));
+
+    const std::vector<HandPoseCandidateScore> scores =
+        RankCandidateHandPoses(options, handposes, candidates, handeye, nullptr);
+    CHECK_EQ(scores.size(), candidates.size());
+    CHECK_EQ(scores[0].candidate_index, 2);
+    CHECK_EQ(scores[1].candidate_index, 1);
+    CHECK_EQ(scores[2].candidate_index, 0);
+
+    // The gain is the increase of the log determinant of the information of
+    // all hand poses, candidate included.
+    const double log_det =
+        LogDet(HandEyeInformation(options, handposes, handeye, nullptr));
+    Eigen::Vector3d rotation_degrees, translation;
+    HandEyeStandardDeviations(
+        HandEyeInformation(options, handposes, handeye, nullptr),
+        &rotation_degrees, &translation);
+    for (const HandPoseCandidateScore& score : scores)
+    {
+        Poses augmented_handposes = handposes;
+        augmented_handposes.emplace_back(candidates[score.candidate_index]);
+        const Matrix6d information =
+            HandEyeInformation(options, augmented_handposes, handeye, nullptr);
+        CHECK_NEAR(score.information_gain, LogDet(information) - log_det, 1e-6);
+        CHECK_GE(score.information_gain, -1e-9);
+
+        Eigen::Vector3d expected_rotation_degrees, expected_translation;
+        HandEyeStandardDeviations(information, &expected_rotation_degrees,
+                                  &expected_translation);
+        CHECK_LT((score.rotation_standard_deviation_degrees -
+                  expected_rotation_degrees).norm(), 1e-9);
+        CHECK_LT((score.translation_standard_deviation -
+                  expected_translation).norm(), 1e-9);
+        CHECK_LE(score.rotation_standard_deviation_degrees.maxCoeff(),
+                 rotation_degrees.maxCoeff() + 1e-9);
+    }
+    // Only the new rotation axis makes the translation observable.
+    CHECK_LT(scores[0].translation_standard_deviation.maxCoeff(), 0.01);
+    CHECK_GT(scores[1].translation_standard_deviation.maxCoeff(), 1.0);
+}
+
+}  // namespace
+
+int main(int argc, char* argv[])
+{
+    google::InitGoogleLogging(argv[0]);
+    FLAGS_logtostderr = true;
+
+    TestInformationMatchesFiniteDifferences();
+    TestRanksByLogDetGain();
+    LOG(INFO) << "The hand pose candidates are ranked by information gain.";
+    return 0;
+}
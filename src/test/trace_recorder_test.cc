@@ -0,0 +1,117 @@
+// Checks that the trace recorder keeps the spans and counters of every
+// thread, also of threads that ended before the trace is written, and
+// records nothing while tracing is off.
+
+#include <glog/logging.h>
+#include <cstdio>
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "trace_recorder.h"
+
+namespace
+{
+
+const char kTraceFilepath[] = "shecar_trace_recorder_test.json";
+const int kNumThreads = 4;
+
+std::string WriteAndReadTrace()
+{
+    CHECK(WriteTrace(kTraceFilepath));
+    std::ifstream file(kTraceFilepath);
+    CHECK(file.is_open());
+    std::ostringstream text;
+    text << file.rdbuf();
+    std::remove(kTraceFilepath);
+    return text.str();
+}
+
+int Count(const std::string& text, const std::string& part)
+{
+    int count = 0;
+    for (size_t position = text.find(part); position != std::string::npos;
+            position = text.find(part, position + part.size()))
+    {
+        count++;
+    }
+    return count;
+}
+
+void TestRecordsNothingWhileOff()
+{
+    CHECK(!IsTracingEnabled());
+    {
+        ScopedTraceSpan span("off span");
+    }
+    TraceCounter("off counter", 1.0);
+
+    StartTracing();
+    CHECK(IsTracingEnabled());
+    const std::string trace = WriteAndReadTrace();
+    CHECK(!IsTracingEnabled());
+    CHECK_EQ(Count(trace, "off "), 0);
+    CHECK_EQ(Count(trace, "\"traceEvents\": ["), 1);
+}
+
+void TestRecordsEveryThread()
+{
+    // Spans of an earlier trace are discarded.
+    StartTracing();
+    {
+        ScopedTraceSpan span("earlier span");
+    }
+
+    StartTracing();
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kNumThreads; t++)
+    {
+        threads.emplace_back([t]()
+        {
+            SetTraceThreadName("worker \"" + std::to_string(t) + "\"");
+            ScopedTraceSpan outer_span(std::string("outer span"));
+            for (int i = 0; i < 10; i++)
+            {
+                ScopedTraceSpan inner_span("inner span");
+            }
+            TraceCounter("num_tracks", t);
+        });
+    }
+    // The threads end before the trace is written.
+    for (std::thread& thread : threads)
+    {
+        thread.join();
+    }
+    TraceCounter("cost", std::numeric_limits<double>::quiet_NaN());
+    const std::string trace = WriteAndReadTrace();
+
+    CHECK_EQ(Count(trace, "earlier span"), 0);
+    CHECK_EQ(Count(trace, "\"name\": \"outer span\", \"ph\": \"X\""),
+             kNumThreads);
+    CHECK_EQ(Count(trace, "\"name\": \"inner span\", \"ph\": \"X\""),
+             10*kNumThreads);
+    CHECK_EQ(Count(trace, "\"name\": \"num_tracks\", \"ph\": \"C\""),
+             kNumThreads);
+    CHECK_EQ(Count(trace, "\"args\": {\"value\": null}"), 1);
+    for (int t = 0; t < kNumThreads; t++)
+    {
+        CHECK_EQ(Count(trace, "\"args\": {\"name\": \"worker \\\"" +
+                       std::to_string(t) + "\\\"\"}"), 1);
+    }
+}
+
+}  // namespace
+
+int main(int argc, char* argv[])
+{
+    google::InitGoogleLogging(argv[0]);
+    FLAGS_logtostderr = true;
+
+    TestRecordsNothingWhileOff();
+    TestRecordsEveryThread();
+    LOG(INFO) << "The trace keeps the spans of every thread.";
+    return 0;
+}
@@ -0,0 +1,157 @@
+// Calibrates many independent captures, e.g. all robot cells of a night, in
+// one process that shares a bounded set of threads between them, see
+// HandEyeCalibrationService. Every line of --jobs_file is one job:
+//
+//   name priority hand_poses_file images image_wildcard [calibration_file]
+//   name priority hand_poses_file matches matches_file
+//
+// Lines starting with # are skipped. Images are named by the index of their
+// hand pose, as for SHECAR. Jobs of a higher priority go first. As every job
+// completes, its reconstruction and X are written to
+// <output_directory>/<name>_reconstruction and <name>_hand_eye.txt, and a
+// CSV line with its diagnostics is printed. The exit code is 1 if a job
+// failed.
+
+#include <glog/logging.h>
+#include <gflags/gflags.h>
+#include <theia/theia.h>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "../handeye_calibration_service.h"
+#include "../handeyecalibration_utils.h"
+#include "../type.h"
+
+DEFINE_string(jobs_file, "", "One calibration job per line, see above.");
+DEFINE_string(output_directory, "", "Directory to write the results to.");
+DEFINE_int32(num_threads, 0,
+             "Threads shared by all jobs, 0 for one per core.");
+DEFINE_int32(num_threads_per_stage, 1,
+             "Threads of each feature extraction and matching or estimation "
+             "stage.");
+DEFINE_bool(use_hand_eye_front_end, false,
+            "Extract and match features with the hand-eye front end.");
+DEFINE_bool(shared_calibration, false,
+            "Share one set of intrinsics between the views of a job.");
+
+namespace
+{
+
+// Parses one line of --jobs_file and reads the inputs of the job.
+std::unique_ptr<HandEyeCalibrationJob> ReadJob(const std::string& line)
+{
+    std::istringstream fields(line);
+    std::unique_ptr<HandEyeCalibrationJob> job(new HandEyeCalibrationJob);
+    std::string hand_poses_file, input_type, input, calibration_file;
+    if (!(fields >> job->name >> job->priority >> hand_poses_file >> input_type
+            >> input))
+    {
+        LOG(ERROR) << "Could not parse the job " << line;
+        return nullptr;
+    }
+    fields >> calibration_file;
+
+    job->options.builder_options = DefaultHandEyeBuilderOptions();
+    job->options.use_hand_eye_front_end = FLAGS_use_hand_eye_front_end;
+    job->options.shared_calibration = FLAGS_shared_calibration;
+    bool read;
+    if (input_type == "images")
+    {
+        read = ReadHandEyeCalibrationFrames(hand_poses_file, input,
+                                            calibration_file, &job->frames);
+    }
+    else if (input_type == "matches")
+    {
+        job->calibrate_from_matches = true;
+        read = ReadHandEyeCalibrationFramesFromMatches(
+                   hand_poses_file, input, &job->frames, &job->matches);
+    }
+    else
+    {
+        LOG(ERROR) << "The input of a job must be images or matches, not "
+                   << input_type;
+        read = false;
+    }
+    if (!read)
+    {
+        return nullptr;
+    }
+    return job;
+}
+
+// Writes the results of the job and returns its CSV line.
+std::string WriteJobResult(const HandEyeCalibrationJobResult& job_result)
+{
+    const HandEyeCalibrationResult& result = job_result.result;
+    const std::string prefix =
+        FLAGS_output_directory + "/" + job_result.name + "_";
+    if (result.reconstruction != nullptr)
+    {
+        CHECK(WriteReconstruction(*result.reconstruction,
+                                  prefix + "reconstruction"))
+                << "Could not write the reconstruction of " << job_result.name;
+        CHECK(WriteHandPoses(prefix + "hand_eye.txt",
+                             Poses(1, result.handeye.GetHandEyePose())));
+    }
+    std::ostringstream line;
+    line << job_result.name << "," << job_result.success << ","
+         << job_result.latency_seconds << "," << result.total_time_seconds << ","
+         << result.num_estimated_views << "," << result.num_input_views << ","
+         << result.num_estimated_tracks << ","
+         << result.mean_reprojection_error_pixels;
+    return line.str();
+}
+
+}  // namespace
+
+int main(int argc, char *argv[])
+{
+    google::ParseCommandLineFlags(&argc, &argv, true);
+    google::InitGoogleLogging(argv[0]);
+    CHECK_GT(FLAGS_jobs_file.size(), 0) << "Please set --jobs_file.";
+    CHECK_GT(FLAGS_output_directory.size(), 0)
+            << "Please set --output_directory.";
+    CHECK(DirectoryExists(FLAGS_output_directory) ||
+          CreateNewDirectory(FLAGS_output_directory))
+            << "Could not create " << FLAGS_output_directory;
+
+    HandEyeCalibrationServiceOptions options;
+    options.num_threads = FLAGS_num_threads;
+    options.num_threads_per_stage = FLAGS_num_threads_per_stage;
+    HandEyeCalibrationService service(options);
+
+    // Jobs start as soon as they are read.
+    std::ifstream jobs_file(FLAGS_jobs_file);
+    CHECK(jobs_file.is_open()) << "Could not open " << FLAGS_jobs_file;
+    bool all_succeeded = true;
+    std::string line;
+    while (std::getline(jobs_file, line))
+    {
+        if (line.empty() || line[0] == '#')
+        {
+            continue;
+        }
+        std::unique_ptr<HandEyeCalibrationJob> job = ReadJob(line);
+        if (job == nullptr)
+        {
+            all_succeeded = false;
+            continue;
+        }
+        service.Submit(std::move(job));
+    }
+
+    std::cout << "name,success,latency_seconds,time_seconds,estimated_views,"
+              "views,estimated_tracks,mean_reprojection_error_pixels"
+              << std::endl;
+    while (const std::unique_ptr<HandEyeCalibrationJobResult> result =
+                service.WaitForNextResult())
+    {
+        std::cout << WriteJobResult(*result) << std::endl;
+        all_succeeded = all_succeeded && result->success;
+    }
+    return all_succeeded ? 0 : 1;
+}
@@ -0,0 +1,179 @@
+// Generates a synthetic hand-eye capture of any size, for scaling and accuracy
+// tests of the whole pipeline without images. The output directory gets
+//
+//   handposes.txt          the hand poses, in the --hand_poses_file format,
+//   hand_eye.txt           the ground truth X, in the same format,
+//   intrinsics.txt         the intrinsics, in the --calibration_file format,
+//   matches.bin            the views, their intrinsics and the verified
+//                          matches with their two-view geometry, for
+//                          --matches_file,
+//   ground_truth.bin       the ground truth reconstruction, unless
+//                          --write_ground_truth_reconstruction=false.
+//
+// The same flags always produce the same files. Views are named by the index
+// of their hand pose. For thousands of views use --path_length, so that every
+// view only sees a stretch of the scene, and --max_view_distance, so that
+// only views close on the path are matched, as a sequential capture would be.
+
+#include <glog/logging.h>
+#include <gflags/gflags.h>
+#include <theia/theia.h>
+#include <fstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "../handeyecalibration_utils.h"
+#include "../synthetic_scene.h"
+#include "../type.h"
+
+DEFINE_string(output_directory, "", "Directory to write the scene to.");
+DEFINE_int32(num_views, 100, "Number of views, i.e. of hand poses.");
+DEFINE_int32(num_points, 20000,
+             "Number of 3D points. Points seen by less than two views are "
+             "dropped.");
+DEFINE_double(path_length, 0.0,
+              "Length of the stretch of the x axis the cameras look at. 0 "
+              "puts all cameras around one cube of points.");
+DEFINE_double(camera_distance, 1.0,
+              "Distance of the cameras to the points they look at.");
+DEFINE_double(scene_size, 0.6, "Edge of the cube the points are drawn from.");
+DEFINE_double(max_viewing_angle_degrees, 35.0,
+              "Maximal angle between a viewing direction and the z axis.");
+DEFINE_int32(image_width, 1280, "Image width in pixels.");
+DEFINE_int32(image_height, 960, "Image height in pixels.");
+DEFINE_double(focal_length, 1000.0, "Focal length in pixels.");
+DEFINE_string(hand_eye, "",
+              "Ground truth X, in the --hand_poses_file format. A fixed "
+              "transformation with a 0.3 rad rotation if empty.");
+DEFINE_double(pixel_noise, 0.5,
+              "Standard deviation in pixels of the noise of the features.");
+DEFINE_double(outlier_ratio, 0.0,
+              "Fraction of the matches replaced by a random feature in the "
+              "second image.");
+DEFINE_double(relative_rotation_noise_degrees, 0.0,
+              "Standard deviation of the noise of the relative rotations "
+              "about each axis.");
+DEFINE_double(outlier_pair_ratio, 0.0,
+              "Fraction of the view pairs given a random relative pose.");
+DEFINE_int32(max_view_distance, 0,
+             "Only match views i and j with |i - j| <= max_view_distance. 0 "
+             "matches every pair of views sharing points.");
+DEFINE_int32(min_num_matches, 30,
+             "View pairs sharing fewer points are not written.");
+DEFINE_bool(write_ground_truth_reconstruction, true,
+            "Write the ground truth reconstruction to ground_truth.bin.");
+DEFINE_int32(seed, 0, "Seed of the random number generator.");
+
+namespace
+{
+
+// One line per view in the format of --calibration_file:
+// name focal_length principal_point_x principal_point_y aspect_ratio skew k1 k2
+bool WriteIntrinsics(const std::string& filename,
+                     const Reconstruction& reconstruction)
+{
+    std::ofstream outdata(filename);
+    for (ViewId view_id = 0; view_id < reconstruction.NumViews(); view_id++)
+    {
+        const View* view = reconstruction.View(view_id);
+        const CameraIntrinsicsPrior& prior = view->CameraIntrinsicsPrior();
+        outdata << view->Name() << " " << prior.focal_length.value[0] << " "
+                << prior.principal_point.value[0] << " "
+                << prior.principal_point.value[1] << " "
+                << prior.aspect_ratio.value[0] << " " << prior.skew.value[0] << " "
+                << prior.radial_distortion.value[0] << " "
+                << prior.radial_distortion.value[1] << "\n";
+    }
+    return outdata.good();
+}
+
+}  // namespace
+
+int main(int argc, char *argv[])
+{
+    google::ParseCommandLineFlags(&argc, &argv, true);
+    google::InitGoogleLogging(argv[0]);
+    CHECK_GT(FLAGS_output_directory.size(), 0)
+            << "Please set --output_directory.";
+    CHECK_GE(FLAGS_num_views, 2);
+
+    SyntheticSceneOptions options;
+    options.num_views = FLAGS_num_views;
+    options.num_points = FLAGS_num_points;
+    options.path_length = FLAGS_path_length;
+    options.camera_distance = FLAGS_camera_distance;
+    options.scene_size = FLAGS_scene_size;
+    options.max_viewing_angle_degrees = FLAGS_max_viewing_angle_degrees;
+    options.image_width = FLAGS_image_width;
+    options.image_height = FLAGS_image_height;
+    options.focal_length = FLAGS_focal_length;
+    options.pixel_noise = FLAGS_pixel_noise;
+    options.seed = FLAGS_seed;
+    if (FLAGS_hand_eye.size() != 0)
+    {
+        Poses handeye;
+        CHECK(ReadHandPoses(FLAGS_hand_eye, &handeye) && handeye.size() == 1)
+                << "Could not read the hand-eye transformation in "
+                << FLAGS_hand_eye;
+        options.handeye = handeye[0];
+    }
+
+    Timer timer;
+    SyntheticScene scene;
+    Reconstruction reconstruction;
+    GenerateSyntheticScene(options, &scene, &reconstruction);
+    int num_observations = 0;
+    for (const ViewId view_id : reconstruction.ViewIds())
+    {
+        num_observations += reconstruction.View(view_id)->NumFeatures();
+    }
+    LOG(INFO) << "Generated " << reconstruction.NumViews() << " views, "
+              << reconstruction.NumTracks() << " tracks and " << num_observations
+              << " observations in " << timer.ElapsedTimeInSeconds() << "s.";
+
+    SyntheticMatchesOptions matches_options;
+    matches_options.outlier_ratio = FLAGS_outlier_ratio;
+    matches_options.relative_rotation_noise_degrees =
+        FLAGS_relative_rotation_noise_degrees;
+    matches_options.outlier_pair_ratio = FLAGS_outlier_pair_ratio;
+    matches_options.max_view_distance = FLAGS_max_view_distance;
+    matches_options.min_num_matches = FLAGS_min_num_matches;
+    // A stream of its own, so that the matches do not change the scene.
+    matches_options.seed = FLAGS_seed + 1;
+    const std::vector<ImagePairMatch> matches =
+        GenerateSyntheticMatches(matches_options, reconstruction);
+    LOG(INFO) << matches.size() << " view pairs have at least "
+              << FLAGS_min_num_matches << " matches.";
+
+    std::vector<std::string> image_files;
+    std::vector<CameraIntrinsicsPrior> priors;
+    for (ViewId view_id = 0; view_id < reconstruction.NumViews(); view_id++)
+    {
+        image_files.emplace_back(reconstruction.View(view_id)->Name());
+        priors.emplace_back(reconstruction.View(view_id)->CameraIntrinsicsPrior());
+    }
+
+    const std::string directory = FLAGS_output_directory + "/";
+    CHECK(theia::DirectoryExists(FLAGS_output_directory) ||
+          theia::CreateNewDirectory(FLAGS_output_directory))
+            << "Could not create " << FLAGS_output_directory;
+    CHECK(WriteHandPoses(directory + "handposes.txt", scene.handposes));
+    CHECK(WriteHandPoses(directory + "hand_eye.txt", Poses(1, scene.handeye)));
+    CHECK(WriteIntrinsics(directory + "intrinsics.txt", reconstruction));
+    CHECK(theia::WriteMatchesAndGeometry(directory + "matches.bin", image_files,
+                                         priors, matches))
+            << "Could not write the matches.";
+    if (FLAGS_write_ground_truth_reconstruction)
+    {
+        CHECK(theia::WriteReconstruction(reconstruction,
+                                         directory + "ground_truth.bin"))
+                << "Could not write the ground truth reconstruction.";
+    }
+    LOG(INFO) << "Wrote the scene to " << FLAGS_output_directory << " in "
+              << timer.ElapsedTimeInSeconds() << "s. Calibrate it with\n"
+              << "SHECAR --matches_file=" << directory << "matches.bin"
+              << " --hand_poses_file=" << directory << "handposes.txt"
+              << " --output_reconstruction=<file>";
+    return 0;
+}
@@ -0,0 +1,66 @@
+// Sends one request to shecar_daemon and prints its answer, e.g.
+//
+//   shecar_client calibrate cell7 data/monocular/handposes.txt \
+//       "data/monocular/*.jpg" results/cell7 data/monocular/intrinsic.txt
+//   shecar_client status
+//
+// The exit code is 0 if the daemon answered "ok".
+
+#include <glog/logging.h>
+#include <gflags/gflags.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+DEFINE_string(socket_path, "/tmp/shecar.sock", "Unix socket of the daemon.");
+
+int main(int argc, char *argv[])
+{
+    google::SetUsageMessage(
+        "shecar_client calibrate|evict|status|shutdown [ARGUMENTS]");
+    google::ParseCommandLineFlags(&argc, &argv, true);
+    google::InitGoogleLogging(argv[0]);
+    CHECK_GT(argc, 1) << "Please give a request.";
+
+    std::string request;
+    for (int i = 1; i < argc; i++)
+    {
+        request += (i > 1 ? " " : "") + std::string(argv[i]);
+    }
+    request += "\n";
+
+    sockaddr_un address;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    CHECK_LT(FLAGS_socket_path.size(), sizeof(address.sun_path))
+            << "Socket path too long: " << FLAGS_socket_path;
+    std::strcpy(address.sun_path, FLAGS_socket_path.c_str());
+    const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    CHECK(fd >= 0 && connect(fd, reinterpret_cast<const sockaddr*>(&address),
+                             sizeof(address)) == 0)
+            << "Could not connect to the daemon on " << FLAGS_socket_path;
+
+    size_t num_sent = 0;
+    while (num_sent < request.size())
+    {
+        const ssize_t n = send(fd, request.data() + num_sent,
+                               request.size() - num_sent, MSG_NOSIGNAL);
+        CHECK_GT(n, 0) << "Could not send the request.";
+        num_sent += n;
+    }
+
+    // The daemon closes the connection after the answer.
+    std::string response;
+    char buffer[4096];
+    ssize_t n;
+    while ((n = recv(fd, buffer, sizeof(buffer), 0)) > 0)
+    {
+        response.append(buffer, n);
+    }
+    close(fd);
+    std::cout << response;
+    return response.compare(0, 2, "ok") == 0 ? 0 : 1;
+}
@@ -0,0 +1,292 @@
+// Long-running calibration daemon on a local Unix socket. It keeps the
+// features, the verified matches and the last X of every robot cell it
+// calibrated in memory, bounded by --cache_size_mb with the least recently
+// used cells evicted first. Recalibrating a cell that changed
+// little thus only extracts the new images and matches the pairs with a new
+// image, and the last X guides the matching and replaces RANSAC when the new
+// motion pairs agree with it. Every connection carries one
+// request line, see shecar_client:
+//
+//   calibrate CELL HAND_POSES_FILE IMAGE_WILDCARD OUTPUT_PREFIX [CALIBRATION_FILE]
+//   evict CELL
+//   status
+//   shutdown
+//
+// The answer is "ok" or "error MESSAGE" followed by "key value" lines, then
+// the connection is closed. A calibration writes
+// OUTPUT_PREFIX_reconstruction and OUTPUT_PREFIX_hand_eye.txt. Requests are
+// served one at a time, each with all --num_threads.
+
+#include <glog/logging.h>
+#include <gflags/gflags.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <theia/theia.h>
+#include <cstring>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "../calibration_cell_cache.h"
+#include "../handeye_calibration.h"
+#include "../handeyecalibration_utils.h"
+
+DEFINE_string(socket_path, "/tmp/shecar.sock", "Unix socket to listen on.");
+DEFINE_int32(cache_size_mb, 2048,
+             "Bound on the estimated memory of the cached cells.");
+DEFINE_int32(num_threads, 1, "Threads of every calibration.");
+DEFINE_int32(feature_extraction_downscale, 1,
+             "Extract features from JPEG images decoded at 1/N resolution.");
+DEFINE_string(feature_cache_directory, "",
+              "Also cache the features on disk in this existing directory, "
+              "e.g. across restarts.");
+DEFINE_bool(guided_matching, true,
+            "Match along the epipolar lines predicted from the last X of the "
+            "cell.");
+DEFINE_bool(shared_calibration, false,
+            "Share one set of intrinsics between the views of a cell.");
+
+namespace
+{
+
+// Longest accepted request line.
+const size_t kMaxRequestSize = 64*1024;
+
+HandEyeCalibrationOptions DaemonCalibrationOptions()
+{
+    HandEyeCalibrationOptions options;
+    options.builder_options = DefaultHandEyeBuilderOptions();
+    options.builder_options.num_threads = FLAGS_num_threads;
+    options.builder_options.reconstruction_estimator_options.num_threads =
+        FLAGS_num_threads;
+    options.shared_calibration = FLAGS_shared_calibration;
+    // Only the hand-eye front end keeps features and matches in memory.
+    options.use_hand_eye_front_end = true;
+    HandEyeFeatureFrontEndOptions& front_end_options = options.front_end_options;
+    front_end_options.num_threads = FLAGS_num_threads;
+    front_end_options.extraction_downscale = FLAGS_feature_extraction_downscale;
+    front_end_options.feature_cache_directory = FLAGS_feature_cache_directory;
+    front_end_options.guided_matching = FLAGS_guided_matching;
+    front_end_options.geometric_verification_options =
+        options.builder_options.matching_options.geometric_verification_options;
+    front_end_options.min_num_inlier_matches =
+        options.builder_options.min_num_inlier_matches;
+    return options;
+}
+
+std::string Calibrate(const std::vector<std::string>& request,
+                      CalibrationCellCache* cells)
+{
+    if (request.size() != 5 && request.size() != 6)
+    {
+        return "error usage: calibrate CELL HAND_POSES_FILE IMAGE_WILDCARD "
+               "OUTPUT_PREFIX [CALIBRATION_FILE]\n";
+    }
+    const std::string& output_prefix = request[4];
+    HandEyeCalibrationFrames frames;
+    if (!ReadHandEyeCalibrationFrames(request[2], request[3],
+                                      request.size() == 6 ? request[5] : "",
+                                      &frames))
+    {
+        return "error Could not read the images and hand poses.\n";
+    }
+
+    const std::shared_ptr<CalibrationCell> cell = cells->Cell(request[1]);
+    HandEyeCalibrationOptions options = DaemonCalibrationOptions();
+    options.front_end_options.memory_cache = &cell->feature_cache;
+    if (cell->has_handeye)
+    {
+        options.has_initial_hand_eye = true;
+        options.initial_hand_eye = cell->handeye;
+    }
+    HandEyeCalibrationResult result;
+    cell->feature_cache.BeginCalibration();
+    const bool success = CalibrateHandEye(options, frames, &result);
+    cell->feature_cache.EndCalibration();
+    cell->num_calibrations++;
+    const FeatureMemoryCacheStatistics statistics =
+        cell->feature_cache.Statistics();
+
+    std::ostringstream response;
+    if (result.reconstruction == nullptr)
+    {
+        cells->Shrink();
+        response << "error Could not calibrate the cell " << cell->name << ". "
+                 << result.message << "\n";
+        return response.str();
+    }
+    const std::string reconstruction_file = output_prefix + "_reconstruction";
+    const std::string hand_eye_file = output_prefix + "_hand_eye.txt";
+    const Pose handeye = result.handeye.GetHandEyePose();
+    if (!WriteReconstruction(*result.reconstruction, reconstruction_file) ||
+            !WriteHandPoses(hand_eye_file, Poses(1, handeye)))
+    {
+        return "error Could not write to " + output_prefix + ".\n";
+    }
+    // A failed estimate must not become the prior of the next calibrations.
+    if (success)
+    {
+        cell->has_handeye = true;
+        cell->handeye = handeye;
+    }
+    cells->Shrink();
+
+    response << "ok\n"
+             << "success " << success << "\n"
+             << "time_seconds " << result.total_time_seconds << "\n"
+             << "views " << result.num_input_views << "\n"
+             << "estimated_views " << result.num_estimated_views << "\n"
+             << "estimated_tracks " << result.num_estimated_tracks << "\n"
+             << "mean_reprojection_error_pixels "
+             << result.mean_reprojection_error_pixels << "\n"
+             << "warm_started " << result.warm_started << "\n"
+             << "feature_cache_hits " << statistics.num_feature_hits << "\n"
+             << "feature_cache_misses " << statistics.num_feature_misses << "\n"
+             << "match_cache_hits " << statistics.num_match_hits << "\n"
+             << "match_cache_misses " << statistics.num_match_misses << "\n"
+             << "reconstruction_file " << reconstruction_file << "\n"
+             << "hand_eye_file " << hand_eye_file << "\n";
+    return response.str();
+}
+
+std::string Status(const CalibrationCellCache& cells)
+{
+    std::ostringstream response;
+    const std::vector<std::string> names = cells.CellNames();
+    response << "ok\n"
+             << "cells " << names.size() << "\n"
+             << "cache_bytes " << cells.NumBytes() << "\n";
+    for (const std::string& name : names)
+    {
+        response << "cell " << name << "\n";
+    }
+    return response.str();
+}
+
+// Answers one request. Sets shutdown if the daemon should stop.
+std::string HandleRequest(const std::string& line, CalibrationCellCache* cells,
+                          bool* shutdown)
+{
+    std::istringstream fields(line);
+    std::vector<std::string> request;
+    std::string field;
+    while (fields >> field)
+    {
+        request.emplace_back(field);
+    }
+    if (request.empty())
+    {
+        return "error Empty request.\n";
+    }
+    LOG(INFO) << "Request: " << line;
+    if (request[0] == "calibrate")
+    {
+        return Calibrate(request, cells);
+    }
+    if (request[0] == "evict" && request.size() == 2)
+    {
+        return cells->Evict(request[1]) ? "ok\n" :
+               "error The cell " + request[1] + " is not cached.\n";
+    }
+    if (request[0] == "status")
+    {
+        return Status(*cells);
+    }
+    if (request[0] == "shutdown")
+    {
+        *shutdown = true;
+        return "ok\n";
+    }
+    return "error Unknown request " + request[0] + ".\n";
+}
+
+// Reads up to the first newline or the end of the stream.
+bool ReadRequest(const int fd, std::string* line)
+{
+    char buffer[4096];
+    while (line->size() < kMaxRequestSize)
+    {
+        const ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+        if (n < 0)
+        {
+            return false;
+        }
+        if (n == 0)
+        {
+            return true;
+        }
+        line->append(buffer, n);
+        const size_t newline = line->find('\n');
+        if (newline != std::string::npos)
+        {
+            line->resize(newline);
+            return true;
+        }
+    }
+    return false;
+}
+
+void SendResponse(const int fd, const std::string& text)
+{
+    size_t num_sent = 0;
+    while (num_sent < text.size())
+    {
+        const ssize_t n = send(fd, text.data() + num_sent, text.size() - num_sent,
+                               MSG_NOSIGNAL);
+        if (n <= 0)
+        {
+            return;
+        }
+        num_sent += n;
+    }
+}
+
+int Listen(const std::string& socket_path)
+{
+    sockaddr_un address;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    CHECK_LT(socket_path.size(), sizeof(address.sun_path))
+            << "Socket path too long: " << socket_path;
+    std::strcpy(address.sun_path, socket_path.c_str());
+
+    const int server_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    CHECK_GE(server_fd, 0) << "Could not create the socket.";
+    // A socket left behind by an earlier run would make bind fail.
+    unlink(socket_path.c_str());
+    CHECK(bind(server_fd, reinterpret_cast<const sockaddr*>(&address),
+               sizeof(address)) == 0 && listen(server_fd, 8) == 0)
+            << "Could not listen on " << socket_path;
+    return server_fd;
+}
+
+}  // namespace
+
+int main(int argc, char *argv[])
+{
+    google::ParseCommandLineFlags(&argc, &argv, true);
+    google::InitGoogleLogging(argv[0]);
+
+    CalibrationCellCache cells(static_cast<size_t>(FLAGS_cache_size_mb) << 20);
+    const int server_fd = Listen(FLAGS_socket_path);
+    LOG(INFO) << "Listening on " << FLAGS_socket_path;
+    bool shutdown = false;
+    while (!shutdown)
+    {
+        const int client_fd = accept(server_fd, nullptr, nullptr);
+        if (client_fd < 0)
+        {
+            continue;
+        }
+        std::string request;
+        SendResponse(client_fd, ReadRequest(client_fd, &request) ?
+                     HandleRequest(request, &cells, &shutdown) :
+                     "error Could not read the request.\n");
+        close(client_fd);
+    }
+    close(server_fd);
+    unlink(FLAGS_socket_path.c_str());
+    return 0;
+}
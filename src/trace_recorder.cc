@@ -0,0 +1,207 @@
+#include "trace_recorder.h"
+
+#include <chrono>  // NOLINT
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>  // NOLINT
+#include <sstream>
+#include <vector>
+
+namespace internal
+{
+std::atomic<bool> tracing_enabled(false);
+}
+
+namespace
+{
+
+struct TraceEvent
+{
+    std::string name;
+    // 'X' for a complete span, 'C' for a counter.
+    char phase;
+    int64_t timestamp_ns;
+    int64_t duration_ns;
+    double value;
+};
+
+struct ThreadTrace
+{
+    int thread_id;
+    std::string thread_name;
+    // Only contended while a trace is started or written.
+    std::mutex mutex;
+    std::vector<TraceEvent> events;
+};
+
+std::mutex& RegistryMutex()
+{
+    static std::mutex mutex;
+    return mutex;
+}
+
+std::vector<std::unique_ptr<ThreadTrace> >& Registry()
+{
+    static std::vector<std::unique_ptr<ThreadTrace> > registry;
+    return registry;
+}
+
+int64_t NowNs()
+{
+    static const std::chrono::steady_clock::time_point start =
+        std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now() - start).count();
+}
+
+ThreadTrace* LocalThreadTrace()
+{
+    thread_local ThreadTrace* local = nullptr;
+    if (local == nullptr)
+    {
+        std::lock_guard<std::mutex> lock(RegistryMutex());
+        Registry().emplace_back(new ThreadTrace);
+        local = Registry().back().get();
+        local->thread_id = Registry().size();
+    }
+    return local;
+}
+
+void AddEvent(TraceEvent&& event)
+{
+    ThreadTrace* trace = LocalThreadTrace();
+    std::lock_guard<std::mutex> lock(trace->mutex);
+    trace->events.emplace_back(std::move(event));
+}
+
+}  // namespace
+
+void StartTracing()
+{
+    std::lock_guard<std::mutex> lock(RegistryMutex());
+    for (auto& trace : Registry())
+    {
+        std::lock_guard<std::mutex> trace_lock(trace->mutex);
+        trace->events.clear();
+    }
+    NowNs();
+    internal::tracing_enabled.store(true);
+}
+
+bool WriteTrace(const std::string& filepath)
+{
+    internal::tracing_enabled.store(false);
+    std::ofstream file(filepath);
+    if (!file.is_open())
+    {
+        return false;
+    }
+
+    // Timestamps are in microseconds.
+    file << std::fixed << std::setprecision(3) << "{\"traceEvents\": [";
+    bool first = true;
+    std::lock_guard<std::mutex> lock(RegistryMutex());
+    for (auto& trace : Registry())
+    {
+        std::lock_guard<std::mutex> trace_lock(trace->mutex);
+        if (trace->events.empty())
+        {
+            continue;
+        }
+        const std::string thread_name = trace->thread_name.empty() ?
+                                        "thread " + std::to_string(trace->thread_id) :
+                                        trace->thread_name;
+        file << (first ? "\n" : ",\n")
+             << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, "
+             << "\"tid\": " << trace->thread_id << ", \"args\": {\"name\": "
+             << JsonString(thread_name) << "}}";
+        first = false;
+        for (const TraceEvent& event : trace->events)
+        {
+            file << ",\n{\"name\": " << JsonString(event.name)
+                 << ", \"ph\": \"" << event.phase << "\", \"pid\": 1, \"tid\": "
+                 << trace->thread_id << ", \"ts\": " << 1e-3*event.timestamp_ns;
+            if (event.phase == 'X')
+            {
+                file << ", \"dur\": " << 1e-3*event.duration_ns << "}";
+            }
+            else
+            {
+                file << ", \"args\": {\"value\": " << JsonNumber(event.value)
+                     << "}}";
+            }
+        }
+    }
+    file << "\n], \"displayTimeUnit\": \"ms\"}\n";
+    return file.good();
+}
+
+void SetTraceThreadName(const std::string& name)
+{
+    if (!IsTracingEnabled())
+    {
+        return;
+    }
+    ThreadTrace* trace = LocalThreadTrace();
+    std::lock_guard<std::mutex> lock(trace->mutex);
+    trace->thread_name = name;
+}
+
+void TraceCounter(const std::string& name, const double value)
+{
+    if (!IsTracingEnabled())
+    {
+        return;
+    }
+    AddEvent(TraceEvent{name, 'C', NowNs(), 0, value});
+}
+
+std::string JsonString(const std::string& str)
+{
+    std::string quoted = "\"";
+    for (const char c : str)
+    {
+        if (c == '"' || c == '\\')
+        {
+            quoted += '\\';
+            quoted += c;
+        }
+        else if (static_cast<unsigned char>(c) < 0x20)
+        {
+            char escaped[8];
+            snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            quoted += escaped;
+        }
+        else
+        {
+            quoted += c;
+        }
+    }
+    return quoted + "\"";
+}
+
+std::string JsonNumber(const double value)
+{
+    if (!std::isfinite(value))
+    {
+        return "null";
+    }
+    std::ostringstream number;
+    number << std::setprecision(9) << value;
+    return number.str();
+}
+
+void ScopedTraceSpan::Begin(const std::string& name)
+{
+    name_ = name;
+    start_ns_ = NowNs();
+}
+
+void ScopedTraceSpan::End()
+{
+    const int64_t end_ns = NowNs();
+    AddEvent(TraceEvent{std::move(name_), 'X', start_ns_, end_ns - start_ns_, 0.0});
+}
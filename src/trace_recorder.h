@@ -0,0 +1,84 @@
+#ifndef TRACE_RECORDER_H
+#define TRACE_RECORDER_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// Records per-thread spans and counters for the Chrome trace event format,
+// which chrome://tracing and Perfetto display as a timeline with one row per
+// thread. Tracing is process wide and off by default; while it is off a span
+// costs one relaxed atomic load.
+//
+// Every thread appends to its own buffer, so recording never contends with
+// other threads. The buffers outlive their threads, so spans of the short
+// lived ThreadPool workers are kept until WriteTrace.
+
+namespace internal
+{
+extern std::atomic<bool> tracing_enabled;
+}
+
+inline bool IsTracingEnabled()
+{
+    return internal::tracing_enabled.load(std::memory_order_relaxed);
+}
+
+// Discards all recorded events and starts recording.
+void StartTracing();
+
+// Stops recording and writes all events as a JSON trace to filepath.
+bool WriteTrace(const std::string& filepath);
+
+// Names the row of the calling thread in the timeline.
+void SetTraceThreadName(const std::string& name);
+
+// Records the value of a counter, drawn as a graph above the threads.
+void TraceCounter(const std::string& name, const double value);
+
+// The string quoted and escaped for JSON, also used by the profile report.
+std::string JsonString(const std::string& str);
+// The number for JSON, null if it is not finite, which JSON can not hold.
+std::string JsonNumber(const double value);
+
+// Records the enclosing scope as a span on the calling thread's row.
+class ScopedTraceSpan
+{
+public:
+    explicit ScopedTraceSpan(const char* name)
+        : enabled_(IsTracingEnabled())
+    {
+        if (enabled_)
+        {
+            Begin(name);
+        }
+    }
+    explicit ScopedTraceSpan(const std::string& name)
+        : enabled_(IsTracingEnabled())
+    {
+        if (enabled_)
+        {
+            Begin(name);
+        }
+    }
+    ~ScopedTraceSpan()
+    {
+        if (enabled_)
+        {
+            End();
+        }
+    }
+
+private:
+    void Begin(const std::string& name);
+    void End();
+
+    const bool enabled_;
+    std::string name_;
+    int64_t start_ns_ = 0;
+
+    ScopedTraceSpan(const ScopedTraceSpan&) = delete;
+    ScopedTraceSpan& operator=(const ScopedTraceSpan&) = delete;
+};
+
+#endif // TRACE_RECORDER_H
@@ -2,10 +2,89 @@
 #define TYPE_H
 
 #include<Eigen/Core>
+#include<Eigen/Geometry>
+#include<Eigen/StdVector>
+#include<glog/logging.h>
 #include<vector>
 
-typedef Eigen::Matrix4d Pose;
-//typedef std::pair<Eigen::Matrix3d, Eigen::Vector3d> Pose;
-typedef std::vector<Pose> Poses;
+// Rigid transformation x -> R*x+t, stored as a unit quaternion and a
+// translation. Compared to a homogeneous 4x4 matrix it needs half the memory
+// and has a closed form inverse and composition.
+class RigidTransform
+{
+public:
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+    RigidTransform()
+        : rotation_(Eigen::Quaterniond::Identity()),
+          translation_(Eigen::Vector3d::Zero()) {}
+    // The rotation must be close to orthonormal with determinant +1, a
+    // reflection would become an unrelated rotation.
+    RigidTransform(const Eigen::Matrix3d& rotation,
+                   const Eigen::Vector3d& translation)
+        : rotation_(rotation), translation_(translation)
+    {
+        DCHECK_NEAR(rotation.determinant(), 1.0, 1e-2)
+                << "Not a rotation:\n" << rotation;
+        rotation_.normalize();
+    }
+    // The quaternion must already be normalized.
+    RigidTransform(const Eigen::Quaterniond& rotation,
+                   const Eigen::Vector3d& translation)
+        : rotation_(rotation), translation_(translation) {}
+
+    static RigidTransform Identity()
+    {
+        return RigidTransform();
+    }
+
+    Eigen::Matrix3d Rotation() const
+    {
+        return rotation_.toRotationMatrix();
+    }
+    const Eigen::Quaterniond& Quaternion() const
+    {
+        return rotation_;
+    }
+    const Eigen::Vector3d& Translation() const
+    {
+        return translation_;
+    }
+    // Homogeneous 4x4 form, for output and interoperability only.
+    Eigen::Matrix4d Matrix() const
+    {
+        Eigen::Matrix4d matrix = Eigen::Matrix4d::Identity();
+        matrix.topLeftCorner(3,3) = Rotation();
+        matrix.topRightCorner(3,1) = translation_;
+        return matrix;
+    }
+
+    // (R,t)^-1 = (R',-R't)
+    RigidTransform Inverse() const
+    {
+        const Eigen::Quaterniond inverse_rotation = rotation_.conjugate();
+        return RigidTransform(inverse_rotation, -(inverse_rotation*translation_));
+    }
+    // (R1,t1)*(R2,t2) = (R1*R2,R1*t2+t1)
+    RigidTransform operator*(const RigidTransform& other) const
+    {
+        return RigidTransform(rotation_*other.rotation_,
+                              rotation_*other.translation_ + translation_);
+    }
+    Eigen::Vector3d operator*(const Eigen::Vector3d& point) const
+    {
+        return rotation_*point + translation_;
+    }
+
+private:
+    Eigen::Quaterniond rotation_;
+    Eigen::Vector3d translation_;
+};
+
+typedef RigidTransform Pose;
+typedef std::vector<Pose, Eigen::aligned_allocator<Pose> > Poses;
+
+// Plain std::vector<Pose> is still used by theia's Estimator interface.
+EIGEN_DEFINE_STL_VECTOR_SPECIALIZATION(Pose)
 
 #endif // TYPE_H